@@ -0,0 +1,1693 @@
+// accept4, pthread_getattr_np and dladdr, unless the LLVM compile definitions of the build brought it in
+// already
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "Runtime.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Pointer hash buckets of the heap profiler, which keeps a count of live samples per bucket
+#define JHEAP_BUCKETS (1 << 16)
+
+// The state jalloc and jfree look at on every call, the rest of the heap profiler is further down. The rate
+// is 0 while the profiler is off.
+static int64_t s_HeapRate = 0;
+static uint32_t s_HeapFilter[JHEAP_BUCKETS];
+static _Thread_local int64_t t_HeapCountdown = 0;
+
+static uint32_t jheap_bucket(const void *ptr)
+{
+    return (uint32_t)(((uint64_t)(uintptr_t)ptr * 0x9E3779B97F4A7C15ULL) >> 48);
+}
+
+static void jheap_sample(void *ptr, int64_t size, const JHeapSite *site, void **frame);
+static void jheap_forget(void *ptr);
+
+void *jalloc(int64_t size, const JHeapSite *site)
+{
+    void *ptr = malloc((size_t)size);
+
+    // An allocation that isn't sampled costs a load and a thread-local subtraction
+    if (__atomic_load_n(&s_HeapRate, __ATOMIC_RELAXED) != 0 && ptr && (t_HeapCountdown -= size) < 0)
+    {
+        jheap_sample(ptr, size, site, (void **)__builtin_frame_address(0));
+    }
+
+    return ptr;
+}
+
+void jfree(void *ptr)
+{
+    // Most pointers hash to a bucket without live samples, only the others take the profiler's lock
+    if (ptr && __atomic_load_n(&s_HeapFilter[jheap_bucket(ptr)], __ATOMIC_RELAXED) != 0)
+    {
+        jheap_forget(ptr);
+    }
+
+    free(ptr);
+}
+
+int32_t jout(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int32_t written = vprintf(format, args);
+    va_end(args);
+
+    return written;
+}
+
+void jbounds_fail(const char *file, int32_t line, int64_t index, int32_t length)
+{
+    fflush(stdout);
+    fprintf(stderr, "%s:%d: index %lld out of bounds for length %d\n", file, line, (long long)index, length);
+    abort();
+}
+
+int32_t jstr_compare(const char *lhs, int32_t lhsLength, const char *rhs, int32_t rhsLength)
+{
+    int32_t common = lhsLength < rhsLength ? lhsLength : rhsLength;
+    int order = common > 0 ? memcmp(lhs, rhs, (size_t)common) : 0;
+
+    if (order != 0)
+    {
+        return order < 0 ? -1 : 1;
+    }
+
+    return lhsLength < rhsLength ? -1 : lhsLength > rhsLength;
+}
+
+// Every allocation is rounded up to this, so the cursor stays aligned for any type the language has
+#define JARENA_ALIGNMENT 16
+#define JARENA_CHUNK_SIZE (64 * 1024)
+
+struct JArenaChunk
+{
+    JArenaChunk *next;
+    size_t size;
+};
+
+// The header is padded so the first allocation of a chunk is aligned like the ones after it
+#define JARENA_HEADER_SIZE \
+    ((sizeof(JArenaChunk) + JARENA_ALIGNMENT - 1) / JARENA_ALIGNMENT * JARENA_ALIGNMENT)
+
+JArena *jarena_new(void)
+{
+    return (JArena *)calloc(1, sizeof(JArena));
+}
+
+void *jarena_alloc(JArena *arena, int64_t size)
+{
+    size_t rounded = ((size_t)size + JARENA_ALIGNMENT - 1) & ~(size_t)(JARENA_ALIGNMENT - 1);
+
+    if ((size_t)(arena->limit - arena->cursor) < rounded)
+    {
+        // The rest of the current chunk is given up; take a chunk kept by jarena_reset if one is large
+        // enough, otherwise allocate a new one
+        JArenaChunk **link = &arena->freeChunks;
+
+        while (*link && (*link)->size - JARENA_HEADER_SIZE < rounded)
+        {
+            link = &(*link)->next;
+        }
+
+        JArenaChunk *chunk = *link;
+
+        if (chunk)
+        {
+            *link = chunk->next;
+        }
+        else
+        {
+            size_t chunkSize = JARENA_HEADER_SIZE + rounded;
+
+            if (chunkSize < JARENA_CHUNK_SIZE)
+            {
+                chunkSize = JARENA_CHUNK_SIZE;
+            }
+
+            chunk = (JArenaChunk *)malloc(chunkSize);
+
+            if (!chunk)
+            {
+                return NULL;
+            }
+
+            chunk->size = chunkSize;
+        }
+
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->cursor = (char *)chunk + JARENA_HEADER_SIZE;
+        arena->limit = (char *)chunk + chunk->size;
+    }
+
+    void *result = arena->cursor;
+    arena->cursor += rounded;
+
+    return result;
+}
+
+void jarena_reset(JArena *arena)
+{
+    while (arena->chunks)
+    {
+        JArenaChunk *chunk = arena->chunks;
+        arena->chunks = chunk->next;
+        chunk->next = arena->freeChunks;
+        arena->freeChunks = chunk;
+    }
+
+    arena->cursor = arena->limit = NULL;
+}
+
+void jarena_free(JArena *arena)
+{
+    if (!arena)
+    {
+        return;
+    }
+
+    jarena_reset(arena);
+
+    while (arena->freeChunks)
+    {
+        JArenaChunk *chunk = arena->freeChunks;
+        arena->freeChunks = chunk->next;
+        free(chunk);
+    }
+
+    free(arena);
+}
+
+typedef struct
+{
+    const char *name;
+    uint64_t hash;
+    uint64_t *counters;
+    uint32_t count;
+} ProfileRecord;
+
+static const char *s_ProfilePath = NULL;
+static ProfileRecord *s_Records = NULL;
+static size_t s_RecordCount = 0;
+static size_t s_RecordCapacity = 0;
+
+void jprof_init(const char *path)
+{
+    s_ProfilePath = path;
+}
+
+void jprof_register(const char *name, uint64_t hash, uint64_t *counters, uint32_t count)
+{
+    if (s_RecordCount == s_RecordCapacity)
+    {
+        size_t capacity = s_RecordCapacity ? s_RecordCapacity * 2 : 16;
+        ProfileRecord *records = (ProfileRecord *)realloc(s_Records, capacity * sizeof(ProfileRecord));
+
+        if (!records)
+        {
+            return;
+        }
+
+        s_Records = records;
+        s_RecordCapacity = capacity;
+    }
+
+    ProfileRecord *record = &s_Records[s_RecordCount++];
+    record->name = name;
+    record->hash = hash;
+    record->counters = counters;
+    record->count = count;
+}
+
+void jprof_write(void)
+{
+    // One line per function and run; the compiler sums the runs when it reads the file back
+    FILE *file = s_ProfilePath ? fopen(s_ProfilePath, "a") : NULL;
+
+    if (!file)
+    {
+        fprintf(stderr, "jprof: cannot write profile to %s\n", s_ProfilePath ? s_ProfilePath : "(null)");
+    }
+
+    for (size_t i = 0; file && i < s_RecordCount; ++i)
+    {
+        const ProfileRecord *record = &s_Records[i];
+        fprintf(file, "%s %llu %u", record->name, (unsigned long long)record->hash, record->count);
+
+        for (uint32_t j = 0; j < record->count; ++j)
+        {
+            fprintf(file, " %llu", (unsigned long long)record->counters[j]);
+        }
+
+        fputc('\n', file);
+    }
+
+    if (file)
+    {
+        fclose(file);
+    }
+
+    free(s_Records);
+    s_Records = NULL;
+    s_RecordCount = s_RecordCapacity = 0;
+}
+
+// The heap profiler follows tcmalloc's: a thread counts down the bytes it allocates from a random interval
+// with mean s_HeapRate and samples the allocation that takes it below zero. The intervals are exponentially
+// distributed, so an allocation of size bytes is sampled with probability 1 - exp(-size / rate), whatever
+// came before it, and each sample stands for 1 / that many allocations like it.
+#define JHEAP_MAX_DEPTH 64
+
+// Written on demand by kill -USR2 <pid>
+#define JHEAP_SIGNAL SIGUSR2
+
+// Chains of the stack table, which samples are grouped by as they are taken
+#define JHEAP_STACK_BUCKETS 4096
+
+// A site with the call stack leading to it, and the allocations sampled there, already scaled up to the
+// allocations they stand for: objects and bytes ever allocated, then objects and bytes still live
+typedef struct
+{
+    const JHeapSite *site;
+    uint32_t depth;
+
+    // Next stack in the same chain, -1 at the end of the chain
+    int32_t next;
+    double values[4];
+    void *frames[JHEAP_MAX_DEPTH];
+} JHeapStack;
+
+// A sampled allocation that wasn't freed yet; the slots of freed ones are reused
+typedef struct
+{
+    void *ptr;
+    double objects;
+    double bytes;
+    int32_t stack;
+
+    // Next live sample in the same bucket or next unused slot, -1 at the end of the chain
+    int32_t next;
+} JHeapSample;
+
+typedef struct
+{
+    uint64_t start;
+    uint64_t size;
+    char *name;
+} JHeapCode;
+
+static pthread_mutex_t s_HeapLock = PTHREAD_MUTEX_INITIALIZER;
+static char *s_HeapPath = NULL;
+static int64_t s_HeapStartTime = 0;
+static uint32_t s_HeapDumpCount = 0;
+static int s_HeapPipe[2] = {-1, -1};
+
+static JHeapStack *s_HeapStacks = NULL;
+static size_t s_HeapStackCount = 0;
+static size_t s_HeapStackCapacity = 0;
+static int32_t *s_HeapStackBuckets = NULL;
+
+static JHeapSample *s_HeapSamples = NULL;
+static size_t s_HeapSampleCount = 0;
+static size_t s_HeapSampleCapacity = 0;
+static int32_t s_HeapUnusedSample = -1;
+static int32_t *s_HeapBuckets = NULL;
+
+// Functions of JIT code, which dladdr can't name
+static JHeapCode *s_HeapCode = NULL;
+static size_t s_HeapCodeCount = 0;
+static size_t s_HeapCodeCapacity = 0;
+
+static _Thread_local uint64_t t_HeapRandom = 0;
+static _Thread_local uintptr_t t_StackLow = 0;
+static _Thread_local uintptr_t t_StackHigh = 0;
+
+static int64_t jheap_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int64_t jheap_next_interval(int64_t rate)
+{
+    // xorshift64*, seeded per thread
+    if (t_HeapRandom == 0)
+    {
+        t_HeapRandom = ((uint64_t)(uintptr_t)&t_HeapRandom ^ (uint64_t)jheap_now()) | 1;
+    }
+
+    t_HeapRandom ^= t_HeapRandom >> 12;
+    t_HeapRandom ^= t_HeapRandom << 25;
+    t_HeapRandom ^= t_HeapRandom >> 27;
+
+    // Uniform in (0, 1], so the logarithm stays finite
+    uint64_t bits = (t_HeapRandom * 0x2545F4914F6CDD1DULL) >> 11;
+    double uniform = (double)(bits + 1) * (1.0 / 9007199254740992.0);
+    double interval = -log(uniform) * (double)rate;
+
+    return interval < 1.0 ? 1 : (int64_t)interval;
+}
+
+// Return addresses from the frame pointer chain. Generated code keeps frame pointers while profiling, the
+// walk stops at the first frame outside the thread's stack or not above the previous one.
+static uint32_t jheap_backtrace(void **frame, void **frames)
+{
+    if (t_StackHigh == 0)
+    {
+        pthread_attr_t attributes;
+
+        if (pthread_getattr_np(pthread_self(), &attributes) == 0)
+        {
+            void *low = NULL;
+            size_t size = 0;
+
+            if (pthread_attr_getstack(&attributes, &low, &size) == 0)
+            {
+                t_StackLow = (uintptr_t)low;
+                t_StackHigh = (uintptr_t)low + size;
+            }
+
+            pthread_attr_destroy(&attributes);
+        }
+    }
+
+    uint32_t depth = 0;
+
+    while (depth < JHEAP_MAX_DEPTH && (uintptr_t)frame >= t_StackLow &&
+           (uintptr_t)(frame + 2) <= t_StackHigh && ((uintptr_t)frame & (sizeof(void *) - 1)) == 0)
+    {
+        void *returnAddress = frame[1];
+        void **next = (void **)frame[0];
+
+        if (!returnAddress)
+        {
+            break;
+        }
+
+        frames[depth++] = returnAddress;
+
+        if (next <= frame)
+        {
+            break;
+        }
+
+        frame = next;
+    }
+
+    return depth;
+}
+
+// Makes room for one more element of an array that grows by doubling
+static void jheap_reserve(void **elements, size_t *capacity, size_t count, size_t elementSize)
+{
+    if (count < *capacity)
+    {
+        return;
+    }
+
+    size_t grown = *capacity ? *capacity * 2 : 256;
+    void *reallocated = realloc(*elements, grown * elementSize);
+
+    if (!reallocated)
+    {
+        abort();
+    }
+
+    *elements = reallocated;
+    *capacity = grown;
+}
+
+static uint32_t jheap_stack_bucket(const JHeapSite *site, void *const *frames, uint32_t depth)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)site;
+
+    for (uint32_t i = 0; i < depth; ++i)
+    {
+        hash = (hash ^ (uint64_t)(uintptr_t)frames[i]) * 0x100000001B3ULL;
+    }
+
+    return (uint32_t)((hash * 0x9E3779B97F4A7C15ULL) >> 52);
+}
+
+// Index of the stack for site and frames, added when it is new. Called with s_HeapLock held.
+static int32_t jheap_find_stack(uint32_t bucket, const JHeapSite *site, void *const *frames, uint32_t depth)
+{
+    for (int32_t index = s_HeapStackBuckets[bucket]; index >= 0; index = s_HeapStacks[index].next)
+    {
+        const JHeapStack *stack = &s_HeapStacks[index];
+
+        if (stack->site == site && stack->depth == depth &&
+            memcmp(stack->frames, frames, depth * sizeof(void *)) == 0)
+        {
+            return index;
+        }
+    }
+
+    jheap_reserve((void **)&s_HeapStacks, &s_HeapStackCapacity, s_HeapStackCount, sizeof(JHeapStack));
+
+    JHeapStack *stack = &s_HeapStacks[s_HeapStackCount];
+    memset(stack, 0, sizeof(JHeapStack));
+    stack->site = site;
+    stack->depth = depth;
+    stack->next = s_HeapStackBuckets[bucket];
+    memcpy(stack->frames, frames, depth * sizeof(void *));
+
+    s_HeapStackBuckets[bucket] = (int32_t)s_HeapStackCount;
+    return (int32_t)s_HeapStackCount++;
+}
+
+static void jheap_sample(void *ptr, int64_t size, const JHeapSite *site, void **frame)
+{
+    int64_t rate = __atomic_load_n(&s_HeapRate, __ATOMIC_RELAXED);
+
+    if (rate == 0)
+    {
+        return;
+    }
+
+    // The countdown starts at zero, the first allocation of a thread only draws its first interval
+    bool isFirst = t_HeapRandom == 0;
+    t_HeapCountdown = jheap_next_interval(rate) - (isFirst ? size : 0);
+
+    if (isFirst && t_HeapCountdown >= 0)
+    {
+        return;
+    }
+
+    // The site names the function that called jalloc, so the walk starts at that function's caller
+    void *frames[JHEAP_MAX_DEPTH];
+    uint32_t depth = jheap_backtrace(site ? (void **)frame[0] : frame, frames);
+    uint32_t stackBucket = jheap_stack_bucket(site, frames, depth);
+
+    double objects = 1.0 / (1.0 - exp(-(double)size / (double)rate));
+    double bytes = objects * (double)size;
+
+    pthread_mutex_lock(&s_HeapLock);
+
+    // jheap_stop may have run since the rate was read
+    if (!s_HeapBuckets)
+    {
+        pthread_mutex_unlock(&s_HeapLock);
+        return;
+    }
+
+    int32_t stackIndex = jheap_find_stack(stackBucket, site, frames, depth);
+    JHeapStack *stack = &s_HeapStacks[stackIndex];
+    stack->values[0] += objects;
+    stack->values[1] += bytes;
+    stack->values[2] += objects;
+    stack->values[3] += bytes;
+
+    int32_t sampleIndex = s_HeapUnusedSample;
+
+    if (sampleIndex >= 0)
+    {
+        s_HeapUnusedSample = s_HeapSamples[sampleIndex].next;
+    }
+    else
+    {
+        jheap_reserve((void **)&s_HeapSamples, &s_HeapSampleCapacity, s_HeapSampleCount, sizeof(JHeapSample));
+        sampleIndex = (int32_t)s_HeapSampleCount++;
+    }
+
+    uint32_t bucket = jheap_bucket(ptr);
+    JHeapSample *sample = &s_HeapSamples[sampleIndex];
+    sample->ptr = ptr;
+    sample->objects = objects;
+    sample->bytes = bytes;
+    sample->stack = stackIndex;
+    sample->next = s_HeapBuckets[bucket];
+
+    s_HeapBuckets[bucket] = sampleIndex;
+    __atomic_add_fetch(&s_HeapFilter[bucket], 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&s_HeapLock);
+}
+
+static void jheap_forget(void *ptr)
+{
+    uint32_t bucket = jheap_bucket(ptr);
+
+    pthread_mutex_lock(&s_HeapLock);
+
+    for (int32_t *link = s_HeapBuckets ? &s_HeapBuckets[bucket] : NULL; link && *link >= 0;
+         link = &s_HeapSamples[*link].next)
+    {
+        int32_t index = *link;
+        JHeapSample *sample = &s_HeapSamples[index];
+
+        if (sample->ptr == ptr)
+        {
+            JHeapStack *stack = &s_HeapStacks[sample->stack];
+            stack->values[2] -= sample->objects;
+            stack->values[3] -= sample->bytes;
+
+            *link = sample->next;
+            sample->next = s_HeapUnusedSample;
+            s_HeapUnusedSample = index;
+            __atomic_sub_fetch(&s_HeapFilter[bucket], 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&s_HeapLock);
+}
+
+void jheap_register_code(uint64_t start, uint64_t size, const char *name)
+{
+    pthread_mutex_lock(&s_HeapLock);
+
+    if (s_HeapCodeCount == s_HeapCodeCapacity)
+    {
+        size_t capacity = s_HeapCodeCapacity ? s_HeapCodeCapacity * 2 : 64;
+        JHeapCode *code = (JHeapCode *)realloc(s_HeapCode, capacity * sizeof(JHeapCode));
+
+        if (!code)
+        {
+            pthread_mutex_unlock(&s_HeapLock);
+            return;
+        }
+
+        s_HeapCode = code;
+        s_HeapCodeCapacity = capacity;
+    }
+
+    JHeapCode *code = &s_HeapCode[s_HeapCodeCount++];
+    code->start = start;
+    code->size = size;
+    code->name = strdup(name);
+
+    pthread_mutex_unlock(&s_HeapLock);
+}
+
+// The profile is a perftools.profiles.Profile protobuf, the format pprof reads, written uncompressed
+typedef struct
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} JHeapBuffer;
+
+static void jheap_append(JHeapBuffer *buffer, const void *data, size_t size)
+{
+    if (buffer->size + size > buffer->capacity)
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+
+        while (capacity < buffer->size + size)
+        {
+            capacity *= 2;
+        }
+
+        uint8_t *grown = (uint8_t *)realloc(buffer->data, capacity);
+
+        if (!grown)
+        {
+            abort();
+        }
+
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void jheap_varint(JHeapBuffer *buffer, uint64_t value)
+{
+    uint8_t bytes[10];
+    size_t count = 0;
+
+    do
+    {
+        bytes[count++] = (uint8_t)((value & 0x7F) | (value > 0x7F ? 0x80 : 0));
+        value >>= 7;
+    } while (value);
+
+    jheap_append(buffer, bytes, count);
+}
+
+static void jheap_field(JHeapBuffer *buffer, uint32_t field, uint64_t value)
+{
+    jheap_varint(buffer, (uint64_t)field << 3);
+    jheap_varint(buffer, value);
+}
+
+static void jheap_bytes(JHeapBuffer *buffer, uint32_t field, const void *data, size_t size)
+{
+    jheap_varint(buffer, ((uint64_t)field << 3) | 2);
+    jheap_varint(buffer, size);
+    jheap_append(buffer, data, size);
+}
+
+// Appends message as field of buffer and empties it for the next one
+static void jheap_message(JHeapBuffer *buffer, uint32_t field, JHeapBuffer *message)
+{
+    jheap_bytes(buffer, field, message->data, message->size);
+    message->size = 0;
+}
+
+typedef struct
+{
+    const char **strings;
+    size_t count;
+    size_t capacity;
+} JHeapStrings;
+
+static uint64_t jheap_string(JHeapStrings *table, const char *string)
+{
+    for (size_t i = 0; i < table->count; ++i)
+    {
+        if (strcmp(table->strings[i], string) == 0)
+        {
+            return i;
+        }
+    }
+
+    if (table->count == table->capacity)
+    {
+        table->capacity = table->capacity ? table->capacity * 2 : 64;
+        table->strings = (const char **)realloc((void *)table->strings, table->capacity * sizeof(char *));
+
+        if (!table->strings)
+        {
+            abort();
+        }
+    }
+
+    table->strings[table->count] = string;
+    return table->count++;
+}
+
+static int jheap_compare_pointers(const void *a, const void *b)
+{
+    uintptr_t left = *(const uintptr_t *)a;
+    uintptr_t right = *(const uintptr_t *)b;
+
+    return left < right ? -1 : left > right;
+}
+
+static int jheap_compare_code(const void *a, const void *b)
+{
+    return jheap_compare_pointers(&((const JHeapCode *)a)->start, &((const JHeapCode *)b)->start);
+}
+
+// Sorted and without duplicates, returns the new count
+static size_t jheap_unique(uintptr_t *values, size_t count)
+{
+    qsort(values, count, sizeof(uintptr_t), jheap_compare_pointers);
+    size_t unique = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (unique == 0 || values[unique - 1] != values[i])
+        {
+            values[unique++] = values[i];
+        }
+    }
+
+    return unique;
+}
+
+static uint64_t jheap_find(const uintptr_t *values, size_t count, uintptr_t value)
+{
+    const uintptr_t *found = (const uintptr_t *)bsearch(&value, values, count, sizeof(uintptr_t),
+                                                        jheap_compare_pointers);
+    return (uint64_t)(found - values);
+}
+
+static const char *jheap_symbolize(uintptr_t address)
+{
+    size_t low = 0;
+    size_t high = s_HeapCodeCount;
+
+    // Last function starting at or before the address
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+
+        if (s_HeapCode[middle].start <= address)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (low > 0 && address < s_HeapCode[low - 1].start + s_HeapCode[low - 1].size)
+    {
+        return s_HeapCode[low - 1].name;
+    }
+
+    Dl_info info;
+    return dladdr((void *)address, &info) && info.dli_sname ? info.dli_sname : NULL;
+}
+
+// Function id for name in file, adding it to the functions message when it is new
+static uint64_t jheap_function(JHeapBuffer *functions, uint64_t **keys, size_t *count, uint64_t name,
+                               uint64_t file)
+{
+    for (size_t i = 0; i < *count; ++i)
+    {
+        if ((*keys)[2 * i] == name && (*keys)[2 * i + 1] == file)
+        {
+            return i + 1;
+        }
+    }
+
+    *keys = (uint64_t *)realloc(*keys, (*count + 1) * 2 * sizeof(uint64_t));
+
+    if (!*keys)
+    {
+        abort();
+    }
+
+    (*keys)[2 * *count] = name;
+    (*keys)[2 * *count + 1] = file;
+    uint64_t id = ++*count;
+
+    JHeapBuffer function = {0};
+    jheap_field(&function, 1, id);
+    jheap_field(&function, 2, name);
+    jheap_field(&function, 3, name);
+    jheap_field(&function, 4, file);
+    jheap_message(functions, 5, &function);
+    free(function.data);
+
+    return id;
+}
+
+// Called with s_HeapLock held
+static void jheap_write_locked(const char *path)
+{
+    int64_t rate = __atomic_load_n(&s_HeapRate, __ATOMIC_RELAXED);
+    size_t count = s_HeapStackCount;
+
+    qsort(s_HeapCode, s_HeapCodeCount, sizeof(JHeapCode), jheap_compare_code);
+
+    // Sites and return addresses become locations, site locations first
+    size_t frameTotal = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        frameTotal += s_HeapStacks[i].depth;
+    }
+
+    uintptr_t *sites = (uintptr_t *)malloc((count + 1) * sizeof(uintptr_t));
+    uintptr_t *addresses = (uintptr_t *)malloc((frameTotal + 1) * sizeof(uintptr_t));
+
+    if (!sites || !addresses)
+    {
+        fprintf(stderr, "jheap: out of memory writing %s\n", path);
+        free(sites);
+        free(addresses);
+        return;
+    }
+
+    size_t siteCount = 0;
+    size_t addressCount = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const JHeapStack *stack = &s_HeapStacks[i];
+
+        if (stack->site)
+        {
+            sites[siteCount++] = (uintptr_t)stack->site;
+        }
+
+        for (uint32_t j = 0; j < stack->depth; ++j)
+        {
+            addresses[addressCount++] = (uintptr_t)stack->frames[j];
+        }
+    }
+
+    siteCount = jheap_unique(sites, siteCount);
+    addressCount = jheap_unique(addresses, addressCount);
+
+    JHeapBuffer profile = {0};
+    JHeapBuffer message = {0};
+    JHeapBuffer inner = {0};
+    JHeapBuffer functions = {0};
+    JHeapStrings strings = {0};
+    uint64_t *functionKeys = NULL;
+    size_t functionCount = 0;
+
+    jheap_string(&strings, "");
+
+    static const char *const s_SampleTypes[][2] = {{"alloc_objects", "count"},
+                                                   {"alloc_space", "bytes"},
+                                                   {"inuse_objects", "count"},
+                                                   {"inuse_space", "bytes"}};
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        jheap_field(&message, 1, jheap_string(&strings, s_SampleTypes[i][0]));
+        jheap_field(&message, 2, jheap_string(&strings, s_SampleTypes[i][1]));
+        jheap_message(&profile, 1, &message);
+    }
+
+    // Each stack becomes one sample
+    for (size_t i = 0; i < count; ++i)
+    {
+        const JHeapStack *stack = &s_HeapStacks[i];
+
+        if (stack->site)
+        {
+            jheap_varint(&inner, jheap_find(sites, siteCount, (uintptr_t)stack->site) + 1);
+        }
+
+        for (uint32_t j = 0; j < stack->depth; ++j)
+        {
+            uint64_t index = jheap_find(addresses, addressCount, (uintptr_t)stack->frames[j]);
+            jheap_varint(&inner, siteCount + index + 1);
+        }
+
+        jheap_message(&message, 1, &inner);
+
+        // Live values drop back to about 0 as samples are freed, rounding must not make them negative
+        for (size_t j = 0; j < 4; ++j)
+        {
+            jheap_varint(&inner, stack->values[j] > 0 ? (uint64_t)llround(stack->values[j]) : 0);
+        }
+
+        jheap_message(&message, 2, &inner);
+        jheap_message(&profile, 2, &message);
+    }
+
+    for (size_t i = 0; i < siteCount; ++i)
+    {
+        const JHeapSite *site = (const JHeapSite *)sites[i];
+        uint64_t name = jheap_string(&strings, site->function);
+        uint64_t file = jheap_string(&strings, site->file);
+        uint64_t function = jheap_function(&functions, &functionKeys, &functionCount, name, file);
+
+        jheap_field(&inner, 1, function);
+        jheap_field(&inner, 2, (uint64_t)site->line);
+
+        jheap_field(&message, 1, i + 1);
+        jheap_message(&message, 4, &inner);
+        jheap_message(&profile, 4, &message);
+    }
+
+    for (size_t i = 0; i < addressCount; ++i)
+    {
+        // A return address points past the call, one byte back is still inside it
+        uintptr_t address = addresses[i] - 1;
+        const char *name = jheap_symbolize(address);
+
+        jheap_field(&message, 1, siteCount + i + 1);
+        jheap_field(&message, 3, address);
+
+        if (name)
+        {
+            uint64_t nameIndex = jheap_string(&strings, name);
+            jheap_field(&inner, 1, jheap_function(&functions, &functionKeys, &functionCount, nameIndex, 0));
+            jheap_message(&message, 4, &inner);
+        }
+
+        jheap_message(&profile, 4, &message);
+    }
+
+    jheap_append(&profile, functions.data, functions.size);
+
+    jheap_string(&strings, "space");
+    jheap_string(&strings, "bytes");
+
+    for (size_t i = 0; i < strings.count; ++i)
+    {
+        jheap_bytes(&profile, 6, strings.strings[i], strlen(strings.strings[i]));
+    }
+
+    int64_t now = jheap_now();
+    jheap_field(&profile, 9, (uint64_t)now);
+    jheap_field(&profile, 10, (uint64_t)(now - s_HeapStartTime));
+
+    jheap_field(&message, 1, jheap_string(&strings, "space"));
+    jheap_field(&message, 2, jheap_string(&strings, "bytes"));
+    jheap_message(&profile, 11, &message);
+    jheap_field(&profile, 12, (uint64_t)rate);
+
+    FILE *file = fopen(path, "wb");
+
+    if (!file || fwrite(profile.data, 1, profile.size, file) != profile.size)
+    {
+        fprintf(stderr, "jheap: cannot write profile to %s\n", path);
+    }
+
+    if (file)
+    {
+        fclose(file);
+    }
+
+    free(profile.data);
+    free(message.data);
+    free(inner.data);
+    free(functions.data);
+    free((void *)strings.strings);
+    free(functionKeys);
+    free(sites);
+    free(addresses);
+}
+
+static void jheap_signal(int signal)
+{
+    (void)signal;
+
+    // Only async-signal-safe calls here, the dump thread does the writing
+    int savedErrno = errno;
+    char byte = 1;
+    ssize_t written = write(s_HeapPipe[1], &byte, 1);
+    (void)written;
+    errno = savedErrno;
+}
+
+static void *jheap_dump_thread(void *argument)
+{
+    (void)argument;
+    char byte;
+
+    while (read(s_HeapPipe[0], &byte, 1) == 1 || errno == EINTR)
+    {
+        pthread_mutex_lock(&s_HeapLock);
+
+        // Signals after jheap_stop are ignored
+        if (s_HeapPath)
+        {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s.%u", s_HeapPath, ++s_HeapDumpCount);
+            jheap_write_locked(path);
+        }
+
+        pthread_mutex_unlock(&s_HeapLock);
+    }
+
+    return NULL;
+}
+
+void jheap_start(const char *path, int64_t rate)
+{
+    pthread_mutex_lock(&s_HeapLock);
+
+    // Every unit compiled with -fheap-profile calls this from its constructor, the first one wins
+    if (s_HeapPath || rate <= 0)
+    {
+        pthread_mutex_unlock(&s_HeapLock);
+        return;
+    }
+
+    s_HeapBuckets = (int32_t *)malloc(JHEAP_BUCKETS * sizeof(int32_t));
+    s_HeapStackBuckets = (int32_t *)malloc(JHEAP_STACK_BUCKETS * sizeof(int32_t));
+    s_HeapPath = strdup(path);
+
+    if (!s_HeapBuckets || !s_HeapStackBuckets || !s_HeapPath)
+    {
+        free(s_HeapBuckets);
+        free(s_HeapStackBuckets);
+        free(s_HeapPath);
+        s_HeapBuckets = NULL;
+        s_HeapStackBuckets = NULL;
+        s_HeapPath = NULL;
+        pthread_mutex_unlock(&s_HeapLock);
+        return;
+    }
+
+    // All bytes 0xFF is -1, an empty chain
+    memset(s_HeapBuckets, 0xFF, JHEAP_BUCKETS * sizeof(int32_t));
+    memset(s_HeapStackBuckets, 0xFF, JHEAP_STACK_BUCKETS * sizeof(int32_t));
+    s_HeapStartTime = jheap_now();
+
+    // The dump thread and the signal handler stay for the rest of the process
+    if (s_HeapPipe[0] < 0 && pipe2(s_HeapPipe, O_CLOEXEC) == 0)
+    {
+        pthread_t thread;
+
+        if (pthread_create(&thread, NULL, jheap_dump_thread, NULL) == 0)
+        {
+            pthread_detach(thread);
+
+            struct sigaction action;
+            memset(&action, 0, sizeof(action));
+            action.sa_handler = jheap_signal;
+            action.sa_flags = SA_RESTART;
+            sigemptyset(&action.sa_mask);
+            sigaction(JHEAP_SIGNAL, &action, NULL);
+        }
+    }
+
+    __atomic_store_n(&s_HeapRate, rate, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&s_HeapLock);
+}
+
+void jheap_stop(void)
+{
+    pthread_mutex_lock(&s_HeapLock);
+
+    if (!s_HeapPath)
+    {
+        pthread_mutex_unlock(&s_HeapLock);
+        return;
+    }
+
+    jheap_write_locked(s_HeapPath);
+    __atomic_store_n(&s_HeapRate, 0, __ATOMIC_RELAXED);
+
+    // Sites point into the program, which may be unloaded once its destructors ran
+    memset(s_HeapFilter, 0, sizeof(s_HeapFilter));
+    free(s_HeapStacks);
+    free(s_HeapStackBuckets);
+    free(s_HeapSamples);
+    free(s_HeapBuckets);
+    free(s_HeapPath);
+    s_HeapStacks = NULL;
+    s_HeapStackBuckets = NULL;
+    s_HeapSamples = NULL;
+    s_HeapBuckets = NULL;
+    s_HeapPath = NULL;
+    s_HeapStackCount = s_HeapStackCapacity = 0;
+    s_HeapSampleCount = s_HeapSampleCapacity = 0;
+    s_HeapUnusedSample = -1;
+
+    for (size_t i = 0; i < s_HeapCodeCount; ++i)
+    {
+        free(s_HeapCode[i].name);
+    }
+
+    free(s_HeapCode);
+    s_HeapCode = NULL;
+    s_HeapCodeCount = s_HeapCodeCapacity = 0;
+
+    pthread_mutex_unlock(&s_HeapLock);
+}
+
+// The deques follow "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al., PPoPP 2013)
+#define JTASK_INITIAL_CAPACITY 1024
+#define JTASK_ALIGNMENT 16
+
+// Failed rounds of stealing before an idle worker goes to sleep
+#define JTASK_SPIN_ROUNDS 64
+
+// Ranges of a parallel_for per worker, enough for load balancing without drowning in tasks
+#define JTASK_RANGES_PER_WORKER 8
+
+typedef struct JTask
+{
+    void (*fn)(void *);
+    JTaskGroup *group;
+} JTask;
+
+// The env copy follows the header at an alignment good for any type the language has
+#define JTASK_HEADER_SIZE ((sizeof(JTask) + JTASK_ALIGNMENT - 1) / JTASK_ALIGNMENT * JTASK_ALIGNMENT)
+
+typedef struct JTaskArray
+{
+    int64_t capacity;
+
+    // Arrays a deque outgrew, thieves may still be reading them
+    struct JTaskArray *previous;
+    JTask *slots[];
+} JTaskArray;
+
+// Aligned to a cache line so workers pushing to their own deques don't slow each other down
+typedef struct JWorker
+{
+    _Alignas(64) int64_t top;
+    int64_t bottom;
+    JTaskArray *array;
+    uint32_t seed;
+} JWorker;
+
+static JWorker *s_Workers = NULL;
+static int s_WorkerCount = 0;
+static pthread_once_t s_PoolOnce = PTHREAD_ONCE_INIT;
+static _Thread_local JWorker *t_Worker = NULL;
+
+static pthread_mutex_t s_SleepLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_SleepCondition = PTHREAD_COND_INITIALIZER;
+static int64_t s_Sleepers = 0;
+
+static JTaskArray *jtask_new_array(int64_t capacity, JTaskArray *previous)
+{
+    JTaskArray *array = (JTaskArray *)malloc(sizeof(JTaskArray) + (size_t)capacity * sizeof(JTask *));
+
+    if (!array)
+    {
+        fprintf(stderr, "jtask: out of memory\n");
+        abort();
+    }
+
+    array->capacity = capacity;
+    array->previous = previous;
+    return array;
+}
+
+static void jtask_push(JWorker *worker, JTask *task)
+{
+    int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+    JTaskArray *array = __atomic_load_n(&worker->array, __ATOMIC_RELAXED);
+
+    if (bottom - top > array->capacity - 1)
+    {
+        JTaskArray *grown = jtask_new_array(array->capacity * 2, array);
+
+        for (int64_t i = top; i < bottom; ++i)
+        {
+            grown->slots[i & (grown->capacity - 1)] = array->slots[i & (array->capacity - 1)];
+        }
+
+        __atomic_store_n(&worker->array, grown, __ATOMIC_RELEASE);
+        array = grown;
+    }
+
+    // Publishes the task to thieves, which read bottom with acquire
+    __atomic_store_n(&array->slots[bottom & (array->capacity - 1)], task, __ATOMIC_RELAXED);
+    __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELEASE);
+}
+
+static JTask *jtask_pop(JWorker *worker)
+{
+    int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED) - 1;
+    JTaskArray *array = __atomic_load_n(&worker->array, __ATOMIC_RELAXED);
+    __atomic_store_n(&worker->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&worker->top, __ATOMIC_RELAXED);
+
+    if (top > bottom)
+    {
+        __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    JTask *task = __atomic_load_n(&array->slots[bottom & (array->capacity - 1)], __ATOMIC_RELAXED);
+
+    // The last task may be stolen at the same time, whoever moves top first gets it
+    if (top == bottom)
+    {
+        if (!__atomic_compare_exchange_n(&worker->top, &top, top + 1, false, __ATOMIC_SEQ_CST,
+                                         __ATOMIC_RELAXED))
+        {
+            task = NULL;
+        }
+
+        __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+
+    return task;
+}
+
+static JTask *jtask_steal(JWorker *victim)
+{
+    int64_t top = __atomic_load_n(&victim->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&victim->bottom, __ATOMIC_ACQUIRE);
+
+    if (top >= bottom)
+    {
+        return NULL;
+    }
+
+    JTaskArray *array = __atomic_load_n(&victim->array, __ATOMIC_ACQUIRE);
+    JTask *task = __atomic_load_n(&array->slots[top & (array->capacity - 1)], __ATOMIC_RELAXED);
+
+    if (!__atomic_compare_exchange_n(&victim->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    {
+        return NULL;
+    }
+
+    return task;
+}
+
+// The worker's own deque first, then one pass over the others starting at a random victim
+static JTask *jtask_find(JWorker *worker)
+{
+    JTask *task = jtask_pop(worker);
+
+    if (task || s_WorkerCount == 1)
+    {
+        return task;
+    }
+
+    worker->seed = worker->seed * 1664525u + 1013904223u;
+    int start = (int)((worker->seed >> 16) % (uint32_t)s_WorkerCount);
+
+    for (int i = 0; i < s_WorkerCount && !task; ++i)
+    {
+        JWorker *victim = &s_Workers[(start + i) % s_WorkerCount];
+
+        if (victim != worker)
+        {
+            task = jtask_steal(victim);
+        }
+    }
+
+    return task;
+}
+
+static bool jtask_has_visible(void)
+{
+    for (int i = 0; i < s_WorkerCount; ++i)
+    {
+        if (__atomic_load_n(&s_Workers[i].top, __ATOMIC_SEQ_CST) <
+            __atomic_load_n(&s_Workers[i].bottom, __ATOMIC_SEQ_CST))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void jtask_run(JTask *task)
+{
+    JTaskGroup *group = task->group;
+
+    task->fn((char *)task + JTASK_HEADER_SIZE);
+    free(task);
+
+    // Releases the task's writes to whoever syncs on the group
+    __atomic_sub_fetch(&group->pending, 1, __ATOMIC_RELEASE);
+}
+
+static void *jtask_worker_main(void *argument)
+{
+    t_Worker = (JWorker *)argument;
+
+    for (;;)
+    {
+        JTask *task = NULL;
+
+        for (int round = 0; round < JTASK_SPIN_ROUNDS && !task; ++round)
+        {
+            task = jtask_find(t_Worker);
+
+            if (!task)
+            {
+                sched_yield();
+            }
+        }
+
+        if (task)
+        {
+            jtask_run(task);
+            continue;
+        }
+
+        // Announce the sleep before the last look at the deques; a spawner pushes before it looks for
+        // sleepers, so one of the two sees the other
+        pthread_mutex_lock(&s_SleepLock);
+        __atomic_add_fetch(&s_Sleepers, 1, __ATOMIC_SEQ_CST);
+
+        if (!jtask_has_visible())
+        {
+            pthread_cond_wait(&s_SleepCondition, &s_SleepLock);
+        }
+
+        __atomic_sub_fetch(&s_Sleepers, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&s_SleepLock);
+    }
+
+    return NULL;
+}
+
+static void jtask_start_workers(void)
+{
+    const char *requested = getenv("JLANG_WORKERS");
+    long count = requested ? strtol(requested, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    s_WorkerCount = count > 0 ? (int)count : 1;
+    s_Workers = (JWorker *)aligned_alloc(64, sizeof(JWorker) * (size_t)s_WorkerCount);
+
+    if (!s_Workers)
+    {
+        fprintf(stderr, "jtask: out of memory\n");
+        abort();
+    }
+
+    for (int i = 0; i < s_WorkerCount; ++i)
+    {
+        s_Workers[i].top = s_Workers[i].bottom = 0;
+        s_Workers[i].array = jtask_new_array(JTASK_INITIAL_CAPACITY, NULL);
+        s_Workers[i].seed = (uint32_t)i * 2654435761u + 1;
+    }
+
+    // The thread that spawns first is worker 0, the others sleep until there is work
+    t_Worker = &s_Workers[0];
+
+    for (int i = 1; i < s_WorkerCount; ++i)
+    {
+        pthread_t thread;
+
+        if (pthread_create(&thread, NULL, jtask_worker_main, &s_Workers[i]) != 0)
+        {
+            fprintf(stderr, "jtask: cannot start worker %d\n", i);
+            abort();
+        }
+
+        pthread_detach(thread);
+    }
+}
+
+void jtask_spawn(JTaskGroup *group, void (*fn)(void *), const void *env, int64_t envSize)
+{
+    pthread_once(&s_PoolOnce, jtask_start_workers);
+
+    JTask *task = (JTask *)malloc(JTASK_HEADER_SIZE + (size_t)envSize);
+
+    if (!task)
+    {
+        fprintf(stderr, "jtask: out of memory\n");
+        abort();
+    }
+
+    task->fn = fn;
+    task->group = group;
+    memcpy((char *)task + JTASK_HEADER_SIZE, env, (size_t)envSize);
+
+    __atomic_add_fetch(&group->pending, 1, __ATOMIC_RELAXED);
+
+    // Only the pool's threads own a deque, any other thread runs its tasks right away
+    if (!t_Worker)
+    {
+        jtask_run(task);
+        return;
+    }
+
+    jtask_push(t_Worker, task);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&s_Sleepers, __ATOMIC_SEQ_CST) > 0)
+    {
+        pthread_mutex_lock(&s_SleepLock);
+        pthread_cond_signal(&s_SleepCondition);
+        pthread_mutex_unlock(&s_SleepLock);
+    }
+}
+
+void jtask_sync(JTaskGroup *group)
+{
+    while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE) != 0)
+    {
+        // Any task will do, the group's own ones are usually on top of the deque and the rest is progress
+        // the program needs anyway
+        JTask *task = t_Worker ? jtask_find(t_Worker) : NULL;
+
+        if (task)
+        {
+            jtask_run(task);
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+}
+
+typedef struct JTaskRange
+{
+    void (*body)(void *, int32_t, int32_t);
+    void *env;
+    JTaskGroup *group;
+    int64_t from;
+    int64_t to;
+    int64_t grain;
+} JTaskRange;
+
+// Keeps the lower half and spawns the upper one until the range is small enough, so thieves take the
+// largest pieces left
+static void jtask_run_range(void *argument)
+{
+    JTaskRange range = *(JTaskRange *)argument;
+
+    while (range.to - range.from > range.grain)
+    {
+        JTaskRange upper = range;
+        upper.from = range.from + (range.to - range.from) / 2;
+        range.to = upper.from;
+
+        jtask_spawn(range.group, jtask_run_range, &upper, sizeof(upper));
+    }
+
+    range.body(range.env, (int32_t)range.from, (int32_t)range.to);
+}
+
+void jtask_parallel_for(int32_t lo, int32_t hi, void (*body)(void *, int32_t, int32_t), void *env)
+{
+    if (lo >= hi)
+    {
+        return;
+    }
+
+    pthread_once(&s_PoolOnce, jtask_start_workers);
+
+    JTaskGroup group = {0};
+    JTaskRange range = {body, env, &group, lo, hi, 0};
+
+    range.grain = ((int64_t)hi - lo) / ((int64_t)s_WorkerCount * JTASK_RANGES_PER_WORKER);
+
+    if (range.grain < 1)
+    {
+        range.grain = 1;
+    }
+
+    jtask_run_range(&range);
+    jtask_sync(&group);
+}
+
+#define JIO_PENDING -2
+#define JIO_READABLE 1
+#define JIO_WRITABLE 2
+
+#define JLOOP_INITIAL_CAPACITY 64
+#define JLOOP_MAX_EVENTS 64
+
+// Every frame of an LLVM switched-resume coroutine starts with these two
+typedef struct JCoroutineFrame
+{
+    void (*resume)(void *);
+    void (*destroy)(void *);
+} JCoroutineFrame;
+
+// Ready coroutines are a ring buffer, so they run in the order they were scheduled
+typedef struct JLoop
+{
+    int epollFd;
+    void **ready;
+    size_t readyHead;
+    size_t readyCount;
+    size_t readyCapacity;
+    int64_t parked;
+} JLoop;
+
+static _Thread_local JLoop t_Loop = {-1, NULL, 0, 0, 0, 0};
+
+void jco_schedule(void *handle)
+{
+    JLoop *loop = &t_Loop;
+
+    if (loop->readyCount == loop->readyCapacity)
+    {
+        size_t capacity = loop->readyCapacity ? loop->readyCapacity * 2 : JLOOP_INITIAL_CAPACITY;
+        void **ready = (void **)malloc(capacity * sizeof(void *));
+
+        if (!ready)
+        {
+            fprintf(stderr, "jloop: out of memory\n");
+            abort();
+        }
+
+        for (size_t i = 0; i < loop->readyCount; ++i)
+        {
+            ready[i] = loop->ready[(loop->readyHead + i) % loop->readyCapacity];
+        }
+
+        free(loop->ready);
+        loop->ready = ready;
+        loop->readyHead = 0;
+        loop->readyCapacity = capacity;
+    }
+
+    loop->ready[(loop->readyHead + loop->readyCount) % loop->readyCapacity] = handle;
+    loop->readyCount++;
+}
+
+void jio_park(void *handle, int32_t fd, int32_t events)
+{
+    JLoop *loop = &t_Loop;
+
+    if (loop->epollFd < 0 && (loop->epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+    {
+        fprintf(stderr, "jloop: cannot create epoll instance\n");
+        abort();
+    }
+
+    // One-shot, so the fd is disarmed once it woke its coroutine and the next park re-arms it
+    struct epoll_event event;
+    event.events = ((events & JIO_WRITABLE) ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+    event.data.ptr = handle;
+
+    if (epoll_ctl(loop->epollFd, EPOLL_CTL_MOD, fd, &event) != 0 &&
+        (errno != ENOENT || epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, fd, &event) != 0))
+    {
+        // Regular files can't be polled, they are always ready. On a bad fd the retry reports the error.
+        jco_schedule(handle);
+        return;
+    }
+
+    loop->parked++;
+}
+
+void jloop_run(void)
+{
+    JLoop *loop = &t_Loop;
+    struct epoll_event events[JLOOP_MAX_EVENTS];
+
+    while (loop->readyCount > 0 || loop->parked > 0)
+    {
+        // Only the ones ready now, those they schedule wait until the fds were polled once
+        for (size_t count = loop->readyCount; count > 0; --count)
+        {
+            JCoroutineFrame *frame = (JCoroutineFrame *)loop->ready[loop->readyHead];
+            loop->readyHead = (loop->readyHead + 1) % loop->readyCapacity;
+            loop->readyCount--;
+
+            frame->resume(frame);
+        }
+
+        if (loop->parked == 0)
+        {
+            continue;
+        }
+
+        int count = epoll_wait(loop->epollFd, events, JLOOP_MAX_EVENTS, loop->readyCount > 0 ? 0 : -1);
+
+        if (count < 0 && errno != EINTR)
+        {
+            fprintf(stderr, "jloop: epoll_wait failed\n");
+            abort();
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            loop->parked--;
+            jco_schedule(events[i].data.ptr);
+        }
+    }
+}
+
+int32_t jio_read(int32_t fd, void *buffer, int32_t size)
+{
+    ssize_t result;
+
+    do
+    {
+        result = read(fd, buffer, (size_t)size);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0)
+    {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? JIO_PENDING : -1;
+    }
+
+    return (int32_t)result;
+}
+
+int32_t jio_write(int32_t fd, const void *buffer, int32_t size)
+{
+    ssize_t result;
+
+    do
+    {
+        result = write(fd, buffer, (size_t)size);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0)
+    {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? JIO_PENDING : -1;
+    }
+
+    return (int32_t)result;
+}
+
+int32_t jio_accept(int32_t fd)
+{
+    int client;
+
+    do
+    {
+        client = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    } while (client < 0 && errno == EINTR);
+
+    if (client < 0)
+    {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? JIO_PENDING : -1;
+    }
+
+    return client;
+}
+
+int32_t jlisten(int32_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    // SO_REUSEPORT lets the loop of every thread listen on the same port, the kernel spreads the
+    // connections over them
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons((uint16_t)port);
+
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int32_t jopen(const char *path)
+{
+    return open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+}
+
+int32_t jclose(int32_t fd)
+{
+    return close(fd);
+}
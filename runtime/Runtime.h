@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+
+// Functions generated Jlang code calls into. The compiler links this file in so the JIT can resolve them.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Where a jalloc call is in the source. Every call passes its own when compiled with -fheap-profile,
+    // null otherwise.
+    typedef struct JHeapSite
+    {
+        const char *function;
+        const char *file;
+        int32_t line;
+    } JHeapSite;
+
+    void *jalloc(int64_t size, const JHeapSite *site);
+    void jfree(void *ptr);
+    int32_t jout(const char *format, ...);
+
+    // Called by the bounds check of an array or slice access when index is not in [0, length); reports the
+    // access and aborts
+    void jbounds_fail(const char *file, int32_t line, int64_t index, int32_t length);
+
+    // Orders two strs by their bytes, a prefix before the longer string: <0, 0 or >0 like memcmp. Generated
+    // code passes each str as its characters and length and tests equality itself.
+    int32_t jstr_compare(const char *lhs, int32_t lhsLength, const char *rhs, int32_t rhsLength);
+
+    // Arenas hand out memory by bumping a cursor through large chunks and release all of it at once. The
+    // generated code inlines the bump and only calls jarena_alloc when the current chunk is full, so the
+    // first two fields are part of the ABI. jarena_reset keeps the chunks for the next round of allocations.
+    typedef struct JArenaChunk JArenaChunk;
+
+    typedef struct JArena
+    {
+        char *cursor;
+        char *limit;
+        JArenaChunk *chunks;
+        JArenaChunk *freeChunks;
+    } JArena;
+
+    JArena *jarena_new(void);
+    void *jarena_alloc(JArena *arena, int64_t size);
+    void jarena_reset(JArena *arena);
+    void jarena_free(JArena *arena);
+
+    // Tasks run on a pool of one worker per core, each with a Chase-Lev deque: the owner pushes and pops
+    // at the bottom, idle workers steal from the top. A task group counts the tasks spawned into it and
+    // not finished yet; generated code keeps one zeroed group per function that spawns. Waiting in
+    // jtask_sync runs other tasks instead of blocking. The pool starts on the first spawn, JLANG_WORKERS
+    // overrides its size.
+    typedef struct JTaskGroup
+    {
+        int64_t pending;
+    } JTaskGroup;
+
+    // env is copied into the task, fn gets a pointer to the copy
+    void jtask_spawn(JTaskGroup *group, void (*fn)(void *), const void *env, int64_t envSize);
+    void jtask_sync(JTaskGroup *group);
+
+    // Splits [lo, hi) into ranges that run as tasks, body(env, from, to) runs one of them. Returns once the
+    // whole range is done.
+    void jtask_parallel_for(int32_t lo, int32_t hi, void (*body)(void *, int32_t, int32_t), void *env);
+
+    // async functions are coroutines run by an event loop per thread. jco_schedule queues a suspended
+    // coroutine, jloop_run resumes queued ones until none is left queued or waiting for an fd. Awaiting I/O
+    // first calls jio_read, jio_write or jio_accept, which never block and return JIO_PENDING (-2) instead;
+    // the coroutine then parks with jio_park until epoll reports the fd ready and tries again. Only one
+    // coroutine may wait on an fd at a time. Running a loop per core on sockets from jlisten, which all
+    // bind the same port, spreads the connections over the cores.
+    void jco_schedule(void *handle);
+    void jio_park(void *handle, int32_t fd, int32_t events);
+    void jloop_run(void);
+
+    int32_t jio_read(int32_t fd, void *buffer, int32_t size);
+    int32_t jio_write(int32_t fd, const void *buffer, int32_t size);
+    int32_t jio_accept(int32_t fd);
+
+    // Nonblocking listening socket on every interface, or -1
+    int32_t jlisten(int32_t port);
+
+    // Opens a file for reading
+    int32_t jopen(const char *path);
+    int32_t jclose(int32_t fd);
+
+    // -fprofile-generate: every instrumented function registers its counters from a module constructor,
+    // a module destructor appends them all to the profile file when the program exits
+    void jprof_init(const char *path);
+    void jprof_register(const char *name, uint64_t hash, uint64_t *counters, uint32_t count);
+    void jprof_write(void);
+
+    // -fheap-profile: a module constructor starts the sampling heap profiler, which samples an allocation
+    // every rate bytes on average with its site and the return addresses on the frame pointer chain. The
+    // module destructor stops it and writes a pprof profile of the sampled allocations and those still live
+    // to path; SIGUSR2 writes one to path.1, path.2, ... while the program runs. The JIT registers the
+    // functions it emitted so the profile can name them.
+    void jheap_start(const char *path, int64_t rate);
+    void jheap_stop(void);
+    void jheap_register_code(uint64_t start, uint64_t size, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
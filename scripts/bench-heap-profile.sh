@@ -0,0 +1,36 @@
+#!/bin/bash
+
+# Overhead of -fheap-profile on an allocation-heavy program. Runs scripts/bench/HeapAlloc.j with and without
+# the profiler and prints the lowest CPU time of each, the one least disturbed by other load.
+#
+#   scripts/bench-heap-profile.sh [path/to/Jlang] [runs]
+#
+# Build the compiler with -DCMAKE_BUILD_TYPE=Release first, the runtime is compiled into it.
+
+set -euo pipefail
+
+JLANG="${1:-build/Jlang}"
+RUNS="${2:-31}"
+PROGRAM="$(dirname "$0")/bench/HeapAlloc.j"
+PROFILE="$(mktemp)"
+
+trap 'rm -f "$PROFILE"' EXIT
+
+cpu_time() {
+  local TIMEFORMAT='%U %S'
+  { time "$JLANG" -O2 "$@" "$PROGRAM" -run >/dev/null 2>&1; } 2>&1 | awk '{ print $1 + $2 }'
+}
+
+best_off=""
+best_on=""
+
+for ((i = 0; i < RUNS; ++i)); do
+  off="$(cpu_time)"
+  on="$(cpu_time -fheap-profile="$PROFILE")"
+
+  best_off="$(awk -v a="$off" -v b="$best_off" 'BEGIN { print (b == "" || a < b) ? a : b }')"
+  best_on="$(awk -v a="$on" -v b="$best_on" 'BEGIN { print (b == "" || a < b) ? a : b }')"
+done
+
+awk -v off="$best_off" -v on="$best_on" \
+  'BEGIN { printf "without profiling %.3fs, with profiling %.3fs, overhead %.1f%%\n", off, on, (on / off - 1) * 100 }'
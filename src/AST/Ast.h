@@ -3,6 +3,7 @@
 #include "../CodeGen/AstVisitor.h"
 #include "../Enums/NodeTypes.h"
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -10,9 +11,17 @@
 namespace jlang
 {
 
+// Where the token a node starts at is in its unit, line 0 when unknown
+struct SourceLocation
+{
+    uint32_t line = 0;
+    uint32_t column = 0;
+};
+
 struct AstNode
 {
     NodeType type;
+    SourceLocation location;
 
     virtual ~AstNode() = default;
 
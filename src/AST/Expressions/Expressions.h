@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Ast.h"
+#include "../TopLevelDecl/TopLevelDecl.h"
 
 namespace jlang
 {
@@ -14,6 +15,21 @@ struct CallExpr : public Expression
     std::string callee;
     std::vector<std::shared_ptr<AstNode>> arguments;
 
+    // 'spawn f(x);' runs the call as a task that may execute on another worker until the next sync
+    bool isSpawned = false;
+
+    // 'await f(x)' suspends the enclosing async function until the call completes
+    bool isAwaited = false;
+
+    // 'parallel_for(lo, hi) -> int32 i { ... }': the body runs once per index, outlined into a closure
+    // over the enclosing locals
+    std::string closureIndex;
+    SymbolId closureIndexSymbol = InvalidSymbolId;
+    std::shared_ptr<AstNode> closureBody;
+
+    // Set by EscapeAnalysis on the jfree of an object that may live on the stack, which CodeGen then drops
+    bool freesStackObject = false;
+
     CallExpr() { type = NodeType::CallExpr; }
 
     void Accept(AstVisitor &visitor) override { visitor.VisitCallExpr(*this); }
@@ -33,15 +49,25 @@ struct BinaryExpr : public Expression
 struct VarExpr : public Expression
 {
     std::string name;
+    SymbolId symbol = InvalidSymbolId;
 
     VarExpr() { type = NodeType::VarExpr; }
 
     void Accept(AstVisitor &visitor) override { visitor.VisitVarExpr(*this); }
 };
 
+enum class LiteralKind
+{
+    Number,
+    String,
+    Null
+};
+
 struct LiteralExpr : public Expression
 {
+    LiteralKind kind = LiteralKind::String;
     std::string value;
+    int32_t numberValue = 0;
 
     LiteralExpr() { type = NodeType::LiteralExpr; }
 
@@ -58,4 +84,48 @@ struct CastExpr : public Expression
     void Accept(AstVisitor &visitor) override { visitor.VisitCastExpr(*this); }
 };
 
+struct MemberExpr : public Expression
+{
+    std::shared_ptr<AstNode> object;
+    std::string member;
+
+    MemberExpr() { type = NodeType::MemberExpr; }
+
+    void Accept(AstVisitor &visitor) override { visitor.VisitMemberExpr(*this); }
+};
+
+// pointer[index], the element at index counted in elements of the pointee type. Indexing an array or a
+// slice checks the index against its length.
+struct IndexExpr : public Expression
+{
+    std::shared_ptr<AstNode> object;
+    std::shared_ptr<AstNode> index;
+
+    // Cleared by BoundsCheckElimination when the index is known to be within bounds
+    bool isBoundsChecked = true;
+
+    IndexExpr() { type = NodeType::IndexExpr; }
+
+    void Accept(AstVisitor &visitor) override { visitor.VisitIndexExpr(*this); }
+};
+
+struct SizeofExpr : public Expression
+{
+    TypeRef targetType;
+
+    SizeofExpr() { type = NodeType::SizeofExpr; }
+
+    void Accept(AstVisitor &visitor) override { visitor.VisitSizeofExpr(*this); }
+};
+
+struct AssignExpr : public Expression
+{
+    std::shared_ptr<AstNode> target;
+    std::shared_ptr<AstNode> value;
+
+    AssignExpr() { type = NodeType::AssignExpr; }
+
+    void Accept(AstVisitor &visitor) override { visitor.VisitAssignExpr(*this); }
+};
+
 } // namespace jlang
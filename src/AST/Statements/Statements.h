@@ -20,6 +20,40 @@ struct IfStatement : public Statement
     void Accept(AstVisitor &visitor) override { visitor.VisitIfStatement(*this); }
 };
 
+// '#vectorize' and '#unroll(N)' in front of a loop, lowered to llvm.loop metadata on its back edge
+struct LoopHints
+{
+    bool vectorize = false;
+
+    // 0 leaves unrolling to the optimizer, 1 disables it
+    uint32_t unrollCount = 0;
+};
+
+struct WhileStatement : public Statement
+{
+    std::shared_ptr<AstNode> condition;
+    std::shared_ptr<AstNode> body;
+    LoopHints hints;
+
+    WhileStatement() { type = NodeType::WhileStatement; }
+
+    void Accept(AstVisitor &visitor) override { visitor.VisitWhileStatement(*this); }
+};
+
+// for (initializer; condition; increment) body, every part but the body is optional
+struct ForStatement : public Statement
+{
+    std::shared_ptr<AstNode> initializer;
+    std::shared_ptr<AstNode> condition;
+    std::shared_ptr<AstNode> increment;
+    std::shared_ptr<AstNode> body;
+    LoopHints hints;
+
+    ForStatement() { type = NodeType::ForStatement; }
+
+    void Accept(AstVisitor &visitor) override { visitor.VisitForStatement(*this); }
+};
+
 struct BlockStatement : public Statement
 {
     std::vector<std::shared_ptr<AstNode>> statements;
@@ -35,7 +69,18 @@ struct ExprStatement : public Statement
 
     ExprStatement() { type = NodeType::ExprStatement; }
 
-    void Accept(AstVisitor &visitor) override { visitor.VisitExprStatement(*this) : }
+    void Accept(AstVisitor &visitor) override { visitor.VisitExprStatement(*this); }
+};
+
+// 'return;', 'return value;' or 'return tail f(...);', the last one must compile to a musttail call
+struct ReturnStatement : public Statement
+{
+    std::shared_ptr<AstNode> value;
+    bool isTail = false;
+
+    ReturnStatement() { type = NodeType::ReturnStatement; }
+
+    void Accept(AstVisitor &visitor) override { visitor.VisitReturnStatement(*this); }
 };
 
 } // namespace jlang
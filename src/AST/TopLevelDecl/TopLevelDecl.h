@@ -1,7 +1,11 @@
 #pragma once
 
+#include "../../Types/SymbolId.h"
+#include "../../Types/TypeId.h"
 #include "../Ast.h"
 
+#include <optional>
+
 namespace jlang
 {
 
@@ -9,6 +13,27 @@ struct TypeRef
 {
     std::string name;
     bool isPointer = false;
+
+    // 'T[N]' holds N elements in place, 'T[]' is a slice: a pointer to elements together with their count
+    uint32_t arrayLength = 0;
+    bool isSlice = false;
+
+    // Filled in by TypeResolver
+    TypeId id = InvalidTypeId;
+
+    // 'atomic int32' or 'atomic T*': plain reads and writes of the variable or field are seq_cst atomics
+    bool isAtomic = false;
+};
+
+// 'import name;' makes the declarations of name.jmi, written by -emit-interface next to name.j, usable
+// without parsing name.j again
+struct ImportDecl : public AstNode
+{
+    std::string moduleName;
+
+    ImportDecl() { type = NodeType::ImportDecl; }
+
+    void Accept(AstVisitor &visitor) override { visitor.VisitImportDecl(*this); }
 };
 
 struct InterfaceDecl : public AstNode
@@ -33,6 +58,11 @@ struct StructDecl : public AstNode
     std::string interfaceImplemented;
     std::vector<StructField> fields;
 
+    // Declared as 'soa struct': collections are stored as one array per field instead of an array of rows.
+    bool isSoa = false;
+
+    TypeId typeId = InvalidTypeId;
+
     StructDecl() { type = NodeType::StructDecl; }
 
     void Accept(AstVisitor &visitor) override { visitor.VisitStructDecl(*this); }
@@ -42,6 +72,9 @@ struct Parameter
 {
     std::string name;
     TypeRef type;
+
+    // Interned by the parser, parameters of module interface functions have none
+    SymbolId symbol = InvalidSymbolId;
 };
 
 struct FunctionDecl : public AstNode
@@ -51,6 +84,15 @@ struct FunctionDecl : public AstNode
     TypeRef returnType;
     std::shared_ptr<AstNode> body;
 
+    // 'async void f()': calling it creates a suspended coroutine, which returns to its caller at every await
+    bool isAsync = false;
+
+    // 'const int32 f()': may also be called by the ConstEvaluator, which runs it while compiling
+    bool isConst = false;
+
+    // Set instead of body by a lazy parse: where the body starts in the unit's tokens
+    std::optional<size_t> lazyBodyTokenIndex;
+
     FunctionDecl() { type = NodeType::FunctionDecl; }
 
     void Accept(AstVisitor &visitor) override { visitor.VisitFunctionDecl(*this); }
@@ -59,9 +101,21 @@ struct FunctionDecl : public AstNode
 struct VariableDecl : public AstNode
 {
     std::string name;
+    SymbolId symbol = InvalidSymbolId;
     TypeRef varType;
     std::shared_ptr<AstNode> initializer;
 
+    // Set by EscapeAnalysis when the jalloc'ed initializer never leaves the function and can live on the stack.
+    // CodeGen only moves it there when the struct is at most MaxStackObjectSize bytes.
+    bool isStackAllocated = false;
+
+    // 'const var': the ConstEvaluator computes the initializer while compiling and leaves the result in
+    // constValue, the elements of an array, slice or str or the single value of a scalar. With
+    // 'const var t int32[N] -> int32 i = e;' element i of t is e, for every i in [0, N).
+    bool isConst = false;
+    std::string elementIndex;
+    std::vector<int32_t> constValue;
+
     VariableDecl() { type = NodeType::VariableDecl; }
 
     void Accept(AstVisitor &visitor) override { visitor.VisitVariableDecl(*this); }
@@ -1,30 +1,58 @@
 #pragma once
 
-#include "../AST/Ast.h"
-#include "../AST/Expressions/Expressions.h"
-#include "../AST/Statements/Statements.h"
-#include "../AST/TopLevelDecl/TopLevelDecl.h"
-
 namespace jlang
 {
+
+// The nodes include this header through Ast.h, so they are only declared here
+struct ImportDecl;
+struct InterfaceDecl;
+struct StructDecl;
+struct FunctionDecl;
+struct VariableDecl;
+
+struct IfStatement;
+struct WhileStatement;
+struct ForStatement;
+struct BlockStatement;
+struct ExprStatement;
+struct ReturnStatement;
+
+struct CallExpr;
+struct BinaryExpr;
+struct VarExpr;
+struct LiteralExpr;
+struct CastExpr;
+struct MemberExpr;
+struct IndexExpr;
+struct SizeofExpr;
+struct AssignExpr;
+
 class AstVisitor
 {
   public:
     virtual ~AstVisitor() = default;
 
+    virtual void VisitImportDecl(ImportDecl &) = 0;
     virtual void VisitFunctionDecl(FunctionDecl &) = 0;
     virtual void VisitInterfaceDecl(InterfaceDecl &) = 0;
     virtual void VisitStructDecl(StructDecl &) = 0;
     virtual void VisitVariableDecl(VariableDecl &) = 0;
 
     virtual void VisitIfStatement(IfStatement &) = 0;
+    virtual void VisitWhileStatement(WhileStatement &) = 0;
+    virtual void VisitForStatement(ForStatement &) = 0;
     virtual void VisitBlockStatement(BlockStatement &) = 0;
     virtual void VisitExprStatement(ExprStatement &) = 0;
+    virtual void VisitReturnStatement(ReturnStatement &) = 0;
 
     virtual void VisitCallExpr(CallExpr &) = 0;
     virtual void VisitBinaryExpr(BinaryExpr &) = 0;
     virtual void VisitLiteralExpr(LiteralExpr &) = 0;
     virtual void VisitVarExpr(VarExpr &) = 0;
     virtual void VisitCastExpr(CastExpr &) = 0;
+    virtual void VisitMemberExpr(MemberExpr &) = 0;
+    virtual void VisitIndexExpr(IndexExpr &) = 0;
+    virtual void VisitSizeofExpr(SizeofExpr &) = 0;
+    virtual void VisitAssignExpr(AssignExpr &) = 0;
 };
 } // namespace jlang
\ No newline at end of file
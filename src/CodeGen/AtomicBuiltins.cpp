@@ -0,0 +1,247 @@
+#include "CodeGen.h"
+
+#include "../Common/Logger.h"
+
+namespace jlang
+{
+
+// The builtins work on any int32 or pointer variable, field or element, like C++'s atomic_ref. Without an
+// ordering they are seq_cst, the same as plain accesses to what was declared atomic.
+bool CodeGenerator::EmitAtomicBuiltin(CallExpr &node)
+{
+    struct AtomicOperation
+    {
+        size_t valueCount;
+        bool hasTarget;
+    };
+
+    static const std::unordered_map<std::string, AtomicOperation> s_Operations = {
+        {"jatomic_load", {0, true}},
+        {"jatomic_store", {1, true}},
+        {"jatomic_cas", {2, true}},
+        {"jatomic_fetch_add", {1, true}},
+        {"jatomic_fence", {0, false}}};
+
+    static const std::unordered_map<std::string, llvm::AtomicOrdering> s_Orderings = {
+        {"relaxed", llvm::AtomicOrdering::Monotonic},
+        {"acquire", llvm::AtomicOrdering::Acquire},
+        {"release", llvm::AtomicOrdering::Release},
+        {"acq_rel", llvm::AtomicOrdering::AcquireRelease},
+        {"seq_cst", llvm::AtomicOrdering::SequentiallyConsistent}};
+
+    auto it = s_Operations.find(node.callee);
+
+    if (it == s_Operations.end())
+    {
+        return false;
+    }
+
+    m_LastValue = nullptr;
+
+    size_t operandCount = (it->second.hasTarget ? 1 : 0) + it->second.valueCount;
+    llvm::AtomicOrdering ordering = llvm::AtomicOrdering::SequentiallyConsistent;
+
+    if (node.arguments.size() == operandCount + 1)
+    {
+        const AstNode *last = node.arguments.back().get();
+        auto orderingIt = last && last->type == NodeType::VarExpr
+                              ? s_Orderings.find(static_cast<const VarExpr *>(last)->name)
+                              : s_Orderings.end();
+
+        if (orderingIt == s_Orderings.end())
+        {
+            JLANG_ERROR(STR("%s expects relaxed, acquire, release, acq_rel or seq_cst as its last argument",
+                            node.callee.c_str()));
+            return true;
+        }
+
+        ordering = orderingIt->second;
+    }
+    else if (node.arguments.size() != operandCount)
+    {
+        JLANG_ERROR(STR("Wrong number of arguments to %s", node.callee.c_str()));
+        return true;
+    }
+
+    bool isValidOrdering = true;
+
+    // Loads can't release and stores can't acquire, so acq_rel fits neither; a relaxed fence orders nothing
+    if (node.callee == "jatomic_load" || node.callee == "jatomic_store")
+    {
+        llvm::AtomicOrdering invalid =
+            node.callee == "jatomic_load" ? llvm::AtomicOrdering::Release : llvm::AtomicOrdering::Acquire;
+        isValidOrdering = ordering != invalid && ordering != llvm::AtomicOrdering::AcquireRelease;
+    }
+    else if (node.callee == "jatomic_fence")
+    {
+        isValidOrdering = ordering != llvm::AtomicOrdering::Monotonic;
+    }
+
+    if (!isValidOrdering)
+    {
+        JLANG_ERROR(STR("Invalid memory ordering for %s", node.callee.c_str()));
+        return true;
+    }
+
+    if (!it->second.hasTarget)
+    {
+        EmitLocation(node);
+        m_IRBuilder.CreateFence(ordering);
+        return true;
+    }
+
+    llvm::Value *address = EmitAtomicAddress(*node.arguments[0]);
+
+    if (!address)
+    {
+        return true;
+    }
+
+    llvm::Type *valueType = address->getType()->getPointerElementType();
+
+    if (!CheckAtomicType(valueType, node.callee))
+    {
+        return true;
+    }
+
+    if (node.callee == "jatomic_fetch_add" && !valueType->isIntegerTy())
+    {
+        JLANG_ERROR("jatomic_fetch_add expects an int32");
+        return true;
+    }
+
+    std::vector<llvm::Value *> values;
+
+    for (size_t i = 1; i <= it->second.valueCount; ++i)
+    {
+        llvm::Value *value = EmitArgument(*node.arguments[i], valueType);
+
+        if (!value || value->getType() != valueType)
+        {
+            JLANG_ERROR(STR("Invalid argument in call to %s", node.callee.c_str()));
+            return true;
+        }
+
+        values.push_back(value);
+    }
+
+    EmitLocation(node);
+
+    llvm::Align alignment = m_Module->getDataLayout().getABITypeAlign(valueType);
+
+    if (node.callee == "jatomic_load")
+    {
+        llvm::LoadInst *load = m_IRBuilder.CreateAlignedLoad(valueType, address, alignment, "atomic.load");
+        load->setAtomic(ordering);
+        m_LastValue = load;
+    }
+    else if (node.callee == "jatomic_store")
+    {
+        llvm::StoreInst *store = m_IRBuilder.CreateAlignedStore(values[0], address, alignment);
+        store->setAtomic(ordering);
+        m_LastValue = values[0];
+    }
+    else if (node.callee == "jatomic_cas")
+    {
+        // Returns the value that was there, the swap happened when that equals the expected one
+        llvm::AtomicCmpXchgInst *exchange = m_IRBuilder.CreateAtomicCmpXchg(
+            address, values[0], values[1], alignment, ordering,
+            llvm::AtomicCmpXchgInst::getStrongestFailureOrdering(ordering));
+        m_LastValue = m_IRBuilder.CreateExtractValue(exchange, 0, "atomic.old");
+    }
+    else
+    {
+        m_LastValue =
+            m_IRBuilder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, address, values[0], alignment, ordering);
+    }
+
+    return true;
+}
+
+llvm::Value *CodeGenerator::EmitAtomicAddress(AstNode &target)
+{
+    if (target.type == NodeType::VarExpr)
+    {
+        auto &variable = static_cast<VarExpr &>(target);
+        llvm::Value *slot = m_Symbols.Lookup(variable.symbol);
+
+        if (!slot || !GetSlotType(slot))
+        {
+            JLANG_ERROR(STR("Cannot access %s atomically, it is not a variable", variable.name.c_str()));
+            return nullptr;
+        }
+
+        return slot;
+    }
+
+    if (target.type == NodeType::IndexExpr)
+    {
+        llvm::Value *elementPtr = EmitElementAddress(static_cast<IndexExpr &>(target));
+
+        if (elementPtr && !elementPtr->getType()->isPointerTy())
+        {
+            JLANG_ERROR("Cannot access a whole soa row atomically, use one of its fields");
+            return nullptr;
+        }
+
+        return elementPtr;
+    }
+
+    if (target.type != NodeType::MemberExpr)
+    {
+        JLANG_ERROR("Atomic operations expect a variable, a field or an element");
+        return nullptr;
+    }
+
+    auto &member = static_cast<MemberExpr &>(target);
+
+    member.object->Accept(*this);
+    llvm::Value *object = m_LastValue;
+
+    if (!object)
+    {
+        JLANG_ERROR("Invalid object in member access");
+        return nullptr;
+    }
+
+    unsigned fieldIndex = 0;
+    const StructInfo *info = ResolveMember(object, member.member, fieldIndex);
+
+    if (!info)
+    {
+        return nullptr;
+    }
+
+    if (!info->isSoa && !object->getType()->isPointerTy())
+    {
+        JLANG_ERROR(STR("Cannot access member of a struct value atomically: %s", member.member.c_str()));
+        return nullptr;
+    }
+
+    return EmitFieldAddress(object, *info, fieldIndex, member.member);
+}
+
+bool CodeGenerator::CheckAtomicType(llvm::Type *type, const std::string &name)
+{
+    if (type->isIntegerTy(32) || type->isPointerTy())
+    {
+        return true;
+    }
+
+    JLANG_ERROR(STR("%s: only int32 and pointers can be atomic", name.c_str()));
+    return false;
+}
+
+void CodeGenerator::MakeSequentiallyConsistent(llvm::Instruction *access)
+{
+    if (auto *load = llvm::dyn_cast<llvm::LoadInst>(access))
+    {
+        load->setAtomic(llvm::AtomicOrdering::SequentiallyConsistent);
+    }
+    else if (auto *store = llvm::dyn_cast<llvm::StoreInst>(access))
+    {
+        store->setAtomic(llvm::AtomicOrdering::SequentiallyConsistent);
+    }
+}
+
+} // namespace jlang
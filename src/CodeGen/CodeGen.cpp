@@ -2,340 +2,2405 @@
 
 #include "../Common/Logger.h"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
 
 namespace jlang
 {
 
-CodeGenerator::CodeGenerator()
-    : m_Module(std::make_unique<llvm::Module>("JlangModule", m_Context)), m_IRBuilder(m_Context)
+CodeGenerator::CodeGenerator(const TypeTable &typeTable, const SymbolInterner &symbols)
+    : m_Module(std::make_unique<llvm::Module>("JlangModule", m_Context)), m_IRBuilder(m_Context),
+      m_TypeTable(typeTable), m_Types(typeTable.Size(), nullptr), m_Symbols(symbols)
 {
+    ConfigureTarget();
+    DeclareRuntimeFunctions();
+    DeclareTBAATypes();
+}
+
+void CodeGenerator::ConfigureTarget()
+{
+    // Struct layouts, TBAA offsets and the optimizer must agree with the JIT, which runs on the host
+    llvm::InitializeNativeTarget();
+
+    std::string triple = llvm::sys::getDefaultTargetTriple();
+    std::string error;
+    const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+
+    if (!target)
+    {
+        JLANG_ERROR(STR("Cannot find target %s: %s", triple.c_str(), error.c_str()));
+        return;
+    }
+
+    std::unique_ptr<llvm::TargetMachine> targetMachine(
+        target->createTargetMachine(triple, "generic", "", llvm::TargetOptions(), llvm::None));
+
+    m_Module->setTargetTriple(triple);
+    m_Module->setDataLayout(targetMachine->createDataLayout());
+}
+
+void CodeGenerator::DeclareTBAATypes()
+{
+    // Same shape as clang's C hierarchy: char aliases everything, every other scalar hangs off char
+    llvm::MDBuilder mdBuilder(m_Context);
+    llvm::MDNode *root = mdBuilder.createTBAARoot("Jlang TBAA");
+
+    m_TBAAChar = mdBuilder.createTBAAScalarTypeNode("omnipotent char", root);
+    m_TBAAInt32 = mdBuilder.createTBAAScalarTypeNode("int32", m_TBAAChar);
+    m_TBAAPointer = mdBuilder.createTBAAScalarTypeNode("any pointer", m_TBAAChar);
+}
+
+void CodeGenerator::DeclareRuntimeFunctions()
+{
+    llvm::Type *bytePtrType = llvm::Type::getInt8PtrTy(m_Context);
+
+    // JHeapSite, the hidden last argument of jalloc
+    m_HeapSiteType = llvm::StructType::create(
+        m_Context, {bytePtrType, bytePtrType, llvm::Type::getInt32Ty(m_Context)}, "jheap_site");
+
+    llvm::Type *sitePtrType = llvm::PointerType::getUnqual(m_HeapSiteType);
+
+    llvm::Function::Create(
+        llvm::FunctionType::get(bytePtrType, {llvm::Type::getInt64Ty(m_Context), sitePtrType}, false),
+        llvm::Function::ExternalLinkage, "jalloc", m_Module.get());
+
+    llvm::Function::Create(llvm::FunctionType::get(llvm::Type::getVoidTy(m_Context), {bytePtrType}, false),
+                           llvm::Function::ExternalLinkage, "jfree", m_Module.get());
+
+    llvm::Function::Create(llvm::FunctionType::get(llvm::Type::getInt32Ty(m_Context), {bytePtrType}, true),
+                           llvm::Function::ExternalLinkage, "jout", m_Module.get());
+
+    // Only reached when a bounds check fails, which lets the optimizer treat every check as unlikely
+    llvm::Type *int32Type = llvm::Type::getInt32Ty(m_Context);
+    llvm::Function *boundsFail = llvm::Function::Create(
+        llvm::FunctionType::get(llvm::Type::getVoidTy(m_Context),
+                                {bytePtrType, int32Type, llvm::Type::getInt64Ty(m_Context), int32Type}, false),
+        llvm::Function::ExternalLinkage, "jbounds_fail", m_Module.get());
+    boundsFail->setDoesNotReturn();
+    boundsFail->setDoesNotThrow();
+    boundsFail->addFnAttr(llvm::Attribute::Cold);
+
+    llvm::Function *strCompare = llvm::Function::Create(
+        llvm::FunctionType::get(int32Type, {bytePtrType, int32Type, bytePtrType, int32Type}, false),
+        llvm::Function::ExternalLinkage, "jstr_compare", m_Module.get());
+    strCompare->setOnlyReadsMemory();
+    strCompare->setDoesNotThrow();
+
+    // Only the bump pointer fields of JArena are spelled out, they are all the inlined jarena_alloc touches
+    m_ArenaType = llvm::StructType::create(m_Context, {bytePtrType, bytePtrType}, "jarena");
+    llvm::Type *arenaPtrType = llvm::PointerType::getUnqual(m_ArenaType);
+    llvm::Type *voidType = llvm::Type::getVoidTy(m_Context);
+
+    llvm::Function::Create(llvm::FunctionType::get(arenaPtrType, false), llvm::Function::ExternalLinkage,
+                           "jarena_new", m_Module.get());
+
+    llvm::Function::Create(
+        llvm::FunctionType::get(bytePtrType, {arenaPtrType, llvm::Type::getInt64Ty(m_Context)}, false),
+        llvm::Function::ExternalLinkage, "jarena_alloc", m_Module.get());
+
+    for (const char *name : {"jarena_reset", "jarena_free"})
+    {
+        llvm::Function::Create(llvm::FunctionType::get(voidType, {arenaPtrType}, false),
+                               llvm::Function::ExternalLinkage, name, m_Module.get());
+    }
+
+    m_TaskGroupType = llvm::StructType::create(m_Context, {llvm::Type::getInt64Ty(m_Context)}, "jtask_group");
+    llvm::Type *taskGroupPtrType = llvm::PointerType::getUnqual(m_TaskGroupType);
+
+    llvm::Type *taskFnType =
+        llvm::PointerType::getUnqual(llvm::FunctionType::get(voidType, {bytePtrType}, false));
+    llvm::Type *rangeFnType = llvm::PointerType::getUnqual(
+        llvm::FunctionType::get(voidType, {bytePtrType, int32Type, int32Type}, false));
+
+    llvm::Function::Create(llvm::FunctionType::get(voidType,
+                                                   {taskGroupPtrType, taskFnType, bytePtrType,
+                                                    llvm::Type::getInt64Ty(m_Context)},
+                                                   false),
+                           llvm::Function::ExternalLinkage, "jtask_spawn", m_Module.get());
+
+    llvm::Function::Create(llvm::FunctionType::get(voidType, {taskGroupPtrType}, false),
+                           llvm::Function::ExternalLinkage, "jtask_sync", m_Module.get());
+
+    llvm::Function::Create(
+        llvm::FunctionType::get(voidType, {int32Type, int32Type, rangeFnType, bytePtrType}, false),
+        llvm::Function::ExternalLinkage, "jtask_parallel_for", m_Module.get());
+
+    // The promise of every coroutine holds the handle of the one awaiting it, null while nobody does
+    m_PromiseType = llvm::StructType::create(m_Context, {bytePtrType}, "jco_promise");
+
+    llvm::Function::Create(llvm::FunctionType::get(voidType, {bytePtrType}, false),
+                           llvm::Function::ExternalLinkage, "jco_schedule", m_Module.get());
+
+    llvm::Function::Create(llvm::FunctionType::get(voidType, {bytePtrType, int32Type, int32Type}, false),
+                           llvm::Function::ExternalLinkage, "jio_park", m_Module.get());
+
+    for (const char *name : {"jio_read", "jio_write"})
+    {
+        llvm::Function::Create(llvm::FunctionType::get(int32Type, {int32Type, bytePtrType, int32Type}, false),
+                               llvm::Function::ExternalLinkage, name, m_Module.get());
+    }
+
+    for (const char *name : {"jio_accept", "jlisten", "jclose"})
+    {
+        llvm::Function::Create(llvm::FunctionType::get(int32Type, {int32Type}, false),
+                               llvm::Function::ExternalLinkage, name, m_Module.get());
+    }
+
+    llvm::Function::Create(llvm::FunctionType::get(int32Type, {bytePtrType}, false),
+                           llvm::Function::ExternalLinkage, "jopen", m_Module.get());
+
+    llvm::Function::Create(llvm::FunctionType::get(voidType, false), llvm::Function::ExternalLinkage,
+                           "jloop_run", m_Module.get());
+}
+
+void CodeGenerator::EnableProfileGeneration(const std::string &outputPath)
+{
+    m_ProfileOutputPath = outputPath;
+}
+
+void CodeGenerator::EnableHeapProfile(const std::string &outputPath, int64_t sampleRate)
+{
+    m_HeapProfilePath = outputPath;
+    m_HeapProfileRate = sampleRate;
+}
+
+void CodeGenerator::DisableBoundsChecks()
+{
+    m_IsBoundsChecking = false;
+}
+
+void CodeGenerator::UseProfile(const ProfileData &profile)
+{
+    m_Profile = &profile;
 }
 
 void CodeGenerator::Generate(const std::vector<std::shared_ptr<AstNode>> &program)
 {
-    for (const auto &node : program)
+    if (m_Profile)
+    {
+        // The summary decides which counts are hot or cold, here and in the optimizer
+        m_Module->setProfileSummary(m_Profile->BuildSummary()->getMD(m_Context),
+                                    llvm::ProfileSummary::PSK_Instr);
+        m_ProfileSummary = std::make_unique<llvm::ProfileSummaryInfo>(*m_Module);
+    }
+
+    std::vector<const std::vector<std::shared_ptr<AstNode>> *> units = m_ImportedUnits;
+    units.push_back(&program);
+
+    // Struct bodies first, so functions and other structs can use a struct declared further down or in
+    // another unit
+    std::vector<const StructDecl *> structDecls;
+
+    for (const auto *unit : units)
+    {
+        for (const auto &node : *unit)
+        {
+            if (node && node->type == NodeType::StructDecl)
+            {
+                node->Accept(*this);
+                structDecls.push_back(static_cast<const StructDecl *>(node.get()));
+            }
+        }
+    }
+
+    // TBAA offsets need the layout of every field, which is only complete once all bodies are set
+    for (const StructDecl *structDecl : structDecls)
+    {
+        BuildTBAAInfo(GetStructInfo(structDecl->typeId), *structDecl);
+    }
+
+    // Calls naming an interface method pick the implementation from the receiver
+    for (TypeId id = 0; id < m_TypeTable.Size(); ++id)
+    {
+        const TypeInfo &type = m_TypeTable.Get(id);
+
+        if (type.kind == TypeKind::Interface)
+        {
+            m_MethodNames.insert(type.methods.begin(), type.methods.end());
+        }
+    }
+
+    // Then every prototype, so calls resolve no matter where the callee is defined
+    for (const auto *unit : units)
+    {
+        for (const auto &node : *unit)
+        {
+            if (node && node->type == NodeType::FunctionDecl)
+            {
+                DeclareFunction(static_cast<const FunctionDecl &>(*node));
+            }
+        }
+    }
+
+    // Unit-level const vars of every unit are visible in every function, like the functions are
+    m_Symbols.PushScope();
+
+    for (const auto *unit : units)
+    {
+        for (const auto &node : *unit)
+        {
+            if (node && node->type == NodeType::VariableDecl)
+            {
+                node->Accept(*this);
+            }
+        }
+    }
+
+    for (const auto &node : program)
+    {
+        if (node && node->type != NodeType::StructDecl && node->type != NodeType::VariableDecl)
+        {
+            node->Accept(*this);
+        }
+    }
+
+    m_Symbols.PopScope();
+
+    EmitProfileRegistration();
+    EmitHeapProfileRegistration();
+
+    if (m_DIBuilder)
+    {
+        m_DIBuilder->finalize();
+    }
+}
+
+void CodeGenerator::EnableDebugInfo(const std::string &sourcePath, bool isOptimized)
+{
+    llvm::SmallString<256> absolutePath(sourcePath);
+    llvm::sys::fs::make_absolute(absolutePath);
+
+    m_DIBuilder = std::make_unique<llvm::DIBuilder>(*m_Module);
+    m_DIFile = m_DIBuilder->createFile(llvm::sys::path::filename(absolutePath),
+                                       llvm::sys::path::parent_path(absolutePath));
+
+    // There is no DWARF language code for Jlang, C is the closest for debuggers to work with
+    m_DIBuilder->createCompileUnit(llvm::dwarf::DW_LANG_C, m_DIFile, "Jlang", isOptimized, "", 0);
+
+    m_Module->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+    m_Module->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+}
+
+void CodeGenerator::AddImportedUnit(const std::vector<std::shared_ptr<AstNode>> &program)
+{
+    m_ImportedUnits.push_back(&program);
+}
+
+void CodeGenerator::DumpIR()
+{
+    m_Module->print(llvm::outs(), nullptr);
+}
+
+llvm::Function *CodeGenerator::DeclareFunction(const FunctionDecl &node)
+{
+    auto it = m_Functions.find(&node);
+
+    if (it != m_Functions.end())
+    {
+        return it->second;
+    }
+
+    std::vector<llvm::Type *> paramTypes;
+    for (const auto &param : node.params)
+    {
+        paramTypes.push_back(MapType(param.type));
+    }
+
+    llvm::Type *returnType = MapType(node.returnType);
+
+    if (!returnType || std::find(paramTypes.begin(), paramTypes.end(), nullptr) != paramTypes.end())
+    {
+        JLANG_ERROR(STR("Unresolved type in signature of function: %s", node.name.c_str()));
+        m_Functions[&node] = nullptr;
+        return nullptr;
+    }
+
+    // Calling an async function only creates its coroutine, the caller gets the handle to it
+    if (node.isAsync)
+    {
+        if (!returnType->isVoidTy())
+        {
+            JLANG_ERROR(STR("Async function %s must return void", node.name.c_str()));
+            m_Functions[&node] = nullptr;
+            return nullptr;
+        }
+
+        returnType = llvm::Type::getInt8PtrTy(m_Context);
+    }
+
+    llvm::FunctionType *funcType = llvm::FunctionType::get(returnType, paramTypes, false);
+
+    // Structs implementing the same interface each have their own print, named Person.print, Frog.print
+    TypeId receiver = GetMethodReceiver(node);
+    std::string name =
+        receiver != InvalidTypeId ? m_TypeTable.Get(receiver).name + "." + node.name : node.name;
+
+    llvm::Function *function =
+        llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, name, m_Module.get());
+
+    if (node.isAsync)
+    {
+        m_AsyncFunctions.insert(function);
+    }
+
+    if (receiver != InvalidTypeId)
+    {
+        m_Methods[{receiver, node.name}] = function;
+    }
+
+    m_Functions[&node] = function;
+    m_UserFunctions.insert(function);
+    return function;
+}
+
+void CodeGenerator::VisitFunctionDecl(FunctionDecl &node)
+{
+    llvm::Function *function = DeclareFunction(node);
+
+    if (!function)
+    {
+        return;
+    }
+
+    llvm::Type *returnType = function->getReturnType();
+
+    llvm::BasicBlock *entry = llvm::BasicBlock::Create(m_Context, "entry", function);
+    m_IRBuilder.SetInsertPoint(entry);
+
+    if (m_DIBuilder)
+    {
+        llvm::DISubroutineType *functionType =
+            m_DIBuilder->createSubroutineType(m_DIBuilder->getOrCreateTypeArray({}));
+
+        m_DIScope = m_DIBuilder->createFunction(
+            m_DIFile, node.name, function->getName(), m_DIFile, node.location.line, functionType,
+            node.location.line, llvm::DINode::FlagPrototyped, llvm::DISubprogram::SPFlagDefinition);
+        function->setSubprogram(m_DIScope);
+        EmitLocation(node);
+    }
+
+    // Parameters form the outermost scope of the function, the body block opens its own
+    m_Symbols.PushScope();
+
+    unsigned i = 0;
+    for (auto &arg : function->args())
+    {
+        arg.setName(node.params[i].name);
+        m_Symbols.Declare(node.params[i].symbol, &arg);
+        ++i;
+    }
+
+    BeginFunctionProfile(node, function);
+    m_TaskGroup = nullptr;
+    m_Coroutine = CoroutineState();
+    m_CurrentFunction = &node;
+    m_Returns.clear();
+
+    if (node.isAsync)
+    {
+        BeginCoroutine(function);
+    }
+
+    if (node.body)
+    {
+        node.body->Accept(*this);
+    }
+
+    if (node.isAsync)
+    {
+        EndCoroutine();
+    }
+    else if (!m_IRBuilder.GetInsertBlock()->getTerminator())
+    {
+        // Falling off the end of a function returns zero, like C's main
+        bool isVoid = node.returnType.id == TypeTable::VoidId;
+        EmitReturn(isVoid ? nullptr : llvm::Constant::getNullValue(returnType), false);
+    }
+
+    FinishReturns(node);
+
+    m_Symbols.PopScope();
+    m_Coroutine = CoroutineState();
+    m_CurrentFunction = nullptr;
+
+    // Instructions of the next function must not pick up a location in this one
+    m_DIScope = nullptr;
+    m_IRBuilder.SetCurrentDebugLocation(llvm::DebugLoc());
+
+    llvm::verifyFunction(*function);
+}
+
+void CodeGenerator::VisitImportDecl(ImportDecl &)
+{
+    // Resolved by the driver, imported declarations arrive through AddImportedUnit
+}
+
+void CodeGenerator::VisitInterfaceDecl(InterfaceDecl &node)
+{
+    // The value and vtable types are created by GetInterfaceInfo once the interface is used
+    JLANG_DEBUG(STR("Interface %s has no code of its own", node.name.c_str()));
+}
+
+void CodeGenerator::VisitStructDecl(StructDecl &node)
+{
+    StructInfo &info = GetStructInfo(node.typeId);
+
+    if (!info.rowType->isOpaque())
+    {
+        JLANG_ERROR(STR("Redefinition of struct: %s", node.name.c_str()));
+        return;
+    }
+
+    std::vector<llvm::Type *> fieldTypes;
+    for (const auto &field : node.fields)
+    {
+        llvm::Type *fieldType = MapType(field.type);
+
+        if (!fieldType || fieldType->isVoidTy())
+        {
+            JLANG_ERROR(STR("Invalid type for field %s of struct %s", field.name.c_str(), node.name.c_str()));
+            return;
+        }
+
+        if (field.type.isAtomic && !CheckAtomicType(fieldType, field.name))
+        {
+            return;
+        }
+
+        info.fieldIndices[field.name] = static_cast<unsigned>(fieldTypes.size());
+        info.atomicFields.push_back(field.type.isAtomic);
+        fieldTypes.push_back(fieldType);
+    }
+
+    info.rowType->setBody(fieldTypes);
+
+    if (node.isSoa)
+    {
+        std::vector<llvm::Type *> columnTypes;
+        for (llvm::Type *fieldType : fieldTypes)
+        {
+            columnTypes.push_back(llvm::PointerType::getUnqual(fieldType));
+        }
+
+        info.columnsType->setBody(columnTypes);
+    }
+
+    JLANG_DEBUG(STR("Defined %sstruct type: %s", node.isSoa ? "soa " : "", node.name.c_str()));
+}
+
+void CodeGenerator::VisitVariableDecl(VariableDecl &node)
+{
+    if (node.isConst)
+    {
+        EmitConstVariable(node);
+        return;
+    }
+
+    EmitLocation(node);
+
+    llvm::Type *varType = MapType(node.varType);
+    if (!varType)
+    {
+        JLANG_ERROR(STR("Unknown variable type: %s", node.varType.name.c_str()));
+        return;
+    }
+
+    if (node.varType.isAtomic && !CheckAtomicType(varType, node.name))
+    {
+        return;
+    }
+
+    llvm::AllocaInst *alloca = CreateEntryBlockAlloca(varType, node.name);
+
+    if (node.varType.isAtomic)
+    {
+        m_AtomicSlots.insert(alloca);
+    }
+
+    if (node.isStackAllocated)
+    {
+        // EscapeAnalysis proved the object dies with this frame, so the jalloc initializer is not emitted
+        TypeId pointee = m_TypeTable.Get(node.varType.id).pointee;
+
+        if (pointee == InvalidTypeId || m_TypeTable.Get(pointee).kind != TypeKind::Struct)
+        {
+            JLANG_ERROR(STR("Unknown struct for stack allocation: %s", node.varType.name.c_str()));
+            return;
+        }
+
+        llvm::StructType *objectType = GetStructInfo(pointee).rowType;
+        uint64_t objectSize = m_Module->getDataLayout().getTypeAllocSize(objectType);
+        const char *function = m_CurrentFunction ? m_CurrentFunction->name.c_str() : "";
+
+        if (objectSize <= MaxStackObjectSize)
+        {
+            llvm::AllocaInst *object = CreateEntryBlockAlloca(objectType, node.name + "_obj");
+            m_IRBuilder.CreateStore(object, alloca);
+            m_StackObjectSlots.insert(alloca);
+            m_Symbols.Declare(node.symbol, alloca);
+
+            JLANG_REMARK("escape-analysis",
+                         STR("%s: 'struct %s' object '%s' does not escape, jalloc replaced with a stack "
+                             "allocation and jfree removed",
+                             function, node.varType.name.c_str(), node.name.c_str()));
+            return;
+        }
+
+        // Past the limit the jalloc initializer and the jfree are emitted as written
+        JLANG_REMARK("escape-analysis",
+                     STR("%s: 'struct %s' object '%s' does not escape but is not promoted: too large, "
+                         "%llu bytes where the limit is %llu",
+                         function, node.varType.name.c_str(), node.name.c_str(),
+                         static_cast<unsigned long long>(objectSize),
+                         static_cast<unsigned long long>(MaxStackObjectSize)));
+    }
+
+    if (node.initializer && IsArrayStorage(varType))
+    {
+        JLANG_ERROR(STR("Array %s can't have an initializer, assign its elements", node.name.c_str()));
+        return;
+    }
+
+    if (m_SoaArrays.count(varType))
+    {
+        InitializeSoaArray(alloca);
+    }
+
+    if (node.initializer)
+    {
+        node.initializer->Accept(*this);
+        if (!m_LastValue)
+        {
+            JLANG_ERROR(STR("Failed to evaluate initializer for variable: %s", node.name.c_str()));
+            return;
+        }
+
+        if (IsSliceType(varType) && m_LastValue->getType() != varType)
+        {
+            JLANG_ERROR(STR("Slice %s initialized with a value of another type", node.name.c_str()));
+            return;
+        }
+
+        llvm::Value *value = EmitInterfaceValue(DecayStringLiteral(m_LastValue, varType), varType);
+
+        if (!value)
+        {
+            return;
+        }
+
+        EmitLocation(node);
+        m_IRBuilder.CreateStore(value, alloca);
+    }
+
+    m_Symbols.Declare(node.symbol, alloca);
+}
+
+void CodeGenerator::EmitConstVariable(const VariableDecl &node)
+{
+    llvm::Type *varType = MapType(node.varType);
+
+    if (!varType)
+    {
+        JLANG_ERROR(STR("Unknown type of const %s: %s", node.name.c_str(), node.varType.name.c_str()));
+        return;
+    }
+
+    // A const the evaluator failed on was reported there, it is bound to zeros so its uses still compile
+    if (varType->isIntegerTy())
+    {
+        int64_t number = node.constValue.empty() ? 0 : node.constValue[0];
+        m_Symbols.Declare(node.symbol, llvm::ConstantInt::get(varType, static_cast<uint64_t>(number), true));
+        return;
+    }
+
+    if (IsStrType(varType))
+    {
+        std::string text(node.constValue.begin(), node.constValue.end());
+        m_Symbols.Declare(node.symbol, GetStringLiteral(text));
+        return;
+    }
+
+    llvm::Type *elementType = nullptr;
+
+    if (varType->isArrayTy())
+    {
+        elementType = varType->getArrayElementType();
+    }
+    else if (IsSliceType(varType))
+    {
+        elementType = varType->getStructElementType(0)->getPointerElementType();
+    }
+
+    if (!elementType || !elementType->isIntegerTy())
+    {
+        JLANG_ERROR(STR("Invalid type of const %s: %s", node.name.c_str(), node.varType.name.c_str()));
+        return;
+    }
+
+    uint64_t length = varType->isArrayTy() ? varType->getArrayNumElements() : node.constValue.size();
+    std::vector<llvm::Constant *> elements(length, llvm::ConstantInt::get(elementType, 0));
+
+    for (size_t i = 0; i < node.constValue.size() && i < length; ++i)
+    {
+        elements[i] = llvm::ConstantInt::get(elementType, static_cast<uint64_t>(node.constValue[i]), true);
+    }
+
+    auto *arrayType = llvm::ArrayType::get(elementType, length);
+    auto *global = new llvm::GlobalVariable(*m_Module, arrayType, true, llvm::GlobalValue::PrivateLinkage,
+                                            llvm::ConstantArray::get(arrayType, elements), node.name);
+    global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+
+    if (varType->isArrayTy())
+    {
+        m_Symbols.Declare(node.symbol, global);
+        return;
+    }
+
+    llvm::Constant *zero = m_IRBuilder.getInt32(0);
+    llvm::Constant *indices[] = {zero, zero};
+    llvm::Constant *data = llvm::ConstantExpr::getInBoundsGetElementPtr(arrayType, global, indices);
+    llvm::Constant *count = m_IRBuilder.getInt32(static_cast<uint32_t>(length));
+
+    auto *sliceType = llvm::cast<llvm::StructType>(varType);
+    m_Symbols.Declare(node.symbol, llvm::ConstantStruct::get(sliceType, {data, count}));
+}
+
+void CodeGenerator::VisitIfStatement(IfStatement &node)
+{
+    EmitLocation(node);
+
+    node.condition->Accept(*this);
+    llvm::Value *isConditionalValue = m_LastValue;
+
+    if (!isConditionalValue)
+    {
+        JLANG_ERROR("Invalid condition in if statement");
+    }
+
+    if (isConditionalValue->getType()->isIntegerTy(32))
+    {
+        isConditionalValue = m_IRBuilder.CreateICmpNE(
+            isConditionalValue, llvm::ConstantInt::get(isConditionalValue->getType(), 0), "ifcond");
+    }
+
+    llvm::Function *parentFunction = m_IRBuilder.GetInsertBlock()->getParent();
+
+    llvm::BasicBlock *thenBlock = llvm::BasicBlock::Create(m_Context, "then", parentFunction);
+    llvm::BasicBlock *mergeBlock = llvm::BasicBlock::Create(m_Context, "ifcont");
+
+    // Without an else branch the false edge goes straight to the merge block
+    llvm::BasicBlock *elseBlock = node.elseBranch ? llvm::BasicBlock::Create(m_Context, "else") : mergeBlock;
+
+    // Profile counters: how often the if is reached and how often the then branch is taken
+    unsigned counter = m_NextCounter;
+    m_NextCounter += 2;
+
+    if (m_ProfileCounters)
+    {
+        EmitCounterIncrement(counter);
+    }
+
+    m_IRBuilder.CreateCondBr(isConditionalValue, thenBlock, elseBlock,
+                             m_FunctionProfile ? BuildBranchWeights(counter) : nullptr);
+
+    m_IRBuilder.SetInsertPoint(thenBlock);
+
+    if (m_ProfileCounters)
+    {
+        EmitCounterIncrement(counter + 1);
+    }
+
+    node.thenBranch->Accept(*this);
+
+    // A branch that ended in a return already has its terminator
+    if (!m_IRBuilder.GetInsertBlock()->getTerminator())
+    {
+        m_IRBuilder.CreateBr(mergeBlock);
+    }
+
+    if (node.elseBranch)
+    {
+        parentFunction->getBasicBlockList().push_back(elseBlock);
+        m_IRBuilder.SetInsertPoint(elseBlock);
+        node.elseBranch->Accept(*this);
+
+        if (!m_IRBuilder.GetInsertBlock()->getTerminator())
+        {
+            m_IRBuilder.CreateBr(mergeBlock);
+        }
+    }
+
+    parentFunction->getBasicBlockList().push_back(mergeBlock);
+    m_IRBuilder.SetInsertPoint(mergeBlock);
+}
+
+void CodeGenerator::VisitWhileStatement(WhileStatement &node)
+{
+    EmitLocation(node);
+
+    llvm::Function *parentFunction = m_IRBuilder.GetInsertBlock()->getParent();
+
+    llvm::BasicBlock *conditionBlock = llvm::BasicBlock::Create(m_Context, "while.cond", parentFunction);
+    llvm::BasicBlock *bodyBlock = llvm::BasicBlock::Create(m_Context, "while.body");
+    llvm::BasicBlock *endBlock = llvm::BasicBlock::Create(m_Context, "while.end");
+
+    m_IRBuilder.CreateBr(conditionBlock);
+    m_IRBuilder.SetInsertPoint(conditionBlock);
+
+    llvm::Value *condition = EmitLoopCondition(node.condition.get());
+
+    if (!condition)
+    {
+        JLANG_ERROR("Invalid condition in while statement");
+        return;
+    }
+
+    m_IRBuilder.CreateCondBr(condition, bodyBlock, endBlock);
+
+    parentFunction->getBasicBlockList().push_back(bodyBlock);
+    m_IRBuilder.SetInsertPoint(bodyBlock);
+
+    if (node.body)
+    {
+        node.body->Accept(*this);
+    }
+
+    // A body that always returns has no back edge to put the hints on
+    if (!m_IRBuilder.GetInsertBlock()->getTerminator())
+    {
+        llvm::BranchInst *backEdge = m_IRBuilder.CreateBr(conditionBlock);
+
+        if (llvm::MDNode *loopMetadata = BuildLoopMetadata(node.hints))
+        {
+            backEdge->setMetadata(llvm::LLVMContext::MD_loop, loopMetadata);
+        }
+    }
+
+    parentFunction->getBasicBlockList().push_back(endBlock);
+    m_IRBuilder.SetInsertPoint(endBlock);
+}
+
+void CodeGenerator::VisitForStatement(ForStatement &node)
+{
+    EmitLocation(node);
+
+    // A variable declared in the initializer is only visible inside the loop
+    m_Symbols.PushScope();
+
+    if (node.initializer)
+    {
+        node.initializer->Accept(*this);
+    }
+
+    llvm::Function *parentFunction = m_IRBuilder.GetInsertBlock()->getParent();
+
+    llvm::BasicBlock *conditionBlock = llvm::BasicBlock::Create(m_Context, "for.cond", parentFunction);
+    llvm::BasicBlock *bodyBlock = llvm::BasicBlock::Create(m_Context, "for.body");
+    llvm::BasicBlock *incrementBlock = llvm::BasicBlock::Create(m_Context, "for.inc");
+    llvm::BasicBlock *endBlock = llvm::BasicBlock::Create(m_Context, "for.end");
+
+    m_IRBuilder.CreateBr(conditionBlock);
+    m_IRBuilder.SetInsertPoint(conditionBlock);
+
+    if (node.condition)
+    {
+        llvm::Value *condition = EmitLoopCondition(node.condition.get());
+
+        if (!condition)
+        {
+            JLANG_ERROR("Invalid condition in for statement");
+            m_Symbols.PopScope();
+            return;
+        }
+
+        m_IRBuilder.CreateCondBr(condition, bodyBlock, endBlock);
+    }
+    else
+    {
+        m_IRBuilder.CreateBr(bodyBlock);
+    }
+
+    parentFunction->getBasicBlockList().push_back(bodyBlock);
+    m_IRBuilder.SetInsertPoint(bodyBlock);
+
+    if (node.body)
+    {
+        node.body->Accept(*this);
+    }
+
+    if (!m_IRBuilder.GetInsertBlock()->getTerminator())
+    {
+        m_IRBuilder.CreateBr(incrementBlock);
+    }
+
+    // The increment block is the single latch, so the loop hints go on its back edge
+    parentFunction->getBasicBlockList().push_back(incrementBlock);
+    m_IRBuilder.SetInsertPoint(incrementBlock);
+
+    if (node.increment)
+    {
+        node.increment->Accept(*this);
+    }
+
+    llvm::BranchInst *backEdge = m_IRBuilder.CreateBr(conditionBlock);
+
+    if (llvm::MDNode *loopMetadata = BuildLoopMetadata(node.hints))
+    {
+        backEdge->setMetadata(llvm::LLVMContext::MD_loop, loopMetadata);
+    }
+
+    parentFunction->getBasicBlockList().push_back(endBlock);
+    m_IRBuilder.SetInsertPoint(endBlock);
+
+    m_Symbols.PopScope();
+}
+
+void CodeGenerator::VisitBlockStatement(BlockStatement &node)
+{
+    m_Symbols.PushScope();
+
+    for (auto &statement : node.statements)
+    {
+        if (statement)
+        {
+            statement->Accept(*this);
+        }
+
+        // Nothing branches to the statements after a return, they are not emitted
+        if (m_IRBuilder.GetInsertBlock()->getTerminator())
+        {
+            break;
+        }
+    }
+
+    m_Symbols.PopScope();
+}
+
+void CodeGenerator::VisitExprStatement(ExprStatement &node)
+{
+    if (node.expression)
+    {
+        node.expression->Accept(*this);
+        // m_LastValue is ignored  result discarded
+    }
+}
+
+void CodeGenerator::VisitReturnStatement(ReturnStatement &node)
+{
+    m_LastValue = nullptr;
+
+    if (!m_CurrentFunction)
+    {
+        JLANG_ERROR("return is not allowed in a parallel_for body");
+        return;
+    }
+
+    EmitLocation(node);
+
+    llvm::Function *function = m_IRBuilder.GetInsertBlock()->getParent();
+    llvm::Type *returnType = function->getReturnType();
+    const char *name = m_CurrentFunction->name.c_str();
+
+    if (m_CurrentFunction->isAsync)
+    {
+        if (node.isTail)
+        {
+            JLANG_ERROR(STR("%s: tail calls are not allowed in async functions", name));
+            return;
+        }
+
+        if (node.value)
+        {
+            JLANG_ERROR(STR("%s: async functions return nothing", name));
+            return;
+        }
+
+        m_IRBuilder.CreateBr(m_Coroutine.returnBlock);
+    }
+    else if (returnType->isVoidTy())
+    {
+        // 'return f(x);' is allowed when f returns void too, it is how a void function asks for a tail call
+        if (node.value)
+        {
+            node.value->Accept(*this);
+
+            if (!m_LastValue || !m_LastValue->getType()->isVoidTy())
+            {
+                JLANG_ERROR(STR("%s returns void, it cannot return a value", name));
+                return;
+            }
+        }
+
+        EmitReturn(nullptr, node.isTail);
+    }
+    else if (!node.value)
+    {
+        JLANG_ERROR(STR("%s must return a value", name));
+        return;
+    }
+    else
+    {
+        llvm::Value *value = EmitArgument(*node.value, returnType, true);
+
+        if (!value)
+        {
+            JLANG_ERROR(STR("Invalid return value in %s", name));
+            return;
+        }
+
+        EmitReturn(value, node.isTail);
+    }
+}
+
+void CodeGenerator::VisitCallExpr(CallExpr &node)
+{
+    if (node.isSpawned || node.callee == "sync")
+    {
+        EmitTaskStatement(node);
+        return;
+    }
+
+    if (node.isAwaited && !m_Coroutine.handle)
+    {
+        JLANG_ERROR(STR("await of %s outside of an async function", node.callee.c_str()));
+        m_LastValue = nullptr;
+        return;
+    }
+
+    if (node.isAwaited && EmitIoAwait(node))
+    {
+        return;
+    }
+
+    if (EmitMethodCall(node))
+    {
+        return;
+    }
+
+    llvm::Function *callee = m_Module->getFunction(node.callee);
+
+    if (!callee && (EmitVectorBuiltin(node) || EmitAtomicBuiltin(node) || EmitSliceBuiltin(node) ||
+                    EmitParallelFor(node)))
+    {
+        return;
+    }
+
+    if (node.callee == "jarena_alloc" && callee && callee->isDeclaration())
+    {
+        EmitArenaAlloc(node, callee);
+        return;
+    }
+
+    if (node.callee == "jalloc" && callee && callee->isDeclaration())
+    {
+        EmitHeapAlloc(node, callee);
+        return;
+    }
+
+    // The object this jfree releases was moved onto the stack and dies with the frame
+    if (node.freesStackObject &&
+        m_StackObjectSlots.count(m_Symbols.Lookup(static_cast<const VarExpr &>(*node.arguments[0]).symbol)))
+    {
+        m_LastValue = nullptr;
+        return;
+    }
+
+    if (!callee)
+    {
+        JLANG_ERROR(STR("Unknown function: %s", node.callee.c_str()));
+        return;
+    }
+
+    llvm::FunctionType *calleeType = callee->getFunctionType();
+    bool isUserFunction = m_UserFunctions.count(callee) != 0;
+
+    std::vector<llvm::Value *> args;
+    for (auto &arg : node.arguments)
+    {
+        // Variadic arguments are passed as they are
+        llvm::Type *paramType = args.size() < calleeType->getNumParams()
+                                    ? calleeType->getParamType(static_cast<unsigned>(args.size()))
+                                    : nullptr;
+
+        llvm::Value *value = EmitArgument(*arg, paramType, isUserFunction);
+        if (!value)
+        {
+            JLANG_ERROR(STR("Invalid argument in call to %s", node.callee.c_str()));
+            return;
+        }
+
+        args.push_back(value);
+    }
+
+    if (calleeType->isVarArg() && !ExpandStrArguments(node, args, calleeType->getNumParams()))
+    {
+        m_LastValue = nullptr;
+        return;
+    }
+
+    EmitLocation(node);
+
+    // Calls returning void can't carry a value name
+    std::string callName = calleeType->getReturnType()->isVoidTy() ? "" : node.callee + "_call";
+    m_LastValue = m_IRBuilder.CreateCall(callee, args, callName);
+
+    if (m_AsyncFunctions.count(callee))
+    {
+        EmitCoroutineCall(node, m_LastValue);
+    }
+    else if (node.isAwaited)
+    {
+        JLANG_ERROR(STR("Cannot await %s: it is not an async function", node.callee.c_str()));
+    }
+}
+
+llvm::Value *CodeGenerator::EmitArgument(AstNode &argument, llvm::Type *paramType, bool isUserFunction)
+{
+    m_LastValue = nullptr;
+    argument.Accept(*this);
+
+    return ConvertArgument(m_LastValue, paramType, isUserFunction);
+}
+
+llvm::Value *CodeGenerator::ConvertArgument(llvm::Value *value, llvm::Type *paramType, bool isUserFunction)
+{
+    if (!value || !paramType || paramType == value->getType())
+    {
+        return value;
+    }
+
+    value = EmitInterfaceValue(DecayStringLiteral(value, paramType), paramType);
+
+    if (!value || paramType == value->getType())
+    {
+        return value;
+    }
+
+    // int32 values (e.g. folded sizeofs) widen to 64-bit size parameters
+    if (paramType->isIntegerTy(64) && value->getType()->isIntegerTy() &&
+        value->getType()->getIntegerBitWidth() < 64)
+    {
+        return m_IRBuilder.CreateIntCast(value, paramType, true);
+    }
+
+    // Any other conversion would pass a Frog* as a Person*, or an int32 as a char
+    if (isUserFunction)
+    {
+        return nullptr;
+    }
+
+    // Typed struct pointers are passed to the runtime as plain byte pointers
+    if (paramType->isPointerTy() && value->getType()->isPointerTy())
+    {
+        return m_IRBuilder.CreateBitCast(value, paramType);
+    }
+
+    // The runtime takes int32 values for its other integer widths
+    if (paramType->isIntegerTy() && value->getType()->isIntegerTy())
+    {
+        return m_IRBuilder.CreateIntCast(value, paramType, true);
+    }
+
+    return value;
+}
+
+void CodeGenerator::EmitHeapAlloc(CallExpr &node, llvm::Function *runtimeAlloc)
+{
+    m_LastValue = nullptr;
+
+    if (node.arguments.size() != 1)
+    {
+        JLANG_ERROR("jalloc expects a size");
+        return;
+    }
+
+    llvm::Value *size = EmitArgument(*node.arguments[0], llvm::Type::getInt64Ty(m_Context));
+
+    if (!size || !size->getType()->isIntegerTy(64))
+    {
+        JLANG_ERROR("Invalid argument in call to jalloc");
+        return;
+    }
+
+    EmitLocation(node);
+
+    // parallel_for bodies are named after the function they are written in
+    std::string function = m_IRBuilder.GetInsertBlock()->getParent()->getName().str();
+    m_LastValue = m_IRBuilder.CreateCall(runtimeAlloc, {size, GetHeapSite(function, node.location.line)},
+                                         "jalloc_call");
+}
+
+llvm::Constant *CodeGenerator::GetHeapSite(const std::string &function, uint32_t line)
+{
+    auto *siteType = llvm::PointerType::getUnqual(m_HeapSiteType);
+
+    if (m_HeapProfilePath.empty())
+    {
+        return llvm::ConstantPointerNull::get(siteType);
+    }
+
+    // A private constant per call site, its address is the site id and it names the site in the profile
+    llvm::Constant *site = llvm::ConstantStruct::get(
+        m_HeapSiteType, {m_IRBuilder.CreateGlobalStringPtr(function, "jheap.function"),
+                         m_IRBuilder.CreateGlobalStringPtr(m_Module->getSourceFileName(), "jheap.file"),
+                         m_IRBuilder.getInt32(line)});
+
+    return new llvm::GlobalVariable(*m_Module, m_HeapSiteType, true, llvm::GlobalValue::PrivateLinkage, site,
+                                    "jheap.site");
+}
+
+void CodeGenerator::EmitArenaAlloc(CallExpr &node, llvm::Function *runtimeAlloc)
+{
+    // Keep in sync with JARENA_ALIGNMENT in the runtime
+    constexpr uint64_t ArenaAlignment = 16;
+
+    if (node.arguments.size() != 2)
+    {
+        JLANG_ERROR("jarena_alloc expects an arena and a size");
+        m_LastValue = nullptr;
+        return;
+    }
+
+    node.arguments[0]->Accept(*this);
+    llvm::Value *arena = m_LastValue;
+
+    node.arguments[1]->Accept(*this);
+    llvm::Value *size = m_LastValue;
+
+    if (!arena || !size || arena->getType() != llvm::PointerType::getUnqual(m_ArenaType) ||
+        !size->getType()->isIntegerTy())
+    {
+        JLANG_ERROR("jarena_alloc expects a jarena* and an integer size");
+        m_LastValue = nullptr;
+        return;
+    }
+
+    EmitLocation(node);
+
+    llvm::Type *int64Type = llvm::Type::getInt64Ty(m_Context);
+    llvm::Type *bytePtrType = llvm::Type::getInt8PtrTy(m_Context);
+
+    size = m_IRBuilder.CreateIntCast(size, int64Type, true, "size");
+    llvm::Value *padded = m_IRBuilder.CreateAdd(size, llvm::ConstantInt::get(int64Type, ArenaAlignment - 1));
+    llvm::Value *rounded =
+        m_IRBuilder.CreateAnd(padded, llvm::ConstantInt::get(int64Type, ~(ArenaAlignment - 1)), "rounded");
+
+    llvm::Value *cursorPtr = m_IRBuilder.CreateStructGEP(m_ArenaType, arena, 0, "cursorptr");
+    llvm::Value *limitPtr = m_IRBuilder.CreateStructGEP(m_ArenaType, arena, 1, "limitptr");
+    llvm::Value *cursor = m_IRBuilder.CreateLoad(bytePtrType, cursorPtr, "cursor");
+    llvm::Value *limit = m_IRBuilder.CreateLoad(bytePtrType, limitPtr, "limit");
+
+    // Unsigned compare, so an arena without a chunk (both pointers null) takes the slow path too
+    llvm::Value *available = m_IRBuilder.CreatePtrDiff(m_IRBuilder.getInt8Ty(), limit, cursor, "available");
+    llvm::Value *fits = m_IRBuilder.CreateICmpULE(rounded, available, "fits");
+
+    llvm::Function *parentFunction = m_IRBuilder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *bumpBlock = llvm::BasicBlock::Create(m_Context, "arena.bump", parentFunction);
+    llvm::BasicBlock *refillBlock = llvm::BasicBlock::Create(m_Context, "arena.refill", parentFunction);
+    llvm::BasicBlock *doneBlock = llvm::BasicBlock::Create(m_Context, "arena.done", parentFunction);
+
+    // A refill happens once per chunk, weighted like __builtin_expect
+    llvm::MDBuilder mdBuilder(m_Context);
+    m_IRBuilder.CreateCondBr(fits, bumpBlock, refillBlock, mdBuilder.createBranchWeights(2000, 1));
+
+    m_IRBuilder.SetInsertPoint(bumpBlock);
+    m_IRBuilder.CreateStore(m_IRBuilder.CreateInBoundsGEP(m_IRBuilder.getInt8Ty(), cursor, rounded, "next"),
+                            cursorPtr);
+    m_IRBuilder.CreateBr(doneBlock);
+
+    // The runtime takes a new or reused chunk and allocates from it
+    m_IRBuilder.SetInsertPoint(refillBlock);
+    llvm::Value *refilled = m_IRBuilder.CreateCall(runtimeAlloc, {arena, size}, "refill");
+    m_IRBuilder.CreateBr(doneBlock);
+
+    m_IRBuilder.SetInsertPoint(doneBlock);
+    llvm::PHINode *result = m_IRBuilder.CreatePHI(bytePtrType, 2, "jarena_alloc");
+    result->addIncoming(cursor, bumpBlock);
+    result->addIncoming(refilled, refillBlock);
+
+    m_LastValue = result;
+}
+
+void CodeGenerator::VisitBinaryExpr(BinaryExpr &node)
+{
+    node.left->Accept(*this);
+    llvm::Value *lhs = m_LastValue;
+
+    node.right->Accept(*this);
+    llvm::Value *rhs = m_LastValue;
+
+    EmitLocation(node);
+
+    if (!lhs || !rhs)
+    {
+        JLANG_ERROR("Invalid operands in binary expression");
+        return;
+    }
+
+    if (IsStrType(lhs->getType()) || IsStrType(rhs->getType()))
+    {
+        m_LastValue = EmitStrComparison(node.op, lhs, rhs);
+        return;
+    }
+
+    // NULL is an untyped byte pointer, compare it as the other operand's pointer type
+    if (lhs->getType() != rhs->getType() && lhs->getType()->isPointerTy() && rhs->getType()->isPointerTy())
+    {
+        rhs = m_IRBuilder.CreateBitCast(rhs, lhs->getType());
+    }
+
+    // A char next to an int32, such as an element of a str and a number, is sign-extended to int32
+    if (lhs->getType()->isIntegerTy(8) && rhs->getType()->isIntegerTy(32))
+    {
+        lhs = m_IRBuilder.CreateSExt(lhs, rhs->getType(), "widened");
+    }
+    else if (lhs->getType()->isIntegerTy(32) && rhs->getType()->isIntegerTy(8))
+    {
+        rhs = m_IRBuilder.CreateSExt(rhs, lhs->getType(), "widened");
+    }
+
+    // A scalar next to a vector applies to every lane
+    if (lhs->getType()->isVectorTy() || rhs->getType()->isVectorTy())
+    {
+        if (!lhs->getType()->isVectorTy())
+        {
+            auto *vectorType = llvm::cast<llvm::FixedVectorType>(rhs->getType());
+            lhs = m_IRBuilder.CreateVectorSplat(vectorType->getNumElements(), lhs, "splat");
+        }
+        else if (!rhs->getType()->isVectorTy())
+        {
+            auto *vectorType = llvm::cast<llvm::FixedVectorType>(lhs->getType());
+            rhs = m_IRBuilder.CreateVectorSplat(vectorType->getNumElements(), rhs, "splat");
+        }
+
+        if (lhs->getType() != rhs->getType())
+        {
+            JLANG_ERROR(STR("Operands of %s have different vector types", node.op.c_str()));
+            m_LastValue = nullptr;
+            return;
+        }
+    }
+
+    if (node.op == "+")
+    {
+        if (lhs->getType()->isIntOrIntVectorTy() && rhs->getType()->isIntOrIntVectorTy())
+        {
+            m_LastValue = m_IRBuilder.CreateAdd(lhs, rhs, "addtmp");
+        }
+        else
+        {
+            JLANG_ERROR("Addition only supported on integer types");
+        }
+    }
+    else if (node.op == "-" || node.op == "*")
+    {
+        if (lhs->getType()->isIntOrIntVectorTy() && rhs->getType()->isIntOrIntVectorTy())
+        {
+            m_LastValue = node.op == "-" ? m_IRBuilder.CreateSub(lhs, rhs, "subtmp")
+                                         : m_IRBuilder.CreateMul(lhs, rhs, "multmp");
+        }
+        else
+        {
+            JLANG_ERROR(STR("Operator %s only supported on integer types", node.op.c_str()));
+        }
+    }
+    else if (node.op == "<")
+    {
+        m_LastValue = m_IRBuilder.CreateICmpSLT(lhs, rhs, "lttmp");
+    }
+    else if (node.op == ">")
+    {
+        m_LastValue = m_IRBuilder.CreateICmpSGT(lhs, rhs, "gttmp");
+    }
+    else if (node.op == "==")
+    {
+        m_LastValue = m_IRBuilder.CreateICmpEQ(lhs, rhs, "eqtmp");
+    }
+    else if (node.op == "!=")
+    {
+        m_LastValue = m_IRBuilder.CreateICmpNE(lhs, rhs, "netmp");
+    }
+    else
+    {
+        JLANG_ERROR(STR("Unsupported binary operator: %s", node.op.c_str()));
+    }
+
+    // Vector comparisons give a mask with all bits of a lane set where it holds, like SIMD compare
+    // instructions, so the result is a vector of the operand type again
+    bool isMask = m_LastValue && m_LastValue->getType()->isVectorTy() &&
+                  m_LastValue->getType()->getScalarType()->isIntegerTy(1);
+
+    if (isMask)
+    {
+        m_LastValue = m_IRBuilder.CreateSExt(m_LastValue, lhs->getType(), "masktmp");
+    }
+}
+
+void CodeGenerator::VisitLiteralExpr(LiteralExpr &node)
+{
+    switch (node.kind)
+    {
+    case LiteralKind::Number:
+        m_LastValue = llvm::ConstantInt::get(llvm::Type::getInt32Ty(m_Context), node.numberValue, true);
+        break;
+    case LiteralKind::String:
+        m_LastValue = GetStringLiteral(node.value);
+        break;
+    case LiteralKind::Null:
+        m_LastValue = llvm::ConstantPointerNull::get(llvm::Type::getInt8PtrTy(m_Context));
+        break;
+    }
+}
+
+void CodeGenerator::VisitVarExpr(VarExpr &node)
+{
+    EmitLocation(node);
+
+    llvm::Value *value = m_Symbols.Lookup(node.symbol);
+
+    if (!value)
+    {
+        JLANG_ERROR(STR("Undefined variable: %s", node.name.c_str()));
+        m_LastValue = nullptr;
+        return;
+    }
+
+    // Const arrays are read-only globals, used through a slice like the arrays in stack slots
+    auto *global = llvm::dyn_cast<llvm::GlobalVariable>(value);
+
+    if (global && global->getValueType()->isArrayTy())
+    {
+        m_LastValue = EmitArraySlice(global);
+        return;
+    }
+
+    // Locals live in stack slots, parameters are plain SSA values
+    if (llvm::Type *slotType = GetSlotType(value))
+    {
+        if (IsArrayStorage(slotType))
+        {
+            m_LastValue = EmitArraySlice(value);
+            return;
+        }
+
+        llvm::LoadInst *load = m_IRBuilder.CreateLoad(slotType, value, node.name);
+
+        if (m_AtomicSlots.count(value))
+        {
+            MakeSequentiallyConsistent(load);
+        }
+
+        m_LastValue = load;
+        return;
+    }
+
+    m_LastValue = value;
+}
+
+void CodeGenerator::VisitCastExpr(CastExpr &node)
+{
+    node.expr->Accept(*this);
+    llvm::Value *valueToCast = m_LastValue;
+
+    if (!valueToCast)
+    {
+        JLANG_ERROR("Invalid expression in cast");
+    }
+
+    llvm::Type *targetLLVMType = MapType(node.targetType);
+
+    if (!targetLLVMType)
+    {
+        JLANG_ERROR("Unknown target type in cast");
+    }
+
+    bool isPointerToPointerCast = valueToCast->getType()->isPointerTy() && targetLLVMType->isPointerTy();
+
+    if (isPointerToPointerCast)
+    {
+        m_LastValue = m_IRBuilder.CreateBitCast(valueToCast, targetLLVMType, "ptrcast");
+    }
+    else
+    {
+        JLANG_ERROR(STR("Unsupported cast from %s to %s",
+                        valueToCast->getType()->getStructName().str().c_str(),
+                        targetLLVMType->getStructName().str().c_str()));
+    }
+}
+
+void CodeGenerator::VisitMemberExpr(MemberExpr &node)
+{
+    node.object->Accept(*this);
+    llvm::Value *object = m_LastValue;
+
+    if (!object)
+    {
+        JLANG_ERROR("Invalid object in member access");
+        return;
+    }
+
+    EmitLocation(node);
+
+    unsigned fieldIndex = 0;
+    const StructInfo *info = ResolveMember(object, node.member, fieldIndex);
+
+    if (!info)
+    {
+        m_LastValue = nullptr;
+        return;
+    }
+
+    if (!info->isSoa && !object->getType()->isPointerTy())
+    {
+        m_LastValue = m_IRBuilder.CreateExtractValue(object, fieldIndex, node.member);
+        return;
+    }
+
+    llvm::Value *fieldPtr = EmitFieldAddress(object, *info, fieldIndex, node.member);
+
+    if (info->rowType->getElementType(fieldIndex)->isArrayTy())
+    {
+        m_LastValue = EmitArraySlice(fieldPtr);
+        return;
+    }
+
+    llvm::LoadInst *load = m_IRBuilder.CreateLoad(info->rowType->getElementType(fieldIndex), fieldPtr, node.member);
+    DecorateFieldAccess(load, *info, fieldIndex);
+
+    m_LastValue = load;
+}
+
+void CodeGenerator::VisitIndexExpr(IndexExpr &node)
+{
+    llvm::Value *elementPtr = EmitElementAddress(node);
+
+    // An element of soa rows is the reference of its row, whose fields are loaded through it
+    if (!elementPtr || !elementPtr->getType()->isPointerTy())
+    {
+        m_LastValue = elementPtr;
+        return;
+    }
+
+    llvm::Type *elementType = elementPtr->getType()->getPointerElementType();
+    llvm::LoadInst *load = m_IRBuilder.CreateLoad(elementType, elementPtr, "elem");
+    DecorateElementAccess(load, elementType);
+
+    m_LastValue = load;
+}
+
+void CodeGenerator::VisitAssignExpr(AssignExpr &node)
+{
+    node.value->Accept(*this);
+    llvm::Value *value = m_LastValue;
+
+    if (!value)
+    {
+        JLANG_ERROR("Invalid value in assignment");
+        return;
+    }
+
+    if (node.target->type == NodeType::VarExpr)
+    {
+        auto &target = static_cast<VarExpr &>(*node.target);
+        llvm::Value *slot = m_Symbols.Lookup(target.symbol);
+
+        if (slot && llvm::isa<llvm::Constant>(slot))
+        {
+            JLANG_ERROR(STR("Cannot assign to const %s", target.name.c_str()));
+            m_LastValue = nullptr;
+            return;
+        }
+
+        llvm::Type *slotType = slot ? GetSlotType(slot) : nullptr;
+
+        if (!slotType)
+        {
+            JLANG_ERROR(STR("Cannot assign to: %s", target.name.c_str()));
+            m_LastValue = nullptr;
+            return;
+        }
+
+        if (IsArrayStorage(slotType) || (IsSliceType(slotType) && value->getType() != slotType))
+        {
+            const char *what = IsArrayStorage(slotType) ? "array" : "slice of another type";
+            JLANG_ERROR(STR("Cannot assign to %s: %s", what, target.name.c_str()));
+            m_LastValue = nullptr;
+            return;
+        }
+
+        value = EmitInterfaceValue(DecayStringLiteral(value, slotType), slotType);
+
+        if (!value)
+        {
+            m_LastValue = nullptr;
+            return;
+        }
+
+        EmitLocation(node);
+        llvm::StoreInst *store = m_IRBuilder.CreateStore(value, slot);
+
+        if (m_AtomicSlots.count(slot))
+        {
+            MakeSequentiallyConsistent(store);
+        }
+
+        m_LastValue = value;
+        return;
+    }
+
+    if (node.target->type == NodeType::IndexExpr)
+    {
+        auto &target = static_cast<IndexExpr &>(*node.target);
+
+        // The elements of a const array, slice or str are in read-only memory
+        if (target.object->type == NodeType::VarExpr)
+        {
+            const auto &object = static_cast<const VarExpr &>(*target.object);
+
+            if (llvm::isa_and_nonnull<llvm::Constant>(m_Symbols.Lookup(object.symbol)))
+            {
+                JLANG_ERROR(STR("Cannot assign to an element of const %s", object.name.c_str()));
+                m_LastValue = nullptr;
+                return;
+            }
+        }
+
+        llvm::Value *elementPtr = EmitElementAddress(target);
+
+        if (elementPtr && !elementPtr->getType()->isPointerTy())
+        {
+            JLANG_ERROR("Cannot assign a whole soa row, assign its fields");
+            elementPtr = nullptr;
+        }
+
+        if (!elementPtr)
+        {
+            m_LastValue = nullptr;
+            return;
+        }
+
+        llvm::Type *elementType = elementPtr->getType()->getPointerElementType();
+        value = EmitInterfaceValue(DecayStringLiteral(value, elementType), elementType);
+
+        if (!value)
+        {
+            m_LastValue = nullptr;
+            return;
+        }
+
+        EmitLocation(node);
+        llvm::StoreInst *store = m_IRBuilder.CreateStore(value, elementPtr);
+        DecorateElementAccess(store, elementType);
+
+        m_LastValue = value;
+        return;
+    }
+
+    if (node.target->type != NodeType::MemberExpr)
+    {
+        JLANG_ERROR("Invalid assignment target");
+        m_LastValue = nullptr;
+        return;
+    }
+
+    auto &target = static_cast<MemberExpr &>(*node.target);
+
+    target.object->Accept(*this);
+    llvm::Value *object = m_LastValue;
+
+    if (!object)
+    {
+        JLANG_ERROR("Invalid object in member assignment");
+        return;
+    }
+
+    unsigned fieldIndex = 0;
+    const StructInfo *info = ResolveMember(object, target.member, fieldIndex);
+
+    if (!info)
+    {
+        m_LastValue = nullptr;
+        return;
+    }
+
+    if (!info->isSoa && !object->getType()->isPointerTy())
+    {
+        JLANG_ERROR(STR("Cannot assign to member of a struct value: %s", target.member.c_str()));
+        m_LastValue = nullptr;
+        return;
+    }
+
+    if (info->rowType->getElementType(fieldIndex)->isArrayTy())
+    {
+        JLANG_ERROR(STR("Cannot assign to array member: %s", target.member.c_str()));
+        m_LastValue = nullptr;
+        return;
+    }
+
+    EmitLocation(node);
+    llvm::Value *fieldPtr = EmitFieldAddress(object, *info, fieldIndex, target.member);
+    llvm::Type *fieldType = fieldPtr->getType()->getPointerElementType();
+    value = EmitInterfaceValue(DecayStringLiteral(value, fieldType), fieldType);
+
+    if (!value)
+    {
+        m_LastValue = nullptr;
+        return;
+    }
+
+    llvm::StoreInst *store = m_IRBuilder.CreateStore(value, fieldPtr);
+    DecorateFieldAccess(store, *info, fieldIndex);
+
+    m_LastValue = value;
+}
+
+void CodeGenerator::VisitSizeofExpr(SizeofExpr &node)
+{
+    llvm::Type *type = MapType(node.targetType);
+
+    if (!type || !type->isSized())
+    {
+        JLANG_ERROR(STR("Cannot take sizeof unsized type: %s", node.targetType.name.c_str()));
+        m_LastValue = nullptr;
+        return;
+    }
+
+    // The module has the target's data layout from the start. A size that fits is an int32 like every other
+    // number, calls to the runtime's i64 size parameters widen it; a larger one stays i64
+    uint64_t size = m_Module->getDataLayout().getTypeAllocSize(type);
+
+    if (size > static_cast<uint64_t>(std::numeric_limits<int32_t>::max()))
+    {
+        m_LastValue = m_IRBuilder.getInt64(size);
+        return;
+    }
+
+    m_LastValue = m_IRBuilder.getInt32(static_cast<uint32_t>(size));
+}
+
+const CodeGenerator::StructInfo *CodeGenerator::ResolveMember(llvm::Value *object, const std::string &member,
+                                                               unsigned &fieldIndex) const
+{
+    const StructInfo *info = FindStructInfo(object->getType());
+
+    if (!info)
+    {
+        JLANG_ERROR(STR("Member access on non-struct value: %s", member.c_str()));
+        return nullptr;
+    }
+
+    auto fieldIt = info->fieldIndices.find(member);
+
+    if (fieldIt == info->fieldIndices.end())
+    {
+        JLANG_ERROR(STR("Unknown struct member: %s", member.c_str()));
+        return nullptr;
+    }
+
+    fieldIndex = fieldIt->second;
+    return info;
+}
+
+llvm::Value *CodeGenerator::EmitFieldAddress(llvm::Value *object, const StructInfo &info, unsigned fieldIndex,
+                                             const std::string &member)
+{
+    if (!info.isSoa)
+    {
+        return m_IRBuilder.CreateStructGEP(info.rowType, object, fieldIndex, member + "_ptr");
+    }
+
+    // row.field -> columns->field[row.index]
+    llvm::Value *columns = m_IRBuilder.CreateExtractValue(object, 0, "columns");
+    llvm::Value *row = m_IRBuilder.CreateExtractValue(object, 1, "row");
+    llvm::Value *columnSlot =
+        m_IRBuilder.CreateStructGEP(info.columnsType, columns, fieldIndex, member + "_column_ptr");
+    llvm::LoadInst *column =
+        m_IRBuilder.CreateLoad(info.columnsType->getElementType(fieldIndex), columnSlot, member + "_column");
+
+    if (info.columnTags[fieldIndex])
+    {
+        column->setMetadata(llvm::LLVMContext::MD_tbaa, info.columnTags[fieldIndex]);
+    }
+
+    return m_IRBuilder.CreateInBoundsGEP(info.rowType->getElementType(fieldIndex), column, row, member + "_ptr");
+}
+
+void CodeGenerator::DecorateFieldAccess(llvm::Instruction *access, const StructInfo &info, unsigned fieldIndex)
+{
+    if (info.atomicFields[fieldIndex])
     {
-        if (node)
-        {
-            node->accept(*this);
-        }
+        MakeSequentiallyConsistent(access);
+    }
+
+    if (info.fieldTags[fieldIndex])
+    {
+        access->setMetadata(llvm::LLVMContext::MD_tbaa, info.fieldTags[fieldIndex]);
+    }
+
+    // Columns are separate allocations, so an element of one column never aliases another column
+    if (info.isSoa && info.columnScopes.size() > 1)
+    {
+        access->setMetadata(llvm::LLVMContext::MD_alias_scope, info.columnScopes[fieldIndex]);
+        access->setMetadata(llvm::LLVMContext::MD_noalias, info.columnNoAlias[fieldIndex]);
     }
 }
 
-void CodeGenerator::VisitFunctionDecl(FunctionDecl &)
+void CodeGenerator::BuildTBAAInfo(StructInfo &info, const StructDecl &node)
 {
-    std::vector<llvm::Type *> paramTypes;
-    for (const auto &param : node.params)
+    // A struct that contains itself by value was already reported when its body was set
+    if (!info.rowType->isSized())
     {
-        paramTypes.push_back(MapType(param.type));
+        return;
     }
 
-    llvm::FunctionType *funcType = llvm::FunctionType::get(MapType(node.returnType), paramTypes, false);
+    llvm::MDBuilder mdBuilder(m_Context);
+    const llvm::DataLayout &dataLayout = m_Module->getDataLayout();
+    const llvm::StructLayout *rowLayout = dataLayout.getStructLayout(info.rowType);
 
-    llvm::Function *function =
-        llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, node.name, m_Module.get());
+    std::vector<llvm::MDNode *> fieldTypeNodes;
+    std::vector<std::pair<llvm::MDNode *, uint64_t>> rowFields;
 
-    llvm::BasicBlock *entry = llvm::BasicBlock::Create(m_Context, "entry", function);
-    m_IRBuilder.SetInsertPoint(entry);
+    for (unsigned i = 0; i < node.fields.size(); ++i)
+    {
+        // Struct-typed fields are aggregates and stay untagged, only scalar accesses carry TBAA
+        llvm::MDNode *fieldTypeNode = GetTBAATypeNode(node.fields[i].type.id);
+        fieldTypeNodes.push_back(fieldTypeNode);
 
-    unsigned i = 0;
-    for (auto &arg : function->args())
+        if (fieldTypeNode)
+        {
+            rowFields.emplace_back(fieldTypeNode, rowLayout->getElementOffset(i));
+        }
+    }
+
+    llvm::MDNode *rowTypeNode = mdBuilder.createTBAAStructTypeNode(node.name, rowFields);
+
+    if (!node.isSoa)
     {
-        arg.setName(node.params[i].name);
-        m_namedValues[node.params[i].name] = &arg;
-        ++i;
+        for (unsigned i = 0; i < node.fields.size(); ++i)
+        {
+            info.fieldTags.push_back(fieldTypeNodes[i] ? mdBuilder.createTBAAStructTagNode(
+                                                             rowTypeNode, fieldTypeNodes[i],
+                                                             rowLayout->getElementOffset(i))
+                                                       : nullptr);
+        }
+
+        return;
     }
 
-    if (node.body)
+    // soa: elements are scalar accesses into a column, column pointers are fields of the column table
+    const llvm::StructLayout *columnsLayout = dataLayout.getStructLayout(info.columnsType);
+    llvm::MDNode *pointerNode = m_TBAAPointer;
+
+    std::vector<std::pair<llvm::MDNode *, uint64_t>> columnFields;
+    for (unsigned i = 0; i < node.fields.size(); ++i)
     {
-        node.body->Accept(*this);
+        columnFields.emplace_back(pointerNode, columnsLayout->getElementOffset(i));
     }
 
-    if (node.returnType.name == "void")
+    llvm::MDNode *columnsTypeNode = mdBuilder.createTBAAStructTypeNode(node.name + ".soa", columnFields);
+    llvm::MDNode *domain = mdBuilder.createAliasScopeDomain(node.name + ".columns");
+
+    std::vector<llvm::Metadata *> scopes;
+    for (unsigned i = 0; i < node.fields.size(); ++i)
     {
-        m_IRBuilder.CreateRetVoid();
+        info.fieldTags.push_back(fieldTypeNodes[i] ? mdBuilder.createTBAAStructTagNode(
+                                                         fieldTypeNodes[i], fieldTypeNodes[i], 0)
+                                                   : nullptr);
+        info.columnTags.push_back(
+            mdBuilder.createTBAAStructTagNode(columnsTypeNode, pointerNode, columnsLayout->getElementOffset(i)));
+        scopes.push_back(mdBuilder.createAliasScope(node.name + "." + node.fields[i].name, domain));
     }
 
-    llvm::verifyFunction(*function);
+    for (unsigned i = 0; i < scopes.size(); ++i)
+    {
+        std::vector<llvm::Metadata *> otherScopes;
+        for (unsigned j = 0; j < scopes.size(); ++j)
+        {
+            if (j != i)
+            {
+                otherScopes.push_back(scopes[j]);
+            }
+        }
+
+        info.columnScopes.push_back(llvm::MDNode::get(m_Context, scopes[i]));
+        info.columnNoAlias.push_back(llvm::MDNode::get(m_Context, otherScopes));
+    }
 }
 
-void CodeGenerator::VisitInterfaceDecl(InterfaceDecl &)
+void CodeGenerator::EmitLocation(const AstNode &node)
 {
-    JLANG_DEBUG(STR("Skipping codegen for interface: %s", node.name.c_str()));
+    if (m_DIScope && node.location.line != 0)
+    {
+        m_IRBuilder.SetCurrentDebugLocation(
+            llvm::DILocation::get(m_Context, node.location.line, node.location.column, m_DIScope));
+    }
 }
 
-void CodeGenerator::VisitStructDecl(StructDecl &)
+llvm::AllocaInst *CodeGenerator::CreateEntryBlockAlloca(llvm::Type *type, const std::string &name)
 {
-    std::vector<llvm::Type *> fieldTypes;
-    for (const auto &field : node.fields)
+    // mem2reg only promotes allocas of the entry block, and one emitted inside a loop body would grow the
+    // stack on every iteration. Keep them in declaration order ahead of the first real instruction.
+    llvm::BasicBlock &entry = m_IRBuilder.GetInsertBlock()->getParent()->getEntryBlock();
+    auto insertPoint = entry.begin();
+
+    while (insertPoint != entry.end() && llvm::isa<llvm::AllocaInst>(*insertPoint))
     {
-        fieldTypes.push_back(MapType(field.type));
+        ++insertPoint;
     }
 
-    llvm::StructType *structType = llvm::StructType::create(m_Context, node.name);
-    structType->setBody(fieldTypes);
+    llvm::IRBuilder<> entryBuilder(&entry, insertPoint);
+    return entryBuilder.CreateAlloca(type, nullptr, name);
+}
+
+llvm::Type *CodeGenerator::GetSlotType(const llvm::Value *binding) const
+{
+    if (const auto *alloca = llvm::dyn_cast<llvm::AllocaInst>(binding))
+    {
+        return alloca->getAllocatedType();
+    }
 
-    JLANG_DEBUG(STR("Defined struct type: %s", node.name.c_str()));
+    auto it = m_CapturedSlots.find(binding);
+    return it != m_CapturedSlots.end() ? it->second : nullptr;
 }
 
-void CodeGenerator::VisitVariableDecl(VariableDecl &)
+llvm::Value *CodeGenerator::EmitLoopCondition(AstNode *condition)
 {
-    llvm::Type *varType = MapType(node.varType);
-    if (!varType)
+    if (!condition)
     {
-        JLANG_ERROR(STR("Unknown variable type: %s", node.varType.name.c_str()));
-        return;
+        return nullptr;
     }
 
-    llvm::AllocaInst *alloca = m_IRBuilder.CreateAlloca(varType, nullptr, node.name);
+    condition->Accept(*this);
+    llvm::Value *value = m_LastValue;
 
-    if (node.initializer)
+    if (value && value->getType()->isIntegerTy(32))
     {
-        node.initializer->accept(*this);
-        if (!m_LastValue)
+        value = m_IRBuilder.CreateICmpNE(value, llvm::ConstantInt::get(value->getType(), 0), "loopcond");
+    }
+
+    return value;
+}
+
+llvm::Value *CodeGenerator::EmitElementAddress(IndexExpr &node)
+{
+    node.object->Accept(*this);
+    llvm::Value *object = m_LastValue;
+    bool isSlice = object && IsSliceType(object->getType());
+
+    if (!object || (!isSlice && !object->getType()->isPointerTy()))
+    {
+        JLANG_ERROR("Subscripted value is not a pointer, an array or a slice");
+        return nullptr;
+    }
+
+    node.index->Accept(*this);
+    llvm::Value *index = m_LastValue;
+
+    if (!index || !index->getType()->isIntegerTy())
+    {
+        JLANG_ERROR("Array index is not an integer");
+        return nullptr;
+    }
+
+    EmitLocation(node);
+
+    if (isSlice)
+    {
+        if (node.isBoundsChecked && m_IsBoundsChecking)
         {
-            JLANG_ERROR(STR("Failed to evaluate initializer for variable: %s", node.name.c_str()));
-            return;
+            EmitBoundsCheck(index, m_IRBuilder.CreateExtractValue(object, 1, "len"), node);
         }
 
-        m_IRBuilder.CreateStore(m_LastValue, alloca);
+        object = m_IRBuilder.CreateExtractValue(object, 0, "elements");
+    }
+
+    // Widening the index up front lets the vectorizer see a plain i64 induction variable
+    index = m_IRBuilder.CreateSExt(index, llvm::Type::getInt64Ty(m_Context), "idx");
+
+    if (const StructInfo *info = FindSoaColumns(object->getType()))
+    {
+        llvm::Value *row = m_IRBuilder.CreateInsertValue(llvm::UndefValue::get(info->refType), object, 0);
+        return m_IRBuilder.CreateInsertValue(row, index, 1, "row");
     }
 
-    m_namedValues[node.name] = alloca;
+    llvm::Type *elementType = object->getType()->getPointerElementType();
+
+    return m_IRBuilder.CreateInBoundsGEP(elementType, object, index, "elemptr");
 }
 
-void CodeGenerator::VisitIfStatement(IfStatement &)
+void CodeGenerator::DecorateElementAccess(llvm::Instruction *access, llvm::Type *elementType)
 {
-    node.condition->Accept(*this);
-    llvm::Value *isConditionalValue = m_LastValue;
+    llvm::MDNode *typeNode = nullptr;
 
-    if (!isConditionalValue)
+    if (elementType->isIntegerTy(32))
     {
-        JLANG_ERROR("Invalid condition in if statement");
+        typeNode = m_TBAAInt32;
+    }
+    else if (elementType->isIntegerTy(8))
+    {
+        typeNode = m_TBAAChar;
+    }
+    else if (elementType->isPointerTy())
+    {
+        typeNode = m_TBAAPointer;
     }
 
-    if (isConditionalValue->getType()->isIntegerTy(32))
+    if (typeNode)
     {
-        isConditionalValue = m_IRBuilder.CreateICmpNE(
-            isConditionalValue, llvm::ConstantInt::get(isConditionalValue->getType(), 0), "ifcond");
+        llvm::MDBuilder mdBuilder(m_Context);
+        access->setMetadata(llvm::LLVMContext::MD_tbaa,
+                            mdBuilder.createTBAAStructTagNode(typeNode, typeNode, 0));
     }
+}
 
-    llvm::Function *parentFunction = m_IRBuilder.GetInsertBlock()->getParent();
+llvm::MDNode *CodeGenerator::BuildLoopMetadata(const LoopHints &hints)
+{
+    if (!hints.vectorize && hints.unrollCount == 0)
+    {
+        return nullptr;
+    }
 
-    llvm::BasicBlock *thenBlock = llvm::BasicBlock::Create(m_Context, "then", parentFunction);
-    llvm::BasicBlock *elseBlock = llvm::BasicBlock::Create(m_Context, "else");
-    llvm::BasicBlock *mergeBlock = llvm::BasicBlock::Create(m_Context, "ifcont");
+    std::vector<llvm::Metadata *> operands;
 
-    m_IRBuilder.CreateCondBr(isConditionalValue, thenBlock, elseBlock);
+    // The first operand is replaced by the node itself, which makes the node distinct per loop
+    operands.push_back(nullptr);
 
-    m_IRBuilder.SetInsertPoint(thenBlock);
-    node.thenBranch->Accept(*this);
-    m_IRBuilder.CreateBr(mergeBlock);
+    if (hints.vectorize)
+    {
+        operands.push_back(llvm::MDNode::get(
+            m_Context, {llvm::MDString::get(m_Context, "llvm.loop.vectorize.enable"),
+                        llvm::ConstantAsMetadata::get(llvm::ConstantInt::getTrue(m_Context))}));
+    }
 
-    parentFunction->getBasicBlockList().push_back(elseBlock);
-    m_IRBuilder.SetInsertPoint(elseBlock);
-    if (node.elseBranch)
+    if (hints.unrollCount == 1)
     {
-        node.elseBranch->Accept(*this);
+        operands.push_back(
+            llvm::MDNode::get(m_Context, llvm::MDString::get(m_Context, "llvm.loop.unroll.disable")));
+    }
+    else if (hints.unrollCount > 1)
+    {
+        operands.push_back(llvm::MDNode::get(
+            m_Context, {llvm::MDString::get(m_Context, "llvm.loop.unroll.count"),
+                        llvm::ConstantAsMetadata::get(
+                            llvm::ConstantInt::get(llvm::Type::getInt32Ty(m_Context), hints.unrollCount))}));
     }
-    m_IRBuilder.CreateBr(mergeBlock);
 
-    parentFunction->getBasicBlockList().push_back(mergeBlock);
-    m_IRBuilder.SetInsertPoint(mergeBlock);
+    llvm::MDNode *loopId = llvm::MDNode::getDistinct(m_Context, operands);
+    loopId->replaceOperandWith(0, loopId);
+
+    return loopId;
 }
 
-void CodeGenerator::VisitBlockStatement(BlockStatement &)
+llvm::MDNode *CodeGenerator::GetTBAATypeNode(TypeId id) const
 {
-    for (auto &statement : node.statements)
+    const TypeInfo &type = m_TypeTable.Get(id);
+
+    switch (type.kind)
     {
-        if (statement)
-        {
-            statement->Accept(*this);
-        }
+    case TypeKind::Int32:
+        return m_TBAAInt32;
+    case TypeKind::Char:
+        return m_TBAAChar;
+    case TypeKind::Pointer:
+        // A pointer to an soa struct is a {columns*, index} aggregate, not a scalar
+        return m_TypeTable.Get(type.pointee).isSoa ? nullptr : m_TBAAPointer;
+    default:
+        return nullptr;
     }
 }
 
-void CodeGenerator::VisitExprStatement(ExprStatement &)
+void CodeGenerator::BeginFunctionProfile(const FunctionDecl &node, llvm::Function *function)
 {
-    if (node.expression)
+    m_ProfileCounters = nullptr;
+    m_FunctionProfile = nullptr;
+    m_NextCounter = 1;
+    m_ProfiledFunction = function->getName().str();
+    m_NextReceiverSite = 0;
+
+    if (m_ProfileOutputPath.empty() && !m_Profile)
     {
-        node.expression->accept(*this);
-        // m_LastValue is ignored  result discarded
+        return;
     }
-}
 
-void CodeGenerator::VisitCallExpr(CallExpr &)
-{
-    llvm::Function *callee = m_Module->getFunction(node.callee);
+    // The hash ties a profile to the shape of the function, so counts from an older version are not
+    // applied to the wrong branches
+    unsigned counterCount = 1;
+    uint64_t hash = 14695981039346656037ULL;
+    HashRegions(node.body.get(), counterCount, hash);
 
-    if (!callee)
+    if (!m_ProfileOutputPath.empty())
+    {
+        auto *countersType = llvm::ArrayType::get(llvm::Type::getInt64Ty(m_Context), counterCount);
+        m_ProfileCounters = new llvm::GlobalVariable(*m_Module, countersType, false,
+                                                     llvm::GlobalValue::PrivateLinkage,
+                                                     llvm::ConstantAggregateZero::get(countersType),
+                                                     "__jprof_cnts." + function->getName());
+
+        m_InstrumentedFunctions.push_back(InstrumentedFunction{function, hash, m_ProfileCounters});
+        EmitCounterIncrement(0);
+    }
+
+    if (!m_Profile)
     {
-        JLANG_ERROR(STR("Unknown function: %s", node.callee.c_str()));
         return;
     }
 
-    std::vector<llvm::Value *> args;
-    for (auto &arg : node.arguments)
+    const ProfileData::Record *record = m_Profile->Find(function->getName().str());
+
+    if (!record)
     {
-        arg->accept(*this);
-        if (!m_LastValue)
-        {
-            JLANG_ERROR(STR("Invalid argument in call to %s", node.callee.c_str()));
-            return;
-        }
-        args.push_back(m_LastValue);
+        return;
+    }
+
+    if (record->hash != hash || record->counts.size() != counterCount)
+    {
+        JLANG_REMARK("pgo", STR("%s: profile does not match the function, ignoring it", node.name.c_str()));
+        return;
+    }
+
+    m_FunctionProfile = record;
+
+    uint64_t entryCount = record->counts[0];
+    function->setEntryCount(entryCount);
+
+    // Hot functions are inlined more eagerly and grouped in .text.hot, functions that never ran are
+    // optimized for size and moved out of the way to .text.unlikely
+    if (m_ProfileSummary->isHotCount(entryCount))
+    {
+        function->addFnAttr(llvm::Attribute::InlineHint);
+        function->setSectionPrefix("hot");
     }
+    else if (m_ProfileSummary->isColdCount(entryCount))
+    {
+        function->addFnAttr(llvm::Attribute::Cold);
+        function->setSectionPrefix("unlikely");
+    }
+}
 
-    m_LastValue = m_IRBuilder.CreateCall(callee, args, node.callee + "_call");
+void CodeGenerator::EmitCounterIncrement(unsigned index)
+{
+    llvm::Value *counter = m_IRBuilder.CreateConstInBoundsGEP2_32(m_ProfileCounters->getValueType(),
+                                                                  m_ProfileCounters, 0, index, "prof_counter");
+    llvm::Value *count = m_IRBuilder.CreateLoad(llvm::Type::getInt64Ty(m_Context), counter, "prof_count");
+    m_IRBuilder.CreateStore(m_IRBuilder.CreateAdd(count, m_IRBuilder.getInt64(1)), counter);
 }
 
-void CodeGenerator::VisitBinaryExpr(BinaryExpr &)
+llvm::MDNode *CodeGenerator::BuildBranchWeights(unsigned counter)
 {
-    node.left->accept(*this);
-    llvm::Value *lhs = m_LastValue;
+    uint64_t reached = m_FunctionProfile->counts[counter];
+    uint64_t taken = m_FunctionProfile->counts[counter + 1];
+    uint64_t notTaken = reached > taken ? reached - taken : 0;
 
-    node.right->accept(*this);
-    llvm::Value *rhs = m_LastValue;
+    // Branch weights are 32-bit, scale both down by the same factor
+    uint64_t scale = std::max(taken, notTaken) / std::numeric_limits<uint32_t>::max() + 1;
 
-    if (!lhs || !rhs)
+    return llvm::MDBuilder(m_Context).createBranchWeights(static_cast<uint32_t>(taken / scale),
+                                                          static_cast<uint32_t>(notTaken / scale));
+}
+
+void CodeGenerator::EmitProfileRegistration()
+{
+    if (m_InstrumentedFunctions.empty())
     {
-        JLANG_ERROR("Invalid operands in binary expression");
         return;
     }
 
-    if (node.op == "+")
-    {
-        if (lhs->getType()->isIntegerTy() && rhs->getType()->isIntegerTy())
-        {
-            m_LastValue = m_IRBuilder.CreateAdd(lhs, rhs, "addtmp");
-        }
-        else
-        {
-            JLANG_ERROR("Addition only supported on integer types");
-        }
-    }
-    else if (node.op == "==")
+    llvm::Type *voidType = llvm::Type::getVoidTy(m_Context);
+    llvm::Type *bytePtrType = llvm::Type::getInt8PtrTy(m_Context);
+    llvm::Type *int64Type = llvm::Type::getInt64Ty(m_Context);
+
+    llvm::FunctionCallee initFunction =
+        m_Module->getOrInsertFunction("jprof_init", llvm::FunctionType::get(voidType, {bytePtrType}, false));
+    llvm::FunctionCallee registerFunction = m_Module->getOrInsertFunction(
+        "jprof_register",
+        llvm::FunctionType::get(voidType,
+                                {bytePtrType, int64Type, llvm::PointerType::getUnqual(int64Type),
+                                 llvm::Type::getInt32Ty(m_Context)},
+                                false));
+    llvm::FunctionCallee writeFunction =
+        m_Module->getOrInsertFunction("jprof_write", llvm::FunctionType::get(voidType, false));
+
+    auto *constructor = llvm::Function::Create(llvm::FunctionType::get(voidType, false),
+                                               llvm::Function::InternalLinkage, "__jprof_init", m_Module.get());
+    m_IRBuilder.SetInsertPoint(llvm::BasicBlock::Create(m_Context, "entry", constructor));
+    m_IRBuilder.CreateCall(initFunction, {m_IRBuilder.CreateGlobalStringPtr(m_ProfileOutputPath)});
+
+    for (const InstrumentedFunction &instrumented : m_InstrumentedFunctions)
     {
-        m_LastValue = m_IRBuilder.CreateICmpEQ(lhs, rhs, "eqtmp");
+        auto *countersType = llvm::cast<llvm::ArrayType>(instrumented.counters->getValueType());
+
+        m_IRBuilder.CreateCall(registerFunction,
+                               {m_IRBuilder.CreateGlobalStringPtr(instrumented.function->getName()),
+                                m_IRBuilder.getInt64(instrumented.hash),
+                                m_IRBuilder.CreateConstInBoundsGEP2_32(countersType, instrumented.counters, 0, 0),
+                                m_IRBuilder.getInt32(static_cast<uint32_t>(countersType->getNumElements()))});
     }
-    else
+
+    for (const ReceiverSite &site : m_ReceiverSites)
     {
-        JLANG_ERROR(STR("Unsupported binary operator: %s", node.op.c_str()));
+        auto *countersType = llvm::cast<llvm::ArrayType>(site.counters->getValueType());
+
+        m_IRBuilder.CreateCall(registerFunction,
+                               {m_IRBuilder.CreateGlobalStringPtr(site.name), m_IRBuilder.getInt64(site.hash),
+                                m_IRBuilder.CreateConstInBoundsGEP2_32(countersType, site.counters, 0, 0),
+                                m_IRBuilder.getInt32(static_cast<uint32_t>(countersType->getNumElements()))});
     }
+
+    m_IRBuilder.CreateRetVoid();
+
+    auto *destructor = llvm::Function::Create(llvm::FunctionType::get(voidType, false),
+                                              llvm::Function::InternalLinkage, "__jprof_write", m_Module.get());
+    m_IRBuilder.SetInsertPoint(llvm::BasicBlock::Create(m_Context, "entry", destructor));
+    m_IRBuilder.CreateCall(writeFunction);
+    m_IRBuilder.CreateRetVoid();
+
+    llvm::appendToGlobalCtors(*m_Module, constructor, 0);
+    llvm::appendToGlobalDtors(*m_Module, destructor, 0);
 }
 
-void CodeGenerator::VisitLiteralExpr(LiteralExpr &)
+void CodeGenerator::EmitHeapProfileRegistration()
 {
-    // TODO --> don't to it like this
-    //  Try to parse as integer literal
-    try
+    if (m_HeapProfilePath.empty())
     {
-        int value = std::stoi(node.value);
-        m_LastValue = llvm::ConstantInt::get(m_Context, llvm::APInt(32, value));
+        return;
     }
-    catch (const std::invalid_argument &)
+
+    // The profiler walks the frame pointer chain for the stack of a sampled allocation
+    for (llvm::Function &function : *m_Module)
     {
-        // Not a number  treat as string
-        m_LastValue = m_IRBuilder.CreateGlobalStringPtr(node.value);
+        if (!function.isDeclaration())
+        {
+            function.addFnAttr("frame-pointer", "all");
+        }
     }
+
+    llvm::Type *voidType = llvm::Type::getVoidTy(m_Context);
+    llvm::Type *bytePtrType = llvm::Type::getInt8PtrTy(m_Context);
+    llvm::Type *int64Type = llvm::Type::getInt64Ty(m_Context);
+
+    llvm::FunctionCallee startFunction = m_Module->getOrInsertFunction(
+        "jheap_start", llvm::FunctionType::get(voidType, {bytePtrType, int64Type}, false));
+    llvm::FunctionCallee stopFunction =
+        m_Module->getOrInsertFunction("jheap_stop", llvm::FunctionType::get(voidType, false));
+
+    auto *constructor = llvm::Function::Create(llvm::FunctionType::get(voidType, false),
+                                               llvm::Function::InternalLinkage, "__jheap_start",
+                                               m_Module.get());
+    m_IRBuilder.SetInsertPoint(llvm::BasicBlock::Create(m_Context, "entry", constructor));
+    m_IRBuilder.CreateCall(startFunction, {m_IRBuilder.CreateGlobalStringPtr(m_HeapProfilePath),
+                                           m_IRBuilder.getInt64(static_cast<uint64_t>(m_HeapProfileRate))});
+    m_IRBuilder.CreateRetVoid();
+
+    auto *destructor = llvm::Function::Create(llvm::FunctionType::get(voidType, false),
+                                              llvm::Function::InternalLinkage, "__jheap_stop",
+                                              m_Module.get());
+    m_IRBuilder.SetInsertPoint(llvm::BasicBlock::Create(m_Context, "entry", destructor));
+    m_IRBuilder.CreateCall(stopFunction);
+    m_IRBuilder.CreateRetVoid();
+
+    llvm::appendToGlobalCtors(*m_Module, constructor, 0);
+    llvm::appendToGlobalDtors(*m_Module, destructor, 0);
 }
 
-void CodeGenerator::VisitCallExpr(BinaryExpr &)
+void CodeGenerator::HashRegions(const AstNode *node, unsigned &counterCount, uint64_t &hash)
 {
-    llvm::Function *callee = m_Module->getFunction(node.callee);
-
-    if (!callee)
+    if (!node)
     {
-        JLANG_ERROR(STR("Unknown function: %s", node.callee.c_str()));
+        return;
     }
 
-    std::vector<llvm::Value *> args;
+    // FNV-1a over the statement kinds, in the order codegen assigns counters
+    hash = (hash ^ static_cast<uint64_t>(node->type)) * 1099511628211ULL;
 
-    for (auto &arg : node.arguments)
+    if (node->type == NodeType::IfStatement)
     {
-        arg->Accept(*this);
+        const auto &ifStatement = static_cast<const IfStatement &>(*node);
+        counterCount += 2;
 
-        if (!m_LastValue)
+        HashRegions(ifStatement.thenBranch.get(), counterCount, hash);
+        HashRegions(ifStatement.elseBranch.get(), counterCount, hash);
+    }
+    else if (node->type == NodeType::WhileStatement)
+    {
+        HashRegions(static_cast<const WhileStatement &>(*node).body.get(), counterCount, hash);
+    }
+    else if (node->type == NodeType::ForStatement)
+    {
+        HashRegions(static_cast<const ForStatement &>(*node).body.get(), counterCount, hash);
+    }
+    else if (node->type == NodeType::BlockStatement)
+    {
+        for (const auto &statement : static_cast<const BlockStatement &>(*node).statements)
         {
-            JLANG_ERROR(STR("Invalid argument in call to %s", node.callee.c_str()));
+            HashRegions(statement.get(), counterCount, hash);
         }
-        args.push_back(m_LastValue);
     }
+    else if (node->type == NodeType::ExprStatement)
+    {
+        // A parallel_for closure counts into the function it is written in
+        const AstNode *expression = static_cast<const ExprStatement &>(*node).expression.get();
 
-    m_LastValue = m_IRBuilder.CreateCall(callee, args, node.callee + "_call");
+        if (expression && expression->type == NodeType::CallExpr)
+        {
+            HashRegions(static_cast<const CallExpr &>(*expression).closureBody.get(), counterCount, hash);
+        }
+    }
 }
 
-void CodeGenerator::VisitVarExpr(VarExpr &)
+const CodeGenerator::StructInfo *CodeGenerator::FindStructInfo(llvm::Type *type) const
 {
-    auto it = m_namedValues.find(node.name);
-
-    if (it == m_namedValues.end())
+    if (type->isPointerTy())
     {
-        JLANG_ERROR(STR("Undefined variable: %s", node.name.c_str()));
+        type = type->getPointerElementType();
     }
 
-    m_LastValue = it->second;
+    auto it = m_StructsByType.find(type);
+    return it != m_StructsByType.end() ? it->second : nullptr;
 }
 
-void CodeGenerator::VisitCastExpr(CastExpr &)
+CodeGenerator::StructInfo &CodeGenerator::GetStructInfo(TypeId id)
 {
-    node.expr->Accept(*this);
-    llvm::Value *valueToCast = m_LastValue;
+    auto it = m_Structs.find(id);
 
-    if (!valueToCast)
+    if (it != m_Structs.end())
     {
-        JLANG_ERROR("Invalid expression in cast");
+        return it->second;
     }
 
-    llvm::Type *targetLLVMType = MapType(node.targetType);
+    // Created opaque on first use, VisitStructDecl sets the bodies
+    const TypeInfo &type = m_TypeTable.Get(id);
+    StructInfo &info = m_Structs[id];
+    info.isSoa = type.isSoa;
+    info.typeId = id;
+    info.rowType = llvm::StructType::create(m_Context, type.name);
+    m_StructsByType[info.rowType] = &info;
 
-    if (!targetLLVMType)
+    if (info.isSoa)
     {
-        JLANG_ERROR("Unknown target type in cast");
+        info.columnsType = llvm::StructType::create(m_Context, type.name + ".soa");
+        info.refType = llvm::StructType::create(
+            m_Context, {llvm::PointerType::getUnqual(info.columnsType), llvm::Type::getInt64Ty(m_Context)},
+            type.name + ".ref");
+        m_StructsByType[info.refType] = &info;
+        m_StructsByColumns[info.columnsType] = &info;
     }
 
-    bool isPointerToPointerCast = valueToCast->getType()->isPointerTy() && targetLLVMType->isPointerTy();
+    return info;
+}
 
-    if (isPointerToPointerCast)
-    {
-        m_LastValue = m_IRBuilder.CreateBitCast(valueToCast, targetLLVMType, "ptrcast");
-    }
-    else
+llvm::Type *CodeGenerator::MapType(const TypeRef &typeRef)
+{
+    if (typeRef.id == InvalidTypeId)
     {
-        JLANG_ERROR(STR("Unsupported cast from %s to %s",
-                        valueToCast->getType()->getStructName().str().c_str(),
-                        targetLLVMType->getStructName().str().c_str()));
+        JLANG_ERROR(STR("Unresolved type: %s", typeRef.name.c_str()));
+        return nullptr;
     }
+
+    return MapType(typeRef.id);
 }
 
-llvm::Type *CodeGenerator::MapType(const TypeRef &typeRef)
+llvm::Type *CodeGenerator::MapType(TypeId id)
 {
-    if (typeRef.name == "void")
+    if (id >= m_Types.size())
+    {
+        m_Types.resize(m_TypeTable.Size(), nullptr);
+    }
+
+    if (m_Types[id])
     {
-        return llvm::Type::getVoidTy(m_Context);
+        return m_Types[id];
     }
 
-    if (typeRef.name == "int32")
+    const TypeInfo &type = m_TypeTable.Get(id);
+    llvm::Type *mapped = nullptr;
+
+    switch (type.kind)
+    {
+    case TypeKind::Void:
+        mapped = llvm::Type::getVoidTy(m_Context);
+        break;
+    case TypeKind::Int32:
+        mapped = llvm::Type::getInt32Ty(m_Context);
+        break;
+    case TypeKind::Char:
+        mapped = llvm::Type::getInt8Ty(m_Context);
+        break;
+    case TypeKind::Struct:
     {
-        return llvm::Type::getInt32Ty(m_Context);
+        // Rows of an soa collection are only reachable through a {columns*, index} reference
+        StructInfo &info = GetStructInfo(id);
+        mapped = info.isSoa ? info.refType : info.rowType;
+        break;
     }
+    case TypeKind::Vector:
+        mapped = llvm::FixedVectorType::get(MapType(type.element), type.laneCount);
+        break;
+    case TypeKind::Arena:
+        mapped = m_ArenaType;
+        break;
+    case TypeKind::Interface:
+        mapped = GetInterfaceInfo(id).valueType;
+        break;
+    case TypeKind::Array:
+        if (m_TypeTable.Get(type.element).isSoa)
+        {
+            mapped = GetSoaArrayType(GetStructInfo(type.element), type.length);
+            break;
+        }
 
-    if (typeRef.name == "char")
+        mapped = llvm::ArrayType::get(MapType(type.element), type.length);
+        break;
+    case TypeKind::Slice:
+        if (m_TypeTable.Get(type.element).isSoa)
+        {
+            mapped = GetSliceType(GetStructInfo(type.element).columnsType);
+            break;
+        }
+
+        mapped = GetSliceType(MapType(type.element));
+        break;
+    case TypeKind::Pointer:
     {
-        llvm::Type *charType = llvm::Type::getInt8Ty(m_Context);
-        return typeRef.isPointer ? llvm::PointerType::getUnqual(charType) : charType;
+        const TypeInfo &pointee = m_TypeTable.Get(type.pointee);
+
+        if (pointee.kind == TypeKind::Void)
+        {
+            mapped = llvm::Type::getInt8PtrTy(m_Context);
+        }
+        else if (pointee.isSoa)
+        {
+            mapped = GetStructInfo(type.pointee).refType;
+        }
+        else
+        {
+            mapped = llvm::PointerType::getUnqual(MapType(type.pointee));
+        }
+        break;
+    }
     }
 
-    return llvm::Type::getVoidTy(m_Context);
+    m_Types[id] = mapped;
+    return mapped;
 }
 
 } // namespace jlang
@@ -1,18 +1,30 @@
 #pragma once
 
 #include "AstVisitor.h"
+#include "SymbolTable.h"
 
 #include "../AST/Ast.h"
 #include "../AST/Expressions/Expressions.h"
 #include "../AST/Statements/Statements.h"
 #include "../AST/TopLevelDecl/TopLevelDecl.h"
+#include "../Profile/ProfileData.h"
+#include "../Sema/TypeTable.h"
 
+#include <functional>
+#include <map>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
@@ -23,36 +35,410 @@ namespace jlang
 class CodeGenerator : public AstVisitor
 {
   public:
-    CodeGenerator();
+    CodeGenerator(const TypeTable &typeTable, const SymbolInterner &symbols);
+
+    // Call before Generate: count function entries, if branches and the receivers of interface calls,
+    // written to outputPath when the program exits
+    void EnableProfileGeneration(const std::string &outputPath);
+
+    // Call before Generate: pass every jalloc call its site, keep frame pointers and run the sampling heap
+    // profiler of the runtime while the program runs, writing its profile to outputPath
+    void EnableHeapProfile(const std::string &outputPath, int64_t sampleRate);
+
+    // Call before Generate: index arrays and slices without comparing the index to their length
+    void DisableBoundsChecks();
+
+    // Call before Generate: annotate branches and functions with the counts of a collected profile
+    void UseProfile(const ProfileData &profile);
+
+    // Call before Generate for every other unit of the program: their structs and function signatures
+    // become usable here, their function bodies are left to the unit that defines them
+    void AddImportedUnit(const std::vector<std::shared_ptr<AstNode>> &program);
+
+    // Call before Generate: describe functions and give every instruction the line and column of the node
+    // it was generated for, as DWARF for the unit read from sourcePath
+    void EnableDebugInfo(const std::string &sourcePath, bool isOptimized);
 
     void Generate(const std::vector<std::shared_ptr<AstNode>> &program);
     void DumpIR();
 
+    llvm::Module &GetModule() { return *m_Module; }
+
   private:
+    virtual void VisitImportDecl(ImportDecl &) override;
     virtual void VisitFunctionDecl(FunctionDecl &) override;
     virtual void VisitInterfaceDecl(InterfaceDecl &) override;
     virtual void VisitStructDecl(StructDecl &) override;
     virtual void VisitVariableDecl(VariableDecl &) override;
 
     virtual void VisitIfStatement(IfStatement &) override;
+    virtual void VisitWhileStatement(WhileStatement &) override;
+    virtual void VisitForStatement(ForStatement &) override;
     virtual void VisitBlockStatement(BlockStatement &) override;
     virtual void VisitExprStatement(ExprStatement &) override;
+    virtual void VisitReturnStatement(ReturnStatement &) override;
 
     virtual void VisitCallExpr(CallExpr &) override;
     virtual void VisitBinaryExpr(BinaryExpr &) override;
     virtual void VisitLiteralExpr(LiteralExpr &) override;
     virtual void VisitVarExpr(VarExpr &) override;
     virtual void VisitCastExpr(CastExpr &) override;
+    virtual void VisitMemberExpr(MemberExpr &) override;
+    virtual void VisitIndexExpr(IndexExpr &) override;
+    virtual void VisitSizeofExpr(SizeofExpr &) override;
+    virtual void VisitAssignExpr(AssignExpr &) override;
 
   private:
+    // Layout of a user struct. For 'soa' structs the row type only describes a single record; collections
+    // are a column table holding one array per field, and a row is addressed by {columns*, index}.
+    // An array of N soa rows is stored as {X.soa table, [N x field0], [N x field1], ...}, the table
+    // pointing at the arrays after it, and a slice of soa rows is {X.soa*, i32 length}.
+    struct StructInfo
+    {
+        llvm::StructType *rowType = nullptr;
+        llvm::StructType *columnsType = nullptr;
+        llvm::StructType *refType = nullptr;
+        std::unordered_map<std::string, unsigned> fieldIndices;
+        bool isSoa = false;
+        TypeId typeId = InvalidTypeId;
+
+        // Per field, whether it was declared atomic
+        std::vector<bool> atomicFields;
+
+        // TBAA access tag per field; for soa structs these tag the element accesses inside each column
+        std::vector<llvm::MDNode *> fieldTags;
+
+        // soa only: tags for loading a column pointer out of the column table, and the alias scope of
+        // each column together with the scopes of all the other columns of the struct
+        std::vector<llvm::MDNode *> columnTags;
+        std::vector<llvm::MDNode *> columnScopes;
+        std::vector<llvm::MDNode *> columnNoAlias;
+
+        // soa only: the storage type of an array of soa rows, per length
+        std::unordered_map<uint32_t, llvm::StructType *> arrayTypes;
+    };
+
+    // An interface value is {i8* object, vtable*}. A vtable starts with the index of its struct among the
+    // implementers of the interface, then holds the methods in the interface's order, each a void(i8*).
+    struct InterfaceInfo
+    {
+        TypeId typeId = InvalidTypeId;
+        llvm::StructType *valueType = nullptr;
+        llvm::StructType *vtableType = nullptr;
+        llvm::FunctionType *methodType = nullptr;
+    };
+
+    void ConfigureTarget();
+    void DeclareRuntimeFunctions();
+    void DeclareTBAATypes();
+
+    llvm::Function *DeclareFunction(const FunctionDecl &node);
+
     llvm::Type *MapType(const TypeRef &typeRef);
+    llvm::Type *MapType(TypeId id);
+    StructInfo &GetStructInfo(TypeId id);
+    const StructInfo *FindStructInfo(llvm::Type *type) const;
+    const StructInfo *ResolveMember(llvm::Value *object, const std::string &member, unsigned &fieldIndex) const;
+
+    llvm::Value *EmitFieldAddress(llvm::Value *object, const StructInfo &info, unsigned fieldIndex,
+                                  const std::string &member);
+    void DecorateFieldAccess(llvm::Instruction *access, const StructInfo &info, unsigned fieldIndex);
+
+    // Following instructions get the node's source location, while debug info is enabled
+    void EmitLocation(const AstNode &node);
+
+    llvm::AllocaInst *CreateEntryBlockAlloca(llvm::Type *type, const std::string &name);
+
+    // The type a variable's slot holds: an alloca of the current function, or the slot of an enclosing
+    // function a parallel_for body captured. Null for parameters and consts, which are not slots.
+    llvm::Type *GetSlotType(const llvm::Value *binding) const;
+
+    // Binds a const var to the value the ConstEvaluator computed: an int32 or char constant, a read-only
+    // global for an array, or a constant slice of one. A const str is a string literal.
+    void EmitConstVariable(const VariableDecl &node);
+
+    // Evaluates a loop condition to an i1, an int32 is true when it is not zero
+    llvm::Value *EmitLoopCondition(AstNode *condition);
+
+    // Address of pointer[index] or slice[index]; element accesses are tagged with the scalar TBAA type of
+    // the element. For a slice of soa rows it is the row reference instead, which is not a pointer.
+    llvm::Value *EmitElementAddress(IndexExpr &node);
+    void DecorateElementAccess(llvm::Instruction *access, llvm::Type *elementType);
+
+    // Evaluates a call argument and converts it to the parameter type: a string literal to a char*, a struct
+    // pointer to an interface, NULL to any pointer and a narrower integer to a 64-bit size. Only the runtime
+    // also takes other pointers and integer widths, for a user function the argument is null then.
+    // paramType is null for variadic arguments. ConvertArgument converts an evaluated one.
+    llvm::Value *EmitArgument(AstNode &argument, llvm::Type *paramType, bool isUserFunction = false);
+    llvm::Value *ConvertArgument(llvm::Value *value, llvm::Type *paramType, bool isUserFunction = false);
+
+    // Inlines the bump of jarena_alloc, the runtime function is only called when the chunk is full
+    void EmitArenaAlloc(CallExpr &node, llvm::Function *runtimeAlloc);
+
+    // jalloc(size) with the hidden site argument, null without -fheap-profile
+    void EmitHeapAlloc(CallExpr &node, llvm::Function *runtimeAlloc);
+    llvm::Constant *GetHeapSite(const std::string &function, uint32_t line);
+
+    // jload4/jload8, jstore, jsplat4/jsplat8, jlane, jsetlane, jshuffle and jreduce_add/min/max. Returns
+    // false when the callee isn't one of them; defined in VectorBuiltins.cpp.
+    bool EmitVectorBuiltin(CallExpr &node);
+    llvm::Value *EmitVectorAddress(llvm::Value *base, llvm::Value *index, llvm::FixedVectorType *vectorType);
+
+    // Slices are {T*, i32 length} values. Naming an array, a local or a field, gives a slice of it, so
+    // arrays are indexed, passed and captured like slices. jlen(x), jslice(pointer, length) and
+    // jslice(x, from, to) are the builtins. Indexing a slice calls jbounds_fail when the index is not below
+    // the length, unless BoundsCheckElimination cleared the check. Defined in Slices.cpp.
+    bool EmitSliceBuiltin(CallExpr &node);
+    void EmitSubslice(CallExpr &node);
+    llvm::StructType *GetSliceType(llvm::Type *elementType);
+    bool IsSliceType(llvm::Type *type) const;
+    llvm::Value *EmitArraySlice(llvm::Value *array);
+    bool IsArrayStorage(llvm::Type *type) const;
+    void EmitBoundsCheck(llvm::Value *index, llvm::Value *length, const AstNode &node);
+
+    // Arrays and slices of soa rows, see StructInfo. Indexing one gives the {columns*, index} reference of
+    // the row rather than an element address.
+    llvm::StructType *GetSoaArrayType(StructInfo &info, uint32_t length);
+    const StructInfo *FindSoaColumns(llvm::Type *type) const;
+    void InitializeSoaArray(llvm::AllocaInst *array);
+
+    // A string literal is a str constant, the slice of chars in a NUL-terminated global that all literals
+    // with the same text share. Where a char* is expected a literal gives its characters instead. str
+    // operands of ==, != and the ordering operators compare by content. A str passed to a variadic function
+    // becomes its length and characters, the %.*s arguments, and its %s in a literal format is rewritten to
+    // %.*s. Defined in Strings.cpp.
+    llvm::Constant *GetStringLiteral(const std::string &text);
+    llvm::Value *DecayStringLiteral(llvm::Value *value, llvm::Type *type);
+    bool IsStrType(llvm::Type *type);
+    llvm::Value *EmitStrComparison(const std::string &op, llvm::Value *lhs, llvm::Value *rhs);
+    bool ExpandStrArguments(CallExpr &node, std::vector<llvm::Value *> &args, unsigned fixedCount);
+
+    // The methods of an interface are named T.method after the struct T implementing it. A call of a method
+    // name resolves on its receiver: a struct calls its own method, an interface value goes through the
+    // vtable. A struct pointer converts to an interface value wherever one is expected, and NULL to a null
+    // interface value or pointer of any type. With -fprofile-generate each call through a vtable counts the
+    // structs it reaches, and with -fprofile-use the one or two that dominate a call site are called directly
+    // behind a compare of the loaded method, the vtable call staying as the fallback. Defined in
+    // Interfaces.cpp.
+    InterfaceInfo &GetInterfaceInfo(TypeId id);
+    const InterfaceInfo *FindInterfaceInfo(llvm::Type *type) const;
+    TypeId GetMethodReceiver(const FunctionDecl &node) const;
+    llvm::Value *EmitInterfaceValue(llvm::Value *value, llvm::Type *type);
+    bool EmitMethodCall(CallExpr &node);
+    void EmitInterfaceCall(CallExpr &node, const InterfaceInfo &info, llvm::Value *receiver, unsigned method);
+    void EmitReceiverCounter(const InterfaceInfo &info, llvm::Value *vtable, const std::string &site,
+                             uint64_t hash);
+    std::vector<std::pair<TypeId, uint64_t>> FindHotReceivers(const InterfaceInfo &info,
+                                                              const std::string &site, uint64_t hash);
+    uint64_t HashReceivers(const InterfaceInfo &info, unsigned method) const;
+    llvm::GlobalVariable *GetVTable(TypeId structId);
+    llvm::Function *GetVTableEntry(TypeId structId, unsigned method);
+
+    // jatomic_load, jatomic_store, jatomic_cas, jatomic_fetch_add and jatomic_fence, each with an optional
+    // ordering name as its last argument. Returns false when the callee isn't one of them; defined in
+    // AtomicBuiltins.cpp together with the helpers for variables and fields declared atomic.
+    bool EmitAtomicBuiltin(CallExpr &node);
+    llvm::Value *EmitAtomicAddress(AstNode &target);
+    bool CheckAtomicType(llvm::Type *type, const std::string &name);
+    void MakeSequentiallyConsistent(llvm::Instruction *access);
+
+    // 'spawn f(x);', 'sync;' and both forms of parallel_for, lowered to jtask_* runtime calls that run
+    // outlined thunks with their captured values in an env struct. Defined in TaskBuiltins.cpp.
+    void EmitTaskStatement(CallExpr &node);
+    bool EmitParallelFor(CallExpr &node);
+    llvm::Value *GetTaskGroup();
+    llvm::Value *EmitTaskEnv(llvm::StructType *envType, const std::vector<llvm::Value *> &values,
+                             const std::string &name);
+    llvm::Function *GetSpawnThunk(llvm::Function *callee);
+    llvm::Function *GetRangeThunk(llvm::Function *body);
+    llvm::Function *EmitParallelClosure(CallExpr &node, llvm::Value *&env);
+
+    // Returns are collected while the body is generated and finished once it is done, when it is known
+    // whether the function spawned tasks it has to wait for. A call right before a return becomes musttail
+    // if nothing of the caller's frame is still needed after it; 'return tail' makes that an error
+    // otherwise. Defined in TailCalls.cpp.
+    void EmitReturn(llvm::Value *value, bool isTailRequired);
+    void FinishReturns(const FunctionDecl &node);
+    const char *CheckTailCall(llvm::CallInst *call) const;
+
+    // async functions are switched-resume coroutines on the llvm.coro intrinsics, with their frame from
+    // jalloc unless CoroElide puts it in the caller's. 'await f(x)' hands the child to the event loop and
+    // suspends until it finishes; awaiting jread, jwrite or jaccept parks the coroutine on the fd while the
+    // call would block. Defined in Coroutines.cpp.
+    void BeginCoroutine(llvm::Function *function);
+    void EndCoroutine();
+    bool EmitIoAwait(CallExpr &node);
+    void EmitCoroutineCall(CallExpr &node, llvm::Value *handle);
+
+    // coro.suspend after save, resuming in resumeBlock; destroying the frame there goes through cleanupBlock,
+    // or the shared cleanup when it is null
+    void EmitSuspend(llvm::Value *save, llvm::BasicBlock *resumeBlock, bool isFinal = false,
+                     llvm::BasicBlock *cleanupBlock = nullptr);
+    llvm::Value *EmitSuspendSave();
+    llvm::Function *GetIntrinsic(llvm::Intrinsic::ID id, llvm::ArrayRef<llvm::Type *> types = {});
+
+    // A void (i8* env, i32 from, i32 to) function with the builder at its entry, and the loop over
+    // [from, to) in it; the builder is left in the exit block
+    llvm::Function *CreateRangeThunk(const llvm::Twine &name);
+    void EmitRangeLoop(llvm::Function *thunk, const std::function<void(llvm::Value *)> &emitBody);
+
+    // Distinct llvm.loop node for the back edge of a loop, null when the loop has no hints
+    llvm::MDNode *BuildLoopMetadata(const LoopHints &hints);
+
+    void BuildTBAAInfo(StructInfo &info, const StructDecl &node);
+    llvm::MDNode *GetTBAATypeNode(TypeId id) const;
+
+    void BeginFunctionProfile(const FunctionDecl &node, llvm::Function *function);
+    void EmitCounterIncrement(unsigned index);
+    llvm::MDNode *BuildBranchWeights(unsigned counter);
+    void EmitProfileRegistration();
+    void EmitHeapProfileRegistration();
+
+    static void HashRegions(const AstNode *node, unsigned &counterCount, uint64_t &hash);
 
   private:
     llvm::LLVMContext m_Context;
     std::unique_ptr<llvm::Module> m_Module;
     llvm::IRBuilder<> m_IRBuilder;
 
-    std::unordered_map<std::string, llvm::Value *> m_namedValues;
+    const TypeTable &m_TypeTable;
+
+    // llvm::Type per TypeId, filled on first use
+    std::vector<llvm::Type *> m_Types;
+
+    std::vector<const std::vector<std::shared_ptr<AstNode>> *> m_ImportedUnits;
+    std::unordered_map<const FunctionDecl *, llvm::Function *> m_Functions;
+
+    // The functions of m_Functions, which take only arguments of their own parameter types
+    std::unordered_set<const llvm::Function *> m_UserFunctions;
+
+    SymbolTable m_Symbols;
+    std::unordered_map<TypeId, StructInfo> m_Structs;
+
+    // Row and ref types of every struct, for finding the struct behind a value in member accesses
+    std::unordered_map<llvm::Type *, const StructInfo *> m_StructsByType;
+
+    std::unordered_map<TypeId, InterfaceInfo> m_Interfaces;
+    std::unordered_map<llvm::Type *, const InterfaceInfo *> m_InterfacesByType;
+    std::unordered_map<TypeId, llvm::GlobalVariable *> m_VTables;
+
+    // The method of each struct per method name, and every name some interface declares a method of
+    std::map<std::pair<TypeId, std::string>, llvm::Function *> m_Methods;
+    std::unordered_set<std::string> m_MethodNames;
+
+    // Stack slots of the variables declared atomic
+    std::unordered_set<const llvm::Value *> m_AtomicSlots;
+
+    // Non-escaping jalloc'ed objects up to this many bytes are moved onto the stack, larger ones would risk
+    // overflowing it and stay on the heap
+    static constexpr uint64_t MaxStackObjectSize = 4096;
+
+    // Stack slots of the pointers to such objects, whose jfree is not emitted
+    std::unordered_set<const llvm::Value *> m_StackObjectSlots;
+
+    // Inside parallel_for bodies, the pointers to the enclosing function's slots and the type each holds
+    std::unordered_map<const llvm::Value *, llvm::Type *> m_CapturedSlots;
+
+    // Slice type per element type
+    std::unordered_map<llvm::Type *, llvm::StructType *> m_SliceTypes;
+
+    // soa collections: the struct of every column table type, and the struct and length of every array
+    // storage type
+    std::unordered_map<llvm::Type *, const StructInfo *> m_StructsByColumns;
+    std::unordered_map<llvm::Type *, std::pair<const StructInfo *, uint32_t>> m_SoaArrays;
+    bool m_IsBoundsChecking = true;
+
+    // Name of the unit's source file, for jbounds_fail
+    llvm::Constant *m_BoundsCheckFile = nullptr;
+
+    // The str constant of each literal text, and the characters of each of those constants
+    std::unordered_map<std::string, llvm::Constant *> m_StringLiterals;
+    std::unordered_map<const llvm::Value *, llvm::Constant *> m_LiteralCharacters;
+
+    llvm::StructType *m_ArenaType = nullptr;
+    llvm::StructType *m_HeapSiteType = nullptr;
+    llvm::StructType *m_TaskGroupType = nullptr;
+
+    // Group the spawns of the function being generated go into, created by the first spawn or sync
+    llvm::Value *m_TaskGroup = nullptr;
+
+    llvm::StructType *m_PromiseType = nullptr;
+    std::unordered_set<const llvm::Function *> m_AsyncFunctions;
+
+    // Coroutine of the async function being generated, all null in other functions
+    struct CoroutineState
+    {
+        llvm::Value *id = nullptr;
+        llvm::Value *handle = nullptr;
+        llvm::Value *promise = nullptr;
+        llvm::BasicBlock *cleanupBlock = nullptr;
+        llvm::BasicBlock *suspendBlock = nullptr;
+
+        // Falling off the end and return statements meet here before the final suspend
+        llvm::BasicBlock *returnBlock = nullptr;
+    };
+
+    CoroutineState m_Coroutine;
+
+    // Function being generated, null inside a parallel_for body which has nothing to return from
+    const FunctionDecl *m_CurrentFunction = nullptr;
+
+    struct PendingReturn
+    {
+        llvm::ReturnInst *ret = nullptr;
+
+        // Call whose result is returned, or a void call right before a void return
+        llvm::CallInst *tailCall = nullptr;
+        bool isTailRequired = false;
+    };
+
+    std::vector<PendingReturn> m_Returns;
+
+    std::unordered_map<llvm::Function *, llvm::Function *> m_SpawnThunks;
+    std::unordered_map<llvm::Function *, llvm::Function *> m_RangeThunks;
+
+    std::unique_ptr<llvm::DIBuilder> m_DIBuilder;
+    llvm::DIFile *m_DIFile = nullptr;
+
+    // Subprogram of the function being generated
+    llvm::DISubprogram *m_DIScope = nullptr;
+
+    llvm::MDNode *m_TBAAChar = nullptr;
+    llvm::MDNode *m_TBAAInt32 = nullptr;
+    llvm::MDNode *m_TBAAPointer = nullptr;
+
+    struct InstrumentedFunction
+    {
+        llvm::Function *function = nullptr;
+        uint64_t hash = 0;
+        llvm::GlobalVariable *counters = nullptr;
+    };
+
+    std::string m_ProfileOutputPath;
+    std::vector<InstrumentedFunction> m_InstrumentedFunctions;
+
+    // Counters of an interface call site, one per implementer of the interface, recorded as function#n
+    struct ReceiverSite
+    {
+        std::string name;
+        uint64_t hash = 0;
+        llvm::GlobalVariable *counters = nullptr;
+    };
+
+    std::vector<ReceiverSite> m_ReceiverSites;
+
+    std::string m_HeapProfilePath;
+    int64_t m_HeapProfileRate = 0;
+
+    const ProfileData *m_Profile = nullptr;
+    std::unique_ptr<llvm::ProfileSummaryInfo> m_ProfileSummary;
+
+    // State of the function being generated: counter 0 counts calls, every if takes the next two
+    llvm::GlobalVariable *m_ProfileCounters = nullptr;
+    const ProfileData::Record *m_FunctionProfile = nullptr;
+    unsigned m_NextCounter = 0;
+    std::string m_ProfiledFunction;
+    unsigned m_NextReceiverSite = 0;
     llvm::Value *m_LastValue = nullptr;
 };
 
@@ -0,0 +1,285 @@
+#include "CodeGen.h"
+
+#include "../Common/Logger.h"
+
+namespace jlang
+{
+
+// Keep in sync with JIO_PENDING, JIO_READABLE and JIO_WRITABLE in the runtime
+constexpr int32_t IoPending = -2;
+constexpr int32_t IoReadable = 1;
+constexpr int32_t IoWritable = 2;
+
+llvm::Function *CodeGenerator::GetIntrinsic(llvm::Intrinsic::ID id, llvm::ArrayRef<llvm::Type *> types)
+{
+    return llvm::Intrinsic::getDeclaration(m_Module.get(), id, types);
+}
+
+// The coroutine starts suspended, so whoever called it can say where to continue before it first runs. The
+// passes split it into a ramp that only sets up the frame and resume and destroy functions behind it.
+void CodeGenerator::BeginCoroutine(llvm::Function *function)
+{
+    function->addFnAttr("coroutine.presplit", "0");
+
+    llvm::Type *bytePtrType = llvm::Type::getInt8PtrTy(m_Context);
+    llvm::Constant *nullBytePtr = llvm::ConstantPointerNull::get(llvm::Type::getInt8PtrTy(m_Context));
+
+    m_Coroutine.promise = CreateEntryBlockAlloca(m_PromiseType, "promise");
+
+    unsigned promiseAlignment = m_Module->getDataLayout().getABITypeAlignment(m_PromiseType);
+    m_Coroutine.id = m_IRBuilder.CreateCall(
+        GetIntrinsic(llvm::Intrinsic::coro_id),
+        {m_IRBuilder.getInt32(promiseAlignment), m_IRBuilder.CreateBitCast(m_Coroutine.promise, bytePtrType),
+         nullBytePtr, nullBytePtr},
+        "coro.id");
+
+    // coro.alloc is false once CoroElide moved the frame into the caller's
+    llvm::BasicBlock *entryBlock = m_IRBuilder.GetInsertBlock();
+    llvm::BasicBlock *allocBlock = llvm::BasicBlock::Create(m_Context, "coro.alloc", function);
+    llvm::BasicBlock *beginBlock = llvm::BasicBlock::Create(m_Context, "coro.begin", function);
+
+    llvm::Value *needsAlloc =
+        m_IRBuilder.CreateCall(GetIntrinsic(llvm::Intrinsic::coro_alloc), {m_Coroutine.id}, "coro.needalloc");
+    m_IRBuilder.CreateCondBr(needsAlloc, allocBlock, beginBlock);
+
+    m_IRBuilder.SetInsertPoint(allocBlock);
+    llvm::Function *frameSize = GetIntrinsic(llvm::Intrinsic::coro_size, {m_IRBuilder.getInt64Ty()});
+    llvm::Value *size = m_IRBuilder.CreateCall(frameSize, {}, "coro.size");
+    llvm::Value *site = GetHeapSite(m_CurrentFunction->name, m_CurrentFunction->location.line);
+    llvm::Value *memory = m_IRBuilder.CreateCall(m_Module->getFunction("jalloc"), {size, site}, "coro.mem");
+    m_IRBuilder.CreateBr(beginBlock);
+
+    m_IRBuilder.SetInsertPoint(beginBlock);
+    llvm::PHINode *frame = m_IRBuilder.CreatePHI(bytePtrType, 2, "coro.frame");
+    frame->addIncoming(nullBytePtr, entryBlock);
+    frame->addIncoming(memory, allocBlock);
+
+    m_Coroutine.handle = m_IRBuilder.CreateCall(GetIntrinsic(llvm::Intrinsic::coro_begin),
+                                                {m_Coroutine.id, frame}, "coro.handle");
+
+    m_IRBuilder.CreateStore(nullBytePtr, m_IRBuilder.CreateStructGEP(m_PromiseType, m_Coroutine.promise, 0));
+
+    // Filled in by EndCoroutine, every suspend point branches to them
+    m_Coroutine.cleanupBlock = llvm::BasicBlock::Create(m_Context, "coro.cleanup");
+    m_Coroutine.suspendBlock = llvm::BasicBlock::Create(m_Context, "coro.suspend");
+    m_Coroutine.returnBlock = llvm::BasicBlock::Create(m_Context, "coro.return");
+
+    llvm::BasicBlock *startBlock = llvm::BasicBlock::Create(m_Context, "coro.start", function);
+    EmitSuspend(EmitSuspendSave(), startBlock);
+    m_IRBuilder.SetInsertPoint(startBlock);
+}
+
+void CodeGenerator::EndCoroutine()
+{
+    llvm::Function *function = m_IRBuilder.GetInsertBlock()->getParent();
+    llvm::Type *bytePtrType = llvm::Type::getInt8PtrTy(m_Context);
+    llvm::Constant *nullBytePtr = llvm::ConstantPointerNull::get(llvm::Type::getInt8PtrTy(m_Context));
+
+    // The body may have ended in a return, which already branches there
+    if (!m_IRBuilder.GetInsertBlock()->getTerminator())
+    {
+        m_IRBuilder.CreateBr(m_Coroutine.returnBlock);
+    }
+
+    m_Coroutine.returnBlock->insertInto(function);
+    m_IRBuilder.SetInsertPoint(m_Coroutine.returnBlock);
+
+    // Like in Cilk, tasks never outlive the function that spawned them
+    if (m_TaskGroup)
+    {
+        m_IRBuilder.CreateCall(m_Module->getFunction("jtask_sync"), {m_TaskGroup});
+    }
+
+    // An awaited coroutine wakes its awaiter and waits at the final suspend for it to destroy the frame. One
+    // nobody awaits has nobody to report to and frees its frame right away.
+    llvm::Value *awaiterSlot = m_IRBuilder.CreateStructGEP(m_PromiseType, m_Coroutine.promise, 0);
+    llvm::Value *awaiter = m_IRBuilder.CreateLoad(bytePtrType, awaiterSlot, "awaiter");
+
+    llvm::BasicBlock *finalBlock = llvm::BasicBlock::Create(m_Context, "coro.final", function);
+    m_IRBuilder.CreateCondBr(m_IRBuilder.CreateICmpEQ(awaiter, nullBytePtr), m_Coroutine.cleanupBlock,
+                             finalBlock);
+
+    m_IRBuilder.SetInsertPoint(finalBlock);
+    llvm::Value *save = EmitSuspendSave();
+    m_IRBuilder.CreateCall(m_Module->getFunction("jco_schedule"), {awaiter});
+
+    // Resuming a coroutine past its final suspend is undefined
+    llvm::BasicBlock *resumedBlock = llvm::BasicBlock::Create(m_Context, "coro.final.resumed", function);
+    EmitSuspend(save, resumedBlock, true);
+
+    m_IRBuilder.SetInsertPoint(resumedBlock);
+    m_IRBuilder.CreateUnreachable();
+
+    m_Coroutine.cleanupBlock->insertInto(function);
+    m_IRBuilder.SetInsertPoint(m_Coroutine.cleanupBlock);
+
+    llvm::Value *memory =
+        m_IRBuilder.CreateCall(GetIntrinsic(llvm::Intrinsic::coro_free), {m_Coroutine.id, m_Coroutine.handle},
+                               "coro.mem");
+
+    llvm::BasicBlock *freeBlock = llvm::BasicBlock::Create(m_Context, "coro.free", function);
+    m_IRBuilder.CreateCondBr(m_IRBuilder.CreateICmpNE(memory, nullBytePtr), freeBlock,
+                             m_Coroutine.suspendBlock);
+
+    m_IRBuilder.SetInsertPoint(freeBlock);
+    m_IRBuilder.CreateCall(m_Module->getFunction("jfree"), {memory});
+    m_IRBuilder.CreateBr(m_Coroutine.suspendBlock);
+
+    // The ramp returns the handle from here, the split-off resume and destroy functions return nothing
+    m_Coroutine.suspendBlock->insertInto(function);
+    m_IRBuilder.SetInsertPoint(m_Coroutine.suspendBlock);
+    m_IRBuilder.CreateCall(GetIntrinsic(llvm::Intrinsic::coro_end),
+                           {m_Coroutine.handle, m_IRBuilder.getFalse()});
+    m_IRBuilder.CreateRet(m_Coroutine.handle);
+}
+
+llvm::Value *CodeGenerator::EmitSuspendSave()
+{
+    llvm::Function *save = GetIntrinsic(llvm::Intrinsic::coro_save);
+    return m_IRBuilder.CreateCall(save, {m_Coroutine.handle}, "coro.save");
+}
+
+void CodeGenerator::EmitSuspend(llvm::Value *save, llvm::BasicBlock *resumeBlock, bool isFinal,
+                                llvm::BasicBlock *cleanupBlock)
+{
+    llvm::Value *state = m_IRBuilder.CreateCall(GetIntrinsic(llvm::Intrinsic::coro_suspend),
+                                                {save, m_IRBuilder.getInt1(isFinal)}, "coro.state");
+
+    // -1 when the coroutine suspended, 0 when it is resumed and 1 when it is destroyed
+    llvm::SwitchInst *dispatch = m_IRBuilder.CreateSwitch(state, m_Coroutine.suspendBlock, 2);
+    dispatch->addCase(m_IRBuilder.getInt8(0), resumeBlock);
+    dispatch->addCase(m_IRBuilder.getInt8(1), cleanupBlock ? cleanupBlock : m_Coroutine.cleanupBlock);
+}
+
+bool CodeGenerator::EmitIoAwait(CallExpr &node)
+{
+    struct IoOperation
+    {
+        const char *function;
+        int32_t events;
+        size_t argumentCount;
+    };
+
+    static const std::unordered_map<std::string, IoOperation> s_Operations = {
+        {"jread", {"jio_read", IoReadable, 3}},
+        {"jwrite", {"jio_write", IoWritable, 3}},
+        {"jaccept", {"jio_accept", IoReadable, 1}},
+        {"jyield", {nullptr, 0, 0}}};
+
+    auto it = s_Operations.find(node.callee);
+
+    if (it == s_Operations.end())
+    {
+        return false;
+    }
+
+    m_LastValue = nullptr;
+
+    if (node.arguments.size() != it->second.argumentCount)
+    {
+        JLANG_ERROR(STR("Wrong number of arguments to %s", node.callee.c_str()));
+        return true;
+    }
+
+    llvm::Function *function = m_IRBuilder.GetInsertBlock()->getParent();
+
+    // jyield goes to the back of the ready queue, so every other ready coroutine runs first
+    if (!it->second.function)
+    {
+        EmitLocation(node);
+
+        llvm::Value *save = EmitSuspendSave();
+        m_IRBuilder.CreateCall(m_Module->getFunction("jco_schedule"), {m_Coroutine.handle});
+
+        llvm::BasicBlock *resumeBlock = llvm::BasicBlock::Create(m_Context, "yield.resume", function);
+        EmitSuspend(save, resumeBlock);
+        m_IRBuilder.SetInsertPoint(resumeBlock);
+        return true;
+    }
+
+    llvm::Function *operation = m_Module->getFunction(it->second.function);
+    llvm::FunctionType *operationType = operation->getFunctionType();
+
+    std::vector<llvm::Value *> args;
+
+    for (unsigned i = 0; i < node.arguments.size(); ++i)
+    {
+        llvm::Value *value = EmitArgument(*node.arguments[i], operationType->getParamType(i));
+
+        if (!value || value->getType() != operationType->getParamType(i))
+        {
+            JLANG_ERROR(STR("Invalid argument in await of %s", node.callee.c_str()));
+            return true;
+        }
+
+        args.push_back(value);
+    }
+
+    EmitLocation(node);
+
+    // The call never blocks; while it would, the coroutine waits for the fd to be ready and tries again
+    llvm::BasicBlock *tryBlock = llvm::BasicBlock::Create(m_Context, "io.try", function);
+    llvm::BasicBlock *parkBlock = llvm::BasicBlock::Create(m_Context, "io.park", function);
+    llvm::BasicBlock *doneBlock = llvm::BasicBlock::Create(m_Context, "io.done", function);
+
+    m_IRBuilder.CreateBr(tryBlock);
+
+    m_IRBuilder.SetInsertPoint(tryBlock);
+    llvm::Value *result = m_IRBuilder.CreateCall(operation, args, node.callee + "_call");
+    m_IRBuilder.CreateCondBr(m_IRBuilder.CreateICmpEQ(result, m_IRBuilder.getInt32(IoPending)), parkBlock,
+                             doneBlock);
+
+    m_IRBuilder.SetInsertPoint(parkBlock);
+    llvm::Value *save = EmitSuspendSave();
+    m_IRBuilder.CreateCall(m_Module->getFunction("jio_park"),
+                           {m_Coroutine.handle, args[0], m_IRBuilder.getInt32(it->second.events)});
+    EmitSuspend(save, tryBlock);
+
+    m_IRBuilder.SetInsertPoint(doneBlock);
+    m_LastValue = result;
+    return true;
+}
+
+void CodeGenerator::EmitCoroutineCall(CallExpr &node, llvm::Value *handle)
+{
+    m_LastValue = nullptr;
+
+    llvm::Function *schedule = m_Module->getFunction("jco_schedule");
+
+    // Without an await the coroutine runs detached, started by the event loop of this thread
+    if (!node.isAwaited)
+    {
+        m_IRBuilder.CreateCall(schedule, {handle});
+        return;
+    }
+
+    llvm::Value *childPromise = m_IRBuilder.CreateCall(
+        GetIntrinsic(llvm::Intrinsic::coro_promise),
+        {handle, m_IRBuilder.getInt32(m_Module->getDataLayout().getABITypeAlignment(m_PromiseType)),
+         m_IRBuilder.getFalse()},
+        "child.promise");
+    llvm::Value *awaiterSlot = m_IRBuilder.CreateStructGEP(
+        m_PromiseType, m_IRBuilder.CreateBitCast(childPromise, m_PromiseType->getPointerTo()), 0);
+
+    llvm::Value *save = EmitSuspendSave();
+    m_IRBuilder.CreateStore(m_Coroutine.handle, awaiterSlot);
+    m_IRBuilder.CreateCall(schedule, {handle});
+
+    // The child is done when this resumes, and has to go too if this coroutine is destroyed while waiting
+    llvm::Function *function = m_IRBuilder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *resumeBlock = llvm::BasicBlock::Create(m_Context, "await.resume", function);
+    llvm::BasicBlock *cleanupBlock = llvm::BasicBlock::Create(m_Context, "await.cleanup", function);
+
+    EmitSuspend(save, resumeBlock, false, cleanupBlock);
+
+    llvm::Function *destroy = GetIntrinsic(llvm::Intrinsic::coro_destroy);
+
+    m_IRBuilder.SetInsertPoint(cleanupBlock);
+    m_IRBuilder.CreateCall(destroy, {handle});
+    m_IRBuilder.CreateBr(m_Coroutine.cleanupBlock);
+
+    m_IRBuilder.SetInsertPoint(resumeBlock);
+    m_IRBuilder.CreateCall(destroy, {handle});
+}
+
+} // namespace jlang
@@ -0,0 +1,464 @@
+#include "CodeGen.h"
+
+#include "../Common/Logger.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <llvm/IR/MDBuilder.h>
+
+namespace jlang
+{
+
+// A struct reaching less than this share of the calls at a site is left to the vtable call
+static constexpr uint64_t HotReceiverPercent = 30;
+static constexpr size_t MaxHotReceivers = 2;
+
+CodeGenerator::InterfaceInfo &CodeGenerator::GetInterfaceInfo(TypeId id)
+{
+    auto it = m_Interfaces.find(id);
+
+    if (it != m_Interfaces.end())
+    {
+        return it->second;
+    }
+
+    const TypeInfo &type = m_TypeTable.Get(id);
+    InterfaceInfo &info = m_Interfaces[id];
+    info.typeId = id;
+
+    llvm::Type *bytePtrType = llvm::Type::getInt8PtrTy(m_Context);
+    info.methodType = llvm::FunctionType::get(llvm::Type::getVoidTy(m_Context), {bytePtrType}, false);
+
+    std::vector<llvm::Type *> vtableFields(type.methods.size() + 1, info.methodType->getPointerTo());
+    vtableFields[0] = llvm::Type::getInt32Ty(m_Context);
+
+    info.vtableType = llvm::StructType::create(m_Context, vtableFields, type.name + ".vtable");
+    info.valueType =
+        llvm::StructType::create(m_Context, {bytePtrType, info.vtableType->getPointerTo()}, type.name);
+    m_InterfacesByType[info.valueType] = &info;
+
+    return info;
+}
+
+const CodeGenerator::InterfaceInfo *CodeGenerator::FindInterfaceInfo(llvm::Type *type) const
+{
+    auto it = m_InterfacesByType.find(type);
+    return it != m_InterfacesByType.end() ? it->second : nullptr;
+}
+
+TypeId CodeGenerator::GetMethodReceiver(const FunctionDecl &node) const
+{
+    if (node.params.size() != 1 || node.params[0].type.id == InvalidTypeId)
+    {
+        return InvalidTypeId;
+    }
+
+    // 'void print() -> Person p' and 'void print() -> Person* p' both implement print for Person
+    const TypeInfo &param = m_TypeTable.Get(node.params[0].type.id);
+    TypeId structId = param.kind == TypeKind::Pointer ? param.pointee : node.params[0].type.id;
+    const TypeInfo &type = m_TypeTable.Get(structId);
+
+    if (type.kind != TypeKind::Struct || type.implemented == InvalidTypeId)
+    {
+        return InvalidTypeId;
+    }
+
+    const std::vector<std::string> &methods = m_TypeTable.Get(type.implemented).methods;
+    bool isMethod = std::find(methods.begin(), methods.end(), node.name) != methods.end();
+
+    return isMethod ? structId : InvalidTypeId;
+}
+
+llvm::Value *CodeGenerator::EmitInterfaceValue(llvm::Value *value, llvm::Type *type)
+{
+    const InterfaceInfo *info = type ? FindInterfaceInfo(type) : nullptr;
+
+    // NULL is an i8* until it is stored, it takes the type of the pointer or interface it's stored to
+    if (llvm::isa_and_nonnull<llvm::ConstantPointerNull>(value) && type && (info || type->isPointerTy()))
+    {
+        return llvm::Constant::getNullValue(type);
+    }
+
+    if (!info || !value || value->getType() == type)
+    {
+        return value;
+    }
+
+    const std::string &interfaceName = m_TypeTable.Get(info->typeId).name;
+    const StructInfo *structInfo =
+        value->getType()->isPointerTy() ? FindStructInfo(value->getType()) : nullptr;
+
+    if (!structInfo || structInfo->isSoa || m_TypeTable.Get(structInfo->typeId).implemented != info->typeId)
+    {
+        JLANG_ERROR(STR("Only a pointer to a struct implementing %s converts to it", interfaceName.c_str()));
+        return nullptr;
+    }
+
+    llvm::GlobalVariable *vtable = GetVTable(structInfo->typeId);
+
+    if (!vtable)
+    {
+        return nullptr;
+    }
+
+    llvm::Value *object = m_IRBuilder.CreateBitCast(value, llvm::Type::getInt8PtrTy(m_Context), "object");
+    llvm::Value *result = m_IRBuilder.CreateInsertValue(llvm::UndefValue::get(type), object, 0);
+
+    return m_IRBuilder.CreateInsertValue(result, vtable, 1, interfaceName);
+}
+
+bool CodeGenerator::EmitMethodCall(CallExpr &node)
+{
+    if (node.arguments.size() != 1 || node.isAwaited || !m_MethodNames.count(node.callee))
+    {
+        return false;
+    }
+
+    m_LastValue = nullptr;
+    llvm::Value *receiver = EmitArgument(*node.arguments[0], nullptr);
+
+    if (!receiver)
+    {
+        JLANG_ERROR(STR("Invalid argument in call to %s", node.callee.c_str()));
+        return true;
+    }
+
+    if (const InterfaceInfo *info = FindInterfaceInfo(receiver->getType()))
+    {
+        const std::vector<std::string> &methods = m_TypeTable.Get(info->typeId).methods;
+        auto method = std::find(methods.begin(), methods.end(), node.callee);
+
+        if (method == methods.end())
+        {
+            JLANG_ERROR(STR("%s is not a method of interface %s", node.callee.c_str(),
+                            m_TypeTable.Get(info->typeId).name.c_str()));
+            return true;
+        }
+
+        EmitInterfaceCall(node, *info, receiver, static_cast<unsigned>(method - methods.begin()));
+        return true;
+    }
+
+    // A struct implementing the method calls it directly, other receivers go to a plain function of the name
+    const StructInfo *structInfo = FindStructInfo(receiver->getType());
+    auto it = structInfo ? m_Methods.find({structInfo->typeId, node.callee}) : m_Methods.end();
+    llvm::Function *callee = it != m_Methods.end() ? it->second : m_Module->getFunction(node.callee);
+
+    if (!callee || callee->arg_size() != 1)
+    {
+        JLANG_ERROR(STR("Unknown function: %s", node.callee.c_str()));
+        return true;
+    }
+
+    llvm::Type *paramType = callee->getFunctionType()->getParamType(0);
+
+    // A method taking the struct by value is called on a pointer to it as well
+    if (structInfo && !structInfo->isSoa && paramType == structInfo->rowType &&
+        receiver->getType() == structInfo->rowType->getPointerTo())
+    {
+        receiver = m_IRBuilder.CreateLoad(structInfo->rowType, receiver, "receiver");
+    }
+
+    receiver = ConvertArgument(receiver, paramType, true);
+
+    if (!receiver)
+    {
+        JLANG_ERROR(STR("Invalid argument in call to %s", node.callee.c_str()));
+        return true;
+    }
+
+    EmitLocation(node);
+
+    std::string callName = callee->getReturnType()->isVoidTy() ? "" : node.callee + "_call";
+    m_LastValue = m_IRBuilder.CreateCall(callee, {receiver}, callName);
+
+    if (m_AsyncFunctions.count(callee))
+    {
+        EmitCoroutineCall(node, m_LastValue);
+    }
+
+    return true;
+}
+
+void CodeGenerator::EmitInterfaceCall(CallExpr &node, const InterfaceInfo &info, llvm::Value *receiver,
+                                      unsigned method)
+{
+    EmitLocation(node);
+
+    llvm::Value *object = m_IRBuilder.CreateExtractValue(receiver, 0, "object");
+    llvm::Value *vtable = m_IRBuilder.CreateExtractValue(receiver, 1, "vtable");
+
+    // Sites are numbered in the order codegen reaches them, which the profile-use build repeats
+    std::string site = m_ProfiledFunction + "#" + std::to_string(m_NextReceiverSite++);
+    uint64_t hash = HashReceivers(info, method);
+
+    if (m_ProfileCounters)
+    {
+        EmitReceiverCounter(info, vtable, site, hash);
+    }
+
+    // Vtables are constants, so the load can be hoisted and merged like any invariant one
+    llvm::Value *slot = m_IRBuilder.CreateStructGEP(info.vtableType, vtable, method + 1, "slot");
+    llvm::LoadInst *target = m_IRBuilder.CreateLoad(info.methodType->getPointerTo(), slot, node.callee);
+    target->setMetadata(llvm::LLVMContext::MD_invariant_load, llvm::MDNode::get(m_Context, {}));
+
+    std::vector<std::pair<TypeId, uint64_t>> hotReceivers =
+        m_Profile ? FindHotReceivers(info, site, hash) : std::vector<std::pair<TypeId, uint64_t>>();
+
+    if (hotReceivers.empty())
+    {
+        m_LastValue = m_IRBuilder.CreateCall(info.methodType, target, {object});
+        return;
+    }
+
+    // A polymorphic inline cache: compare the method against the dominant structs' ones and call those
+    // directly, where they can be inlined. The method, not the vtable, is compared, so a vtable emitted by
+    // another unit matches as well.
+    llvm::Function *function = m_IRBuilder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *doneBlock = llvm::BasicBlock::Create(m_Context, "devirt.done");
+    llvm::MDBuilder mdBuilder(m_Context);
+
+    const std::vector<uint64_t> &counts = m_Profile->Find(site)->counts;
+    uint64_t siteTotal = 0;
+
+    for (uint64_t count : counts)
+    {
+        siteTotal += count;
+    }
+
+    // Calls not taken by an earlier guard, the weights of each guard are relative to these
+    uint64_t total = siteTotal;
+
+    for (const auto &[structId, count] : hotReceivers)
+    {
+        llvm::Function *direct = GetVTableEntry(structId, method);
+
+        if (!direct)
+        {
+            break;
+        }
+
+        const std::string &structName = m_TypeTable.Get(structId).name;
+        JLANG_REMARK("devirtualize", STR("%s: %s.%s called directly, %llu of %llu calls", site.c_str(),
+                                         structName.c_str(), node.callee.c_str(),
+                                         static_cast<unsigned long long>(count),
+                                         static_cast<unsigned long long>(siteTotal)));
+
+        llvm::Constant *directTarget =
+            llvm::ConstantExpr::getBitCast(direct, info.methodType->getPointerTo());
+        llvm::Value *isDirect = m_IRBuilder.CreateICmpEQ(target, directTarget, "is." + structName);
+
+        llvm::BasicBlock *directBlock = llvm::BasicBlock::Create(m_Context, "devirt." + structName, function);
+        llvm::BasicBlock *nextBlock = llvm::BasicBlock::Create(m_Context, "devirt.next", function);
+
+        // Branch weights are 32-bit, scale both down by the same factor
+        uint64_t others = total - count;
+        uint64_t scale = std::max(count, others) / std::numeric_limits<uint32_t>::max() + 1;
+        m_IRBuilder.CreateCondBr(isDirect, directBlock, nextBlock,
+                                 mdBuilder.createBranchWeights(static_cast<uint32_t>(count / scale),
+                                                               static_cast<uint32_t>(others / scale)));
+        total = others;
+
+        m_IRBuilder.SetInsertPoint(directBlock);
+        llvm::Type *receiverType = direct->getFunctionType()->getParamType(0);
+        m_IRBuilder.CreateCall(direct, {m_IRBuilder.CreateBitCast(object, receiverType)});
+        m_IRBuilder.CreateBr(doneBlock);
+
+        m_IRBuilder.SetInsertPoint(nextBlock);
+    }
+
+    m_LastValue = m_IRBuilder.CreateCall(info.methodType, target, {object});
+    m_IRBuilder.CreateBr(doneBlock);
+
+    doneBlock->insertInto(function);
+    m_IRBuilder.SetInsertPoint(doneBlock);
+}
+
+void CodeGenerator::EmitReceiverCounter(const InterfaceInfo &info, llvm::Value *vtable,
+                                        const std::string &site, uint64_t hash)
+{
+    size_t implementerCount = m_TypeTable.Get(info.typeId).implementers.size();
+
+    if (implementerCount == 0)
+    {
+        return;
+    }
+
+    llvm::Type *int64Type = llvm::Type::getInt64Ty(m_Context);
+    auto *countersType = llvm::ArrayType::get(int64Type, implementerCount);
+    auto *counters =
+        new llvm::GlobalVariable(*m_Module, countersType, false, llvm::GlobalValue::PrivateLinkage,
+                                 llvm::ConstantAggregateZero::get(countersType), "__jprof_recv." + site);
+
+    m_ReceiverSites.push_back(ReceiverSite{site, hash, counters});
+
+    // The vtable knows which implementer it belongs to, that index picks the counter
+    llvm::Value *indexSlot = m_IRBuilder.CreateStructGEP(info.vtableType, vtable, 0, "implementer_ptr");
+    llvm::Value *index = m_IRBuilder.CreateLoad(m_IRBuilder.getInt32Ty(), indexSlot, "implementer");
+    llvm::Value *counter = m_IRBuilder.CreateInBoundsGEP(countersType, counters,
+                                                         {m_IRBuilder.getInt32(0), index}, "prof_counter");
+    llvm::Value *count = m_IRBuilder.CreateLoad(int64Type, counter, "prof_count");
+    m_IRBuilder.CreateStore(m_IRBuilder.CreateAdd(count, m_IRBuilder.getInt64(1)), counter);
+}
+
+std::vector<std::pair<TypeId, uint64_t>>
+CodeGenerator::FindHotReceivers(const InterfaceInfo &info, const std::string &site, uint64_t hash)
+{
+    const std::vector<TypeId> &implementers = m_TypeTable.Get(info.typeId).implementers;
+    const ProfileData::Record *record = m_Profile->Find(site);
+
+    if (!record)
+    {
+        return {};
+    }
+
+    // Implementers added or removed since the profile was taken renumber the counters
+    if (record->hash != hash || record->counts.size() != implementers.size())
+    {
+        JLANG_REMARK("devirtualize",
+                     STR("%s: profile does not match the call site, ignoring it", site.c_str()));
+        return {};
+    }
+
+    uint64_t total = 0;
+    std::vector<std::pair<TypeId, uint64_t>> receivers;
+
+    for (size_t i = 0; i < implementers.size(); ++i)
+    {
+        total += record->counts[i];
+        receivers.emplace_back(implementers[i], record->counts[i]);
+    }
+
+    std::stable_sort(receivers.begin(), receivers.end(),
+                     [](const auto &a, const auto &b) { return a.second > b.second; });
+
+    size_t hotCount = 0;
+
+    while (hotCount < receivers.size() && hotCount < MaxHotReceivers && receivers[hotCount].second != 0 &&
+           receivers[hotCount].second * 100 >= total * HotReceiverPercent)
+    {
+        ++hotCount;
+    }
+
+    receivers.resize(hotCount);
+    return receivers;
+}
+
+uint64_t CodeGenerator::HashReceivers(const InterfaceInfo &info, unsigned method) const
+{
+    const TypeInfo &type = m_TypeTable.Get(info.typeId);
+
+    // FNV-1a over the method and the implementer names, in counter order
+    uint64_t hash = 14695981039346656037ULL;
+    auto hashName = [&](const std::string &name) {
+        for (char c : name)
+        {
+            hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ULL;
+        }
+
+        hash = (hash ^ 0) * 1099511628211ULL;
+    };
+
+    hashName(type.methods[method]);
+
+    for (TypeId structId : type.implementers)
+    {
+        hashName(m_TypeTable.Get(structId).name);
+    }
+
+    return hash;
+}
+
+llvm::GlobalVariable *CodeGenerator::GetVTable(TypeId structId)
+{
+    auto it = m_VTables.find(structId);
+
+    if (it != m_VTables.end())
+    {
+        return it->second;
+    }
+
+    llvm::GlobalVariable *&vtable = m_VTables[structId];
+
+    const TypeInfo &structType = m_TypeTable.Get(structId);
+    const TypeInfo &interfaceType = m_TypeTable.Get(structType.implemented);
+    const InterfaceInfo &info = GetInterfaceInfo(structType.implemented);
+
+    const std::vector<TypeId> &implementers = interfaceType.implementers;
+    auto index = std::find(implementers.begin(), implementers.end(), structId) - implementers.begin();
+
+    std::vector<llvm::Constant *> fields{m_IRBuilder.getInt32(static_cast<uint32_t>(index))};
+
+    for (unsigned method = 0; method < interfaceType.methods.size(); ++method)
+    {
+        llvm::Function *entry = GetVTableEntry(structId, method);
+
+        if (!entry)
+        {
+            return nullptr;
+        }
+
+        fields.push_back(llvm::ConstantExpr::getBitCast(entry, info.methodType->getPointerTo()));
+    }
+
+    // Every unit emits the vtables it uses, linking keeps one of each
+    vtable = new llvm::GlobalVariable(*m_Module, info.vtableType, true, llvm::GlobalValue::LinkOnceODRLinkage,
+                                      llvm::ConstantStruct::get(info.vtableType, fields),
+                                      structType.name + ".vtable");
+
+    return vtable;
+}
+
+llvm::Function *CodeGenerator::GetVTableEntry(TypeId structId, unsigned method)
+{
+    const TypeInfo &structType = m_TypeTable.Get(structId);
+    const TypeInfo &interfaceType = m_TypeTable.Get(structType.implemented);
+    const std::string &methodName = interfaceType.methods[method];
+
+    auto it = m_Methods.find({structId, methodName});
+
+    if (it == m_Methods.end() || !it->second)
+    {
+        JLANG_ERROR(STR("Struct %s does not implement %s of interface %s", structType.name.c_str(),
+                        methodName.c_str(), interfaceType.name.c_str()));
+        return nullptr;
+    }
+
+    llvm::Function *function = it->second;
+
+    if (!function->getReturnType()->isVoidTy())
+    {
+        JLANG_ERROR(STR("%s must return void to implement interface %s", function->getName().str().c_str(),
+                        interfaceType.name.c_str()));
+        return nullptr;
+    }
+
+    if (function->getFunctionType()->getParamType(0)->isPointerTy())
+    {
+        return function;
+    }
+
+    // A method taking the struct by value is reached through a thunk that loads it from the object
+    std::string thunkName = function->getName().str() + ".thunk";
+
+    if (llvm::Function *thunk = m_Module->getFunction(thunkName))
+    {
+        return thunk;
+    }
+
+    const InterfaceInfo &info = GetInterfaceInfo(structType.implemented);
+    llvm::Function *thunk = llvm::Function::Create(info.methodType, llvm::Function::LinkOnceODRLinkage,
+                                                   thunkName, m_Module.get());
+
+    llvm::Type *rowType = function->getFunctionType()->getParamType(0);
+    llvm::IRBuilder<> builder(llvm::BasicBlock::Create(m_Context, "entry", thunk));
+    llvm::Value *object = builder.CreateBitCast(thunk->getArg(0), rowType->getPointerTo(), "object");
+
+    builder.CreateCall(function, {builder.CreateLoad(rowType, object, "receiver")});
+    builder.CreateRetVoid();
+
+    return thunk;
+}
+
+} // namespace jlang
@@ -0,0 +1,110 @@
+#include "PassPipeline.h"
+
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+#include <llvm/Transforms/IPO/GlobalDCE.h>
+#include <llvm/Transforms/IPO/HotColdSplitting.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+
+namespace jlang
+{
+
+PassPipeline::PassPipeline(const CompileOptions &options) : m_Options(options) {}
+
+void PassPipeline::Run(llvm::Module &module, Stage stage)
+{
+    bool isOptimizing = m_Options.optimizationLevel != 0;
+
+    // The backend can't lower the llvm.coro intrinsics of async functions, the coroutine passes have to split
+    // them into plain functions at every optimization level
+    bool hasCoroutines = module.getFunction("llvm.coro.id") != nullptr;
+
+    if (!isOptimizing && stage != Stage::Link && !hasCoroutines)
+    {
+        return;
+    }
+
+    llvm::LoopAnalysisManager loopAnalysisManager;
+    llvm::FunctionAnalysisManager functionAnalysisManager;
+    llvm::CGSCCAnalysisManager cgsccAnalysisManager;
+    llvm::ModuleAnalysisManager moduleAnalysisManager;
+
+    // Without the target the cost models see no vector registers and the loop vectorizer never fires.
+    // Same CPU as CodeGenerator::ConfigureTarget, so the code stays portable between hosts.
+    std::string error;
+    const llvm::Target *target = llvm::TargetRegistry::lookupTarget(module.getTargetTriple(), error);
+    std::unique_ptr<llvm::TargetMachine> targetMachine(
+        target ? target->createTargetMachine(module.getTargetTriple(), "generic", "", llvm::TargetOptions(),
+                                             llvm::None)
+               : nullptr);
+
+    llvm::PassBuilder passBuilder(targetMachine.get());
+
+    if (!m_Options.profileUsePath.empty())
+    {
+        passBuilder.registerOptimizerLastEPCallback(
+            [](llvm::ModulePassManager &modulePassManager, llvm::OptimizationLevel) {
+                modulePassManager.addPass(llvm::HotColdSplittingPass());
+            });
+    }
+
+    passBuilder.registerModuleAnalyses(moduleAnalysisManager);
+    passBuilder.registerCGSCCAnalyses(cgsccAnalysisManager);
+    passBuilder.registerFunctionAnalyses(functionAnalysisManager);
+    passBuilder.registerLoopAnalyses(loopAnalysisManager);
+    passBuilder.crossRegisterProxies(loopAnalysisManager, functionAnalysisManager, cgsccAnalysisManager,
+                                     moduleAnalysisManager);
+
+    llvm::ModulePassManager modulePassManager;
+
+    if (stage == Stage::Link)
+    {
+        // main is the only entry point of a linked program, so every other function can be inlined into
+        // its callers across units and then dropped
+        modulePassManager.addPass(
+            llvm::InternalizePass([](const llvm::GlobalValue &value) { return value.getName() == "main"; }));
+        modulePassManager.addPass(llvm::GlobalDCEPass());
+    }
+
+    if (!isOptimizing)
+    {
+        if (hasCoroutines)
+        {
+            modulePassManager.addPass(
+                passBuilder.buildO0DefaultPipeline(llvm::OptimizationLevel::O0, stage == Stage::PreLink));
+        }
+
+        modulePassManager.run(module, moduleAnalysisManager);
+        return;
+    }
+
+    llvm::OptimizationLevel level = llvm::OptimizationLevel::O2;
+
+    if (m_Options.optimizationLevel == 1)
+    {
+        level = llvm::OptimizationLevel::O1;
+    }
+    else if (m_Options.optimizationLevel >= 3)
+    {
+        level = llvm::OptimizationLevel::O3;
+    }
+
+    switch (stage)
+    {
+    case Stage::Default:
+        modulePassManager.addPass(passBuilder.buildPerModuleDefaultPipeline(level));
+        break;
+    case Stage::PreLink:
+        modulePassManager.addPass(passBuilder.buildLTOPreLinkDefaultPipeline(level));
+        break;
+    case Stage::Link:
+        modulePassManager.addPass(passBuilder.buildLTODefaultPipeline(level, nullptr));
+        break;
+    }
+
+    modulePassManager.run(module, moduleAnalysisManager);
+}
+
+} // namespace jlang
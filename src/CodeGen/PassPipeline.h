@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../Common/CompileOptions.h"
+
+#include <llvm/IR/Module.h>
+
+namespace jlang
+{
+
+// LLVM's default -O1..-O3 module pipeline. With -fprofile-use the inliner and block placement follow the
+// counts CodeGenerator attached, and cold blocks are split out of hot functions at the end.
+class PassPipeline
+{
+  public:
+    enum class Stage
+    {
+        // The module is the whole program
+        Default,
+
+        // -flto: a single unit before it is written as bitcode, cross-unit work is left to the link
+        PreLink,
+
+        // -flto: the merged program, everything but main is internalized first
+        Link
+    };
+
+    explicit PassPipeline(const CompileOptions &options);
+
+    void Run(llvm::Module &module, Stage stage = Stage::Default);
+
+  private:
+    const CompileOptions &m_Options;
+};
+
+} // namespace jlang
@@ -0,0 +1,268 @@
+#include "CodeGen.h"
+
+#include "../Common/Logger.h"
+
+#include <llvm/IR/MDBuilder.h>
+
+namespace jlang
+{
+
+bool CodeGenerator::EmitSliceBuiltin(CallExpr &node)
+{
+    if (node.callee != "jlen" && node.callee != "jslice")
+    {
+        return false;
+    }
+
+    m_LastValue = nullptr;
+
+    if (node.callee == "jlen")
+    {
+        llvm::Value *slice = node.arguments.size() == 1 ? EmitArgument(*node.arguments[0], nullptr) : nullptr;
+
+        if (!slice || !IsSliceType(slice->getType()))
+        {
+            JLANG_ERROR("jlen expects an array or a slice");
+            return true;
+        }
+
+        EmitLocation(node);
+        m_LastValue = m_IRBuilder.CreateExtractValue(slice, 1, "len");
+        return true;
+    }
+
+    if (node.arguments.size() == 3)
+    {
+        EmitSubslice(node);
+        return true;
+    }
+
+    if (node.arguments.size() != 2)
+    {
+        JLANG_ERROR("jslice expects a pointer and a length");
+        return true;
+    }
+
+    llvm::Value *elements = EmitArgument(*node.arguments[0], nullptr);
+    llvm::Type *int32Type = llvm::Type::getInt32Ty(m_Context);
+    llvm::Value *length = EmitArgument(*node.arguments[1], int32Type);
+
+    if (!elements || !elements->getType()->isPointerTy() || !length || length->getType() != int32Type)
+    {
+        JLANG_ERROR("jslice expects a pointer and a length");
+        return true;
+    }
+
+    EmitLocation(node);
+
+    // A negative length makes an empty slice. Lengths are never negative, so a single unsigned compare
+    // checks an index against both ends.
+    llvm::Value *zero = llvm::ConstantInt::get(int32Type, 0);
+    length = m_IRBuilder.CreateSelect(m_IRBuilder.CreateICmpSLT(length, zero), zero, length, "len");
+
+    llvm::StructType *sliceType = GetSliceType(elements->getType()->getPointerElementType());
+    llvm::Value *slice = m_IRBuilder.CreateInsertValue(llvm::UndefValue::get(sliceType), elements, 0);
+    m_LastValue = m_IRBuilder.CreateInsertValue(slice, length, 1, "slice");
+
+    return true;
+}
+
+void CodeGenerator::EmitSubslice(CallExpr &node)
+{
+    llvm::Value *slice = EmitArgument(*node.arguments[0], nullptr);
+    llvm::Type *int32Type = llvm::Type::getInt32Ty(m_Context);
+    llvm::Value *from = EmitArgument(*node.arguments[1], int32Type);
+    llvm::Value *to = EmitArgument(*node.arguments[2], int32Type);
+
+    if (!slice || !IsSliceType(slice->getType()) || !from || from->getType() != int32Type || !to ||
+        to->getType() != int32Type)
+    {
+        JLANG_ERROR("jslice expects an array, a slice or a str and the range of elements to keep");
+        return;
+    }
+
+    if (FindSoaColumns(slice->getType()->getStructElementType(0)))
+    {
+        JLANG_ERROR("jslice can't take a range of soa rows, index the slice instead");
+        return;
+    }
+
+    EmitLocation(node);
+
+    // The range is clamped to the elements there are, like the length of jslice(pointer, length), so the
+    // result never reaches outside of the slice it is taken from
+    llvm::Value *length = m_IRBuilder.CreateExtractValue(slice, 1, "len");
+    llvm::Value *zero = llvm::ConstantInt::get(int32Type, 0);
+
+    to = m_IRBuilder.CreateSelect(m_IRBuilder.CreateICmpSLT(to, zero), zero, to);
+    to = m_IRBuilder.CreateSelect(m_IRBuilder.CreateICmpSGT(to, length), length, to, "to");
+    from = m_IRBuilder.CreateSelect(m_IRBuilder.CreateICmpSLT(from, zero), zero, from);
+    from = m_IRBuilder.CreateSelect(m_IRBuilder.CreateICmpSGT(from, to), to, from, "from");
+
+    llvm::Value *elements = m_IRBuilder.CreateExtractValue(slice, 0, "elements");
+    llvm::Type *elementType = elements->getType()->getPointerElementType();
+
+    elements = m_IRBuilder.CreateInBoundsGEP(elementType, elements, from, "elements");
+
+    slice = m_IRBuilder.CreateInsertValue(slice, elements, 0);
+    m_LastValue = m_IRBuilder.CreateInsertValue(slice, m_IRBuilder.CreateSub(to, from), 1, "slice");
+}
+
+llvm::StructType *CodeGenerator::GetSliceType(llvm::Type *elementType)
+{
+    llvm::StructType *&sliceType = m_SliceTypes[elementType];
+
+    if (!sliceType)
+    {
+        llvm::Type *elementsType = llvm::PointerType::getUnqual(elementType);
+        llvm::Type *lengthType = llvm::Type::getInt32Ty(m_Context);
+        const char *name = elementType->isIntegerTy(8) ? "str" : "slice";
+        sliceType = llvm::StructType::create(m_Context, {elementsType, lengthType}, name);
+    }
+
+    return sliceType;
+}
+
+bool CodeGenerator::IsSliceType(llvm::Type *type) const
+{
+    auto *structType = llvm::dyn_cast<llvm::StructType>(type);
+
+    if (!structType || structType->getNumElements() != 2 || !structType->getElementType(0)->isPointerTy())
+    {
+        return false;
+    }
+
+    auto it = m_SliceTypes.find(structType->getElementType(0)->getPointerElementType());
+    return it != m_SliceTypes.end() && it->second == structType;
+}
+
+llvm::Value *CodeGenerator::EmitArraySlice(llvm::Value *array)
+{
+    auto soaArray = m_SoaArrays.find(array->getType()->getPointerElementType());
+
+    // An array of soa rows is indexed through its column table, which starts the storage
+    if (soaArray != m_SoaArrays.end())
+    {
+        const auto &[info, length] = soaArray->second;
+        llvm::StructType *sliceType = GetSliceType(info->columnsType);
+
+        llvm::Value *slice =
+            m_IRBuilder.CreateInsertValue(llvm::UndefValue::get(sliceType), m_IRBuilder.getInt32(length), 1);
+        llvm::Value *columns = m_IRBuilder.CreateStructGEP(soaArray->first, array, 0, "columns");
+
+        return m_IRBuilder.CreateInsertValue(slice, columns, 0, "slice");
+    }
+
+    auto *arrayType = llvm::cast<llvm::ArrayType>(array->getType()->getPointerElementType());
+    llvm::StructType *sliceType = GetSliceType(arrayType->getElementType());
+
+    auto length = static_cast<uint32_t>(arrayType->getNumElements());
+
+    llvm::Value *slice =
+        m_IRBuilder.CreateInsertValue(llvm::UndefValue::get(sliceType), m_IRBuilder.getInt32(length), 1);
+    llvm::Value *elements = m_IRBuilder.CreateConstInBoundsGEP2_32(arrayType, array, 0, 0, "elements");
+
+    return m_IRBuilder.CreateInsertValue(slice, elements, 0, "slice");
+}
+
+bool CodeGenerator::IsArrayStorage(llvm::Type *type) const
+{
+    return type->isArrayTy() || m_SoaArrays.count(type);
+}
+
+llvm::StructType *CodeGenerator::GetSoaArrayType(StructInfo &info, uint32_t length)
+{
+    llvm::StructType *&arrayType = info.arrayTypes[length];
+
+    if (arrayType)
+    {
+        return arrayType;
+    }
+
+    if (info.rowType->isOpaque())
+    {
+        JLANG_ERROR(STR("Array of soa struct %s is used before the struct is defined",
+                        info.rowType->getName().str().c_str()));
+        return nullptr;
+    }
+
+    std::vector<llvm::Type *> types = {info.columnsType};
+
+    for (llvm::Type *fieldType : info.rowType->elements())
+    {
+        types.push_back(llvm::ArrayType::get(fieldType, length));
+    }
+
+    std::string name = STR("%s.soa.%u", info.rowType->getName().str().c_str(), length);
+    arrayType = llvm::StructType::create(m_Context, types, name);
+    m_SoaArrays[arrayType] = {&info, length};
+
+    return arrayType;
+}
+
+const CodeGenerator::StructInfo *CodeGenerator::FindSoaColumns(llvm::Type *type) const
+{
+    if (!type->isPointerTy())
+    {
+        return nullptr;
+    }
+
+    auto it = m_StructsByColumns.find(type->getPointerElementType());
+    return it != m_StructsByColumns.end() ? it->second : nullptr;
+}
+
+void CodeGenerator::InitializeSoaArray(llvm::AllocaInst *array)
+{
+    auto *arrayType = llvm::cast<llvm::StructType>(array->getAllocatedType());
+    const StructInfo &info = *m_SoaArrays.at(arrayType).first;
+
+    // Points each column of the table at its array; the storage never moves, so this is done once
+    llvm::Value *columns = m_IRBuilder.CreateStructGEP(arrayType, array, 0, "columns");
+
+    for (unsigned i = 0; i < info.columnsType->getNumElements(); ++i)
+    {
+        llvm::Type *columnType = arrayType->getElementType(i + 1);
+        llvm::Value *column = m_IRBuilder.CreateConstInBoundsGEP2_32(arrayType, array, 0, i + 1);
+        column = m_IRBuilder.CreateConstInBoundsGEP2_32(columnType, column, 0, 0, "column");
+
+        llvm::StoreInst *store =
+            m_IRBuilder.CreateStore(column, m_IRBuilder.CreateStructGEP(info.columnsType, columns, i));
+
+        if (info.columnTags[i])
+        {
+            store->setMetadata(llvm::LLVMContext::MD_tbaa, info.columnTags[i]);
+        }
+    }
+}
+
+void CodeGenerator::EmitBoundsCheck(llvm::Value *index, llvm::Value *length, const AstNode &node)
+{
+    // The element address is computed from the index widened to i64, so the check compares in i64 as well;
+    // narrowing the index instead would let k * 2^32 + i through for any i below the length
+    llvm::Type *int64Type = llvm::Type::getInt64Ty(m_Context);
+    index = m_IRBuilder.CreateSExt(index, int64Type);
+    llvm::Value *wideLength = m_IRBuilder.CreateZExt(length, int64Type);
+    llvm::Value *isInBounds = m_IRBuilder.CreateICmpULT(index, wideLength, "inbounds");
+
+    llvm::Function *function = m_IRBuilder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *failBlock = llvm::BasicBlock::Create(m_Context, "bounds.fail", function);
+    llvm::BasicBlock *okBlock = llvm::BasicBlock::Create(m_Context, "bounds.ok", function);
+
+    // The weights __builtin_expect gives, which keeps the failing call out of the way of the loop body
+    llvm::MDBuilder mdBuilder(m_Context);
+    m_IRBuilder.CreateCondBr(isInBounds, okBlock, failBlock, mdBuilder.createBranchWeights(2000, 1));
+
+    if (!m_BoundsCheckFile)
+    {
+        m_BoundsCheckFile = m_IRBuilder.CreateGlobalStringPtr(m_Module->getSourceFileName(), "jbounds.file");
+    }
+
+    m_IRBuilder.SetInsertPoint(failBlock);
+    m_IRBuilder.CreateCall(m_Module->getFunction("jbounds_fail"),
+                           {m_BoundsCheckFile, m_IRBuilder.getInt32(node.location.line), index, length});
+    m_IRBuilder.CreateUnreachable();
+
+    m_IRBuilder.SetInsertPoint(okBlock);
+}
+
+} // namespace jlang
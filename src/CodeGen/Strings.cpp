@@ -0,0 +1,212 @@
+#include "CodeGen.h"
+
+#include "../Common/Logger.h"
+
+#include <algorithm>
+
+namespace jlang
+{
+
+llvm::Constant *CodeGenerator::GetStringLiteral(const std::string &text)
+{
+    llvm::Constant *&literal = m_StringLiterals[text];
+
+    if (literal)
+    {
+        return literal;
+    }
+
+    // The terminating NUL stays, so the characters can go to the runtime and to printf as a C string
+    llvm::Constant *characters = llvm::ConstantDataArray::getString(m_Context, text);
+    auto *global = new llvm::GlobalVariable(*m_Module, characters->getType(), true,
+                                            llvm::GlobalValue::PrivateLinkage, characters, "str");
+    global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    global->setAlignment(llvm::Align(1));
+
+    llvm::Constant *zero = m_IRBuilder.getInt32(0);
+    llvm::Constant *indices[] = {zero, zero};
+    llvm::Constant *data =
+        llvm::ConstantExpr::getInBoundsGetElementPtr(characters->getType(), global, indices);
+
+    literal = llvm::ConstantStruct::get(GetSliceType(m_IRBuilder.getInt8Ty()),
+                                        {data, m_IRBuilder.getInt32(static_cast<uint32_t>(text.size()))});
+    m_LiteralCharacters[literal] = data;
+
+    return literal;
+}
+
+llvm::Value *CodeGenerator::DecayStringLiteral(llvm::Value *value, llvm::Type *type)
+{
+    if (!value || !type || !type->isPointerTy())
+    {
+        return value;
+    }
+
+    // Only literals are known to end in a NUL, a str from jslice may stop in the middle of its characters
+    auto it = m_LiteralCharacters.find(value);
+
+    if (it == m_LiteralCharacters.end())
+    {
+        return value;
+    }
+
+    return llvm::ConstantExpr::getBitCast(it->second, type);
+}
+
+bool CodeGenerator::IsStrType(llvm::Type *type)
+{
+    return type == GetSliceType(m_IRBuilder.getInt8Ty());
+}
+
+llvm::Value *CodeGenerator::EmitStrComparison(const std::string &op, llvm::Value *lhs, llvm::Value *rhs)
+{
+    if (lhs->getType() != rhs->getType())
+    {
+        JLANG_ERROR(STR("Operands of %s: a str can only be compared with another str", op.c_str()));
+        return nullptr;
+    }
+
+    llvm::Value *lhsData = m_IRBuilder.CreateExtractValue(lhs, 0, "lhs.data");
+    llvm::Value *lhsLength = m_IRBuilder.CreateExtractValue(lhs, 1, "lhs.len");
+    llvm::Value *rhsData = m_IRBuilder.CreateExtractValue(rhs, 0, "rhs.data");
+    llvm::Value *rhsLength = m_IRBuilder.CreateExtractValue(rhs, 1, "rhs.len");
+
+    if (op == "<" || op == ">")
+    {
+        llvm::Value *order = m_IRBuilder.CreateCall(m_Module->getFunction("jstr_compare"),
+                                                    {lhsData, lhsLength, rhsData, rhsLength}, "order");
+        llvm::Value *zero = m_IRBuilder.getInt32(0);
+
+        return op == "<" ? m_IRBuilder.CreateICmpSLT(order, zero, "lttmp")
+                         : m_IRBuilder.CreateICmpSGT(order, zero, "gttmp");
+    }
+
+    if (op != "==" && op != "!=")
+    {
+        JLANG_ERROR(STR("Operator %s is not supported on str", op.c_str()));
+        return nullptr;
+    }
+
+    // Strings of different lengths differ without looking at their characters. A literal on either side
+    // makes the memcmp length a constant, which the optimizer expands into a few loads and compares.
+    llvm::Value *length = llvm::isa<llvm::Constant>(lhsLength) ? lhsLength : rhsLength;
+    llvm::Value *isSameLength = m_IRBuilder.CreateICmpEQ(lhsLength, rhsLength, "samelen");
+
+    llvm::Function *function = m_IRBuilder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *lengthBlock = m_IRBuilder.GetInsertBlock();
+    llvm::BasicBlock *compareBlock = llvm::BasicBlock::Create(m_Context, "str.cmp", function);
+    llvm::BasicBlock *doneBlock = llvm::BasicBlock::Create(m_Context, "str.done", function);
+
+    m_IRBuilder.CreateCondBr(isSameLength, compareBlock, doneBlock);
+
+    m_IRBuilder.SetInsertPoint(compareBlock);
+
+    llvm::Type *int64Type = m_IRBuilder.getInt64Ty();
+    llvm::Type *bytePtrType = m_IRBuilder.getInt8PtrTy();
+    llvm::FunctionType *memcmpType =
+        llvm::FunctionType::get(m_IRBuilder.getInt32Ty(), {bytePtrType, bytePtrType, int64Type}, false);
+    llvm::FunctionCallee memcmp = m_Module->getOrInsertFunction("memcmp", memcmpType);
+
+    llvm::Value *difference = m_IRBuilder.CreateCall(
+        memcmp, {lhsData, rhsData, m_IRBuilder.CreateZExt(length, int64Type)}, "memcmp");
+    llvm::Value *isSameData = m_IRBuilder.CreateICmpEQ(difference, m_IRBuilder.getInt32(0), "samedata");
+    m_IRBuilder.CreateBr(doneBlock);
+
+    m_IRBuilder.SetInsertPoint(doneBlock);
+    llvm::PHINode *isEqual = m_IRBuilder.CreatePHI(m_IRBuilder.getInt1Ty(), 2, "streq");
+    isEqual->addIncoming(m_IRBuilder.getFalse(), lengthBlock);
+    isEqual->addIncoming(isSameData, compareBlock);
+
+    return op == "==" ? static_cast<llvm::Value *>(isEqual) : m_IRBuilder.CreateNot(isEqual, "strne");
+}
+
+bool CodeGenerator::ExpandStrArguments(CallExpr &node, std::vector<llvm::Value *> &args, unsigned fixedCount)
+{
+    auto variadic = args.begin() + fixedCount;
+
+    if (std::none_of(variadic, args.end(), [&](llvm::Value *arg) { return IsStrType(arg->getType()); }))
+    {
+        return true;
+    }
+
+    // printf formats end their fixed parameters. Without a literal one the caller has to spell %.*s itself.
+    const AstNode *formatArgument = fixedCount > 0 ? node.arguments[fixedCount - 1].get() : nullptr;
+    const auto *format = formatArgument && formatArgument->type == NodeType::LiteralExpr
+                             ? static_cast<const LiteralExpr *>(formatArgument)
+                             : nullptr;
+
+    if (format && format->kind == LiteralKind::String)
+    {
+        const std::string &text = format->value;
+        std::string rewritten;
+        size_t argument = fixedCount;
+        size_t position = 0;
+
+        while (position < text.size())
+        {
+            size_t percent = text.find('%', position);
+            size_t end = percent == std::string::npos
+                             ? std::string::npos
+                             : text.find_first_of("diouxXfFeEgGaAcspn%", percent + 1);
+
+            if (end == std::string::npos)
+            {
+                rewritten.append(text, position, std::string::npos);
+                break;
+            }
+
+            std::string spec = text.substr(percent + 1, end - percent - 1);
+            rewritten.append(text, position, end - position);
+            position = end + 1;
+
+            if (text[end] == '%')
+            {
+                rewritten += '%';
+                continue;
+            }
+
+            // A '*' width or precision takes an argument of its own, before the one converted
+            argument += static_cast<size_t>(std::count(spec.begin(), spec.end(), '*'));
+            bool isStr = argument < args.size() && IsStrType(args[argument]->getType());
+            ++argument;
+
+            if (!isStr)
+            {
+                rewritten += text[end];
+                continue;
+            }
+
+            if (text[end] != 's' || spec.find('.') != std::string::npos)
+            {
+                JLANG_ERROR(STR("%s: a str argument needs a %%s conversion without a precision",
+                                node.callee.c_str()));
+                return false;
+            }
+
+            rewritten += ".*s";
+        }
+
+        llvm::Type *formatType = args[fixedCount - 1]->getType();
+        args[fixedCount - 1] = DecayStringLiteral(GetStringLiteral(rewritten), formatType);
+    }
+
+    std::vector<llvm::Value *> expanded(args.begin(), variadic);
+
+    for (auto arg = variadic; arg != args.end(); ++arg)
+    {
+        if (IsStrType((*arg)->getType()))
+        {
+            expanded.push_back(m_IRBuilder.CreateExtractValue(*arg, 1, "len"));
+            expanded.push_back(m_IRBuilder.CreateExtractValue(*arg, 0, "data"));
+        }
+        else
+        {
+            expanded.push_back(*arg);
+        }
+    }
+
+    args = std::move(expanded);
+    return true;
+}
+
+} // namespace jlang
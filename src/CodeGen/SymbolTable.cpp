@@ -0,0 +1,66 @@
+#include "SymbolTable.h"
+
+#include "../Common/Assert.h"
+
+namespace jlang
+{
+
+SymbolTable::SymbolTable(const SymbolInterner &names) : m_Names(names), m_Values(names.GetCount(), nullptr) {}
+
+void SymbolTable::PushScope()
+{
+    m_ScopeStarts.push_back(m_Shadowed.size());
+}
+
+void SymbolTable::PopScope()
+{
+    if (m_ScopeStarts.empty())
+    {
+        return;
+    }
+
+    // Undo in reverse, a name declared twice in one scope gets its outer binding back
+    for (size_t i = m_Shadowed.size(); i > m_ScopeStarts.back(); --i)
+    {
+        m_Values[m_Shadowed[i - 1].first] = m_Shadowed[i - 1].second;
+    }
+
+    m_Shadowed.resize(m_ScopeStarts.back());
+    m_ScopeStarts.pop_back();
+}
+
+void SymbolTable::Declare(SymbolId symbol, llvm::Value *value)
+{
+    ASSERT(symbol < m_Names.GetCount());
+
+    // The interner is shared by every unit and may have grown since the table was made
+    if (symbol >= m_Values.size())
+    {
+        m_Values.resize(m_Names.GetCount(), nullptr);
+    }
+
+    m_Shadowed.emplace_back(symbol, m_Values[symbol]);
+    m_Values[symbol] = value;
+}
+
+llvm::Value *SymbolTable::Lookup(SymbolId symbol) const
+{
+    return symbol < m_Values.size() ? m_Values[symbol] : nullptr;
+}
+
+std::vector<std::pair<SymbolId, llvm::Value *>> SymbolTable::GetVisible() const
+{
+    std::vector<std::pair<SymbolId, llvm::Value *>> visible;
+
+    for (SymbolId symbol = 0; symbol < m_Values.size(); ++symbol)
+    {
+        if (m_Values[symbol])
+        {
+            visible.emplace_back(symbol, m_Values[symbol]);
+        }
+    }
+
+    return visible;
+}
+
+} // namespace jlang
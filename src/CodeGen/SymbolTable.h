@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../Parser/SymbolInterner.h"
+
+#include <utility>
+#include <vector>
+
+#include <llvm/IR/Value.h>
+
+namespace jlang
+{
+
+// The locals and parameters visible at the current point of codegen. The parser interned their names into
+// SymbolIds, the current binding of each id sits in a flat vector indexed by it. A declaration records the
+// binding it shadows on an undo stack, popping a scope restores them, so push, pop, declare and look up are
+// all O(1) and never hash a name. The storage is kept for the next function, which makes them allocation
+// free once the generator has seen its names.
+class SymbolTable
+{
+  public:
+    explicit SymbolTable(const SymbolInterner &names);
+
+    void PushScope();
+    void PopScope();
+
+    // Visible until the current scope is popped, shadowing any outer binding of the name
+    void Declare(SymbolId symbol, llvm::Value *value);
+
+    // nullptr when the name isn't bound in any open scope
+    llvm::Value *Lookup(SymbolId symbol) const;
+
+    // Every bound name with its innermost binding, in the order the names were interned
+    std::vector<std::pair<SymbolId, llvm::Value *>> GetVisible() const;
+
+    const std::string &GetName(SymbolId symbol) const { return m_Names.GetName(symbol); }
+
+  private:
+    const SymbolInterner &m_Names;
+
+    std::vector<llvm::Value *> m_Values;
+    std::vector<std::pair<SymbolId, llvm::Value *>> m_Shadowed;
+    std::vector<size_t> m_ScopeStarts;
+};
+
+} // namespace jlang
@@ -0,0 +1,222 @@
+#include "CodeGen.h"
+
+#include "../Common/Logger.h"
+
+#include <algorithm>
+
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/IntrinsicInst.h>
+
+namespace jlang
+{
+
+// Whether some stack slot's address is kept anywhere but in the loads and stores that use it, after which a
+// pointer loaded from memory may point into the frame
+static bool IsFrameAddressTaken(const llvm::Function &function)
+{
+    std::vector<const llvm::Value *> addresses;
+
+    for (const llvm::Instruction &instruction : llvm::instructions(function))
+    {
+        if (llvm::isa<llvm::AllocaInst>(instruction))
+        {
+            addresses.push_back(&instruction);
+        }
+    }
+
+    while (!addresses.empty())
+    {
+        const llvm::Value *address = addresses.back();
+        addresses.pop_back();
+
+        for (const llvm::User *user : address->users())
+        {
+            if (llvm::isa<llvm::LoadInst>(user) || llvm::isa<llvm::ICmpInst>(user))
+            {
+                continue;
+            }
+
+            if (const auto *store = llvm::dyn_cast<llvm::StoreInst>(user))
+            {
+                if (store->getValueOperand() == address)
+                {
+                    return true;
+                }
+
+                continue;
+            }
+
+            if (llvm::isa<llvm::GetElementPtrInst>(user) || llvm::isa<llvm::BitCastInst>(user))
+            {
+                addresses.push_back(user);
+                continue;
+            }
+
+            if (const auto *intrinsic = llvm::dyn_cast<llvm::IntrinsicInst>(user))
+            {
+                if (intrinsic->isLifetimeStartOrEnd())
+                {
+                    continue;
+                }
+            }
+
+            // Inserted into a slice or an interface value, passed to a call, merged by a phi...
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool HoldsPointer(llvm::Type *type)
+{
+    if (auto *structType = llvm::dyn_cast<llvm::StructType>(type))
+    {
+        return std::any_of(structType->element_begin(), structType->element_end(), HoldsPointer);
+    }
+
+    if (auto *arrayType = llvm::dyn_cast<llvm::ArrayType>(type))
+    {
+        return HoldsPointer(arrayType->getElementType());
+    }
+
+    return type->isPointerTy();
+}
+
+// Adds the pointers an argument is made of: the argument itself, or the fields of a slice or an interface
+// value built by insertvalue. Aggregates that come from anywhere else are added whole.
+static void CollectArgumentPointers(llvm::Value *value, std::vector<llvm::Value *> &pointers)
+{
+    if (llvm::isa<llvm::Constant>(value) || !HoldsPointer(value->getType()))
+    {
+        return;
+    }
+
+    if (auto *insert = llvm::dyn_cast<llvm::InsertValueInst>(value))
+    {
+        CollectArgumentPointers(insert->getAggregateOperand(), pointers);
+        CollectArgumentPointers(insert->getInsertedValueOperand(), pointers);
+        return;
+    }
+
+    pointers.push_back(value);
+}
+
+void CodeGenerator::EmitReturn(llvm::Value *value, bool isTailRequired)
+{
+    llvm::BasicBlock *block = m_IRBuilder.GetInsertBlock();
+    auto *call = block->empty() ? nullptr : llvm::dyn_cast<llvm::CallInst>(&block->back());
+
+    // 'return f(x);', and in void functions a call that is the last thing before the return
+    bool isTailPosition = call && (value ? value == call : call->getType()->isVoidTy());
+
+    PendingReturn pending;
+    pending.ret = value ? m_IRBuilder.CreateRet(value) : m_IRBuilder.CreateRetVoid();
+    pending.tailCall = isTailPosition ? call : nullptr;
+    pending.isTailRequired = isTailRequired;
+
+    if (isTailRequired && !isTailPosition)
+    {
+        JLANG_ERROR(STR("%s: 'return tail' needs a call whose result is returned unchanged",
+                        m_CurrentFunction->name.c_str()));
+    }
+
+    m_Returns.push_back(pending);
+}
+
+void CodeGenerator::FinishReturns(const FunctionDecl &node)
+{
+    for (const PendingReturn &pending : m_Returns)
+    {
+        // Like in Cilk, tasks never outlive the function that spawned them
+        if (m_TaskGroup)
+        {
+            m_IRBuilder.SetInsertPoint(pending.ret);
+            m_IRBuilder.CreateCall(m_Module->getFunction("jtask_sync"), {m_TaskGroup});
+        }
+
+        if (!pending.tailCall)
+        {
+            continue;
+        }
+
+        const char *reason = m_TaskGroup ? "the function waits for its spawned tasks before returning"
+                                         : CheckTailCall(pending.tailCall);
+
+        if (!reason)
+        {
+            pending.tailCall->setTailCallKind(llvm::CallInst::TCK_MustTail);
+        }
+        else if (pending.isTailRequired)
+        {
+            std::string callee = pending.tailCall->getCalledOperand()->getName().str();
+            JLANG_ERROR(STR("%s: cannot guarantee the tail call to %s, %s", node.name.c_str(), callee.c_str(),
+                            reason));
+        }
+    }
+
+    m_Returns.clear();
+}
+
+// musttail reuses the caller's frame for the callee, which the backend can only guarantee when both take
+// and return the same types, and which is only safe when no argument points into the frame being reused
+const char *CodeGenerator::CheckTailCall(llvm::CallInst *call) const
+{
+    llvm::Function *callee = call->getCalledFunction();
+
+    if (!callee || callee->isIntrinsic())
+    {
+        return "it is not a call to a function";
+    }
+
+    if (callee->getFunctionType() != call->getFunction()->getFunctionType() ||
+        callee->getCallingConv() != call->getFunction()->getCallingConv())
+    {
+        return "its parameter and return types differ from those of the caller";
+    }
+
+    std::vector<llvm::Value *> pointers;
+
+    for (const llvm::Use &argument : call->args())
+    {
+        CollectArgumentPointers(argument.get(), pointers);
+    }
+
+    bool isUnknownPointerPassed = false;
+
+    for (llvm::Value *pointer : pointers)
+    {
+        if (!pointer->getType()->isPointerTy())
+        {
+            isUnknownPointerPassed = true;
+            continue;
+        }
+
+        llvm::SmallVector<const llvm::Value *, 4> objects;
+        llvm::getUnderlyingObjects(pointer, objects);
+
+        for (const llvm::Value *object : objects)
+        {
+            if (llvm::isa<llvm::AllocaInst>(object))
+            {
+                return "an argument points into the caller's stack frame";
+            }
+
+            // Parameters and globals never point into this frame, loaded pointers might
+            if (!llvm::isa<llvm::Argument>(object) && !llvm::isa<llvm::Constant>(object))
+            {
+                isUnknownPointerPassed = true;
+            }
+        }
+    }
+
+    if (isUnknownPointerPassed && IsFrameAddressTaken(*call->getFunction()))
+    {
+        return "an argument may point into the caller's stack frame, whose address is taken";
+    }
+
+    return nullptr;
+}
+
+} // namespace jlang
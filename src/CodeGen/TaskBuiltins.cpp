@@ -0,0 +1,371 @@
+#include "CodeGen.h"
+
+#include "../Common/Logger.h"
+
+#include <algorithm>
+
+#include <llvm/IR/DerivedTypes.h>
+
+namespace jlang
+{
+
+// Fields of the env a spawned task gets: the callee's parameters. Literal struct types are uniqued, so a
+// spawn site and the thunk reading its env agree on the layout.
+static llvm::StructType *GetEnvType(llvm::FunctionType *calleeType)
+{
+    return llvm::StructType::get(calleeType->getContext(), calleeType->params());
+}
+
+// The arguments are evaluated by the spawning function and copied into the task, the thunk loads them
+// back and makes an ordinary call, which the optimizer is free to inline into it.
+void CodeGenerator::EmitTaskStatement(CallExpr &node)
+{
+    m_LastValue = nullptr;
+    llvm::Value *group = GetTaskGroup();
+
+    if (!node.isSpawned)
+    {
+        EmitLocation(node);
+        m_IRBuilder.CreateCall(m_Module->getFunction("jtask_sync"), {group});
+        return;
+    }
+
+    llvm::Function *callee = m_Module->getFunction(node.callee);
+
+    if (!callee)
+    {
+        JLANG_ERROR(STR("Unknown function: %s", node.callee.c_str()));
+        return;
+    }
+
+    if (callee->isVarArg() || callee->arg_size() != node.arguments.size())
+    {
+        JLANG_ERROR(STR("Cannot spawn %s: wrong number of arguments", node.callee.c_str()));
+        return;
+    }
+
+    // Coroutines belong to the event loop of the thread that created them
+    if (m_AsyncFunctions.count(callee))
+    {
+        JLANG_ERROR(STR("Cannot spawn %s: it is an async function", node.callee.c_str()));
+        return;
+    }
+
+    llvm::FunctionType *calleeType = callee->getFunctionType();
+    bool isUserFunction = m_UserFunctions.count(callee) != 0;
+    std::vector<llvm::Value *> args;
+
+    for (unsigned i = 0; i < node.arguments.size(); ++i)
+    {
+        llvm::Value *value = EmitArgument(*node.arguments[i], calleeType->getParamType(i), isUserFunction);
+
+        if (!value)
+        {
+            JLANG_ERROR(STR("Invalid argument in spawn of %s", node.callee.c_str()));
+            return;
+        }
+
+        args.push_back(value);
+    }
+
+    EmitLocation(node);
+
+    llvm::StructType *envType = GetEnvType(calleeType);
+    llvm::Value *env = EmitTaskEnv(envType, args, "spawn.env");
+    uint64_t envSize = m_Module->getDataLayout().getTypeAllocSize(envType);
+
+    m_IRBuilder.CreateCall(m_Module->getFunction("jtask_spawn"),
+                           {group, GetSpawnThunk(callee), env, m_IRBuilder.getInt64(envSize)});
+}
+
+// parallel_for(lo, hi, fn) calls 'void fn() -> int32 i' for every i in [lo, hi), the closure form runs
+// its body instead. Either way the runtime gets a thunk that runs one range of indices.
+bool CodeGenerator::EmitParallelFor(CallExpr &node)
+{
+    if (node.callee != "parallel_for")
+    {
+        return false;
+    }
+
+    m_LastValue = nullptr;
+
+    size_t argumentCount = node.closureBody ? 2 : 3;
+    const AstNode *bodyName = node.arguments.size() == 3 ? node.arguments[2].get() : nullptr;
+
+    if (node.arguments.size() != argumentCount || (!node.closureBody && bodyName->type != NodeType::VarExpr))
+    {
+        JLANG_ERROR("Expected 'parallel_for(lo, hi, fn)' or 'parallel_for(lo, hi) -> int32 i { ... }'");
+        return true;
+    }
+
+    llvm::Type *int32Type = llvm::Type::getInt32Ty(m_Context);
+    llvm::Function *body = nullptr;
+
+    if (!node.closureBody)
+    {
+        const std::string &name = static_cast<const VarExpr *>(bodyName)->name;
+        body = m_Module->getFunction(name);
+
+        if (!body || body->isVarArg() || body->arg_size() != 1 ||
+            body->getFunctionType()->getParamType(0) != int32Type)
+        {
+            JLANG_ERROR(STR("parallel_for needs %s to be a function taking an int32 index", name.c_str()));
+            return true;
+        }
+    }
+
+    llvm::Value *lo = EmitArgument(*node.arguments[0], int32Type);
+    llvm::Value *hi = EmitArgument(*node.arguments[1], int32Type);
+
+    if (!lo || !hi || lo->getType() != int32Type || hi->getType() != int32Type)
+    {
+        JLANG_ERROR("parallel_for expects an int32 range");
+        return true;
+    }
+
+    EmitLocation(node);
+
+    llvm::Value *env = llvm::ConstantPointerNull::get(llvm::Type::getInt8PtrTy(m_Context));
+    llvm::Function *thunk = body ? GetRangeThunk(body) : EmitParallelClosure(node, env);
+
+    m_IRBuilder.CreateCall(m_Module->getFunction("jtask_parallel_for"), {lo, hi, thunk, env});
+
+    return true;
+}
+
+llvm::Value *CodeGenerator::GetTaskGroup()
+{
+    if (m_TaskGroup)
+    {
+        return m_TaskGroup;
+    }
+
+    // Zeroed in the entry block: in a loop the sync may come before the spawn in the source
+    llvm::AllocaInst *group = CreateEntryBlockAlloca(m_TaskGroupType, "taskgroup");
+    llvm::IRBuilder<> entryBuilder(group->getParent(), std::next(group->getIterator()));
+    entryBuilder.CreateStore(llvm::Constant::getNullValue(m_TaskGroupType), group);
+
+    m_TaskGroup = group;
+    return group;
+}
+
+llvm::Value *CodeGenerator::EmitTaskEnv(llvm::StructType *envType, const std::vector<llvm::Value *> &values,
+                                        const std::string &name)
+{
+    // The runtime copies the env before the call returns, so one slot per site serves every iteration
+    llvm::AllocaInst *env = CreateEntryBlockAlloca(envType, name);
+
+    for (unsigned i = 0; i < values.size(); ++i)
+    {
+        m_IRBuilder.CreateStore(values[i], m_IRBuilder.CreateStructGEP(envType, env, i));
+    }
+
+    return m_IRBuilder.CreateBitCast(env, llvm::Type::getInt8PtrTy(m_Context));
+}
+
+// void f.task(i8* env): f(env->0, env->1, ...)
+llvm::Function *CodeGenerator::GetSpawnThunk(llvm::Function *callee)
+{
+    llvm::Function *&thunk = m_SpawnThunks[callee];
+
+    if (thunk)
+    {
+        return thunk;
+    }
+
+    llvm::IRBuilderBase::InsertPointGuard guard(m_IRBuilder);
+    m_IRBuilder.SetCurrentDebugLocation(llvm::DebugLoc());
+
+    llvm::Type *bytePtrType = llvm::Type::getInt8PtrTy(m_Context);
+    thunk = llvm::Function::Create(
+        llvm::FunctionType::get(llvm::Type::getVoidTy(m_Context), {bytePtrType}, false),
+        llvm::Function::InternalLinkage, callee->getName() + ".task", m_Module.get());
+
+    m_IRBuilder.SetInsertPoint(llvm::BasicBlock::Create(m_Context, "entry", thunk));
+
+    llvm::StructType *envType = GetEnvType(callee->getFunctionType());
+    llvm::Value *env = m_IRBuilder.CreateBitCast(thunk->getArg(0), envType->getPointerTo(), "env");
+
+    std::vector<llvm::Value *> args;
+
+    for (unsigned i = 0; i < envType->getNumElements(); ++i)
+    {
+        args.push_back(m_IRBuilder.CreateLoad(envType->getElementType(i),
+                                              m_IRBuilder.CreateStructGEP(envType, env, i)));
+    }
+
+    m_IRBuilder.CreateCall(callee, args);
+    m_IRBuilder.CreateRetVoid();
+
+    return thunk;
+}
+
+// void f.range(i8* env, i32 from, i32 to): for (i = from; i < to; i = i + 1) f(i)
+llvm::Function *CodeGenerator::GetRangeThunk(llvm::Function *body)
+{
+    llvm::Function *&thunk = m_RangeThunks[body];
+
+    if (thunk)
+    {
+        return thunk;
+    }
+
+    llvm::IRBuilderBase::InsertPointGuard guard(m_IRBuilder);
+    m_IRBuilder.SetCurrentDebugLocation(llvm::DebugLoc());
+
+    thunk = CreateRangeThunk(body->getName() + ".range");
+    EmitRangeLoop(thunk, [&](llvm::Value *index) { m_IRBuilder.CreateCall(body, {index}); });
+    m_IRBuilder.CreateRetVoid();
+
+    return thunk;
+}
+
+// The closure is generated as a function of its own. Every binding in scope, a local's slot or a parameter's
+// value, is captured into env, which stays on the enclosing frame since jtask_parallel_for only returns once
+// all ranges are done; captures the body never reads end up as dead loads and are optimized away.
+llvm::Function *CodeGenerator::EmitParallelClosure(CallExpr &node, llvm::Value *&env)
+{
+    std::vector<std::pair<SymbolId, llvm::Value *>> captures = m_Symbols.GetVisible();
+    std::vector<llvm::Value *> values;
+
+    // Consts are the same in the body, only the frame's slots and parameters need capturing
+    auto isConst = [](const auto &capture) { return llvm::isa<llvm::Constant>(capture.second); };
+    captures.erase(std::remove_if(captures.begin(), captures.end(), isConst), captures.end());
+    std::vector<llvm::Type *> types;
+
+    // Slots are captured by reference, so the body reads and writes the enclosing function's variables,
+    // atomic ones included. They outlive the body, jtask_parallel_for returns once every index ran.
+    for (const auto &capture : captures)
+    {
+        values.push_back(capture.second);
+        types.push_back(capture.second->getType());
+    }
+
+    llvm::StructType *envType = llvm::StructType::get(m_Context, types);
+    env = EmitTaskEnv(envType, values, "closure.env");
+
+    llvm::Function *enclosing = m_IRBuilder.GetInsertBlock()->getParent();
+
+    llvm::IRBuilderBase::InsertPointGuard guard(m_IRBuilder);
+    llvm::Value *enclosingGroup = m_TaskGroup;
+    llvm::DISubprogram *enclosingScope = m_DIScope;
+    CoroutineState enclosingCoroutine = m_Coroutine;
+    const FunctionDecl *enclosingFunction = m_CurrentFunction;
+
+    // The body runs on worker threads, outside of any coroutine of the enclosing function
+    m_IRBuilder.SetCurrentDebugLocation(llvm::DebugLoc());
+    m_TaskGroup = nullptr;
+    m_Coroutine = CoroutineState();
+    m_CurrentFunction = nullptr;
+
+    llvm::Function *thunk = CreateRangeThunk(enclosing->getName() + ".parallel_for");
+
+    if (m_DIBuilder)
+    {
+        llvm::DISubroutineType *functionType =
+            m_DIBuilder->createSubroutineType(m_DIBuilder->getOrCreateTypeArray({}));
+
+        m_DIScope = m_DIBuilder->createFunction(
+            m_DIFile, "parallel_for", thunk->getName(), m_DIFile, node.location.line, functionType,
+            node.location.line, llvm::DINode::FlagPrototyped,
+            llvm::DISubprogram::SPFlagDefinition | llvm::DISubprogram::SPFlagLocalToUnit);
+        thunk->setSubprogram(m_DIScope);
+        EmitLocation(node);
+    }
+
+    // Every captured name is rebound to the value or slot pointer the env holds for it
+    m_Symbols.PushScope();
+
+    llvm::Value *captured = m_IRBuilder.CreateBitCast(thunk->getArg(0), envType->getPointerTo(), "env");
+    std::vector<const llvm::Value *> capturedSlots;
+
+    for (unsigned i = 0; i < captures.size(); ++i)
+    {
+        const auto &[symbol, binding] = captures[i];
+        llvm::Value *field = m_IRBuilder.CreateStructGEP(envType, captured, i);
+        llvm::Value *value = m_IRBuilder.CreateLoad(types[i], field, m_Symbols.GetName(symbol));
+
+        if (llvm::Type *slotType = GetSlotType(binding))
+        {
+            m_CapturedSlots[value] = slotType;
+            capturedSlots.push_back(value);
+
+            if (m_AtomicSlots.count(binding))
+            {
+                m_AtomicSlots.insert(value);
+            }
+        }
+
+        m_Symbols.Declare(symbol, value);
+    }
+
+    llvm::Type *int32Type = llvm::Type::getInt32Ty(m_Context);
+    llvm::AllocaInst *indexSlot = CreateEntryBlockAlloca(int32Type, node.closureIndex);
+    m_Symbols.Declare(node.closureIndexSymbol, indexSlot);
+
+    EmitRangeLoop(thunk, [&](llvm::Value *index) {
+        m_IRBuilder.CreateStore(index, indexSlot);
+        node.closureBody->Accept(*this);
+    });
+
+    if (m_TaskGroup)
+    {
+        m_IRBuilder.CreateCall(m_Module->getFunction("jtask_sync"), {m_TaskGroup});
+    }
+
+    m_IRBuilder.CreateRetVoid();
+    m_Symbols.PopScope();
+
+    for (const llvm::Value *slot : capturedSlots)
+    {
+        m_CapturedSlots.erase(slot);
+        m_AtomicSlots.erase(slot);
+    }
+
+    m_TaskGroup = enclosingGroup;
+    m_DIScope = enclosingScope;
+    m_Coroutine = enclosingCoroutine;
+    m_CurrentFunction = enclosingFunction;
+
+    return thunk;
+}
+
+llvm::Function *CodeGenerator::CreateRangeThunk(const llvm::Twine &name)
+{
+    llvm::Type *int32Type = llvm::Type::getInt32Ty(m_Context);
+    llvm::Type *bytePtrType = llvm::Type::getInt8PtrTy(m_Context);
+
+    llvm::Function *thunk = llvm::Function::Create(
+        llvm::FunctionType::get(llvm::Type::getVoidTy(m_Context), {bytePtrType, int32Type, int32Type}, false),
+        llvm::Function::InternalLinkage, name, m_Module.get());
+
+    m_IRBuilder.SetInsertPoint(llvm::BasicBlock::Create(m_Context, "entry", thunk));
+    return thunk;
+}
+
+void CodeGenerator::EmitRangeLoop(llvm::Function *thunk, const std::function<void(llvm::Value *)> &emitBody)
+{
+    llvm::Value *from = thunk->getArg(1);
+    llvm::Value *to = thunk->getArg(2);
+
+    llvm::BasicBlock *bodyBlock = llvm::BasicBlock::Create(m_Context, "range.body", thunk);
+    llvm::BasicBlock *endBlock = llvm::BasicBlock::Create(m_Context, "range.end", thunk);
+
+    // The runtime never hands out an empty range, but the loop is rotated and still checks once up front
+    llvm::BasicBlock *entryBlock = m_IRBuilder.GetInsertBlock();
+    m_IRBuilder.CreateCondBr(m_IRBuilder.CreateICmpSLT(from, to), bodyBlock, endBlock);
+
+    m_IRBuilder.SetInsertPoint(bodyBlock);
+    llvm::PHINode *index = m_IRBuilder.CreatePHI(from->getType(), 2, "i");
+    index->addIncoming(from, entryBlock);
+
+    emitBody(index);
+
+    llvm::Value *next = m_IRBuilder.CreateNSWAdd(index, m_IRBuilder.getInt32(1), "next");
+    index->addIncoming(next, m_IRBuilder.GetInsertBlock());
+    m_IRBuilder.CreateCondBr(m_IRBuilder.CreateICmpSLT(next, to), bodyBlock, endBlock);
+
+    m_IRBuilder.SetInsertPoint(endBlock);
+}
+
+} // namespace jlang
@@ -0,0 +1,207 @@
+#include "CodeGen.h"
+
+#include "../Common/Logger.h"
+
+#include <llvm/IR/DerivedTypes.h>
+
+namespace jlang
+{
+
+// Everything lowers to plain vector IR and the llvm.vector.reduce intrinsics, which the backend legalizes
+// for whatever SIMD width the host has, so the same program runs on any x86-64 or AArch64 machine.
+bool CodeGenerator::EmitVectorBuiltin(CallExpr &node)
+{
+    static const std::unordered_map<std::string, size_t> s_ArgumentCounts = {
+        {"jload4", 2},      {"jload8", 2},      {"jstore", 3},      {"jsplat4", 1},
+        {"jsplat8", 1},     {"jlane", 2},       {"jsetlane", 3},    {"jshuffle", 0},
+        {"jreduce_add", 1}, {"jreduce_min", 1}, {"jreduce_max", 1}};
+
+    auto it = s_ArgumentCounts.find(node.callee);
+
+    if (it == s_ArgumentCounts.end())
+    {
+        return false;
+    }
+
+    m_LastValue = nullptr;
+
+    // jshuffle takes both vectors and then one lane index per result lane
+    bool isShuffle = node.callee == "jshuffle";
+
+    if (isShuffle ? node.arguments.size() != 6 && node.arguments.size() != 10
+                  : node.arguments.size() != it->second)
+    {
+        JLANG_ERROR(STR("Wrong number of arguments to %s", node.callee.c_str()));
+        return true;
+    }
+
+    // Lane indices of a shuffle are part of the instruction, so they have to be literals
+    std::vector<int> mask;
+
+    if (isShuffle)
+    {
+        for (size_t i = 2; i < node.arguments.size(); ++i)
+        {
+            const AstNode *argument = node.arguments[i].get();
+
+            if (!argument || argument->type != NodeType::LiteralExpr ||
+                static_cast<const LiteralExpr *>(argument)->kind != LiteralKind::Number)
+            {
+                JLANG_ERROR("jshuffle lane indices must be number literals");
+                return true;
+            }
+
+            mask.push_back(static_cast<const LiteralExpr *>(argument)->numberValue);
+        }
+    }
+
+    std::vector<llvm::Value *> args;
+
+    for (size_t i = 0; i < node.arguments.size() - mask.size(); ++i)
+    {
+        node.arguments[i]->Accept(*this);
+
+        if (!m_LastValue)
+        {
+            JLANG_ERROR(STR("Invalid argument in call to %s", node.callee.c_str()));
+            return true;
+        }
+
+        args.push_back(m_LastValue);
+        m_LastValue = nullptr;
+    }
+
+    EmitLocation(node);
+
+    llvm::Type *int32Type = llvm::Type::getInt32Ty(m_Context);
+    auto *vectorType = llvm::dyn_cast<llvm::FixedVectorType>(args[0]->getType());
+
+    if (node.callee == "jload4" || node.callee == "jload8")
+    {
+        auto *loadType = llvm::FixedVectorType::get(int32Type, node.callee == "jload4" ? 4 : 8);
+
+        if (llvm::Value *address = EmitVectorAddress(args[0], args[1], loadType))
+        {
+            // Only the element alignment is known, the vector may start at any int32
+            llvm::LoadInst *load = m_IRBuilder.CreateAlignedLoad(loadType, address, llvm::Align(4), "vload");
+            DecorateElementAccess(load, int32Type);
+            m_LastValue = load;
+        }
+    }
+    else if (node.callee == "jstore")
+    {
+        auto *storeType = llvm::dyn_cast<llvm::FixedVectorType>(args[2]->getType());
+
+        if (!storeType)
+        {
+            JLANG_ERROR("jstore expects a vector value");
+        }
+        else if (llvm::Value *address = EmitVectorAddress(args[0], args[1], storeType))
+        {
+            llvm::StoreInst *store = m_IRBuilder.CreateAlignedStore(args[2], address, llvm::Align(4));
+            DecorateElementAccess(store, int32Type);
+            m_LastValue = args[2];
+        }
+    }
+    else if (node.callee == "jsplat4" || node.callee == "jsplat8")
+    {
+        if (!args[0]->getType()->isIntegerTy(32))
+        {
+            JLANG_ERROR(STR("%s expects an int32", node.callee.c_str()));
+        }
+        else
+        {
+            m_LastValue = m_IRBuilder.CreateVectorSplat(node.callee == "jsplat4" ? 4 : 8, args[0], "splat");
+        }
+    }
+    else if (!vectorType)
+    {
+        JLANG_ERROR(STR("%s expects a vector as its first argument", node.callee.c_str()));
+    }
+    else if (node.callee == "jlane" || node.callee == "jsetlane")
+    {
+        auto *lane = llvm::dyn_cast<llvm::ConstantInt>(args[1]);
+
+        if (!args[1]->getType()->isIntegerTy())
+        {
+            JLANG_ERROR(STR("%s expects an int32 lane", node.callee.c_str()));
+        }
+        else if (lane && lane->getZExtValue() >= vectorType->getNumElements())
+        {
+            JLANG_ERROR(STR("Lane %d is out of range in %s", static_cast<int>(lane->getSExtValue()),
+                            node.callee.c_str()));
+        }
+        else if (node.callee == "jlane")
+        {
+            m_LastValue = m_IRBuilder.CreateExtractElement(args[0], args[1], "lane");
+        }
+        else if (args[2]->getType() != vectorType->getElementType())
+        {
+            JLANG_ERROR("jsetlane expects a value of the element type");
+        }
+        else
+        {
+            m_LastValue = m_IRBuilder.CreateInsertElement(args[0], args[2], args[1], "setlane");
+        }
+    }
+    else if (isShuffle)
+    {
+        auto laneCount = static_cast<int>(vectorType->getNumElements());
+
+        if (args[1]->getType() != vectorType)
+        {
+            JLANG_ERROR("jshuffle expects two vectors of the same type");
+            return true;
+        }
+
+        for (int index : mask)
+        {
+            if (index < 0 || index >= 2 * laneCount)
+            {
+                JLANG_ERROR(STR("jshuffle lane index %d is out of range", index));
+                return true;
+            }
+        }
+
+        m_LastValue = m_IRBuilder.CreateShuffleVector(args[0], args[1], mask, "shuffle");
+    }
+    else if (node.callee == "jreduce_add")
+    {
+        m_LastValue = m_IRBuilder.CreateAddReduce(args[0]);
+    }
+    else if (node.callee == "jreduce_min")
+    {
+        m_LastValue = m_IRBuilder.CreateIntMinReduce(args[0], true);
+    }
+    else
+    {
+        m_LastValue = m_IRBuilder.CreateIntMaxReduce(args[0], true);
+    }
+
+    return true;
+}
+
+llvm::Value *CodeGenerator::EmitVectorAddress(llvm::Value *base, llvm::Value *index,
+                                              llvm::FixedVectorType *vectorType)
+{
+    llvm::Type *elementType = vectorType->getElementType();
+
+    if (base->getType() != llvm::PointerType::getUnqual(elementType))
+    {
+        JLANG_ERROR("Vector loads and stores expect an int32 pointer");
+        return nullptr;
+    }
+
+    if (!index->getType()->isIntegerTy())
+    {
+        JLANG_ERROR("Vector loads and stores expect an int32 index");
+        return nullptr;
+    }
+
+    index = m_IRBuilder.CreateSExt(index, llvm::Type::getInt64Ty(m_Context), "idx");
+    llvm::Value *elementPtr = m_IRBuilder.CreateInBoundsGEP(elementType, base, index, "elemptr");
+
+    return m_IRBuilder.CreateBitCast(elementPtr, llvm::PointerType::getUnqual(vectorType), "vecptr");
+}
+
+} // namespace jlang
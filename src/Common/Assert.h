@@ -9,8 +9,7 @@
         if (!(condition))                                                                                    \
         {                                                                                                    \
             std::cerr << "JLANG ASSERT FAILED: " << #condition << " at " << __FILE__ << ":" << __LINE__      \
-                      << "\r\n"
-std::abort();
-}
-}
-while (0)
\ No newline at end of file
+                      << "\r\n";                                                                            \
+            std::abort();                                                                                    \
+        }                                                                                                    \
+    } while (0)
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace jlang
+{
+
+struct CompileOptions
+{
+    // .j units of the program and, when linking, .bc files written by an earlier -c
+    std::vector<std::string> inputPaths{"../samples/sample.j"};
+
+    // -O0 .. -O3
+    unsigned optimizationLevel = 0;
+
+    // -fprofile-generate[=path]: count function entries and if branches, appended to path on exit
+    std::string profileGeneratePath;
+
+    // -fprofile-use[=path]: weight branches and classify functions hot or cold from a collected profile
+    std::string profileUsePath;
+
+    // -fheap-profile[=path]: sample jalloc calls with their stacks and write a pprof heap profile on exit
+    std::string heapProfilePath;
+
+    // -fheap-profile-rate=N: average number of allocated bytes between two samples
+    int64_t heapProfileRate = 512 * 1024;
+
+    // -fno-bounds-check: index arrays and slices without comparing the index to their length
+    bool boundsChecks = true;
+
+    // -fconst-steps=N, -fconst-memory=N: the AST nodes evaluating one const var may visit and the bytes of
+    // arrays it may create, so a runaway const function fails instead of stalling the build
+    uint64_t constSteps = 10 * 1000 * 1000;
+    uint64_t constMemory = 64 * 1024 * 1024;
+
+    // -flto: optimize the linked program as a whole, inlining across units
+    bool lto = false;
+
+    // -c: write each unit as bitcode next to its source instead of linking
+    bool compileOnly = false;
+
+    // -emit-interface: also write the declarations of each unit to a .jmi next to its source
+    bool emitInterface = false;
+
+    // -lex-threads=N: lex each unit on N threads instead of streaming it into the parser
+    unsigned lexerThreads = 1;
+
+    // -lazy-parse: skip function bodies while parsing, then parse and compile only those reachable from main
+    // (or, with -c, every function of the unit)
+    bool lazyParsing = false;
+
+    // -g: emit line tables and function descriptions, and with -run make JIT code visible to gdb and perf
+    bool debugInfo = false;
+
+    // -run: execute main in the JIT instead of printing the IR
+    bool run = false;
+};
+
+} // namespace jlang
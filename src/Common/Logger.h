@@ -1,6 +1,9 @@
 #pragma once
 
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <llvm/IR/Value.h>
 
 #define MAX_BUFFER_SIZE 256
@@ -13,6 +16,7 @@
     }(format, __VA_ARGS__)
 
 #define JLANG_ERROR(MSG) LogErrorV(MSG)
+#define JLANG_REMARK(PASS, MSG) LogRemark(PASS, MSG)
 
 #define LOG(severity, message) jlang::Logger::log(severity, message, __FILE__, __LINE__)
 
@@ -21,12 +25,30 @@
 #define JLANG_LOG_WARN(message) LOG("WARN", message)
 #define JLANG_LOG_ERROR(message) LOG("ERROR", message)
 
+// Every JLANG_ERROR is counted, so the driver stops before generating or running code after one
+inline unsigned &ErrorCount()
+{
+    static unsigned errorCount = 0;
+    return errorCount;
+}
+
 inline llvm::Value *LogErrorV(const char *message)
 {
+    ++ErrorCount();
     std::cerr << "JLANG ERROR: " << message << std::endl;
     return nullptr;
 }
 
+inline llvm::Value *LogErrorV(const std::string &message)
+{
+    return LogErrorV(message.c_str());
+}
+
+inline void LogRemark(const char *pass, const std::string &message)
+{
+    std::cerr << "JLANG REMARK [" << pass << "]: " << message << std::endl;
+}
+
 namespace jlang
 {
 
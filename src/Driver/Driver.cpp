@@ -0,0 +1,436 @@
+#include "Driver.h"
+
+#include "../CodeGen/CodeGen.h"
+#include "../CodeGen/PassPipeline.h"
+#include "../Common/Logger.h"
+#include "../Interface/ImportTable.h"
+#include "../Interface/InterfaceWriter.h"
+#include "../JIT/JitRunner.h"
+#include "../Lexer/Lexer.h"
+#include "../Lexer/ParallelLexer.h"
+#include "../Parser/Parser.h"
+#include "../Profile/ProfileData.h"
+#include "../Sema/BoundsCheckElimination.h"
+#include "../Sema/ConstEvaluator.h"
+#include "../Sema/ConstantFolder.h"
+#include "../Sema/EscapeAnalysis.h"
+#include "../Sema/Reachability.h"
+#include "../Sema/TypeResolver.h"
+#include "../Sema/TypeTable.h"
+
+#include <fstream>
+#include <unordered_map>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace jlang
+{
+
+Driver::Driver(const CompileOptions &options) : m_Options(options) {}
+
+int Driver::Run()
+{
+    std::vector<Unit> units;
+    std::vector<std::string> bitcodePaths;
+
+    for (const std::string &path : m_Options.inputPaths)
+    {
+        if (IsBitcodeFile(path))
+        {
+            bitcodePaths.push_back(path);
+            continue;
+        }
+
+        units.emplace_back();
+
+        if (!ParseUnit(path, units.back()))
+        {
+            return 1;
+        }
+    }
+
+    if (m_Options.emitInterface)
+    {
+        for (const Unit &unit : units)
+        {
+            InterfaceWriter interfaceWriter;
+
+            if (!interfaceWriter.Write(unit.program, ReplaceExtension(unit.path, ".jmi")))
+            {
+                return 1;
+            }
+        }
+    }
+
+    if (m_Options.lazyParsing)
+    {
+        ParseReachableBodies(units);
+    }
+
+    ImportTable importTable;
+
+    if (!ImportModules(units, importTable))
+    {
+        return 1;
+    }
+
+    // Structs and functions of every unit first, a unit may use what another one declares
+    TypeTable typeTable;
+    TypeResolver typeResolver(typeTable, &importTable);
+    ConstEvaluator constEvaluator(typeTable, m_Options.constSteps, m_Options.constMemory);
+
+    for (Unit &unit : units)
+    {
+        typeResolver.DeclareUnit(unit.program);
+        constEvaluator.DeclareUnit(unit.program);
+    }
+
+    for (Unit &unit : units)
+    {
+        typeResolver.Run(unit.program);
+
+        EscapeAnalysis escapeAnalysis(typeTable);
+        escapeAnalysis.Run(unit.program);
+
+        ConstantFolder constantFolder;
+        constantFolder.Run(unit.program);
+
+        // After folding, so constant indices are plain literals
+        BoundsCheckElimination boundsCheckElimination(typeTable);
+        boundsCheckElimination.Run(unit.program);
+    }
+
+    // Once every unit is resolved and folded, a const var may call a const function or read a const var of
+    // another unit, which is evaluated first when it comes later
+    for (Unit &unit : units)
+    {
+        constEvaluator.Run(unit.program);
+    }
+
+    // Parsing and the passes above go on after an error to report the others, codegen would only trip over
+    // the InvalidTypeIds and nodes they left behind
+    if (ErrorCount() != 0)
+    {
+        return 1;
+    }
+
+    ProfileData profile;
+    bool hasProfile = !m_Options.profileUsePath.empty() && profile.Load(m_Options.profileUsePath);
+
+    PassPipeline passPipeline(m_Options);
+    PassPipeline::Stage unitStage = m_Options.lto ? PassPipeline::Stage::PreLink : PassPipeline::Stage::Default;
+
+    std::unique_ptr<llvm::Module> program;
+
+    for (const Unit &unit : units)
+    {
+        CodeGenerator codeGenerator(typeTable, m_Symbols);
+
+        for (const Unit &other : units)
+        {
+            if (&other != &unit)
+            {
+                codeGenerator.AddImportedUnit(other.program);
+            }
+        }
+
+        // Only the imported declarations the program actually uses
+        codeGenerator.AddImportedUnit(importTable.GetDeclarations());
+
+        if (m_Options.debugInfo)
+        {
+            codeGenerator.EnableDebugInfo(unit.path, m_Options.optimizationLevel != 0);
+        }
+
+        if (!m_Options.profileGeneratePath.empty())
+        {
+            codeGenerator.EnableProfileGeneration(m_Options.profileGeneratePath);
+        }
+
+        if (!m_Options.heapProfilePath.empty())
+        {
+            codeGenerator.EnableHeapProfile(m_Options.heapProfilePath, m_Options.heapProfileRate);
+        }
+
+        if (!m_Options.boundsChecks)
+        {
+            codeGenerator.DisableBoundsChecks();
+        }
+
+        if (hasProfile)
+        {
+            codeGenerator.UseProfile(profile);
+        }
+
+        llvm::Module &module = codeGenerator.GetModule();
+        module.setModuleIdentifier(unit.path);
+        module.setSourceFileName(unit.path);
+
+        codeGenerator.Generate(unit.program);
+
+        // Errors found while generating code, such as a tail call that cannot be guaranteed
+        if (ErrorCount() != 0)
+        {
+            return 1;
+        }
+
+        passPipeline.Run(module, unitStage);
+
+        if (m_Options.compileOnly)
+        {
+            if (!WriteBitcode(module, ReplaceExtension(unit.path, ".bc")))
+            {
+                return 1;
+            }
+
+            continue;
+        }
+
+        if (!LinkInto(program, CopyToContext(module)))
+        {
+            return 1;
+        }
+    }
+
+    if (m_Options.compileOnly)
+    {
+        return 0;
+    }
+
+    for (const std::string &path : bitcodePaths)
+    {
+        llvm::SMDiagnostic diagnostic;
+        std::unique_ptr<llvm::Module> module = llvm::parseIRFile(path, diagnostic, m_Context);
+
+        if (!module)
+        {
+            JLANG_ERROR(STR("Cannot read %s: %s", path.c_str(), diagnostic.getMessage().str().c_str()));
+            return 1;
+        }
+
+        if (!LinkInto(program, std::move(module)))
+        {
+            return 1;
+        }
+    }
+
+    if (!program)
+    {
+        JLANG_ERROR("No input files");
+        return 1;
+    }
+
+    if (m_Options.lto)
+    {
+        passPipeline.Run(*program, PassPipeline::Stage::Link);
+    }
+
+    if (m_Options.run)
+    {
+        JitRunner jitRunner(m_Options.debugInfo, !m_Options.heapProfilePath.empty());
+        return jitRunner.Run(*program);
+    }
+
+    program->print(llvm::outs(), nullptr);
+    return 0;
+}
+
+bool Driver::ParseUnit(const std::string &path, Unit &unit)
+{
+    std::ifstream in(path);
+
+    if (!in.is_open())
+    {
+        JLANG_ERROR(STR("Cannot open %s", path.c_str()));
+        return false;
+    }
+
+    unit.path = path;
+
+    if (m_Options.lexerThreads > 1)
+    {
+        // Chunks are lexed concurrently, which needs the whole source in memory
+        std::string sourceCode(static_cast<size_t>(in.seekg(0, std::ios::end).tellg()), '\0');
+        in.seekg(0).read(&sourceCode[0], static_cast<std::streamsize>(sourceCode.size()));
+
+        ParallelLexer lexer(sourceCode, m_Options.lexerThreads);
+        unit.tokens = lexer.Tokenize();
+    }
+    else if (m_Options.lazyParsing)
+    {
+        Lexer lexer(in);
+        unit.tokens = lexer.Tokenize();
+    }
+
+    // Skipped bodies are parsed from the unit's tokens later on, so a lazy unit keeps them
+    if (!unit.tokens.empty())
+    {
+        Parser parser(unit.tokens, m_Symbols, m_Options.lazyParsing);
+        unit.program = parser.Parse();
+
+        if (!m_Options.lazyParsing)
+        {
+            std::vector<Token>().swap(unit.tokens);
+        }
+
+        return true;
+    }
+
+    // The parser pulls tokens as it goes and the lexer reads the file in chunks, neither holds the whole unit
+    Lexer lexer(in);
+    Parser parser(lexer, m_Symbols);
+    unit.program = parser.Parse();
+
+    return true;
+}
+
+void Driver::ParseReachableBodies(std::vector<Unit> &units)
+{
+    std::vector<std::vector<std::shared_ptr<AstNode>> *> programs;
+    std::unordered_map<const FunctionDecl *, const Unit *> owners;
+
+    // main runs the program; with -c any function may be called from a unit compiled on its own
+    std::vector<std::string> roots{"main"};
+
+    for (Unit &unit : units)
+    {
+        programs.push_back(&unit.program);
+
+        for (const auto &node : unit.program)
+        {
+            if (node && node->type == NodeType::FunctionDecl)
+            {
+                const auto &functionDecl = static_cast<const FunctionDecl &>(*node);
+                owners.emplace(&functionDecl, &unit);
+
+                if (m_Options.compileOnly)
+                {
+                    roots.push_back(functionDecl.name);
+                }
+            }
+        }
+    }
+
+    Reachability reachability([this, &owners](FunctionDecl &node) {
+        Parser parser(owners.at(&node)->tokens, m_Symbols, true);
+        node.body = parser.ParseLazyBody(node);
+    });
+
+    reachability.Run(programs, roots);
+
+    for (Unit &unit : units)
+    {
+        std::vector<Token>().swap(unit.tokens);
+    }
+}
+
+bool Driver::ImportModules(const std::vector<Unit> &units, ImportTable &importTable)
+{
+    for (const Unit &unit : units)
+    {
+        // 'import name;' refers to name.jmi next to the importing unit
+        llvm::StringRef directory = llvm::sys::path::parent_path(unit.path);
+
+        for (const auto &node : unit.program)
+        {
+            if (!node || node->type != NodeType::ImportDecl)
+            {
+                continue;
+            }
+
+            llvm::SmallString<128> path(directory);
+            llvm::sys::path::append(path, static_cast<const ImportDecl &>(*node).moduleName + ".jmi");
+
+            if (!importTable.Import(path.str().str()))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool Driver::WriteBitcode(const llvm::Module &module, const std::string &path)
+{
+    std::error_code error;
+    llvm::raw_fd_ostream out(path, error, llvm::sys::fs::OF_None);
+
+    if (error)
+    {
+        JLANG_ERROR(STR("Cannot write %s: %s", path.c_str(), error.message().c_str()));
+        return false;
+    }
+
+    llvm::WriteBitcodeToFile(module, out);
+    return true;
+}
+
+std::unique_ptr<llvm::Module> Driver::CopyToContext(const llvm::Module &module)
+{
+    // Modules can only be linked within one context, round-trip the unit through in-memory bitcode
+    llvm::SmallVector<char, 0> buffer;
+    llvm::raw_svector_ostream out(buffer);
+    llvm::WriteBitcodeToFile(module, out);
+
+    llvm::Expected<std::unique_ptr<llvm::Module>> copy = llvm::parseBitcodeFile(
+        llvm::MemoryBufferRef(llvm::StringRef(buffer.data(), buffer.size()), module.getModuleIdentifier()),
+        m_Context);
+
+    if (!copy)
+    {
+        JLANG_ERROR(STR("Cannot load %s: %s", module.getModuleIdentifier().c_str(),
+                        llvm::toString(copy.takeError()).c_str()));
+        return nullptr;
+    }
+
+    return std::move(*copy);
+}
+
+bool Driver::LinkInto(std::unique_ptr<llvm::Module> &program, std::unique_ptr<llvm::Module> module)
+{
+    if (!module)
+    {
+        return false;
+    }
+
+    if (!program)
+    {
+        program = std::move(module);
+        return true;
+    }
+
+    std::string name = module->getModuleIdentifier();
+
+    // Reports duplicate definitions itself and returns true on error
+    if (llvm::Linker::linkModules(*program, std::move(module)))
+    {
+        JLANG_ERROR(STR("Cannot link %s", name.c_str()));
+        return false;
+    }
+
+    return true;
+}
+
+bool Driver::IsBitcodeFile(const std::string &path)
+{
+    return path.size() > 3 && path.compare(path.size() - 3, 3, ".bc") == 0;
+}
+
+std::string Driver::ReplaceExtension(const std::string &sourcePath, const char *extension)
+{
+    llvm::SmallString<128> path(sourcePath);
+    llvm::sys::path::replace_extension(path, extension);
+
+    return path.str().str();
+}
+
+} // namespace jlang
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../AST/Ast.h"
+#include "../Common/CompileOptions.h"
+#include "../Enums/TokenTypes.h"
+#include "../Interface/ImportTable.h"
+#include "../Parser/SymbolInterner.h"
+#include "../Types/Token.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+
+namespace jlang
+{
+
+// Compiles every .j input to its own module, with the structs and functions of the other units visible
+// as declarations. With -c each unit is written as bitcode; otherwise the units and any .bc inputs are
+// linked into one program, which -flto then optimizes as a whole before it is printed or run.
+// -emit-interface writes the declarations of each unit as a .jmi module interface, which other units
+// 'import' instead of parsing the unit itself. -lazy-parse skips function bodies while parsing and only
+// parses and compiles the ones reachable from main.
+class Driver
+{
+  public:
+    explicit Driver(const CompileOptions &options);
+
+    // Returns the exit code of the process
+    int Run();
+
+  private:
+    struct Unit
+    {
+        std::string path;
+        std::vector<std::shared_ptr<AstNode>> program;
+
+        // Kept after parsing only under -lazy-parse, until the reachable bodies are parsed
+        std::vector<Token> tokens;
+    };
+
+    bool ParseUnit(const std::string &path, Unit &unit);
+    void ParseReachableBodies(std::vector<Unit> &units);
+    bool ImportModules(const std::vector<Unit> &units, ImportTable &importTable);
+    bool WriteBitcode(const llvm::Module &module, const std::string &path);
+    std::unique_ptr<llvm::Module> CopyToContext(const llvm::Module &module);
+    bool LinkInto(std::unique_ptr<llvm::Module> &program, std::unique_ptr<llvm::Module> module);
+
+    static bool IsBitcodeFile(const std::string &path);
+    static std::string ReplaceExtension(const std::string &sourcePath, const char *extension);
+
+  private:
+    const CompileOptions &m_Options;
+
+    // The names of every unit, interned by the parsers and bound by id in codegen
+    SymbolInterner m_Symbols;
+
+    // Owns the linked program; every CodeGenerator has a context of its own
+    llvm::LLVMContext m_Context;
+};
+
+} // namespace jlang
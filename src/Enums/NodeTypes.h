@@ -4,19 +4,27 @@ namespace jlang
 {
 enum class NodeType
 {
+    ImportDecl,
     InterfaceDecl,
     StructDecl,
     FunctionDecl,
     VariableDecl,
 
     IfStatement,
+    WhileStatement,
+    ForStatement,
     BlockStatement,
     ExprStatement,
+    ReturnStatement,
 
     CallExpr,
     BinaryExpr,
     VarExpr,
     LiteralExpr,
-    CastExpr
+    CastExpr,
+    MemberExpr,
+    IndexExpr,
+    SizeofExpr,
+    AssignExpr
 };
 } // namespace jlang
\ No newline at end of file
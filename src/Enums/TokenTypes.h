@@ -5,25 +5,44 @@ namespace jlang
 enum class TokenType
 {
     // Keywords
+    Import,
     Interface,
     Struct,
+    Soa,
     Var,
     Void,
     Int32,
+    Int32x4,
+    Int32x8,
     If,
     Else,
+    For,
+    While,
     Return,
+    Sizeof,
+    Null,
+    Spawn,
+    Sync,
+    Async,
+    Await,
+    Atomic,
+    Const,
 
     // Symbols
     LBrace,
     RBrace,
     LParen,
     RParen,
+    LBracket,
+    RBracket,
+    Hash,
     Semicolon,
     Colon,
     Arrow,
     Assign,
     Star,
+    Plus,
+    Minus,
     Comma,
     Dot,
     NotEqual,
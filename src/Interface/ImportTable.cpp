@@ -0,0 +1,114 @@
+#include "ImportTable.h"
+
+namespace jlang
+{
+
+bool ImportTable::Import(const std::string &path)
+{
+    // Several units importing the same module share one mapping
+    if (m_ImportedPaths.count(path))
+    {
+        return true;
+    }
+
+    auto reader = std::make_unique<InterfaceReader>();
+
+    if (!reader->Open(path))
+    {
+        return false;
+    }
+
+    m_ImportedPaths.insert(path);
+    m_Readers.push_back(std::move(reader));
+    return true;
+}
+
+std::shared_ptr<StructDecl> ImportTable::RequireStruct(const std::string &name)
+{
+    auto it = m_Structs.find(name);
+
+    if (it != m_Structs.end())
+    {
+        return it->second;
+    }
+
+    std::shared_ptr<StructDecl> structDecl;
+
+    for (const auto &reader : m_Readers)
+    {
+        if ((structDecl = reader->LoadStruct(name)))
+        {
+            break;
+        }
+    }
+
+    m_Structs.emplace(name, structDecl);
+
+    if (structDecl)
+    {
+        m_Declarations.push_back(structDecl);
+
+        if (!structDecl->interfaceImplemented.empty())
+        {
+            RequireInterface(structDecl->interfaceImplemented);
+        }
+    }
+
+    return structDecl;
+}
+
+std::shared_ptr<FunctionDecl> ImportTable::RequireFunction(const std::string &name)
+{
+    auto it = m_Functions.find(name);
+
+    if (it != m_Functions.end())
+    {
+        return it->second;
+    }
+
+    std::shared_ptr<FunctionDecl> functionDecl;
+
+    for (const auto &reader : m_Readers)
+    {
+        if ((functionDecl = reader->LoadFunction(name)))
+        {
+            break;
+        }
+    }
+
+    m_Functions.emplace(name, functionDecl);
+
+    if (functionDecl)
+    {
+        m_Declarations.push_back(functionDecl);
+    }
+
+    return functionDecl;
+}
+
+void ImportTable::RequireInterface(const std::string &name)
+{
+    if (m_Interfaces.count(name))
+    {
+        return;
+    }
+
+    std::shared_ptr<InterfaceDecl> interfaceDecl;
+
+    for (const auto &reader : m_Readers)
+    {
+        if ((interfaceDecl = reader->LoadInterface(name)))
+        {
+            break;
+        }
+    }
+
+    m_Interfaces.emplace(name, interfaceDecl);
+
+    if (interfaceDecl)
+    {
+        m_Declarations.push_back(interfaceDecl);
+    }
+}
+
+} // namespace jlang
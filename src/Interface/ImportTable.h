@@ -0,0 +1,46 @@
+#pragma once
+
+#include "InterfaceReader.h"
+
+#include "../AST/Ast.h"
+#include "../AST/TopLevelDecl/TopLevelDecl.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace jlang
+{
+
+// The module interfaces named by 'import' declarations. Declarations are materialized the first time
+// TypeResolver asks for a name it can't find in the program, and only those end up in GetDeclarations(),
+// which codegen then sees as one more imported unit.
+class ImportTable
+{
+  public:
+    bool Import(const std::string &path);
+
+    // Each returns nullptr when no imported module declares the name
+    std::shared_ptr<StructDecl> RequireStruct(const std::string &name);
+    std::shared_ptr<FunctionDecl> RequireFunction(const std::string &name);
+
+    const std::vector<std::shared_ptr<AstNode>> &GetDeclarations() const { return m_Declarations; }
+
+  private:
+    void RequireInterface(const std::string &name);
+
+  private:
+    std::vector<std::unique_ptr<InterfaceReader>> m_Readers;
+    std::unordered_set<std::string> m_ImportedPaths;
+
+    // Misses are cached as nullptr too
+    std::unordered_map<std::string, std::shared_ptr<StructDecl>> m_Structs;
+    std::unordered_map<std::string, std::shared_ptr<InterfaceDecl>> m_Interfaces;
+    std::unordered_map<std::string, std::shared_ptr<FunctionDecl>> m_Functions;
+
+    std::vector<std::shared_ptr<AstNode>> m_Declarations;
+};
+
+} // namespace jlang
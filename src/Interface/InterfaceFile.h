@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+
+namespace jlang
+{
+
+// On-disk layout of a .jmi module interface. Every record is a fixed-size run of uint32_t, so the file is
+// used in place once it is mapped: names are offsets into one string table of NUL-terminated, interned
+// strings, and structs and functions are sorted by name for binary search.
+constexpr char InterfaceFileMagic[4] = {'J', 'M', 'I', '\0'};
+constexpr uint32_t InterfaceFileVersion = 4;
+
+struct InterfaceSection
+{
+    uint32_t offset;
+    uint32_t count;
+};
+
+struct InterfaceFileHeader
+{
+    char magic[4];
+    uint32_t version;
+
+    // Size in bytes, not a record count
+    InterfaceSection strings;
+
+    InterfaceSection structs;
+    InterfaceSection fields;
+    InterfaceSection functions;
+    InterfaceSection params;
+    InterfaceSection interfaces;
+    InterfaceSection methods;
+};
+
+struct TypeRecord
+{
+    uint32_t name;
+    uint32_t isPointer;
+    uint32_t isAtomic;
+
+    // 0 unless the type is an array
+    uint32_t arrayLength;
+    uint32_t isSlice;
+};
+
+// Used for struct fields and function parameters
+struct FieldRecord
+{
+    uint32_t name;
+    TypeRecord type;
+};
+
+struct StructRecord
+{
+    uint32_t name;
+    uint32_t interfaceImplemented;
+    uint32_t isSoa;
+    uint32_t firstField;
+    uint32_t fieldCount;
+};
+
+struct FunctionRecord
+{
+    uint32_t name;
+    TypeRecord returnType;
+    uint32_t firstParam;
+    uint32_t paramCount;
+
+    // Callers of an async function get a coroutine handle back instead of its return value
+    uint32_t isAsync;
+};
+
+// Methods are string offsets in the methods section
+struct InterfaceRecord
+{
+    uint32_t name;
+    uint32_t firstMethod;
+    uint32_t methodCount;
+};
+
+} // namespace jlang
@@ -0,0 +1,208 @@
+#include "InterfaceReader.h"
+
+#include "../Common/Logger.h"
+
+#include <cstring>
+
+namespace jlang
+{
+
+bool InterfaceReader::Open(const std::string &path)
+{
+    m_Path = path;
+
+    // Not volatile and no terminator needed, so the file is mapped rather than read once it is large enough
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+        llvm::MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+
+    if (!buffer)
+    {
+        JLANG_ERROR(STR("Cannot open module interface %s: %s", path.c_str(), buffer.getError().message().c_str()));
+        return false;
+    }
+
+    m_Buffer = std::move(*buffer);
+
+    if (m_Buffer->getBufferSize() < sizeof(InterfaceFileHeader))
+    {
+        JLANG_ERROR(STR("Not a module interface: %s", path.c_str()));
+        return false;
+    }
+
+    m_Header = reinterpret_cast<const InterfaceFileHeader *>(m_Buffer->getBufferStart());
+
+    if (std::memcmp(m_Header->magic, InterfaceFileMagic, sizeof(m_Header->magic)) != 0 ||
+        m_Header->version != InterfaceFileVersion)
+    {
+        JLANG_ERROR(STR("Not a module interface or written by another version: %s", path.c_str()));
+        m_Header = nullptr;
+        return false;
+    }
+
+    // Every later lookup trusts these bounds
+    bool isValid = IsValidSection(m_Header->strings, 1) && m_Header->strings.count != 0 &&
+                   m_Buffer->getBufferStart()[m_Header->strings.offset + m_Header->strings.count - 1] == '\0' &&
+                   IsValidSection(m_Header->structs, sizeof(StructRecord)) &&
+                   IsValidSection(m_Header->fields, sizeof(FieldRecord)) &&
+                   IsValidSection(m_Header->functions, sizeof(FunctionRecord)) &&
+                   IsValidSection(m_Header->params, sizeof(FieldRecord)) &&
+                   IsValidSection(m_Header->interfaces, sizeof(InterfaceRecord)) &&
+                   IsValidSection(m_Header->methods, sizeof(uint32_t));
+
+    if (!isValid)
+    {
+        JLANG_ERROR(STR("Corrupt module interface: %s", path.c_str()));
+        m_Header = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+std::shared_ptr<StructDecl> InterfaceReader::LoadStruct(const std::string &name) const
+{
+    const StructRecord *record = FindRecord<StructRecord>(m_Header ? m_Header->structs : InterfaceSection{}, name);
+
+    if (!record || record->firstField > m_Header->fields.count ||
+        record->fieldCount > m_Header->fields.count - record->firstField)
+    {
+        return nullptr;
+    }
+
+    auto structDecl = std::make_shared<StructDecl>();
+    structDecl->name = name;
+    structDecl->interfaceImplemented = GetString(record->interfaceImplemented);
+    structDecl->isSoa = record->isSoa != 0;
+
+    const FieldRecord *fields = GetRecords<FieldRecord>(m_Header->fields) + record->firstField;
+
+    for (uint32_t i = 0; i < record->fieldCount; ++i)
+    {
+        structDecl->fields.push_back(StructField{GetString(fields[i].name), MakeTypeRef(fields[i].type)});
+    }
+
+    return structDecl;
+}
+
+std::shared_ptr<InterfaceDecl> InterfaceReader::LoadInterface(const std::string &name) const
+{
+    const InterfaceRecord *record =
+        FindRecord<InterfaceRecord>(m_Header ? m_Header->interfaces : InterfaceSection{}, name);
+
+    if (!record || record->firstMethod > m_Header->methods.count ||
+        record->methodCount > m_Header->methods.count - record->firstMethod)
+    {
+        return nullptr;
+    }
+
+    auto interfaceDecl = std::make_shared<InterfaceDecl>();
+    interfaceDecl->name = name;
+
+    const uint32_t *methods = GetRecords<uint32_t>(m_Header->methods) + record->firstMethod;
+
+    for (uint32_t i = 0; i < record->methodCount; ++i)
+    {
+        interfaceDecl->methods.push_back(GetString(methods[i]));
+    }
+
+    return interfaceDecl;
+}
+
+std::shared_ptr<FunctionDecl> InterfaceReader::LoadFunction(const std::string &name) const
+{
+    const FunctionRecord *record =
+        FindRecord<FunctionRecord>(m_Header ? m_Header->functions : InterfaceSection{}, name);
+
+    if (!record || record->firstParam > m_Header->params.count ||
+        record->paramCount > m_Header->params.count - record->firstParam)
+    {
+        return nullptr;
+    }
+
+    // Only the prototype, the body stays in the unit that defines it
+    auto functionDecl = std::make_shared<FunctionDecl>();
+    functionDecl->name = name;
+    functionDecl->returnType = MakeTypeRef(record->returnType);
+    functionDecl->isAsync = record->isAsync != 0;
+
+    const FieldRecord *params = GetRecords<FieldRecord>(m_Header->params) + record->firstParam;
+
+    for (uint32_t i = 0; i < record->paramCount; ++i)
+    {
+        functionDecl->params.push_back(Parameter{GetString(params[i].name), MakeTypeRef(params[i].type)});
+    }
+
+    return functionDecl;
+}
+
+bool InterfaceReader::IsValidSection(const InterfaceSection &section, size_t recordSize) const
+{
+    uint64_t end = static_cast<uint64_t>(section.offset) + static_cast<uint64_t>(section.count) * recordSize;
+    return section.offset % alignof(uint32_t) == 0 && end <= m_Buffer->getBufferSize();
+}
+
+template <typename Record> const Record *InterfaceReader::GetRecords(const InterfaceSection &section) const
+{
+    return reinterpret_cast<const Record *>(m_Buffer->getBufferStart() + section.offset);
+}
+
+template <typename Record>
+const Record *InterfaceReader::FindRecord(const InterfaceSection &section, const std::string &name) const
+{
+    if (section.count == 0)
+    {
+        return nullptr;
+    }
+
+    // Records are sorted by name, only the probed names are touched
+    const Record *records = GetRecords<Record>(section);
+    uint32_t low = 0;
+    uint32_t high = section.count;
+
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        int order = std::strcmp(GetString(records[middle].name), name.c_str());
+
+        if (order == 0)
+        {
+            return &records[middle];
+        }
+
+        if (order < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return nullptr;
+}
+
+const char *InterfaceReader::GetString(uint32_t offset) const
+{
+    // The table ends with a NUL, so any offset inside it yields a terminated string
+    if (offset >= m_Header->strings.count)
+    {
+        return "";
+    }
+
+    return m_Buffer->getBufferStart() + m_Header->strings.offset + offset;
+}
+
+TypeRef InterfaceReader::MakeTypeRef(const TypeRecord &record) const
+{
+    TypeRef typeRef;
+    typeRef.name = GetString(record.name);
+    typeRef.isPointer = record.isPointer != 0;
+    typeRef.isAtomic = record.isAtomic != 0;
+    typeRef.arrayLength = record.arrayLength;
+    typeRef.isSlice = record.isSlice != 0;
+
+    return typeRef;
+}
+
+} // namespace jlang
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "InterfaceFile.h"
+
+#include "../AST/Ast.h"
+#include "../AST/TopLevelDecl/TopLevelDecl.h"
+
+#include <memory>
+#include <string>
+
+#include <llvm/Support/MemoryBuffer.h>
+
+namespace jlang
+{
+
+// Maps a .jmi module interface and materializes single declarations from it on request. Nothing is read
+// up front beyond the header, so a large interface costs only the pages the lookups touch.
+class InterfaceReader
+{
+  public:
+    bool Open(const std::string &path);
+
+    std::shared_ptr<StructDecl> LoadStruct(const std::string &name) const;
+    std::shared_ptr<InterfaceDecl> LoadInterface(const std::string &name) const;
+    std::shared_ptr<FunctionDecl> LoadFunction(const std::string &name) const;
+
+  private:
+    bool IsValidSection(const InterfaceSection &section, size_t recordSize) const;
+
+    template <typename Record> const Record *GetRecords(const InterfaceSection &section) const;
+    template <typename Record> const Record *FindRecord(const InterfaceSection &section,
+                                                        const std::string &name) const;
+
+    const char *GetString(uint32_t offset) const;
+    TypeRef MakeTypeRef(const TypeRecord &record) const;
+
+  private:
+    std::string m_Path;
+    std::unique_ptr<llvm::MemoryBuffer> m_Buffer;
+    const InterfaceFileHeader *m_Header = nullptr;
+};
+
+} // namespace jlang
@@ -0,0 +1,167 @@
+#include "InterfaceWriter.h"
+
+#include "../Common/Logger.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace jlang
+{
+
+bool InterfaceWriter::Write(const std::vector<std::shared_ptr<AstNode>> &program, const std::string &path)
+{
+    std::vector<const StructDecl *> structDecls;
+    std::vector<const FunctionDecl *> functionDecls;
+    std::vector<const InterfaceDecl *> interfaceDecls;
+
+    for (const auto &node : program)
+    {
+        if (!node)
+        {
+            continue;
+        }
+
+        switch (node->type)
+        {
+        case NodeType::StructDecl:
+            structDecls.push_back(static_cast<const StructDecl *>(node.get()));
+            break;
+        case NodeType::FunctionDecl:
+            functionDecls.push_back(static_cast<const FunctionDecl *>(node.get()));
+            break;
+        case NodeType::InterfaceDecl:
+            interfaceDecls.push_back(static_cast<const InterfaceDecl *>(node.get()));
+            break;
+        default:
+            break;
+        }
+    }
+
+    auto byName = [](const auto *lhs, const auto *rhs) { return lhs->name < rhs->name; };
+    std::stable_sort(structDecls.begin(), structDecls.end(), byName);
+    std::stable_sort(functionDecls.begin(), functionDecls.end(), byName);
+    std::stable_sort(interfaceDecls.begin(), interfaceDecls.end(), byName);
+
+    m_Strings.clear();
+    m_InternedStrings.clear();
+    Intern("");
+
+    std::vector<StructRecord> structs;
+    std::vector<FieldRecord> fields;
+
+    for (const StructDecl *structDecl : structDecls)
+    {
+        StructRecord record{Intern(structDecl->name), Intern(structDecl->interfaceImplemented),
+                            structDecl->isSoa ? 1u : 0u, static_cast<uint32_t>(fields.size()),
+                            static_cast<uint32_t>(structDecl->fields.size())};
+        structs.push_back(record);
+
+        for (const StructField &field : structDecl->fields)
+        {
+            fields.push_back(FieldRecord{Intern(field.name), MakeTypeRecord(field.type)});
+        }
+    }
+
+    std::vector<FunctionRecord> functions;
+    std::vector<FieldRecord> params;
+
+    for (const FunctionDecl *functionDecl : functionDecls)
+    {
+        FunctionRecord record{Intern(functionDecl->name), MakeTypeRecord(functionDecl->returnType),
+                              static_cast<uint32_t>(params.size()),
+                              static_cast<uint32_t>(functionDecl->params.size()),
+                              functionDecl->isAsync ? 1u : 0u};
+        functions.push_back(record);
+
+        for (const Parameter &param : functionDecl->params)
+        {
+            params.push_back(FieldRecord{Intern(param.name), MakeTypeRecord(param.type)});
+        }
+    }
+
+    std::vector<InterfaceRecord> interfaces;
+    std::vector<uint32_t> methods;
+
+    for (const InterfaceDecl *interfaceDecl : interfaceDecls)
+    {
+        interfaces.push_back(InterfaceRecord{Intern(interfaceDecl->name), static_cast<uint32_t>(methods.size()),
+                                             static_cast<uint32_t>(interfaceDecl->methods.size())});
+
+        for (const std::string &method : interfaceDecl->methods)
+        {
+            methods.push_back(Intern(method));
+        }
+    }
+
+    // Records first, the string table last; keep it 4-byte aligned so the records stay aligned when mapped
+    InterfaceFileHeader header{};
+    std::memcpy(header.magic, InterfaceFileMagic, sizeof(header.magic));
+    header.version = InterfaceFileVersion;
+
+    uint32_t offset = sizeof(InterfaceFileHeader);
+    auto place = [&offset](InterfaceSection &section, size_t count, size_t recordSize) {
+        section.offset = offset;
+        section.count = static_cast<uint32_t>(count);
+        offset += static_cast<uint32_t>(count * recordSize);
+    };
+
+    place(header.structs, structs.size(), sizeof(StructRecord));
+    place(header.fields, fields.size(), sizeof(FieldRecord));
+    place(header.functions, functions.size(), sizeof(FunctionRecord));
+    place(header.params, params.size(), sizeof(FieldRecord));
+    place(header.interfaces, interfaces.size(), sizeof(InterfaceRecord));
+    place(header.methods, methods.size(), sizeof(uint32_t));
+
+    m_Strings.resize((m_Strings.size() + 3) / 4 * 4, '\0');
+    place(header.strings, m_Strings.size(), 1);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+
+    if (!out.is_open())
+    {
+        JLANG_ERROR(STR("Cannot write module interface: %s", path.c_str()));
+        return false;
+    }
+
+    auto writeAll = [&out](const auto &records) {
+        out.write(reinterpret_cast<const char *>(records.data()),
+                  static_cast<std::streamsize>(records.size() * sizeof(records[0])));
+    };
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    writeAll(structs);
+    writeAll(fields);
+    writeAll(functions);
+    writeAll(params);
+    writeAll(interfaces);
+    writeAll(methods);
+    out.write(m_Strings.data(), static_cast<std::streamsize>(m_Strings.size()));
+
+    return static_cast<bool>(out);
+}
+
+uint32_t InterfaceWriter::Intern(const std::string &text)
+{
+    auto it = m_InternedStrings.find(text);
+
+    if (it != m_InternedStrings.end())
+    {
+        return it->second;
+    }
+
+    auto offset = static_cast<uint32_t>(m_Strings.size());
+    m_Strings.append(text);
+    m_Strings.push_back('\0');
+
+    m_InternedStrings.emplace(text, offset);
+    return offset;
+}
+
+TypeRecord InterfaceWriter::MakeTypeRecord(const TypeRef &typeRef)
+{
+    return TypeRecord{Intern(typeRef.name), typeRef.isPointer ? 1u : 0u, typeRef.isAtomic ? 1u : 0u,
+                      typeRef.arrayLength, typeRef.isSlice ? 1u : 0u};
+}
+
+} // namespace jlang
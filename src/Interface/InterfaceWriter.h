@@ -0,0 +1,31 @@
+#pragma once
+
+#include "InterfaceFile.h"
+
+#include "../AST/Ast.h"
+#include "../AST/TopLevelDecl/TopLevelDecl.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace jlang
+{
+
+// Writes the structs, interfaces and function signatures of a unit as a .jmi module interface
+class InterfaceWriter
+{
+  public:
+    bool Write(const std::vector<std::shared_ptr<AstNode>> &program, const std::string &path);
+
+  private:
+    uint32_t Intern(const std::string &text);
+    TypeRecord MakeTypeRecord(const TypeRef &typeRef);
+
+  private:
+    std::string m_Strings;
+    std::unordered_map<std::string, uint32_t> m_InternedStrings;
+};
+
+} // namespace jlang
@@ -0,0 +1,19 @@
+#include "HeapProfileListener.h"
+
+#include "LoadedFunctions.h"
+#include "Runtime.h"
+
+#include <string>
+
+namespace jlang
+{
+
+void HeapProfileListener::notifyObjectLoaded(ObjectKey, const llvm::object::ObjectFile &object,
+                                             const llvm::RuntimeDyld::LoadedObjectInfo &info)
+{
+    ForEachLoadedFunction(object, info, [](llvm::StringRef name, uint64_t address, uint64_t size) {
+        jheap_register_code(address, size, name.str().c_str());
+    });
+}
+
+} // namespace jlang
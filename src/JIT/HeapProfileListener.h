@@ -0,0 +1,17 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/JITEventListener.h>
+
+namespace jlang
+{
+
+// Hands the address range and name of every function the JIT loads to the runtime's heap profiler, which
+// can't find JIT code with dladdr when it names the frames of a sampled allocation
+class HeapProfileListener : public llvm::JITEventListener
+{
+  public:
+    void notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile &object,
+                            const llvm::RuntimeDyld::LoadedObjectInfo &info) override;
+};
+
+} // namespace jlang
@@ -0,0 +1,118 @@
+#include "JitRunner.h"
+
+#include "../Common/Logger.h"
+
+#include "HeapProfileListener.h"
+#include "PerfMapListener.h"
+#include "Runtime.h"
+
+#include <memory>
+#include <string>
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/JITEventListener.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+namespace jlang
+{
+
+JitRunner::JitRunner(bool registerObjects, bool registerHeapProfileCode)
+    : m_RegisterObjects(registerObjects), m_RegisterHeapProfileCode(registerHeapProfileCode)
+{
+}
+
+int JitRunner::Run(const llvm::Module &module)
+{
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    llvm::sys::DynamicLibrary::AddSymbol("jalloc", reinterpret_cast<void *>(&jalloc));
+    llvm::sys::DynamicLibrary::AddSymbol("jfree", reinterpret_cast<void *>(&jfree));
+    llvm::sys::DynamicLibrary::AddSymbol("jout", reinterpret_cast<void *>(&jout));
+    llvm::sys::DynamicLibrary::AddSymbol("jbounds_fail", reinterpret_cast<void *>(&jbounds_fail));
+    llvm::sys::DynamicLibrary::AddSymbol("jstr_compare", reinterpret_cast<void *>(&jstr_compare));
+    llvm::sys::DynamicLibrary::AddSymbol("jarena_new", reinterpret_cast<void *>(&jarena_new));
+    llvm::sys::DynamicLibrary::AddSymbol("jarena_alloc", reinterpret_cast<void *>(&jarena_alloc));
+    llvm::sys::DynamicLibrary::AddSymbol("jarena_reset", reinterpret_cast<void *>(&jarena_reset));
+    llvm::sys::DynamicLibrary::AddSymbol("jarena_free", reinterpret_cast<void *>(&jarena_free));
+    llvm::sys::DynamicLibrary::AddSymbol("jtask_spawn", reinterpret_cast<void *>(&jtask_spawn));
+    llvm::sys::DynamicLibrary::AddSymbol("jtask_sync", reinterpret_cast<void *>(&jtask_sync));
+    llvm::sys::DynamicLibrary::AddSymbol("jtask_parallel_for", reinterpret_cast<void *>(&jtask_parallel_for));
+    llvm::sys::DynamicLibrary::AddSymbol("jco_schedule", reinterpret_cast<void *>(&jco_schedule));
+    llvm::sys::DynamicLibrary::AddSymbol("jio_park", reinterpret_cast<void *>(&jio_park));
+    llvm::sys::DynamicLibrary::AddSymbol("jloop_run", reinterpret_cast<void *>(&jloop_run));
+    llvm::sys::DynamicLibrary::AddSymbol("jio_read", reinterpret_cast<void *>(&jio_read));
+    llvm::sys::DynamicLibrary::AddSymbol("jio_write", reinterpret_cast<void *>(&jio_write));
+    llvm::sys::DynamicLibrary::AddSymbol("jio_accept", reinterpret_cast<void *>(&jio_accept));
+    llvm::sys::DynamicLibrary::AddSymbol("jlisten", reinterpret_cast<void *>(&jlisten));
+    llvm::sys::DynamicLibrary::AddSymbol("jopen", reinterpret_cast<void *>(&jopen));
+    llvm::sys::DynamicLibrary::AddSymbol("jclose", reinterpret_cast<void *>(&jclose));
+    llvm::sys::DynamicLibrary::AddSymbol("jprof_init", reinterpret_cast<void *>(&jprof_init));
+    llvm::sys::DynamicLibrary::AddSymbol("jprof_register", reinterpret_cast<void *>(&jprof_register));
+    llvm::sys::DynamicLibrary::AddSymbol("jprof_write", reinterpret_cast<void *>(&jprof_write));
+    llvm::sys::DynamicLibrary::AddSymbol("jheap_start", reinterpret_cast<void *>(&jheap_start));
+    llvm::sys::DynamicLibrary::AddSymbol("jheap_stop", reinterpret_cast<void *>(&jheap_stop));
+
+    const llvm::Function *mainFunction = module.getFunction("main");
+
+    if (!mainFunction || mainFunction->arg_size() != 0)
+    {
+        JLANG_ERROR("Nothing to run: expected 'int32 main()' or 'void main()'");
+        return 1;
+    }
+
+    bool isVoidMain = mainFunction->getReturnType()->isVoidTy();
+
+    // The engine notifies its listeners again when it is destroyed, so these have to outlive it
+    PerfMapListener perfMapListener;
+    HeapProfileListener heapProfileListener;
+
+    // The engine takes ownership, keep the caller's module for printing
+    std::string error;
+    std::unique_ptr<llvm::ExecutionEngine> engine(llvm::EngineBuilder(llvm::CloneModule(module))
+                                                      .setEngineKind(llvm::EngineKind::JIT)
+                                                      .setErrorStr(&error)
+                                                      .create());
+
+    if (!engine)
+    {
+        JLANG_ERROR(STR("Cannot create JIT: %s", error.c_str()));
+        return 1;
+    }
+
+    // Listeners see each object as it is loaded, so they have to be in place before code is emitted
+    if (m_RegisterObjects)
+    {
+        engine->RegisterJITEventListener(llvm::JITEventListener::createGDBRegistrationListener());
+        engine->RegisterJITEventListener(&perfMapListener);
+    }
+
+    if (m_RegisterHeapProfileCode)
+    {
+        engine->RegisterJITEventListener(&heapProfileListener);
+    }
+
+    engine->finalizeObject();
+    engine->runStaticConstructorsDestructors(false);
+
+    uint64_t mainAddress = engine->getFunctionAddress("main");
+    int exitCode = 0;
+
+    if (isVoidMain)
+    {
+        reinterpret_cast<void (*)()>(mainAddress)();
+    }
+    else
+    {
+        exitCode = reinterpret_cast<int32_t (*)()>(mainAddress)();
+    }
+
+    engine->runStaticConstructorsDestructors(true);
+
+    return exitCode;
+}
+
+} // namespace jlang
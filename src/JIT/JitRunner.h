@@ -0,0 +1,27 @@
+#pragma once
+
+#include <llvm/IR/Module.h>
+
+namespace jlang
+{
+
+// Executes a generated module in this process with MCJIT, resolving its runtime calls to the runtime
+// linked into the compiler. Module constructors run before main and destructors after it, as they would
+// around a native program.
+class JitRunner
+{
+  public:
+    // With registerObjects the emitted code is announced to gdb through its JIT interface and listed in
+    // /tmp/perf-<pid>.map, so debuggers and profilers can name the functions. With registerHeapProfileCode
+    // the runtime's heap profiler learns them.
+    explicit JitRunner(bool registerObjects = false, bool registerHeapProfileCode = false);
+
+    // Returns main's exit code
+    int Run(const llvm::Module &module);
+
+  private:
+    bool m_RegisterObjects;
+    bool m_RegisterHeapProfileCode;
+};
+
+} // namespace jlang
@@ -0,0 +1,38 @@
+#include "LoadedFunctions.h"
+
+#include <llvm/Object/SymbolSize.h>
+
+namespace jlang
+{
+
+void ForEachLoadedFunction(const llvm::object::ObjectFile &object,
+                           const llvm::RuntimeDyld::LoadedObjectInfo &info,
+                           const std::function<void(llvm::StringRef, uint64_t, uint64_t)> &visit)
+{
+    // The debug object has its symbols relocated to the addresses the code was loaded at
+    llvm::object::OwningBinary<llvm::object::ObjectFile> debugObject = info.getObjectForDebug(object);
+
+    if (!debugObject.getBinary())
+    {
+        return;
+    }
+
+    for (const auto &[symbol, size] : llvm::object::computeSymbolSizes(*debugObject.getBinary()))
+    {
+        llvm::Expected<llvm::object::SymbolRef::Type> type = symbol.getType();
+        llvm::Expected<llvm::StringRef> name = symbol.getName();
+        llvm::Expected<uint64_t> address = symbol.getAddress();
+
+        if (!type || !name || !address || *type != llvm::object::SymbolRef::ST_Function)
+        {
+            llvm::consumeError(type.takeError());
+            llvm::consumeError(name.takeError());
+            llvm::consumeError(address.takeError());
+            continue;
+        }
+
+        visit(*name, *address, size);
+    }
+}
+
+} // namespace jlang
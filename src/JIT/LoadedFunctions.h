@@ -0,0 +1,17 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/RuntimeDyld.h>
+#include <llvm/Object/ObjectFile.h>
+
+#include <cstdint>
+#include <functional>
+
+namespace jlang
+{
+
+// Calls visit with the name, load address and size of every function in an object the JIT loaded
+void ForEachLoadedFunction(const llvm::object::ObjectFile &object,
+                           const llvm::RuntimeDyld::LoadedObjectInfo &info,
+                           const std::function<void(llvm::StringRef, uint64_t, uint64_t)> &visit);
+
+} // namespace jlang
@@ -0,0 +1,46 @@
+#include "PerfMapListener.h"
+
+#include "../Common/Logger.h"
+
+#include "LoadedFunctions.h"
+
+#include <string>
+
+#include <llvm/Support/Process.h>
+
+namespace jlang
+{
+
+PerfMapListener::~PerfMapListener()
+{
+    if (m_File)
+    {
+        std::fclose(m_File);
+    }
+}
+
+void PerfMapListener::notifyObjectLoaded(ObjectKey, const llvm::object::ObjectFile &object,
+                                         const llvm::RuntimeDyld::LoadedObjectInfo &info)
+{
+    if (!m_File)
+    {
+        std::string path = "/tmp/perf-" + std::to_string(llvm::sys::Process::getProcessId()) + ".map";
+        m_File = std::fopen(path.c_str(), "a");
+
+        if (!m_File)
+        {
+            JLANG_ERROR(STR("Cannot open %s", path.c_str()));
+            return;
+        }
+    }
+
+    ForEachLoadedFunction(object, info, [this](llvm::StringRef name, uint64_t address, uint64_t size) {
+        std::fprintf(m_File, "%llx %llx %s\n", static_cast<unsigned long long>(address),
+                     static_cast<unsigned long long>(size), name.str().c_str());
+    });
+
+    // perf may read the map while the program is still running
+    std::fflush(m_File);
+}
+
+} // namespace jlang
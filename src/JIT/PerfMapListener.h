@@ -0,0 +1,27 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/JITEventListener.h>
+
+#include <cstdio>
+
+namespace jlang
+{
+
+// Appends "<start> <size> <name>" for every function of a loaded object to /tmp/perf-<pid>.map, the file
+// perf reads to symbolize addresses that belong to no mapped binary.
+class PerfMapListener : public llvm::JITEventListener
+{
+  public:
+    PerfMapListener() = default;
+    PerfMapListener(const PerfMapListener &) = delete;
+    PerfMapListener &operator=(const PerfMapListener &) = delete;
+    ~PerfMapListener() override;
+
+    void notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile &object,
+                            const llvm::RuntimeDyld::LoadedObjectInfo &info) override;
+
+  private:
+    FILE *m_File = nullptr;
+};
+
+} // namespace jlang
@@ -1,5 +1,6 @@
 #include "../Lexer/Lexer.h"
 
+#include <algorithm>
 #include <cctype>
 #include <unordered_map>
 
@@ -7,22 +8,56 @@ namespace jlang
 {
 
 static std::unordered_map<std::string, TokenType> s_Keywords = {
-    {"interface", TokenType::Interface}, {"struct", TokenType::Struct}, {"void", TokenType::Void},
-    {"int32", TokenType::Int32},         {"var", TokenType::Var},       {"if", TokenType::If},
-    {"else", TokenType::Else},           {"return", TokenType::Return}};
+    {"interface", TokenType::Interface}, {"struct", TokenType::Struct}, {"soa", TokenType::Soa},
+    {"void", TokenType::Void},           {"int32", TokenType::Int32},   {"var", TokenType::Var},
+    {"if", TokenType::If},               {"else", TokenType::Else},     {"return", TokenType::Return},
+    {"sizeof", TokenType::Sizeof},       {"NULL", TokenType::Null},     {"import", TokenType::Import},
+    {"for", TokenType::For},             {"while", TokenType::While},   {"int32x4", TokenType::Int32x4},
+    {"int32x8", TokenType::Int32x8},     {"spawn", TokenType::Spawn},   {"sync", TokenType::Sync},
+    {"async", TokenType::Async},         {"await", TokenType::Await},   {"atomic", TokenType::Atomic},
+    {"const", TokenType::Const}};
 
 Lexer::Lexer(const std::string &source) : m_Source(source) {}
 
+Lexer::Lexer(const std::string &source, size_t begin, size_t end)
+    : m_Source(source), m_Start(begin), m_CurrentPosition(begin), m_End(end)
+{
+    // The range may start in the middle of a line, columns still count from the real start of that line
+    size_t previousNewline = begin == 0 ? std::string::npos : source.rfind('\n', begin - 1);
+    m_LineStart = previousNewline == std::string::npos ? 0 : previousNewline + 1;
+}
+
+Lexer::Lexer(std::istream &input) : m_Input(&input), m_Source(m_Buffer) {}
+
 std::vector<Token> Lexer::Tokenize()
 {
-    while (!IsEndReached())
+    std::vector<Token> tokens;
+
+    do
+    {
+        tokens.push_back(NextToken());
+    } while (tokens.back().m_type != TokenType::EndOfFile);
+
+    return tokens;
+}
+
+Token Lexer::NextToken()
+{
+    m_Tokens.clear();
+
+    // Whitespace and an unterminated string literal scan without producing a token
+    while (m_Tokens.empty() && !IsEndReached())
     {
         m_Start = m_CurrentPosition;
         ScanToken();
     }
 
-    m_Tokens.emplace_back(TokenType::EndOfFile, "", m_CurrentLine);
-    return m_Tokens;
+    if (m_Tokens.empty())
+    {
+        return Token(TokenType::EndOfFile, "", m_CurrentLine);
+    }
+
+    return std::move(m_Tokens.back());
 }
 
 void Lexer::ScanToken()
@@ -34,6 +69,8 @@ void Lexer::ScanToken()
         return;
     }
 
+    m_Start = m_CurrentPosition;
+    m_StartColumn = static_cast<uint32_t>(m_Discarded + m_Start - m_LineStart + 1);
     char c = Advance();
 
     switch (c)
@@ -50,6 +87,15 @@ void Lexer::ScanToken()
     case ')':
         AddToken(TokenType::RParen);
         break;
+    case '[':
+        AddToken(TokenType::LBracket);
+        break;
+    case ']':
+        AddToken(TokenType::RBracket);
+        break;
+    case '#':
+        AddToken(TokenType::Hash);
+        break;
     case ';':
         AddToken(TokenType::Semicolon);
         break;
@@ -62,6 +108,9 @@ void Lexer::ScanToken()
     case '*':
         AddToken(TokenType::Star);
         break;
+    case '+':
+        AddToken(TokenType::Plus);
+        break;
     case '=':
         AddToken(IsMatched('=') ? TokenType::EqualEqual : TokenType::Equal);
         break;
@@ -81,7 +130,7 @@ void Lexer::ScanToken()
         }
         else
         {
-            AddToken(TokenType::Unknown);
+            AddToken(TokenType::Minus);
         }
         break;
     case '"':
@@ -117,6 +166,7 @@ void Lexer::SkipWhitespace()
         {
             m_CurrentLine++;
             Advance();
+            m_LineStart = m_Discarded + m_CurrentPosition;
         }
         else
         {
@@ -130,14 +180,14 @@ char Lexer::Advance()
     return m_Source[m_CurrentPosition++];
 }
 
-char Lexer::Peek() const
+char Lexer::Peek()
 {
     return IsEndReached() ? '\0' : m_Source[m_CurrentPosition];
 }
 
-char Lexer::PeekNext() const
+char Lexer::PeekNext()
 {
-    return (m_CurrentPosition + 1 >= m_Source.length()) ? '\0' : m_Source[m_CurrentPosition + 1];
+    return IsAvailable(1) ? m_Source[m_CurrentPosition + 1] : '\0';
 }
 
 bool Lexer::IsMatched(char expected)
@@ -151,9 +201,40 @@ bool Lexer::IsMatched(char expected)
     return true;
 }
 
-bool Lexer::IsEndReached() const
+bool Lexer::IsEndReached()
 {
-    return m_CurrentPosition >= m_Source.length();
+    return !IsAvailable(0);
+}
+
+bool Lexer::IsAvailable(size_t offset)
+{
+    while (m_CurrentPosition + offset >= std::min(m_End, m_Source.length()))
+    {
+        if (!m_Input || !ReadChunk())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Lexer::ReadChunk()
+{
+    // Everything before the token being scanned is done with
+    m_Discarded += m_Start;
+    m_Buffer.erase(0, m_Start);
+    m_CurrentPosition -= m_Start;
+    m_Start = 0;
+
+    size_t size = m_Buffer.size();
+    m_Buffer.resize(size + ChunkSize);
+    m_Input->read(&m_Buffer[size], ChunkSize);
+
+    auto count = static_cast<size_t>(m_Input->gcount());
+    m_Buffer.resize(size + count);
+
+    return count != 0;
 }
 
 void Lexer::AddToken(TokenType type)
@@ -163,7 +244,7 @@ void Lexer::AddToken(TokenType type)
 
 void Lexer::AddToken(TokenType type, const std::string &lexeme)
 {
-    m_Tokens.emplace_back(type, lexeme, m_CurrentLine);
+    m_Tokens.emplace_back(type, lexeme, m_CurrentLine, m_StartColumn);
 }
 
 void Lexer::AddIdentifier()
@@ -193,12 +274,14 @@ void Lexer::AddStringLiteral()
 {
     while (Peek() != '"' && !IsEndReached())
     {
-        if (Peek() == '\n')
+        bool isNewline = Peek() == '\n';
+        Advance();
+
+        if (isNewline)
         {
             m_CurrentLine++;
+            m_LineStart = m_Discarded + m_CurrentPosition;
         }
-
-        Advance();
     }
 
     if (IsEndReached())
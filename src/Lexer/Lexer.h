@@ -4,6 +4,7 @@
 #include "../Parser/Parser.h"
 #include "../Types/Token.h"
 
+#include <istream>
 #include <string>
 #include <vector>
 
@@ -14,17 +15,34 @@ class Lexer
 {
   public:
     explicit Lexer(const std::string &source);
+
+    // Scans only source[begin, end); line numbers start over at 1, columns are those of the whole source
+    Lexer(const std::string &source, size_t begin, size_t end);
+
+    // Reads the source in ChunkSize pieces as scanning reaches them; besides the current chunk only the
+    // token being scanned is kept, so memory stays flat however large the input is
+    explicit Lexer(std::istream &input);
+
     std::vector<Token> Tokenize();
 
+    // One token per call, EndOfFile from then on once the source is exhausted
+    Token NextToken();
+
   private:
+    static constexpr size_t ChunkSize = 64 * 1024;
+
     void ScanToken();
     char Advance();
 
-    char Peek() const;
-    char PeekNext() const;
+    char Peek();
+    char PeekNext();
 
     bool IsMatched(char expected);
-    bool IsEndReached() const;
+    bool IsEndReached();
+
+    // Whether the character offset positions ahead is in the buffer, reading more of the input if needed
+    bool IsAvailable(size_t offset);
+    bool ReadChunk();
 
     void AddToken(TokenType type);
     void AddToken(TokenType type, const std::string &lexeme);
@@ -40,12 +58,23 @@ class Lexer
   private:
     std::vector<Token> m_Tokens;
 
+    std::istream *m_Input = nullptr;
+    std::string m_Buffer;
+
+    // The caller's source, or m_Buffer when streaming
     const std::string &m_Source;
 
     size_t m_Start = 0;
     size_t m_CurrentPosition = 0;
+    size_t m_End = std::string::npos;
 
     uint32_t m_CurrentLine = 1;
+
+    // Columns count from the start of the line. Offsets are absolute in the input: streaming drops the
+    // bytes in front of m_Start, m_Discarded counts how many.
+    uint64_t m_Discarded = 0;
+    uint64_t m_LineStart = 0;
+    uint32_t m_StartColumn = 0;
 };
 
 } // namespace jlang
@@ -0,0 +1,154 @@
+#include "ParallelLexer.h"
+
+#include "Lexer.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+namespace jlang
+{
+
+ParallelLexer::ParallelLexer(const std::string &source, unsigned threadCount, size_t minChunkSize)
+    : m_Source(source), m_ThreadCount(std::max(threadCount, 1u)),
+      m_MinChunkSize(std::max<size_t>(minChunkSize, 1))
+{
+}
+
+std::vector<Token> ParallelLexer::Tokenize()
+{
+    std::vector<Chunk> chunks = SplitIntoChunks();
+
+    if (chunks.size() == 1)
+    {
+        Lexer lexer(m_Source);
+        return lexer.Tokenize();
+    }
+
+    RunInParallel(chunks, [this](Chunk &chunk) {
+        Lexer lexer(m_Source, chunk.begin, chunk.end);
+        chunk.tokens = lexer.Tokenize();
+        chunk.tokens.pop_back();
+
+        chunk.newlines = static_cast<uint32_t>(
+            std::count(m_Source.begin() + chunk.begin, m_Source.begin() + chunk.end, '\n'));
+    });
+
+    size_t tokenCount = 0;
+
+    for (const Chunk &chunk : chunks)
+    {
+        tokenCount += chunk.tokens.size();
+    }
+
+    std::vector<Token> tokens;
+    tokens.reserve(tokenCount + 1);
+
+    // Every chunk counted its lines from 1, shift them by the newlines of all chunks in front
+    uint32_t firstLine = 1;
+
+    for (Chunk &chunk : chunks)
+    {
+        for (Token &token : chunk.tokens)
+        {
+            token.m_CurrentLine += firstLine - 1;
+            tokens.push_back(std::move(token));
+        }
+
+        firstLine += chunk.newlines;
+        chunk.tokens = {};
+    }
+
+    tokens.emplace_back(TokenType::EndOfFile, "", firstLine);
+    return tokens;
+}
+
+std::vector<ParallelLexer::Chunk> ParallelLexer::SplitIntoChunks() const
+{
+    size_t chunkCount = std::min<size_t>(m_ThreadCount, m_Source.size() / m_MinChunkSize);
+    std::vector<Chunk> chunks(std::max<size_t>(chunkCount, 1));
+
+    if (chunks.size() == 1)
+    {
+        chunks[0].end = m_Source.size();
+        return chunks;
+    }
+
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        chunks[i].begin = m_Source.size() * i / chunks.size();
+        chunks[i].end = m_Source.size() * (i + 1) / chunks.size();
+    }
+
+    // Whether a position is inside a string literal only depends on the number of quotes in front of it,
+    // there are no escapes. Count them per even slice in parallel, then the parity at each cut is a prefix sum.
+    RunInParallel(chunks, [this](Chunk &chunk) {
+        chunk.quotes = static_cast<size_t>(
+            std::count(m_Source.begin() + chunk.begin, m_Source.begin() + chunk.end, '"'));
+    });
+
+    size_t quotesInFront = 0;
+    size_t previousEnd = 0;
+
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        size_t cut = chunks[i].begin;
+        quotesInFront += i == 0 ? 0 : chunks[i - 1].quotes;
+
+        // A long string literal can swallow several cuts, the chunks between them stay empty
+        size_t boundary = i == 0 ? 0 : std::max(FindTokenBoundary(cut, quotesInFront % 2 != 0), previousEnd);
+
+        if (i != 0)
+        {
+            chunks[i - 1].end = boundary;
+        }
+
+        chunks[i].begin = boundary;
+        previousEnd = boundary;
+    }
+
+    chunks.back().end = m_Source.size();
+    return chunks;
+}
+
+size_t ParallelLexer::FindTokenBoundary(size_t position, bool isInString) const
+{
+    // Tokens never contain whitespace outside a string literal, so a chunk may start at the first such
+    // whitespace at or after position
+    for (; position < m_Source.size(); ++position)
+    {
+        char c = m_Source[position];
+
+        if (c == '"')
+        {
+            isInString = !isInString;
+        }
+        else if (!isInString && (c == ' ' || c == '\r' || c == '\t' || c == '\n'))
+        {
+            return position;
+        }
+    }
+
+    return m_Source.size();
+}
+
+template <typename Function> void ParallelLexer::RunInParallel(std::vector<Chunk> &chunks, Function function)
+{
+    std::vector<std::thread> threads;
+    threads.reserve(chunks.size() - 1);
+
+    for (size_t i = 1; i < chunks.size(); ++i)
+    {
+        threads.emplace_back(function, std::ref(chunks[i]));
+    }
+
+    // The calling thread takes the first chunk
+    function(chunks[0]);
+
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+} // namespace jlang
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "../Enums/TokenTypes.h"
+#include "../Types/Token.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace jlang
+{
+
+// Lexes one large source on several threads. The source is cut into chunks at whitespace outside string
+// literals, found with a quote-parity pre-scan, so every chunk starts between two tokens; each chunk is
+// lexed by its own Lexer and the token arrays are stitched back together with their line numbers shifted by
+// the newlines of the chunks in front. The result is identical to Lexer::Tokenize on the whole source.
+class ParallelLexer
+{
+  public:
+    // Smaller sources are not worth a thread per chunk
+    static constexpr size_t DefaultMinChunkSize = 1024 * 1024;
+
+    // Each chunk gets at least minChunkSize bytes, so a source shorter than twice that is lexed on the
+    // calling thread alone
+    ParallelLexer(const std::string &source, unsigned threadCount, size_t minChunkSize = DefaultMinChunkSize);
+
+    std::vector<Token> Tokenize();
+
+  private:
+    struct Chunk
+    {
+        size_t begin = 0;
+        size_t end = 0;
+        size_t quotes = 0;
+        uint32_t newlines = 0;
+        std::vector<Token> tokens;
+    };
+
+    std::vector<Chunk> SplitIntoChunks() const;
+    size_t FindTokenBoundary(size_t position, bool isInString) const;
+
+    template <typename Function> static void RunInParallel(std::vector<Chunk> &chunks, Function function);
+
+  private:
+    const std::string &m_Source;
+    unsigned m_ThreadCount;
+    size_t m_MinChunkSize;
+};
+
+} // namespace jlang
@@ -1,16 +1,18 @@
+#include "Common/CompileOptions.h"
+#include "Driver/Driver.h"
 #include "Lexer/Lexer.h"
-#include "Parser/Parser.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
-#include <sstream>
 
 using namespace jlang;
 
-// std::filesystem::path is better here, but don't care, it's for testing, if you have C++17
-// It would have taken me less time to replace it than to type this out
-std::string Load(const std::string &path)
+void TryLexer()
 {
+    // std::filesystem::path is better here, but don't care, it's for testing, if you have C++17
+    const std::string path = "../samples/sample.j";
     std::ifstream in(path);
 
     if (!in.is_open())
@@ -18,41 +20,164 @@ std::string Load(const std::string &path)
         std::cout << "No can do for: " << path << "\r\n";
     }
 
-    std::stringstream buffer;
-    buffer << in.rdbuf();
+    // Streams the file, tokens are printed as they are scanned
+    Lexer lexer(in);
+
+    std::cout << "Tokens: \r\n";
 
-    in.close();
+    for (Token token = lexer.NextToken();; token = lexer.NextToken())
+    {
+        std::cout << token.ToString() << "\r\n ";
 
-    return buffer.str();
+        if (token.m_type == TokenType::EndOfFile)
+        {
+            break;
+        }
+    }
+}
+
+int TryCodeGen(const CompileOptions &options)
+{
+    Driver driver(options);
+    return driver.Run();
 }
 
 void TryAllThis()
 {
     TryLexer();
     // TryParser();
-    // TryCodeGen();
+    TryCodeGen(CompileOptions());
 }
 
-void TryLexer()
+// Jlang [-O0..-O3] [-g] [-fprofile-generate[=file]] [-fprofile-use[=file]] [-fheap-profile[=file]]
+//       [-fheap-profile-rate=N] [-fno-bounds-check] [-fconst-steps=N] [-fconst-memory=N] [-flto] [-c]
+//       [-emit-interface] [-lex-threads=N] [-lazy-parse] [-run] file.j|file.bc...
+bool ParseArguments(int argc, char **argv, CompileOptions &options)
 {
-    std::string sourceCode = Load("../samples/sample.j");
+    const std::string defaultProfile = "default.jprof";
+    bool hasInputs = false;
 
-    Lexer lexer(sourceCode);
-    const std::vector<Token> &tokens = lexer.Tokenize();
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
 
-    std::cout << "Tokens: \r\n";
+        if (argument == "-run")
+        {
+            options.run = true;
+        }
+        else if (argument == "-g")
+        {
+            options.debugInfo = true;
+        }
+        else if (argument == "-flto")
+        {
+            options.lto = true;
+        }
+        else if (argument == "-fno-bounds-check")
+        {
+            options.boundsChecks = false;
+        }
+        else if (argument == "-c")
+        {
+            options.compileOnly = true;
+        }
+        else if (argument == "-emit-interface")
+        {
+            options.emitInterface = true;
+        }
+        else if (argument == "-lazy-parse")
+        {
+            options.lazyParsing = true;
+        }
+        else if (argument.rfind("-lex-threads=", 0) == 0)
+        {
+            std::string threadCount = argument.substr(std::string("-lex-threads=").size());
+            options.lexerThreads = static_cast<unsigned>(std::strtoul(threadCount.c_str(), nullptr, 10));
+        }
+        else if (argument.size() == 3 && argument.rfind("-O", 0) == 0 && argument[2] >= '0' &&
+                 argument[2] <= '3')
+        {
+            options.optimizationLevel = static_cast<unsigned>(argument[2] - '0');
+        }
+        else if (argument == "-fprofile-generate")
+        {
+            options.profileGeneratePath = defaultProfile;
+        }
+        else if (argument.rfind("-fprofile-generate=", 0) == 0)
+        {
+            options.profileGeneratePath = argument.substr(std::string("-fprofile-generate=").size());
+        }
+        else if (argument == "-fprofile-use")
+        {
+            options.profileUsePath = defaultProfile;
+        }
+        else if (argument.rfind("-fprofile-use=", 0) == 0)
+        {
+            options.profileUsePath = argument.substr(std::string("-fprofile-use=").size());
+        }
+        else if (argument == "-fheap-profile")
+        {
+            options.heapProfilePath = "heap.pprof";
+        }
+        else if (argument.rfind("-fheap-profile=", 0) == 0)
+        {
+            options.heapProfilePath = argument.substr(std::string("-fheap-profile=").size());
+        }
+        else if (argument.rfind("-fheap-profile-rate=", 0) == 0)
+        {
+            std::string rate = argument.substr(std::string("-fheap-profile-rate=").size());
+            options.heapProfileRate = std::max<int64_t>(1, std::strtoll(rate.c_str(), nullptr, 10));
+        }
+        else if (argument.rfind("-fconst-steps=", 0) == 0)
+        {
+            std::string steps = argument.substr(std::string("-fconst-steps=").size());
+            options.constSteps = std::strtoull(steps.c_str(), nullptr, 10);
+        }
+        else if (argument.rfind("-fconst-memory=", 0) == 0)
+        {
+            std::string memory = argument.substr(std::string("-fconst-memory=").size());
+            options.constMemory = std::strtoull(memory.c_str(), nullptr, 10);
+        }
+        else if (!argument.empty() && argument[0] == '-')
+        {
+            std::cout << "Unknown option: " << argument << "\r\n";
+            return false;
+        }
+        else
+        {
+            // The first input replaces the default sample
+            if (!hasInputs)
+            {
+                options.inputPaths.clear();
+                hasInputs = true;
+            }
 
-    for (const auto &token : tokens)
-    {
-        std::cout << token.ToString() << "\r\n ";
+            options.inputPaths.push_back(argument);
+        }
     }
+
+    return true;
 }
 
-int main()
+int main(int argc, char **argv)
 {
+    CompileOptions options;
+
+    if (!ParseArguments(argc, argv, options))
+    {
+        return 1;
+    }
+
     try
     {
-        TryAllThis();
+        // Without arguments keep exercising the lexer and codegen on the sample
+        if (argc == 1)
+        {
+            TryAllThis();
+            return 0;
+        }
+
+        return TryCodeGen(options);
     }
     catch (const std::exception &ex)
     {
@@ -2,10 +2,18 @@
 
 #include "../Common/Logger.h"
 
+#include <cstdlib>
+#include <limits>
+
 namespace jlang
 {
 
-Parser::Parser(const std::vector<Token> &tokens) : m_Tokens(tokens), m_CurrentPosition(0) {}
+Parser::Parser(const std::vector<Token> &tokens, SymbolInterner &symbols, bool isLazy)
+    : m_Tokens(tokens), m_Symbols(symbols), m_IsLazy(isLazy)
+{
+}
+
+Parser::Parser(Lexer &lexer, SymbolInterner &symbols) : m_Tokens(lexer), m_Symbols(symbols) {}
 
 std::vector<std::shared_ptr<AstNode>> Parser::Parse()
 {
@@ -13,7 +21,8 @@ std::vector<std::shared_ptr<AstNode>> Parser::Parse()
 
     while (!IsEndReached())
     {
-        auto declaration = ParseDeclaration();
+        SourceLocation location = CurrentLocation();
+        auto declaration = Locate(ParseDeclaration(), location);
 
         if (declaration)
         {
@@ -24,6 +33,17 @@ std::vector<std::shared_ptr<AstNode>> Parser::Parse()
     return program;
 }
 
+std::shared_ptr<AstNode> Parser::ParseLazyBody(const FunctionDecl &node)
+{
+    if (!node.lazyBodyTokenIndex)
+    {
+        return node.body;
+    }
+
+    m_Tokens.Seek(*node.lazyBodyTokenIndex);
+    return ParseBlock();
+}
+
 bool Parser::IsMatched(TokenType type)
 {
     if (Check(type))
@@ -35,7 +55,40 @@ bool Parser::IsMatched(TokenType type)
     return false;
 }
 
-bool Parser::Check(TokenType type) const
+bool Parser::CheckBuiltinType()
+{
+    return Check(TokenType::Int32) || Check(TokenType::Int32x4) || Check(TokenType::Int32x8);
+}
+
+bool Parser::IsMatchedTypeName()
+{
+    if (CheckBuiltinType())
+    {
+        Advance();
+        return true;
+    }
+
+    return IsMatched(TokenType::Identifier);
+}
+
+SourceLocation Parser::CurrentLocation()
+{
+    const Token &token = Peek();
+    return SourceLocation{token.m_CurrentLine, token.m_Column};
+}
+
+std::shared_ptr<AstNode> Parser::Locate(std::shared_ptr<AstNode> node, SourceLocation location)
+{
+    // Keep a location a nested parse already gave the node
+    if (node && node->location.line == 0)
+    {
+        node->location = location;
+    }
+
+    return node;
+}
+
+bool Parser::Check(TokenType type)
 {
     if (IsEndReached())
     {
@@ -49,23 +102,23 @@ const Token &Parser::Advance()
 {
     if (!IsEndReached())
     {
-        m_CurrentPosition++;
+        m_Tokens.Advance();
     }
 
     return Previous();
 }
 
-const Token &Parser::Peek() const
+const Token &Parser::Peek()
 {
-    return m_Tokens[m_CurrentPosition];
+    return m_Tokens.Peek();
 }
 
 const Token &Parser::Previous() const
 {
-    return m_Tokens[m_CurrentPosition - 1];
+    return m_Tokens.Previous();
 }
 
-bool Parser::IsEndReached() const
+bool Parser::IsEndReached()
 {
     return Peek().m_type == TokenType::EndOfFile;
 }
@@ -73,26 +126,94 @@ bool Parser::IsEndReached() const
 // Everything is kinda hardcoded for now!! -> will change that later on, just trying to get stuff rolling..
 std::shared_ptr<AstNode> Parser::ParseDeclaration()
 {
+    if (Check(TokenType::Import))
+    {
+        return ParseImport();
+    }
+
     if (Check(TokenType::Interface))
     {
         return ParseInterface();
     }
 
-    if (Check(TokenType::Struct))
+    if (Check(TokenType::Struct) || Check(TokenType::Soa))
     {
         return ParseStruct();
     }
 
-    if (Check(TokenType::Void) || Check(TokenType::Int32))
+    if (Check(TokenType::Void) || CheckBuiltinType())
     {
         return ParseFunction();
     }
 
+    if (IsMatched(TokenType::Async))
+    {
+        if (!Check(TokenType::Void) && !CheckBuiltinType())
+        {
+            JLANG_ERROR("Expected a function declaration after 'async'");
+            return nullptr;
+        }
+
+        auto function = ParseFunction();
+
+        if (function)
+        {
+            static_cast<FunctionDecl &>(*function).isAsync = true;
+        }
+
+        return function;
+    }
+
+    // Unit-level variables are only allowed as constants
+    if (IsMatched(TokenType::Const))
+    {
+        if (Check(TokenType::Var))
+        {
+            return ParseVariableDecl(true);
+        }
+
+        if (!Check(TokenType::Void) && !CheckBuiltinType())
+        {
+            JLANG_ERROR("Expected a function declaration or 'var' after 'const'");
+            return nullptr;
+        }
+
+        auto function = ParseFunction();
+
+        if (function)
+        {
+            static_cast<FunctionDecl &>(*function).isConst = true;
+        }
+
+        return function;
+    }
+
     Advance();
 
     return nullptr;
 }
 
+std::shared_ptr<AstNode> Parser::ParseImport()
+{
+    Advance();
+
+    if (!IsMatched(TokenType::Identifier))
+    {
+        JLANG_ERROR("Expected module name after 'import'");
+        return nullptr;
+    }
+
+    auto importDeclNode = std::make_shared<ImportDecl>();
+    importDeclNode->moduleName = Previous().m_lexeme;
+
+    if (!IsMatched(TokenType::Semicolon))
+    {
+        JLANG_ERROR("Expected ';' after import");
+    }
+
+    return importDeclNode;
+}
+
 std::shared_ptr<AstNode> Parser::ParseInterface()
 {
     Advance();
@@ -102,7 +223,7 @@ std::shared_ptr<AstNode> Parser::ParseInterface()
         JLANG_ERROR("Expected interaface name");
     }
 
-    const std::string &name = Previous().m_lexeme;
+    std::string name = Previous().m_lexeme;
 
     if (!IsMatched(TokenType::LBrace))
     {
@@ -116,26 +237,25 @@ std::shared_ptr<AstNode> Parser::ParseInterface()
     {
         if (!IsMatched(TokenType::Void))
         {
-            if (!IsMatched(TokenType::Void))
-            {
-                JLANG_ERROR("Expected 'void' in interface method");
-            }
-
-            if (!IsMatched(TokenType::Identifier))
-            {
-                JLANG_ERROR("Expected method name");
-            }
+            JLANG_ERROR("Expected 'void' in interface method");
+            Synchronize();
+            continue;
+        }
 
-            std::string methodName = Previous().m_lexeme;
+        if (!IsMatched(TokenType::Identifier))
+        {
+            JLANG_ERROR("Expected method name");
+        }
 
-            if (!IsMatched(TokenType::LParen) || !IsMatched(TokenType::RParen) ||
-                !IsMatched(TokenType::Semicolon))
-            {
-                JLANG_ERROR("Expected '()' and ';' after method name");
-            }
+        std::string methodName = Previous().m_lexeme;
 
-            interfaceDeclNode->methods.push_back(methodName);
+        if (!IsMatched(TokenType::LParen) || !IsMatched(TokenType::RParen) ||
+            !IsMatched(TokenType::Semicolon))
+        {
+            JLANG_ERROR("Expected '()' and ';' after method name");
         }
+
+        interfaceDeclNode->methods.push_back(methodName);
     }
 
     if (!IsMatched(TokenType::RBrace))
@@ -148,7 +268,12 @@ std::shared_ptr<AstNode> Parser::ParseInterface()
 
 std::shared_ptr<AstNode> Parser::ParseStruct()
 {
-    Advance();
+    bool isSoa = IsMatched(TokenType::Soa);
+
+    if (!IsMatched(TokenType::Struct))
+    {
+        JLANG_ERROR("Expected 'struct' after 'soa'");
+    }
 
     if (!IsMatched(TokenType::Identifier))
     {
@@ -177,17 +302,21 @@ std::shared_ptr<AstNode> Parser::ParseStruct()
     auto structDeclNode = std::make_shared<StructDecl>();
     structDeclNode->name = name;
     structDeclNode->interfaceImplemented = implementedInterface;
+    structDeclNode->isSoa = isSoa;
 
     while (!Check(TokenType::RBrace) && !IsEndReached())
     {
         if (!IsMatched(TokenType::Identifier))
         {
             JLANG_ERROR("Expected field name");
+            Synchronize();
+            continue;
         }
 
         std::string fieldName = Previous().m_lexeme;
+        bool isAtomic = IsMatched(TokenType::Atomic);
 
-        if (!IsMatched(TokenType::Identifier))
+        if (!IsMatchedTypeName())
         {
             JLANG_ERROR("Expected field type");
         }
@@ -200,12 +329,15 @@ std::shared_ptr<AstNode> Parser::ParseStruct()
             isPointer = true;
         }
 
+        StructField field{fieldName, TypeRef{typeName, isPointer}};
+        field.type.isAtomic = isAtomic;
+        ParseArraySuffix(field.type);
+
         if (!IsMatched(TokenType::Semicolon))
         {
             JLANG_ERROR("Expected ';' after struct field");
         }
 
-        StructField field{fieldName, TypeRef{typeName, isPointer}};
         structDeclNode->fields.push_back(field);
     }
 
@@ -222,13 +354,14 @@ std::shared_ptr<AstNode> Parser::ParseFunction()
     Advance();
 
     TokenType returnTokenType = Previous().m_type;
+    std::string returnTypeName = Previous().m_lexeme;
 
     if (!IsMatched(TokenType::Identifier))
     {
         JLANG_ERROR("Expected function name!");
     }
 
-    const std::string &functionName = Previous().m_lexeme;
+    std::string functionName = Previous().m_lexeme;
 
     // Hardcoded for no arguments, currently ..... will change that
     if (!IsMatched(TokenType::LParen) || !IsMatched(TokenType::RParen))
@@ -244,38 +377,46 @@ std::shared_ptr<AstNode> Parser::ParseFunction()
     }
     else
     {
-        returnType = TypeRef{Previous().m_lexeme, false};
+        returnType = TypeRef{returnTypeName, false};
     }
 
     std::vector<Parameter> params;
 
     if (IsMatched(TokenType::Arrow))
     {
-        if (!IsMatched(TokenType::Identifier))
+        if (!IsMatchedTypeName())
         {
             JLANG_ERROR("Expected paramter type identifier '->' ");
         }
 
-        const std::string &paramType = Previous().m_lexeme;
-        bool isPointer = IsMatched(TokenType::Star);
+        TypeRef paramType{Previous().m_lexeme, IsMatched(TokenType::Star)};
+        ParseArraySuffix(paramType);
 
         if (!IsMatched(TokenType::Identifier))
         {
             JLANG_ERROR("Expected paramter name!");
         }
 
-        const std::string &paramName = Previous().m_lexeme;
+        std::string paramName = Previous().m_lexeme;
 
-        params.push_back(Parameter{paramName, TypeRef{paramType, isPointer}});
+        params.push_back(Parameter{paramName, paramType, m_Symbols.Intern(paramName)});
     }
 
-    auto body = ParseBlock();
-
     auto functionDeclNode = std::make_shared<FunctionDecl>();
     functionDeclNode->name = functionName;
     functionDeclNode->params = params;
     functionDeclNode->returnType = returnType;
-    functionDeclNode->body = body;
+
+    // Only the braces are matched now, the body is parsed if the function turns out to be reachable
+    if (m_IsLazy && Check(TokenType::LBrace))
+    {
+        functionDeclNode->lazyBodyTokenIndex = m_Tokens.GetIndex();
+        SkipBlock();
+    }
+    else
+    {
+        functionDeclNode->body = ParseBlock();
+    }
 
     return functionDeclNode;
 }
@@ -307,9 +448,155 @@ std::shared_ptr<AstNode> Parser::ParseBlock()
     return blockStmt;
 }
 
+void Parser::SkipBlock()
+{
+    Advance();
+
+    uint32_t depth = 1;
+
+    while (depth != 0 && !IsEndReached())
+    {
+        TokenType type = Advance().m_type;
+
+        if (type == TokenType::LBrace)
+        {
+            depth++;
+        }
+        else if (type == TokenType::RBrace)
+        {
+            depth--;
+        }
+    }
+
+    if (depth != 0)
+    {
+        JLANG_ERROR("Expected '}' after block");
+    }
+}
+
+void Parser::Synchronize()
+{
+    while (!IsEndReached())
+    {
+        if (Advance().m_type == TokenType::Semicolon || Check(TokenType::RBrace))
+        {
+            return;
+        }
+    }
+}
+
 std::shared_ptr<AstNode> Parser::ParseStatement()
 {
-    return std::shared_ptr<AstNode>();
+    SourceLocation location = CurrentLocation();
+
+    if (Check(TokenType::Var))
+    {
+        return Locate(ParseVariableDecl(), location);
+    }
+
+    if (IsMatched(TokenType::Const))
+    {
+        if (!Check(TokenType::Var))
+        {
+            JLANG_ERROR("Expected 'var' after 'const'");
+            return nullptr;
+        }
+
+        return Locate(ParseVariableDecl(true), location);
+    }
+
+    if (Check(TokenType::If))
+    {
+        return Locate(ParseIfStatement(), location);
+    }
+
+    if (Check(TokenType::Hash) || Check(TokenType::While) || Check(TokenType::For))
+    {
+        LoopHints hints = ParseLoopHints();
+        location = CurrentLocation();
+
+        if (Check(TokenType::While))
+        {
+            return Locate(ParseWhileStatement(hints), location);
+        }
+
+        if (Check(TokenType::For))
+        {
+            return Locate(ParseForStatement(hints), location);
+        }
+
+        JLANG_ERROR("Expected 'for' or 'while' after loop pragmas");
+        return nullptr;
+    }
+
+    if (Check(TokenType::LBrace))
+    {
+        return Locate(ParseBlock(), location);
+    }
+
+    if (Check(TokenType::Spawn) || Check(TokenType::Sync))
+    {
+        return Locate(ParseTaskStatement(), location);
+    }
+
+    if (Check(TokenType::Return))
+    {
+        return Locate(ParseReturnStatement(), location);
+    }
+
+    return Locate(ParseExprStatement(), location);
+}
+
+std::shared_ptr<AstNode> Parser::ParseVariableDecl(bool isConst)
+{
+    Advance();
+
+    if (!IsMatched(TokenType::Identifier))
+    {
+        JLANG_ERROR("Expected variable name after 'var'");
+    }
+
+    std::string name = Previous().m_lexeme;
+    bool isAtomic = IsMatched(TokenType::Atomic);
+
+    if (!IsMatchedTypeName())
+    {
+        JLANG_ERROR("Expected variable type");
+    }
+
+    std::string typeName = Previous().m_lexeme;
+    bool isPointer = IsMatched(TokenType::Star);
+
+    auto variableDeclNode = std::make_shared<VariableDecl>();
+    variableDeclNode->name = name;
+    variableDeclNode->symbol = m_Symbols.Intern(name);
+    variableDeclNode->varType = TypeRef{typeName, isPointer};
+    variableDeclNode->varType.isAtomic = isAtomic;
+    variableDeclNode->isConst = isConst;
+    ParseArraySuffix(variableDeclNode->varType);
+
+    // 'const var t int32[N] -> int32 i = e;' gives each element its own initializer
+    if (isConst && IsMatched(TokenType::Arrow))
+    {
+        if (!IsMatched(TokenType::Int32) || !IsMatched(TokenType::Identifier))
+        {
+            JLANG_ERROR("Expected 'int32' and the element index name after '->'");
+        }
+
+        variableDeclNode->elementIndex = Previous().m_lexeme;
+    }
+
+    if (IsMatched(TokenType::Equal))
+    {
+        variableDeclNode->initializer = ParseExpression();
+    }
+
+    if (!IsMatched(TokenType::Semicolon))
+    {
+        JLANG_ERROR("Expected ';' after variable declaration");
+    }
+
+    return variableDeclNode;
 }
 
 std::shared_ptr<AstNode> Parser::ParseIfStatement()
@@ -345,26 +632,304 @@ std::shared_ptr<AstNode> Parser::ParseIfStatement()
     return node;
 }
 
+std::shared_ptr<AstNode> Parser::ParseWhileStatement(const LoopHints &hints)
+{
+    Advance();
+
+    if (!IsMatched(TokenType::LParen))
+    {
+        JLANG_ERROR("Expected '(' after 'while'");
+    }
+
+    auto node = std::make_shared<WhileStatement>();
+    node->condition = ParseExpression();
+    node->hints = hints;
+
+    if (!IsMatched(TokenType::RParen))
+    {
+        JLANG_ERROR("Expected ')' after condition");
+    }
+
+    node->body = ParseStatement();
+
+    return node;
+}
+
+std::shared_ptr<AstNode> Parser::ParseForStatement(const LoopHints &hints)
+{
+    Advance();
+
+    if (!IsMatched(TokenType::LParen))
+    {
+        JLANG_ERROR("Expected '(' after 'for'");
+    }
+
+    auto node = std::make_shared<ForStatement>();
+    node->hints = hints;
+
+    // Both forms consume the ';' that ends the initializer
+    if (Check(TokenType::Var))
+    {
+        node->initializer = ParseVariableDecl();
+    }
+    else if (!IsMatched(TokenType::Semicolon))
+    {
+        node->initializer = ParseExprStatement();
+    }
+
+    if (!Check(TokenType::Semicolon))
+    {
+        node->condition = ParseExpression();
+    }
+
+    if (!IsMatched(TokenType::Semicolon))
+    {
+        JLANG_ERROR("Expected ';' after loop condition");
+    }
+
+    if (!Check(TokenType::RParen))
+    {
+        node->increment = ParseExpression();
+    }
+
+    if (!IsMatched(TokenType::RParen))
+    {
+        JLANG_ERROR("Expected ')' after for clauses");
+    }
+
+    node->body = ParseStatement();
+
+    return node;
+}
+
+LoopHints Parser::ParseLoopHints()
+{
+    LoopHints hints;
+
+    while (IsMatched(TokenType::Hash))
+    {
+        if (!IsMatched(TokenType::Identifier))
+        {
+            JLANG_ERROR("Expected pragma name after '#'");
+            continue;
+        }
+
+        std::string pragma = Previous().m_lexeme;
+
+        if (pragma == "vectorize")
+        {
+            hints.vectorize = true;
+        }
+        else if (pragma == "unroll")
+        {
+            if (!IsMatched(TokenType::LParen) || !IsMatched(TokenType::NumberLiteral))
+            {
+                JLANG_ERROR("Expected '(count)' after '#unroll'");
+                continue;
+            }
+
+            hints.unrollCount = static_cast<uint32_t>(std::strtoul(Previous().m_lexeme.c_str(), nullptr, 10));
+
+            if (!IsMatched(TokenType::RParen))
+            {
+                JLANG_ERROR("Expected ')' after unroll count");
+            }
+        }
+        else
+        {
+            JLANG_ERROR(STR("Unknown pragma: #%s", pragma.c_str()));
+        }
+    }
+
+    return hints;
+}
+
 std::shared_ptr<AstNode> Parser::ParseExpression()
 {
-    auto expersion = ParseExpression();
+    return ParseAssignment();
+}
+
+std::shared_ptr<AstNode> Parser::ParseAssignment()
+{
+    auto expression = ParseEquality();
+    SourceLocation location = CurrentLocation();
+
+    // Already reported, the caller skips the statement
+    if (!expression)
+    {
+        return nullptr;
+    }
+
+    if (IsMatched(TokenType::Equal))
+    {
+        if (expression->type != NodeType::VarExpr && expression->type != NodeType::MemberExpr &&
+            expression->type != NodeType::IndexExpr)
+        {
+            JLANG_ERROR("Invalid assignment target");
+        }
+
+        auto assign = std::make_shared<AssignExpr>();
+        assign->location = location;
+        assign->target = expression;
+        assign->value = ParseAssignment();
+
+        return assign;
+    }
+
+    return expression;
+}
+
+std::shared_ptr<AstNode> Parser::ParseEquality()
+{
+    auto expression = ParseComparison();
+
+    while (Check(TokenType::EqualEqual) || Check(TokenType::NotEqual))
+    {
+        auto binary = std::make_shared<BinaryExpr>();
+        binary->location = CurrentLocation();
+        binary->op = Advance().m_lexeme;
+        binary->left = expression;
+        binary->right = ParseComparison();
+        expression = binary;
+    }
+
+    return expression;
+}
+
+std::shared_ptr<AstNode> Parser::ParseComparison()
+{
+    auto expression = ParseTerm();
+
+    while (Check(TokenType::Less) || Check(TokenType::Greater))
+    {
+        auto binary = std::make_shared<BinaryExpr>();
+        binary->location = CurrentLocation();
+        binary->op = Advance().m_lexeme;
+        binary->left = expression;
+        binary->right = ParseTerm();
+        expression = binary;
+    }
+
+    return expression;
+}
+
+std::shared_ptr<AstNode> Parser::ParseTerm()
+{
+    auto expression = ParseFactor();
+
+    while (Check(TokenType::Plus) || Check(TokenType::Minus))
+    {
+        auto binary = std::make_shared<BinaryExpr>();
+        binary->location = CurrentLocation();
+        binary->op = Advance().m_lexeme;
+        binary->left = expression;
+        binary->right = ParseFactor();
+        expression = binary;
+    }
+
+    return expression;
+}
+
+std::shared_ptr<AstNode> Parser::ParseFactor()
+{
+    auto expression = ParsePostfix();
+
+    while (Check(TokenType::Star))
+    {
+        auto binary = std::make_shared<BinaryExpr>();
+        binary->location = CurrentLocation();
+        binary->op = Advance().m_lexeme;
+        binary->left = expression;
+        binary->right = ParsePostfix();
+        expression = binary;
+    }
+
+    return expression;
+}
+
+std::shared_ptr<AstNode> Parser::ParseTaskStatement()
+{
+    auto statement = std::make_shared<ExprStatement>();
+
+    // sync is a keyword, so a call by that name can only come from here
+    if (Check(TokenType::Sync))
+    {
+        auto call = std::make_shared<CallExpr>();
+        call->location = CurrentLocation();
+        call->callee = Advance().m_lexeme;
+        statement->expression = call;
+    }
+    else
+    {
+        Advance();
+        statement->expression = ParsePostfix();
+
+        if (statement->expression && statement->expression->type == NodeType::CallExpr)
+        {
+            static_cast<CallExpr &>(*statement->expression).isSpawned = true;
+        }
+        else
+        {
+            JLANG_ERROR("Expected a function call after 'spawn'");
+        }
+    }
 
     if (!IsMatched(TokenType::Semicolon))
     {
-        JLANG_ERROR("Expected ';' after expression");
+        JLANG_ERROR("Expected ';' after task statement");
     }
 
-    auto stmt = std::make_shared<ExprStatement>();
-    stmt->expression = expersion;
+    return statement;
+}
 
-    return stmt;
+std::shared_ptr<AstNode> Parser::ParseReturnStatement()
+{
+    Advance();
+
+    auto statement = std::make_shared<ReturnStatement>();
+
+    // 'tail' is only a keyword in front of a call, 'return tail;' still returns a variable named tail
+    if (Check(TokenType::Identifier) && Peek().m_lexeme == "tail" &&
+        m_Tokens.Peek(1).m_type == TokenType::Identifier)
+    {
+        Advance();
+        statement->isTail = true;
+        statement->value = ParsePostfix();
+
+        if (!statement->value || statement->value->type != NodeType::CallExpr)
+        {
+            JLANG_ERROR("Expected a function call after 'return tail'");
+        }
+    }
+    else if (!Check(TokenType::Semicolon))
+    {
+        statement->value = ParseExpression();
+    }
+
+    if (!IsMatched(TokenType::Semicolon))
+    {
+        JLANG_ERROR("Expected ';' after return statement");
+    }
+
+    return statement;
 }
 
 std::shared_ptr<AstNode> Parser::ParseExprStatement()
 {
     auto expression = ParseExpression();
 
-    if (!IsMatched(TokenType::Semicolon))
+    // Nothing could start an expression here, a token no statement starts with
+    if (!expression)
+    {
+        Synchronize();
+        return nullptr;
+    }
+
+    // A closure body closes the statement the way a block does
+    bool endsWithBlock = expression->type == NodeType::CallExpr &&
+                         static_cast<const CallExpr &>(*expression).closureBody;
+
+    if (!endsWithBlock && !IsMatched(TokenType::Semicolon))
     {
         JLANG_ERROR("Expected ';' after expression");
     }
@@ -375,38 +940,206 @@ std::shared_ptr<AstNode> Parser::ParseExprStatement()
     return stmt;
 }
 
+TypeRef Parser::ParseStructTypeRef()
+{
+    if (!IsMatched(TokenType::Identifier))
+    {
+        JLANG_ERROR("Expected struct name");
+    }
+
+    std::string name = Previous().m_lexeme;
+    bool isPointer = IsMatched(TokenType::Star);
+
+    return TypeRef{name, isPointer};
+}
+
+void Parser::ParseArraySuffix(TypeRef &typeRef)
+{
+    if (!IsMatched(TokenType::LBracket))
+    {
+        return;
+    }
+
+    if (IsMatched(TokenType::RBracket))
+    {
+        typeRef.isSlice = true;
+        return;
+    }
+
+    if (!IsMatched(TokenType::NumberLiteral))
+    {
+        JLANG_ERROR("Expected an array length or ']' after '['");
+        return;
+    }
+
+    unsigned long long length = std::strtoull(Previous().m_lexeme.c_str(), nullptr, 10);
+
+    if (length == 0 || length > static_cast<unsigned long long>(std::numeric_limits<int32_t>::max()))
+    {
+        JLANG_ERROR(STR("Invalid array length: %s", Previous().m_lexeme.c_str()));
+    }
+    else
+    {
+        typeRef.arrayLength = static_cast<uint32_t>(length);
+    }
+
+    if (!IsMatched(TokenType::RBracket))
+    {
+        JLANG_ERROR("Expected ']' after array length");
+    }
+}
+
+std::shared_ptr<AstNode> Parser::ParsePostfix()
+{
+    SourceLocation primaryLocation = CurrentLocation();
+    auto expression = Locate(ParsePrimary(), primaryLocation);
+
+    while (Check(TokenType::Dot) || Check(TokenType::LBracket))
+    {
+        SourceLocation location = CurrentLocation();
+
+        if (IsMatched(TokenType::LBracket))
+        {
+            auto index = std::make_shared<IndexExpr>();
+            index->location = location;
+            index->object = expression;
+            index->index = ParseExpression();
+            expression = index;
+
+            if (!IsMatched(TokenType::RBracket))
+            {
+                JLANG_ERROR("Expected ']' after index");
+            }
+
+            continue;
+        }
+
+        Advance();
+
+        if (!IsMatched(TokenType::Identifier))
+        {
+            JLANG_ERROR("Expected member name after '.'");
+        }
+
+        auto member = std::make_shared<MemberExpr>();
+        member->location = location;
+        member->object = expression;
+        member->member = Previous().m_lexeme;
+        expression = member;
+    }
+
+    return expression;
+}
+
 std::shared_ptr<AstNode> Parser::ParsePrimary()
 {
+    // (struct Name*) expression or (int32*) expression
+    if (Check(TokenType::LParen) &&
+        (m_Tokens.Peek(1).m_type == TokenType::Struct || m_Tokens.Peek(1).m_type == TokenType::Int32))
+    {
+        Advance();
+
+        auto cast = std::make_shared<CastExpr>();
+
+        if (IsMatched(TokenType::Int32))
+        {
+            cast->targetType = TypeRef{"int32", IsMatched(TokenType::Star)};
+        }
+        else
+        {
+            Advance();
+            cast->targetType = ParseStructTypeRef();
+        }
+
+        if (!IsMatched(TokenType::RParen))
+        {
+            JLANG_ERROR("Expected ')' after cast type");
+        }
+
+        cast->expr = ParsePostfix();
+
+        return cast;
+    }
+
+    if (IsMatched(TokenType::Await))
+    {
+        auto expression = ParsePostfix();
+
+        if (expression && expression->type == NodeType::CallExpr)
+        {
+            static_cast<CallExpr &>(*expression).isAwaited = true;
+        }
+        else
+        {
+            JLANG_ERROR("Expected a function call after 'await'");
+        }
+
+        return expression;
+    }
+
+    if (IsMatched(TokenType::Sizeof))
+    {
+        if (!IsMatched(TokenType::LParen) || !IsMatched(TokenType::Struct))
+        {
+            JLANG_ERROR("Expected '(struct' after 'sizeof'");
+        }
+
+        auto size = std::make_shared<SizeofExpr>();
+        size->targetType = ParseStructTypeRef();
+
+        if (!IsMatched(TokenType::RParen))
+        {
+            JLANG_ERROR("Expected ')' after sizeof type");
+        }
+
+        return size;
+    }
 
     if (IsMatched(TokenType::Identifier))
     {
-        const std::string &name = Previous().m_lexeme;
+        std::string name = Previous().m_lexeme;
 
         if (IsMatched(TokenType::LParen))
         {
             auto call = std::make_shared<CallExpr>();
             call->callee = name;
 
-            if (!IsMatched(TokenType::RParen))
+            if (IsMatched(TokenType::RParen))
             {
-                do
-                {
-                    auto arg = ParseExpression();
-                    call->arguments.push_back(arg);
-                } while (IsMatched(TokenType::Comma));
+                return call;
             }
 
+            do
+            {
+                auto arg = ParseExpression();
+                call->arguments.push_back(arg);
+            } while (IsMatched(TokenType::Comma));
+
             if (!IsMatched(TokenType::RParen))
             {
                 JLANG_ERROR("Expected ')' after arguments");
             }
 
+            // The index is declared like the receiver of a function
+            if (name == "parallel_for" && IsMatched(TokenType::Arrow))
+            {
+                if (!IsMatched(TokenType::Int32) || !IsMatched(TokenType::Identifier))
+                {
+                    JLANG_ERROR("Expected 'int32 <name>' after '->' in parallel_for");
+                }
+
+                call->closureIndex = Previous().m_lexeme;
+                call->closureIndexSymbol = m_Symbols.Intern(call->closureIndex);
+                call->closureBody = ParseBlock();
+            }
+
             return call;
         }
         else
         {
             auto var = std::make_shared<VarExpr>();
             var->name = name;
+            var->symbol = m_Symbols.Intern(name);
             return var;
         }
     }
@@ -415,6 +1148,7 @@ std::shared_ptr<AstNode> Parser::ParsePrimary()
     {
         auto experssion = std::make_shared<VarExpr>();
         experssion->name = Previous().m_lexeme;
+        experssion->symbol = m_Symbols.Intern(experssion->name);
         return experssion;
     }
 
@@ -425,7 +1159,34 @@ std::shared_ptr<AstNode> Parser::ParsePrimary()
         return experssion;
     }
 
+    if (IsMatched(TokenType::NumberLiteral))
+    {
+        auto experssion = std::make_shared<LiteralExpr>();
+        experssion->kind = LiteralKind::Number;
+        experssion->value = Previous().m_lexeme;
+
+        // The lexer only produces digit sequences, so the only failure left is overflow
+        long long number = std::strtoll(experssion->value.c_str(), nullptr, 10);
+
+        if (number > std::numeric_limits<int32_t>::max())
+        {
+            JLANG_ERROR(STR("Number literal out of int32 range: %s", experssion->value.c_str()));
+        }
+
+        experssion->numberValue = static_cast<int32_t>(number);
+        return experssion;
+    }
+
+    if (IsMatched(TokenType::Null))
+    {
+        auto experssion = std::make_shared<LiteralExpr>();
+        experssion->kind = LiteralKind::Null;
+        experssion->value = Previous().m_lexeme;
+        return experssion;
+    }
+
     JLANG_ERROR("Expected expression");
+    return nullptr;
 }
 
 } // namespace jlang
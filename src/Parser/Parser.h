@@ -1,6 +1,13 @@
 #pragma once
 
+#include "SymbolInterner.h"
+#include "TokenStream.h"
+
 #include "../AST/Ast.h"
+#include "../AST/Expressions/Expressions.h"
+#include "../AST/Statements/Statements.h"
+#include "../AST/TopLevelDecl/TopLevelDecl.h"
+#include "../Types/Token.h"
 
 #include <memory>
 #include <optional>
@@ -13,31 +20,75 @@ namespace jlang
 class Parser
 {
   public:
-    explicit Parser(const std::vector<Token> &tokens);
+    // Names of variables and parameters are interned into symbols, which every unit shares.
+    // Lazy parsing skips function bodies and only records where they start, see ParseLazyBody.
+    Parser(const std::vector<Token> &tokens, SymbolInterner &symbols, bool isLazy = false);
+
+    // Pulls tokens from the lexer as parsing reaches them instead of taking a tokenized unit
+    Parser(Lexer &lexer, SymbolInterner &symbols);
+
     std::vector<std::shared_ptr<AstNode>> Parse();
 
+    // Parses the body a lazy parse of the same tokens skipped
+    std::shared_ptr<AstNode> ParseLazyBody(const FunctionDecl &node);
+
   private:
     bool IsMatched(TokenType type);
-    bool Check(TokenType type) const;
+    bool Check(TokenType type);
     const Token &Advance();
-    const Token &Peek() const;
+    const Token &Peek();
     const Token &Previous() const;
-    bool IsEndReached() const;
+    bool IsEndReached();
+
+    // int32 and the vector types are keywords, struct names are identifiers
+    bool CheckBuiltinType();
+    bool IsMatchedTypeName();
+
+    // Nodes get the location of the token they start at, operators that of the operator token
+    SourceLocation CurrentLocation();
+    static std::shared_ptr<AstNode> Locate(std::shared_ptr<AstNode> node, SourceLocation location);
 
     std::shared_ptr<AstNode> ParseDeclaration();
+    std::shared_ptr<AstNode> ParseImport();
     std::shared_ptr<AstNode> ParseInterface();
     std::shared_ptr<AstNode> ParseStruct();
     std::shared_ptr<AstNode> ParseFunction();
     std::shared_ptr<AstNode> ParseStatement();
     std::shared_ptr<AstNode> ParseBlock();
+    void SkipBlock();
+
+    // Skips the rest of a statement or member that failed to parse, through its ';' or up to the '}' that
+    // closes the enclosing block; always past the token the error was found at, so the caller's loop goes on
+    void Synchronize();
+    std::shared_ptr<AstNode> ParseVariableDecl(bool isConst = false);
     std::shared_ptr<AstNode> ParseIfStatement();
+    std::shared_ptr<AstNode> ParseWhileStatement(const LoopHints &hints);
+    std::shared_ptr<AstNode> ParseForStatement(const LoopHints &hints);
+    LoopHints ParseLoopHints();
     std::shared_ptr<AstNode> ParseExpression();
+    std::shared_ptr<AstNode> ParseAssignment();
+    std::shared_ptr<AstNode> ParseEquality();
+    std::shared_ptr<AstNode> ParseComparison();
+    std::shared_ptr<AstNode> ParseTerm();
+    std::shared_ptr<AstNode> ParseFactor();
     std::shared_ptr<AstNode> ParseExprStatement();
+
+    // 'spawn f(x);' and 'sync;', both parsed to an ExprStatement holding a CallExpr
+    std::shared_ptr<AstNode> ParseTaskStatement();
+
+    // 'return tail f(x);' asks for a guaranteed tail call, 'tail' is not reserved anywhere else
+    std::shared_ptr<AstNode> ParseReturnStatement();
+    std::shared_ptr<AstNode> ParsePostfix();
     std::shared_ptr<AstNode> ParsePrimary();
+    TypeRef ParseStructTypeRef();
+
+    // '[N]' makes the type parsed so far the element type of an array, '[]' that of a slice
+    void ParseArraySuffix(TypeRef &typeRef);
 
   private:
-    const std::vector<Token> &m_Tokens;
-    size_t m_CurrentPosition;
+    TokenStream m_Tokens;
+    SymbolInterner &m_Symbols;
+    bool m_IsLazy = false;
 };
 
 } // namespace jlang
@@ -0,0 +1,63 @@
+#include "SymbolInterner.h"
+
+#include <functional>
+
+namespace jlang
+{
+
+SymbolId SymbolInterner::Intern(const std::string &name)
+{
+    size_t slot = 0;
+    SymbolId symbol = m_Slots.empty() ? InvalidSymbolId : Find(name, slot);
+
+    if (symbol != InvalidSymbolId)
+    {
+        return symbol;
+    }
+
+    // Only a new name takes a slot. Keep at most half of them in use so probe sequences stay short.
+    if ((m_Names.size() + 1) * 2 > m_Slots.size())
+    {
+        Grow();
+        Find(name, slot);
+    }
+
+    symbol = static_cast<SymbolId>(m_Names.size());
+    m_Names.push_back(name);
+    m_Slots[slot] = symbol;
+
+    return symbol;
+}
+
+SymbolId SymbolInterner::Find(const std::string &name, size_t &slot) const
+{
+    // The slot count is a power of two, linear probing until the name or an empty slot
+    size_t mask = m_Slots.size() - 1;
+    slot = std::hash<std::string>{}(name) & mask;
+
+    while (m_Slots[slot] != InvalidSymbolId)
+    {
+        if (m_Names[m_Slots[slot]] == name)
+        {
+            return m_Slots[slot];
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return InvalidSymbolId;
+}
+
+void SymbolInterner::Grow()
+{
+    m_Slots.assign(m_Slots.empty() ? 64 : m_Slots.size() * 2, InvalidSymbolId);
+
+    for (SymbolId symbol = 0; symbol < m_Names.size(); ++symbol)
+    {
+        size_t slot = 0;
+        Find(m_Names[symbol], slot);
+        m_Slots[slot] = symbol;
+    }
+}
+
+} // namespace jlang
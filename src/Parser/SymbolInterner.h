@@ -0,0 +1,30 @@
+#pragma once
+
+#include "../Types/SymbolId.h"
+
+#include <string>
+#include <vector>
+
+namespace jlang
+{
+
+// The names of variables and parameters of every unit, each interned once while parsing into a dense
+// SymbolId through an open-addressing table. Codegen then binds names by id without hashing them again.
+class SymbolInterner
+{
+  public:
+    SymbolId Intern(const std::string &name);
+
+    const std::string &GetName(SymbolId symbol) const { return m_Names[symbol]; }
+    size_t GetCount() const { return m_Names.size(); }
+
+  private:
+    SymbolId Find(const std::string &name, size_t &slot) const;
+    void Grow();
+
+  private:
+    std::vector<std::string> m_Names;
+    std::vector<SymbolId> m_Slots;
+};
+
+} // namespace jlang
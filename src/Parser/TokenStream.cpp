@@ -0,0 +1,75 @@
+#include "TokenStream.h"
+
+#include "../Common/Assert.h"
+#include "../Lexer/Lexer.h"
+
+namespace jlang
+{
+
+static const Token s_EndOfFile(TokenType::EndOfFile, "", 0);
+
+TokenStream::TokenStream(const std::vector<Token> &tokens)
+    : m_Tokens(&tokens), m_Ring(Capacity, s_EndOfFile)
+{
+}
+
+TokenStream::TokenStream(Lexer &lexer) : m_Lexer(&lexer), m_Ring(Capacity, s_EndOfFile) {}
+
+const Token &TokenStream::Peek(size_t offset)
+{
+    // The slot behind the head holds Previous(), lookahead must never overwrite it
+    ASSERT(offset <= MaxLookahead);
+
+    while (m_Buffered <= offset)
+    {
+        m_Ring[(m_Head + m_Buffered) % Capacity] = Pull();
+        m_Buffered++;
+    }
+
+    return m_Ring[(m_Head + offset) % Capacity];
+}
+
+const Token &TokenStream::Previous() const
+{
+    return m_Ring[(m_Head + Capacity - 1) % Capacity];
+}
+
+void TokenStream::Advance()
+{
+    Peek();
+
+    m_Head = (m_Head + 1) % Capacity;
+    m_Buffered--;
+}
+
+void TokenStream::Seek(size_t index)
+{
+    if (!m_Tokens)
+    {
+        return;
+    }
+
+    // The ring starts over at the new position, with the token before it in the slot Previous() reads
+    m_NextIndex = index;
+    m_Head = 0;
+    m_Buffered = 0;
+    m_Ring[Capacity - 1] = index > 0 && index <= m_Tokens->size() ? (*m_Tokens)[index - 1] : s_EndOfFile;
+}
+
+Token TokenStream::Pull()
+{
+    if (m_Lexer)
+    {
+        return m_Lexer->NextToken();
+    }
+
+    // Past the end the stream keeps yielding the closing EndOfFile
+    if (m_NextIndex < m_Tokens->size())
+    {
+        return (*m_Tokens)[m_NextIndex++];
+    }
+
+    return m_Tokens->empty() ? s_EndOfFile : m_Tokens->back();
+}
+
+} // namespace jlang
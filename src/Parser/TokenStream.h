@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../Enums/TokenTypes.h"
+#include "../Types/Token.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace jlang
+{
+
+class Lexer;
+
+// The tokens the parser looks at: the previous one, the current one and a fixed lookahead, kept in a small
+// ring. Tokens come from a vector or are pulled from a Lexer only when the parser reaches them, so scanning
+// is interleaved with parsing and a unit never exists as a whole token vector.
+class TokenStream
+{
+  public:
+    // Previous, current and two tokens of lookahead beyond it
+    static constexpr size_t Capacity = 4;
+    static constexpr size_t MaxLookahead = Capacity - 2;
+
+    explicit TokenStream(const std::vector<Token> &tokens);
+    explicit TokenStream(Lexer &lexer);
+
+    // Asserts that offset is at most MaxLookahead, a parser needing more has to raise Capacity
+    const Token &Peek(size_t offset = 0);
+    const Token &Previous() const;
+    void Advance();
+
+    // Index of the current token; only a stream over a vector can be repositioned
+    size_t GetIndex() const { return m_NextIndex - m_Buffered; }
+    void Seek(size_t index);
+
+  private:
+    Token Pull();
+
+  private:
+    const std::vector<Token> *m_Tokens = nullptr;
+    size_t m_NextIndex = 0;
+
+    Lexer *m_Lexer = nullptr;
+
+    std::vector<Token> m_Ring;
+    size_t m_Head = 0;
+    size_t m_Buffered = 0;
+};
+
+} // namespace jlang
@@ -0,0 +1,97 @@
+#include "ProfileData.h"
+
+#include "../Common/Logger.h"
+
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include <llvm/ProfileData/InstrProf.h>
+#include <llvm/ProfileData/ProfileCommon.h>
+
+namespace jlang
+{
+
+bool ProfileData::Load(const std::string &path)
+{
+    std::ifstream in(path);
+
+    if (!in.is_open())
+    {
+        JLANG_ERROR(STR("Cannot open profile: %s", path.c_str()));
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+
+        std::string name;
+        Record run;
+        uint32_t count = 0;
+
+        if (!(fields >> name >> run.hash >> count))
+        {
+            continue;
+        }
+
+        run.counts.resize(count);
+        for (uint64_t &value : run.counts)
+        {
+            fields >> value;
+        }
+
+        if (!fields)
+        {
+            JLANG_ERROR(STR("Truncated profile record for function: %s", name.c_str()));
+            continue;
+        }
+
+        auto it = m_Records.find(name);
+
+        // A run of a different version of the function replaces the older data
+        if (it == m_Records.end() || it->second.hash != run.hash || it->second.counts.size() != count)
+        {
+            m_Records[name] = std::move(run);
+            continue;
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint64_t &total = it->second.counts[i];
+            total = run.counts[i] > std::numeric_limits<uint64_t>::max() - total
+                        ? std::numeric_limits<uint64_t>::max()
+                        : total + run.counts[i];
+        }
+    }
+
+    return true;
+}
+
+const ProfileData::Record *ProfileData::Find(const std::string &functionName) const
+{
+    auto it = m_Records.find(functionName);
+    return it != m_Records.end() ? &it->second : nullptr;
+}
+
+std::unique_ptr<llvm::ProfileSummary> ProfileData::BuildSummary() const
+{
+    // Same summary an instrumented clang build records, so the inliner and hot/cold splitting see our counts
+    llvm::InstrProfSummaryBuilder builder(llvm::ProfileSummaryBuilder::DefaultCutoffs);
+
+    for (const auto &entry : m_Records)
+    {
+        // Receiver counts of interface call sites say nothing about how hot a function is
+        if (entry.first.find('#') != std::string::npos)
+        {
+            continue;
+        }
+
+        builder.addRecord(llvm::InstrProfRecord(entry.second.counts));
+    }
+
+    return builder.getSummary();
+}
+
+} // namespace jlang
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/IR/ProfileSummary.h>
+
+namespace jlang
+{
+
+// Counters collected by a -fprofile-generate build, read back for -fprofile-use. The runtime appends one
+// line per function and run ('name hash count c0 c1 ...'); runs of the same function are summed here.
+// Interface call sites are recorded the same way as 'function#n', with one counter per implementing struct.
+class ProfileData
+{
+  public:
+    struct Record
+    {
+        uint64_t hash = 0;
+
+        // counts[0] is the number of calls, then two counters per if: reached and then-branch taken
+        std::vector<uint64_t> counts;
+    };
+
+    bool Load(const std::string &path);
+
+    const Record *Find(const std::string &functionName) const;
+
+    std::unique_ptr<llvm::ProfileSummary> BuildSummary() const;
+
+  private:
+    std::unordered_map<std::string, Record> m_Records;
+};
+
+} // namespace jlang
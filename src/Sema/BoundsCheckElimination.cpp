@@ -0,0 +1,429 @@
+#include "BoundsCheckElimination.h"
+
+#include "../Common/Logger.h"
+
+#include <algorithm>
+
+namespace jlang
+{
+
+BoundsCheckElimination::BoundsCheckElimination(const TypeTable &typeTable) : m_TypeTable(typeTable) {}
+
+void BoundsCheckElimination::Run(const std::vector<std::shared_ptr<AstNode>> &program)
+{
+    for (const auto &node : program)
+    {
+        Visit(node);
+    }
+}
+
+void BoundsCheckElimination::Visit(const std::shared_ptr<AstNode> &node)
+{
+    if (node)
+    {
+        node->Accept(*this);
+    }
+}
+
+void BoundsCheckElimination::Declare(const std::string &name, TypeId type)
+{
+    if (!m_Scopes.empty())
+    {
+        m_Scopes.back()[name] = type;
+    }
+}
+
+TypeId BoundsCheckElimination::Lookup(const std::string &name) const
+{
+    for (auto scope = m_Scopes.rbegin(); scope != m_Scopes.rend(); ++scope)
+    {
+        auto it = scope->find(name);
+
+        if (it != scope->end())
+        {
+            return it->second;
+        }
+    }
+
+    return InvalidTypeId;
+}
+
+void BoundsCheckElimination::VisitFunctionDecl(FunctionDecl &node)
+{
+    m_FunctionName = node.name;
+    m_Scopes.emplace_back();
+
+    for (const Parameter &param : node.params)
+    {
+        Declare(param.name, param.type.id);
+    }
+
+    Visit(node.body);
+
+    m_Scopes.clear();
+    m_Facts.clear();
+    m_Assigned.clear();
+}
+
+void BoundsCheckElimination::VisitImportDecl(ImportDecl &) {}
+
+void BoundsCheckElimination::VisitInterfaceDecl(InterfaceDecl &) {}
+
+void BoundsCheckElimination::VisitStructDecl(StructDecl &) {}
+
+void BoundsCheckElimination::VisitVariableDecl(VariableDecl &node)
+{
+    Visit(node.initializer);
+
+    // A new variable of the same name inside a loop body hides the one a fact is about
+    Declare(node.name, node.varType.id);
+    m_Assigned.push_back(node.name);
+}
+
+void BoundsCheckElimination::VisitIfStatement(IfStatement &node)
+{
+    Visit(node.condition);
+    Visit(node.thenBranch);
+    Visit(node.elseBranch);
+}
+
+void BoundsCheckElimination::VisitWhileStatement(WhileStatement &node)
+{
+    Visit(node.condition);
+    VisitLoopBody(node.body, nullptr);
+}
+
+void BoundsCheckElimination::VisitForStatement(ForStatement &node)
+{
+    m_Scopes.emplace_back();
+
+    Visit(node.initializer);
+    Visit(node.condition);
+    Visit(node.increment);
+
+    // The start: 'var i int32 = c' or 'i = c' on an int32 i, with c >= 0
+    std::string index;
+    const LiteralExpr *start = nullptr;
+
+    if (node.initializer && node.initializer->type == NodeType::VariableDecl)
+    {
+        auto &decl = static_cast<const VariableDecl &>(*node.initializer);
+        index = decl.name;
+        start = AsNumber(decl.initializer.get());
+    }
+    else if (const AssignExpr *assign = AsAssign(node.initializer.get()))
+    {
+        if (const VarExpr *target = AsVar(assign->target.get()))
+        {
+            index = target->name;
+            start = AsNumber(assign->value.get());
+        }
+    }
+
+    bool isCounting = start && start->numberValue >= 0 && Lookup(index) == TypeTable::Int32Id;
+
+    // The step: 'i = i + 1', which can't overflow while i < bound
+    const AssignExpr *increment = AsAssign(node.increment.get());
+    const VarExpr *incremented = increment ? AsVar(increment->target.get()) : nullptr;
+    const auto *sum = increment && increment->value && increment->value->type == NodeType::BinaryExpr
+                          ? static_cast<const BinaryExpr *>(increment->value.get())
+                          : nullptr;
+
+    if (!incremented || incremented->name != index || !sum || sum->op != "+")
+    {
+        isCounting = false;
+    }
+    else
+    {
+        const VarExpr *addend = AsVar(sum->left.get());
+        const LiteralExpr *step = AsNumber(sum->right.get());
+        isCounting = isCounting && addend && addend->name == index && step && step->numberValue == 1;
+    }
+
+    // The condition: 'i < bound'
+    const auto *condition = node.condition && node.condition->type == NodeType::BinaryExpr
+                                ? static_cast<const BinaryExpr *>(node.condition.get())
+                                : nullptr;
+    const VarExpr *compared = condition && condition->op == "<" ? AsVar(condition->left.get()) : nullptr;
+
+    RangeFact fact;
+    bool hasFact = isCounting && compared && compared->name == index &&
+                   MatchBound(index, condition->right.get(), fact);
+
+    VisitLoopBody(node.body, hasFact ? &fact : nullptr);
+
+    m_Scopes.pop_back();
+}
+
+void BoundsCheckElimination::VisitBlockStatement(BlockStatement &node)
+{
+    m_Scopes.emplace_back();
+
+    for (const auto &statement : node.statements)
+    {
+        Visit(statement);
+    }
+
+    m_Scopes.pop_back();
+}
+
+void BoundsCheckElimination::VisitExprStatement(ExprStatement &node)
+{
+    Visit(node.expression);
+}
+
+void BoundsCheckElimination::VisitReturnStatement(ReturnStatement &node)
+{
+    Visit(node.value);
+}
+
+void BoundsCheckElimination::VisitCallExpr(CallExpr &node)
+{
+    for (const auto &argument : node.arguments)
+    {
+        Visit(argument);
+    }
+
+    // The atomic builtins write the variable they are given
+    if (node.callee.rfind("jatomic_", 0) == 0 && !node.arguments.empty())
+    {
+        if (const VarExpr *target = AsVar(node.arguments[0].get()))
+        {
+            m_Assigned.push_back(target->name);
+        }
+    }
+
+    if (!node.closureBody)
+    {
+        return;
+    }
+
+    // The closure's index hides any variable of the same name, like a declaration does
+    m_Scopes.emplace_back();
+    Declare(node.closureIndex, TypeTable::Int32Id);
+    m_Assigned.push_back(node.closureIndex);
+
+    // parallel_for(c, bound) -> int32 i runs the body for every i in [c, bound)
+    const LiteralExpr *start = node.arguments.size() == 2 ? AsNumber(node.arguments[0].get()) : nullptr;
+
+    RangeFact fact;
+    bool hasFact =
+        start && start->numberValue >= 0 && MatchBound(node.closureIndex, node.arguments[1].get(), fact);
+
+    VisitLoopBody(node.closureBody, hasFact ? &fact : nullptr);
+
+    m_Scopes.pop_back();
+}
+
+void BoundsCheckElimination::VisitBinaryExpr(BinaryExpr &node)
+{
+    Visit(node.left);
+    Visit(node.right);
+}
+
+void BoundsCheckElimination::VisitLiteralExpr(LiteralExpr &) {}
+
+void BoundsCheckElimination::VisitVarExpr(VarExpr &) {}
+
+void BoundsCheckElimination::VisitCastExpr(CastExpr &node)
+{
+    Visit(node.expr);
+}
+
+void BoundsCheckElimination::VisitMemberExpr(MemberExpr &node)
+{
+    Visit(node.object);
+}
+
+void BoundsCheckElimination::VisitIndexExpr(IndexExpr &node)
+{
+    Visit(node.object);
+    Visit(node.index);
+
+    const VarExpr *sequence = AsVar(node.object.get());
+    TypeId sequenceType = sequence ? Lookup(sequence->name) : InvalidTypeId;
+
+    if (sequenceType == InvalidTypeId)
+    {
+        return;
+    }
+
+    const TypeInfo &type = m_TypeTable.Get(sequenceType);
+
+    if (type.kind != TypeKind::Array && type.kind != TypeKind::Slice)
+    {
+        return;
+    }
+
+    if (const LiteralExpr *constant = AsNumber(node.index.get()))
+    {
+        if (type.kind != TypeKind::Array)
+        {
+            return;
+        }
+
+        if (constant->numberValue < 0 || static_cast<uint32_t>(constant->numberValue) >= type.length)
+        {
+            JLANG_ERROR(STR("%s: index %d is out of bounds for %s of length %u", m_FunctionName.c_str(),
+                            constant->numberValue, sequence->name.c_str(), type.length));
+            return;
+        }
+
+        node.isBoundsChecked = false;
+        return;
+    }
+
+    const VarExpr *index = AsVar(node.index.get());
+
+    if (!index)
+    {
+        return;
+    }
+
+    for (auto fact = m_Facts.rbegin(); fact != m_Facts.rend(); ++fact)
+    {
+        if (fact->index != index->name)
+        {
+            continue;
+        }
+
+        bool isInBounds = fact->sequence == sequence->name;
+
+        if (fact->sequence.empty())
+        {
+            isInBounds = type.kind == TypeKind::Array && static_cast<uint32_t>(fact->bound) <= type.length;
+        }
+
+        if (isInBounds)
+        {
+            node.isBoundsChecked = false;
+            fact->clearedAccesses.push_back(&node);
+            return;
+        }
+    }
+}
+
+void BoundsCheckElimination::VisitSizeofExpr(SizeofExpr &) {}
+
+void BoundsCheckElimination::VisitAssignExpr(AssignExpr &node)
+{
+    Visit(node.target);
+    Visit(node.value);
+
+    if (const VarExpr *target = AsVar(node.target.get()))
+    {
+        m_Assigned.push_back(target->name);
+    }
+}
+
+bool BoundsCheckElimination::MatchBound(const std::string &index, const AstNode *bound, RangeFact &fact) const
+{
+    fact.index = index;
+
+    if (const LiteralExpr *constant = AsNumber(bound))
+    {
+        fact.bound = constant->numberValue;
+        return true;
+    }
+
+    if (!bound || bound->type != NodeType::CallExpr)
+    {
+        return false;
+    }
+
+    auto &call = static_cast<const CallExpr &>(*bound);
+    const VarExpr *sequence =
+        call.callee == "jlen" && call.arguments.size() == 1 ? AsVar(call.arguments[0].get()) : nullptr;
+    TypeId sequenceType = sequence ? Lookup(sequence->name) : InvalidTypeId;
+
+    if (sequenceType == InvalidTypeId)
+    {
+        return false;
+    }
+
+    const TypeInfo &type = m_TypeTable.Get(sequenceType);
+
+    // The length of an array is a constant, which covers every array at least as long
+    if (type.kind == TypeKind::Array)
+    {
+        fact.bound = static_cast<int32_t>(type.length);
+        return true;
+    }
+
+    fact.sequence = sequence->name;
+    return type.kind == TypeKind::Slice;
+}
+
+void BoundsCheckElimination::VisitLoopBody(const std::shared_ptr<AstNode> &body, RangeFact *fact)
+{
+    size_t firstAssigned = m_Assigned.size();
+
+    if (fact)
+    {
+        m_Facts.push_back(*fact);
+    }
+
+    Visit(body);
+
+    if (!fact)
+    {
+        return;
+    }
+
+    RangeFact done = std::move(m_Facts.back());
+    m_Facts.pop_back();
+
+    auto assigned = m_Assigned.begin() + static_cast<std::ptrdiff_t>(firstAssigned);
+    bool isKept = std::none_of(assigned, m_Assigned.end(), [&](const std::string &name) {
+        return name == done.index || name == done.sequence;
+    });
+
+    if (!isKept)
+    {
+        for (IndexExpr *access : done.clearedAccesses)
+        {
+            access->isBoundsChecked = true;
+        }
+
+        return;
+    }
+
+    if (!done.clearedAccesses.empty())
+    {
+        std::string bound =
+            done.sequence.empty() ? std::to_string(done.bound) : "jlen(" + done.sequence + ")";
+
+        JLANG_REMARK("bounds-check",
+                     STR("%s: %zu bounds checks on '%s' removed, it stays below %s", m_FunctionName.c_str(),
+                         done.clearedAccesses.size(), done.index.c_str(), bound.c_str()));
+    }
+}
+
+const LiteralExpr *BoundsCheckElimination::AsNumber(const AstNode *node)
+{
+    if (!node || node->type != NodeType::LiteralExpr)
+    {
+        return nullptr;
+    }
+
+    auto *literal = static_cast<const LiteralExpr *>(node);
+    return literal->kind == LiteralKind::Number ? literal : nullptr;
+}
+
+const AssignExpr *BoundsCheckElimination::AsAssign(const AstNode *statement)
+{
+    if (statement && statement->type == NodeType::ExprStatement)
+    {
+        statement = static_cast<const ExprStatement *>(statement)->expression.get();
+    }
+
+    return statement && statement->type == NodeType::AssignExpr ? static_cast<const AssignExpr *>(statement)
+                                                                : nullptr;
+}
+
+const VarExpr *BoundsCheckElimination::AsVar(const AstNode *node)
+{
+    return node && node->type == NodeType::VarExpr ? static_cast<const VarExpr *>(node) : nullptr;
+}
+
+} // namespace jlang
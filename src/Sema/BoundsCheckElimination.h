@@ -0,0 +1,102 @@
+#pragma once
+
+#include "TypeTable.h"
+
+#include "../AST/Ast.h"
+#include "../AST/Expressions/Expressions.h"
+#include "../AST/Statements/Statements.h"
+#include "../AST/TopLevelDecl/TopLevelDecl.h"
+#include "../CodeGen/AstVisitor.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace jlang
+{
+
+// Runs after the ConstantFolder and clears isBoundsChecked on array and slice accesses whose index is known
+// to be in range, so they compile to plain loads and stores the vectorizer can work with. That is the case
+// for constant indices into an array, and for the index of
+//
+//     for (var i int32 = c; i < bound; i = i + 1) { ... s[i] ... }
+//
+// with c >= 0 and a body that neither assigns i nor s, when bound is jlen(s) or a constant no larger than
+// the length of array s. The index of parallel_for(c, bound) -> int32 i is handled the same way. Constant
+// indices outside of an array are errors.
+class BoundsCheckElimination : public AstVisitor
+{
+  public:
+    explicit BoundsCheckElimination(const TypeTable &typeTable);
+
+    void Run(const std::vector<std::shared_ptr<AstNode>> &program);
+
+  private:
+    virtual void VisitImportDecl(ImportDecl &) override;
+    virtual void VisitFunctionDecl(FunctionDecl &) override;
+    virtual void VisitInterfaceDecl(InterfaceDecl &) override;
+    virtual void VisitStructDecl(StructDecl &) override;
+    virtual void VisitVariableDecl(VariableDecl &) override;
+
+    virtual void VisitIfStatement(IfStatement &) override;
+    virtual void VisitWhileStatement(WhileStatement &) override;
+    virtual void VisitForStatement(ForStatement &) override;
+    virtual void VisitBlockStatement(BlockStatement &) override;
+    virtual void VisitExprStatement(ExprStatement &) override;
+    virtual void VisitReturnStatement(ReturnStatement &) override;
+
+    virtual void VisitCallExpr(CallExpr &) override;
+    virtual void VisitBinaryExpr(BinaryExpr &) override;
+    virtual void VisitLiteralExpr(LiteralExpr &) override;
+    virtual void VisitVarExpr(VarExpr &) override;
+    virtual void VisitCastExpr(CastExpr &) override;
+    virtual void VisitMemberExpr(MemberExpr &) override;
+    virtual void VisitIndexExpr(IndexExpr &) override;
+    virtual void VisitSizeofExpr(SizeofExpr &) override;
+    virtual void VisitAssignExpr(AssignExpr &) override;
+
+  private:
+    // While a loop body runs, index is in [0, jlen(sequence)), or in [0, bound) when sequence is empty.
+    // The accesses it cleared are checked again when the body turns out to assign index or sequence.
+    struct RangeFact
+    {
+        std::string index;
+        std::string sequence;
+        int32_t bound = 0;
+        std::vector<IndexExpr *> clearedAccesses;
+    };
+
+    void Visit(const std::shared_ptr<AstNode> &node);
+
+    void Declare(const std::string &name, TypeId type);
+    TypeId Lookup(const std::string &name) const;
+
+    // The fact 'index < bound' gives about index, false when bound is neither jlen of an array or slice
+    // nor a constant
+    bool MatchBound(const std::string &index, const AstNode *bound, RangeFact &fact) const;
+
+    // Visits a loop body with fact in effect, if there is one, and keeps what it cleared only when the
+    // body leaves the index and the sequence alone
+    void VisitLoopBody(const std::shared_ptr<AstNode> &body, RangeFact *fact);
+
+    static const LiteralExpr *AsNumber(const AstNode *node);
+    static const VarExpr *AsVar(const AstNode *node);
+
+    // 'x = y;' as the initializer or increment of a for loop
+    static const AssignExpr *AsAssign(const AstNode *statement);
+
+  private:
+    const TypeTable &m_TypeTable;
+    std::string m_FunctionName;
+
+    // Types of the variables in scope, innermost scope last
+    std::vector<std::unordered_map<std::string, TypeId>> m_Scopes;
+
+    std::vector<RangeFact> m_Facts;
+
+    // Every variable assigned or declared so far, loops look at what their body added
+    std::vector<std::string> m_Assigned;
+};
+
+} // namespace jlang
@@ -0,0 +1,954 @@
+#include "ConstEvaluator.h"
+
+#include "../Common/Logger.h"
+
+#include <algorithm>
+
+namespace jlang
+{
+
+// Every interpreted call nests a few frames of the compiler's own stack
+static constexpr uint32_t MaxCallDepth = 256;
+
+ConstEvaluator::ConstEvaluator(const TypeTable &typeTable, uint64_t maxSteps, uint64_t maxMemory)
+    : m_TypeTable(typeTable), m_MaxSteps(maxSteps), m_MaxMemory(maxMemory)
+{
+}
+
+void ConstEvaluator::DeclareUnit(const std::vector<std::shared_ptr<AstNode>> &program)
+{
+    for (const auto &node : program)
+    {
+        if (node && node->type == NodeType::FunctionDecl)
+        {
+            const auto &functionDecl = static_cast<const FunctionDecl &>(*node);
+
+            if (functionDecl.isConst)
+            {
+                m_ConstFunctions.emplace(functionDecl.name, &functionDecl);
+            }
+        }
+        else if (node && node->type == NodeType::VariableDecl)
+        {
+            auto &variableDecl = static_cast<VariableDecl &>(*node);
+            m_UnitConsts.emplace(variableDecl.name, &variableDecl);
+        }
+    }
+}
+
+void ConstEvaluator::Run(const std::vector<std::shared_ptr<AstNode>> &program)
+{
+    // Unit-level const vars first so the functions see all of them. One read by an earlier one, in this
+    // unit or another, is already done.
+    for (const auto &node : program)
+    {
+        if (node && node->type == NodeType::VariableDecl)
+        {
+            auto &variableDecl = static_cast<VariableDecl &>(*node);
+            auto it = m_UnitConsts.find(variableDecl.name);
+            bool isDone = it != m_UnitConsts.end() && it->second == &variableDecl && m_Globals.count(it->first);
+
+            if (!isDone)
+            {
+                m_Evaluating.push_back(variableDecl.name);
+                EvaluateConstVar(variableDecl);
+                m_Evaluating.pop_back();
+            }
+        }
+    }
+
+    for (const auto &node : program)
+    {
+        if (node && node->type == NodeType::FunctionDecl)
+        {
+            node->Accept(*this);
+        }
+    }
+}
+
+void ConstEvaluator::Evaluate(const std::shared_ptr<AstNode> &node)
+{
+    m_Value = Value();
+
+    if (!node || m_IsFailed)
+    {
+        return;
+    }
+
+    if (++m_Steps > m_MaxSteps)
+    {
+        Fail(STR("evaluation takes more than %llu steps, -fconst-steps=N raises the limit",
+                 static_cast<unsigned long long>(m_MaxSteps)));
+        return;
+    }
+
+    node->Accept(*this);
+}
+
+void ConstEvaluator::Fail(const std::string &message)
+{
+    // The first error of an evaluation is the one to report, the ones after it follow from it
+    if (!m_IsFailed)
+    {
+        JLANG_ERROR(STR("const %s: %s", m_ConstName.c_str(), message.c_str()));
+    }
+
+    m_IsFailed = true;
+}
+
+void ConstEvaluator::Scan(const std::shared_ptr<AstNode> &node)
+{
+    if (!node)
+    {
+        return;
+    }
+
+    switch (node->type)
+    {
+    case NodeType::BlockStatement:
+        m_Scopes.emplace_back();
+
+        for (const auto &statement : static_cast<BlockStatement &>(*node).statements)
+        {
+            Scan(statement);
+        }
+
+        m_Scopes.pop_back();
+        break;
+    case NodeType::IfStatement:
+        Scan(static_cast<IfStatement &>(*node).thenBranch);
+        Scan(static_cast<IfStatement &>(*node).elseBranch);
+        break;
+    case NodeType::WhileStatement:
+        Scan(static_cast<WhileStatement &>(*node).body);
+        break;
+    case NodeType::ForStatement:
+        m_Scopes.emplace_back();
+        Scan(static_cast<ForStatement &>(*node).initializer);
+        Scan(static_cast<ForStatement &>(*node).body);
+        m_Scopes.pop_back();
+        break;
+    case NodeType::ExprStatement:
+    {
+        // The body of a parallel_for is a block of its own with the index in scope
+        const auto &expression = static_cast<ExprStatement &>(*node).expression;
+
+        if (expression && expression->type == NodeType::CallExpr)
+        {
+            auto &call = static_cast<CallExpr &>(*expression);
+
+            if (call.closureBody)
+            {
+                m_Scopes.emplace_back();
+                Declare(call.closureIndex, Value::Runtime());
+                Scan(call.closureBody);
+                m_Scopes.pop_back();
+            }
+        }
+
+        break;
+    }
+    case NodeType::VariableDecl:
+    {
+        auto &decl = static_cast<VariableDecl &>(*node);
+
+        if (decl.isConst)
+        {
+            EvaluateConstVar(decl);
+        }
+        else
+        {
+            Declare(decl.name, Value::Runtime());
+        }
+
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void ConstEvaluator::EvaluateConstVar(VariableDecl &node)
+{
+    m_ConstName = node.name;
+    m_Steps = 0;
+    m_Memory = 0;
+    m_CallDepth = 0;
+    m_IsFailed = false;
+    m_IsReturning = false;
+
+    node.constValue.clear();
+
+    if (node.varType.id == InvalidTypeId)
+    {
+        return;
+    }
+
+    const TypeInfo &type = m_TypeTable.Get(node.varType.id);
+    bool isSequence = type.kind == TypeKind::Array || type.kind == TypeKind::Slice;
+    TypeId scalarType = isSequence ? type.element : node.varType.id;
+    TypeKind scalarKind = m_TypeTable.Get(scalarType).kind;
+
+    Value result;
+
+    if (node.varType.isAtomic || (scalarKind != TypeKind::Int32 && scalarKind != TypeKind::Char))
+    {
+        Fail(STR("%s is not a constant type, const vars hold int32 and char values and arrays, slices and "
+                 "strs of them",
+                 type.name.c_str()));
+    }
+    else if (!node.elementIndex.empty())
+    {
+        EvaluateElements(node, type, result);
+    }
+    else if (!node.initializer)
+    {
+        Fail("a const var needs an initializer");
+    }
+    else
+    {
+        Evaluate(node.initializer);
+        result = m_Value;
+    }
+
+    bool isChar = scalarKind == TypeKind::Char;
+
+    if (!m_IsFailed && !isSequence && AsNumber(result, "the initializer"))
+    {
+        int32_t number = isChar ? static_cast<int8_t>(result.number) : result.number;
+        node.constValue.push_back(number);
+    }
+
+    if (!m_IsFailed && isSequence && AsSequence(result, "the initializer"))
+    {
+        if (type.kind == TypeKind::Array && static_cast<uint32_t>(result.length) != type.length)
+        {
+            Fail(STR("%s holds %u elements, its initializer has %d", type.name.c_str(), type.length,
+                     result.length));
+        }
+
+        for (int32_t i = 0; i < result.length && !m_IsFailed; ++i)
+        {
+            int32_t element = result.storage->elements[result.offset + static_cast<size_t>(i)];
+            node.constValue.push_back(isChar ? static_cast<int8_t>(element) : element);
+        }
+    }
+
+    if (m_IsFailed)
+    {
+        node.constValue.clear();
+        Declare(node.name, Value::Runtime());
+        return;
+    }
+
+    Value constant{node.constValue.empty() ? 0 : node.constValue[0]};
+
+    if (isSequence)
+    {
+        constant.storage = std::make_shared<Storage>(Storage{node.constValue, isChar, true});
+        constant.length = static_cast<int32_t>(node.constValue.size());
+    }
+
+    Declare(node.name, constant);
+
+    JLANG_REMARK("const-eval", STR("%s: computed in %llu steps", node.name.c_str(),
+                                   static_cast<unsigned long long>(m_Steps)));
+}
+
+bool ConstEvaluator::EvaluateElements(VariableDecl &node, const TypeInfo &type, Value &result)
+{
+    if (type.kind != TypeKind::Array || !node.initializer)
+    {
+        Fail(STR("'-> int32 %s' needs an array and an initializer for its elements",
+                 node.elementIndex.c_str()));
+        return false;
+    }
+
+    // The elements before the one being computed can be read through the array itself
+    Value array = MakeArray(static_cast<int32_t>(type.length), IsCharType(type.element));
+
+    m_Scopes.emplace_back();
+    Declare(node.name, array);
+
+    for (int32_t i = 0; i < array.length && !m_IsFailed; ++i)
+    {
+        Declare(node.elementIndex, Value{i});
+        Evaluate(node.initializer);
+
+        if (!m_IsFailed && AsNumber(m_Value, "an element"))
+        {
+            array.storage->elements[static_cast<size_t>(i)] =
+                array.storage->isChar ? static_cast<int8_t>(m_Value.number) : m_Value.number;
+        }
+    }
+
+    m_Scopes.pop_back();
+
+    result = array;
+    return !m_IsFailed;
+}
+
+ConstEvaluator::Value *ConstEvaluator::EvaluateUnitConst(const std::string &name)
+{
+    auto unitConst = m_UnitConsts.find(name);
+
+    if (unitConst == m_UnitConsts.end())
+    {
+        return nullptr;
+    }
+
+    auto cycle = std::find(m_Evaluating.begin(), m_Evaluating.end(), name);
+
+    if (cycle != m_Evaluating.end())
+    {
+        std::string path;
+
+        for (auto it = cycle; it != m_Evaluating.end(); ++it)
+        {
+            path += *it + " -> ";
+        }
+
+        Fail(STR("%s depends on itself: %s%s", name.c_str(), path.c_str(), name.c_str()));
+        return nullptr;
+    }
+
+    // The reader's evaluation resumes once the const var is done
+    std::string constName = std::move(m_ConstName);
+    uint64_t steps = m_Steps;
+    uint64_t memory = m_Memory;
+    uint32_t callDepth = m_CallDepth;
+    bool isFailed = m_IsFailed;
+    bool isReturning = m_IsReturning;
+    Value value = std::move(m_Value);
+    std::vector<Scope> scopes = std::move(m_Scopes);
+
+    m_Scopes.clear();
+    m_Evaluating.push_back(name);
+    EvaluateConstVar(*unitConst->second);
+    m_Evaluating.pop_back();
+
+    bool isDependencyFailed = m_IsFailed;
+
+    m_ConstName = std::move(constName);
+    m_Steps = steps;
+    m_Memory = memory;
+    m_CallDepth = callDepth;
+    m_IsFailed = isFailed || isDependencyFailed;
+    m_IsReturning = isReturning;
+    m_Value = std::move(value);
+    m_Scopes = std::move(scopes);
+
+    // The failed const var reported its own error, the reader fails with it
+    auto it = m_Globals.find(name);
+    return it != m_Globals.end() && !isDependencyFailed ? &it->second : nullptr;
+}
+
+void ConstEvaluator::Declare(const std::string &name, Value value)
+{
+    Scope &scope = m_Scopes.empty() ? m_Globals : m_Scopes.back();
+    scope[name] = std::move(value);
+}
+
+ConstEvaluator::Value *ConstEvaluator::Lookup(const std::string &name)
+{
+    for (auto scope = m_Scopes.rbegin(); scope != m_Scopes.rend(); ++scope)
+    {
+        auto it = scope->find(name);
+
+        if (it != scope->end())
+        {
+            return &it->second;
+        }
+    }
+
+    auto it = m_Globals.find(name);
+    return it != m_Globals.end() ? &it->second : EvaluateUnitConst(name);
+}
+
+ConstEvaluator::Value ConstEvaluator::MakeArray(int32_t length, bool isChar)
+{
+    Value array;
+    array.storage = std::make_shared<Storage>();
+    array.storage->isChar = isChar;
+
+    uint64_t size = static_cast<uint64_t>(std::max(length, 0)) * (isChar ? 1 : sizeof(int32_t));
+
+    if (m_Memory + size > m_MaxMemory)
+    {
+        Fail(STR("arrays take more than %llu bytes, -fconst-memory=N raises the limit",
+                 static_cast<unsigned long long>(m_MaxMemory)));
+        return array;
+    }
+
+    m_Memory += size;
+    array.storage->elements.assign(static_cast<size_t>(std::max(length, 0)), 0);
+    array.length = std::max(length, 0);
+
+    return array;
+}
+
+bool ConstEvaluator::AsNumber(const Value &value, const char *what)
+{
+    if (value.storage)
+    {
+        Fail(STR("%s must be an int32 or a char", what));
+        return false;
+    }
+
+    return !m_IsFailed;
+}
+
+bool ConstEvaluator::AsSequence(const Value &value, const char *what)
+{
+    if (!value.storage)
+    {
+        Fail(STR("%s must be an array, a slice or a str", what));
+        return false;
+    }
+
+    return !m_IsFailed;
+}
+
+bool ConstEvaluator::IsCharType(TypeId id) const
+{
+    return id != InvalidTypeId && m_TypeTable.Get(id).kind == TypeKind::Char;
+}
+
+void ConstEvaluator::VisitFunctionDecl(FunctionDecl &node)
+{
+    m_Scopes.clear();
+    m_Scopes.emplace_back();
+
+    for (const Parameter &param : node.params)
+    {
+        Declare(param.name, Value::Runtime());
+    }
+
+    Scan(node.body);
+
+    m_Scopes.clear();
+}
+
+void ConstEvaluator::VisitImportDecl(ImportDecl &) {}
+
+void ConstEvaluator::VisitInterfaceDecl(InterfaceDecl &) {}
+
+void ConstEvaluator::VisitStructDecl(StructDecl &) {}
+
+void ConstEvaluator::VisitVariableDecl(VariableDecl &node)
+{
+    if (node.varType.id == InvalidTypeId)
+    {
+        Fail(STR("%s has an unknown type", node.name.c_str()));
+        return;
+    }
+
+    const TypeInfo &type = m_TypeTable.Get(node.varType.id);
+    Value value;
+
+    switch (node.varType.isAtomic ? TypeKind::Void : type.kind)
+    {
+    case TypeKind::Int32:
+    case TypeKind::Char:
+        Evaluate(node.initializer);
+
+        if (!AsNumber(m_Value, node.name.c_str()))
+        {
+            return;
+        }
+
+        value.number = type.kind == TypeKind::Char ? static_cast<int8_t>(m_Value.number) : m_Value.number;
+        break;
+    case TypeKind::Array:
+        value = MakeArray(static_cast<int32_t>(type.length), IsCharType(type.element));
+        break;
+    case TypeKind::Slice:
+        if (!node.initializer)
+        {
+            value = MakeArray(0, IsCharType(type.element));
+            break;
+        }
+
+        Evaluate(node.initializer);
+
+        if (!AsSequence(m_Value, node.name.c_str()))
+        {
+            return;
+        }
+
+        value = m_Value;
+        break;
+    default:
+        Fail(STR("%s: %s values can't be computed while compiling", node.name.c_str(), type.name.c_str()));
+        return;
+    }
+
+    Declare(node.name, value);
+}
+
+void ConstEvaluator::VisitIfStatement(IfStatement &node)
+{
+    Evaluate(node.condition);
+
+    if (!AsNumber(m_Value, "an if condition"))
+    {
+        return;
+    }
+
+    Evaluate(m_Value.number != 0 ? node.thenBranch : node.elseBranch);
+}
+
+void ConstEvaluator::VisitWhileStatement(WhileStatement &node)
+{
+    while (!m_IsFailed && !m_IsReturning)
+    {
+        Evaluate(node.condition);
+
+        if (!AsNumber(m_Value, "a loop condition") || m_Value.number == 0)
+        {
+            break;
+        }
+
+        Evaluate(node.body);
+    }
+}
+
+void ConstEvaluator::VisitForStatement(ForStatement &node)
+{
+    m_Scopes.emplace_back();
+    Evaluate(node.initializer);
+
+    while (!m_IsFailed && !m_IsReturning)
+    {
+        if (node.condition)
+        {
+            Evaluate(node.condition);
+
+            if (!AsNumber(m_Value, "a loop condition") || m_Value.number == 0)
+            {
+                break;
+            }
+        }
+
+        Evaluate(node.body);
+
+        if (!m_IsReturning)
+        {
+            Evaluate(node.increment);
+        }
+    }
+
+    m_Scopes.pop_back();
+}
+
+void ConstEvaluator::VisitBlockStatement(BlockStatement &node)
+{
+    m_Scopes.emplace_back();
+
+    for (const auto &statement : node.statements)
+    {
+        Evaluate(statement);
+
+        if (m_IsFailed || m_IsReturning)
+        {
+            break;
+        }
+    }
+
+    m_Scopes.pop_back();
+}
+
+void ConstEvaluator::VisitExprStatement(ExprStatement &node)
+{
+    Evaluate(node.expression);
+}
+
+void ConstEvaluator::VisitReturnStatement(ReturnStatement &node)
+{
+    Evaluate(node.value);
+    m_IsReturning = !m_IsFailed;
+}
+
+void ConstEvaluator::VisitCallExpr(CallExpr &node)
+{
+    if (node.isSpawned || node.isAwaited || node.closureBody)
+    {
+        Fail(STR("%s: tasks and async calls don't run while compiling", node.callee.c_str()));
+        return;
+    }
+
+    if (node.callee == "jlen" && node.arguments.size() == 1)
+    {
+        Evaluate(node.arguments[0]);
+
+        if (AsSequence(m_Value, "the argument of jlen"))
+        {
+            m_Value = Value{m_Value.length};
+        }
+
+        return;
+    }
+
+    if (node.callee == "jslice" && node.arguments.size() == 3)
+    {
+        Evaluate(node.arguments[0]);
+        Value slice = m_Value;
+
+        if (!AsSequence(slice, "the first argument of jslice"))
+        {
+            return;
+        }
+
+        Evaluate(node.arguments[1]);
+        int32_t from = m_Value.number;
+
+        if (!AsNumber(m_Value, "the start of a jslice"))
+        {
+            return;
+        }
+
+        Evaluate(node.arguments[2]);
+        int32_t to = m_Value.number;
+
+        if (!AsNumber(m_Value, "the end of a jslice"))
+        {
+            return;
+        }
+
+        // Clamped like the generated code clamps it
+        to = std::min(std::max(to, 0), slice.length);
+        from = std::min(std::max(from, 0), to);
+
+        slice.offset += static_cast<size_t>(from);
+        slice.length = to - from;
+        m_Value = slice;
+        return;
+    }
+
+    auto it = m_ConstFunctions.find(node.callee);
+
+    if (it == m_ConstFunctions.end())
+    {
+        Fail(STR("%s is not a const function", node.callee.c_str()));
+        return;
+    }
+
+    CallFunction(node, *it->second);
+}
+
+void ConstEvaluator::CallFunction(CallExpr &node, const FunctionDecl &function)
+{
+    const char *name = function.name.c_str();
+
+    if (node.arguments.size() != function.params.size())
+    {
+        Fail(STR("%s takes %zu arguments, not %zu", name, function.params.size(), node.arguments.size()));
+        return;
+    }
+
+    if (!function.body)
+    {
+        Fail(STR("%s has no body to run, it is declared in a module interface", name));
+        return;
+    }
+
+    if (m_CallDepth >= MaxCallDepth)
+    {
+        Fail(STR("calls of %s nest deeper than %u", name, MaxCallDepth));
+        return;
+    }
+
+    Scope frame;
+
+    if (!function.params.empty())
+    {
+        const Parameter &param = function.params[0];
+        TypeId paramType = param.type.id;
+        TypeKind kind = paramType == InvalidTypeId ? TypeKind::Void : m_TypeTable.Get(paramType).kind;
+
+        Evaluate(node.arguments[0]);
+
+        if (kind == TypeKind::Int32 || kind == TypeKind::Char)
+        {
+            if (!AsNumber(m_Value, param.name.c_str()))
+            {
+                return;
+            }
+
+            m_Value.number = kind == TypeKind::Char ? static_cast<int8_t>(m_Value.number) : m_Value.number;
+        }
+        else if (kind != TypeKind::Slice || !AsSequence(m_Value, param.name.c_str()))
+        {
+            Fail(STR("%s: parameter %s can't be passed while compiling", name, param.name.c_str()));
+            return;
+        }
+
+        frame[param.name] = m_Value;
+    }
+
+    TypeId returnType = function.returnType.id;
+    TypeKind returnKind = returnType == InvalidTypeId ? TypeKind::Pointer : m_TypeTable.Get(returnType).kind;
+
+    if (returnKind != TypeKind::Int32 && returnKind != TypeKind::Void)
+    {
+        const char *typeName = function.returnType.name.c_str();
+        Fail(STR("%s returns %s, which can't be computed while compiling", name, typeName));
+        return;
+    }
+
+    // The callee sees its parameter and the unit-level const vars, none of the caller's locals
+    std::vector<Scope> callerScopes = std::move(m_Scopes);
+    m_Scopes.clear();
+    m_Scopes.push_back(std::move(frame));
+    ++m_CallDepth;
+
+    Evaluate(function.body);
+
+    // Falling off the end returns zero, like in the generated code
+    Value result = m_IsReturning ? m_Value : Value();
+
+    --m_CallDepth;
+    m_IsReturning = false;
+    m_Scopes = std::move(callerScopes);
+
+    if (returnKind == TypeKind::Int32 && !m_IsFailed)
+    {
+        AsNumber(result, "a return value");
+    }
+
+    m_Value = result;
+}
+
+void ConstEvaluator::VisitBinaryExpr(BinaryExpr &node)
+{
+    Evaluate(node.left);
+    Value lhs = m_Value;
+
+    Evaluate(node.right);
+    Value rhs = m_Value;
+
+    if (m_IsFailed)
+    {
+        return;
+    }
+
+    const std::string &op = node.op;
+
+    if (!lhs.storage && !rhs.storage)
+    {
+        // int32 arithmetic wraps in the generated code, so it does here too
+        auto left = static_cast<uint32_t>(lhs.number);
+        auto right = static_cast<uint32_t>(rhs.number);
+
+        if (op == "+" || op == "-" || op == "*")
+        {
+            uint32_t result = op == "+" ? left + right : op == "-" ? left - right : left * right;
+            m_Value = Value{static_cast<int32_t>(result)};
+            return;
+        }
+
+        if (op == "<" || op == ">" || op == "==" || op == "!=")
+        {
+            bool result = op == "<"    ? lhs.number < rhs.number
+                          : op == ">"  ? lhs.number > rhs.number
+                          : op == "==" ? lhs.number == rhs.number
+                                       : lhs.number != rhs.number;
+            m_Value = Value{result ? 1 : 0};
+            return;
+        }
+    }
+    else if (lhs.storage && rhs.storage && (op == "<" || op == ">" || op == "==" || op == "!="))
+    {
+        // strs compare by their bytes, a prefix before the longer string
+        auto lhsBegin = lhs.storage->elements.begin() + static_cast<std::ptrdiff_t>(lhs.offset);
+        auto rhsBegin = rhs.storage->elements.begin() + static_cast<std::ptrdiff_t>(rhs.offset);
+        auto byteLess = [](int32_t a, int32_t b) {
+            return static_cast<uint8_t>(a) < static_cast<uint8_t>(b);
+        };
+
+        bool isLess = std::lexicographical_compare(lhsBegin, lhsBegin + lhs.length, rhsBegin,
+                                                   rhsBegin + rhs.length, byteLess);
+        bool isGreater = std::lexicographical_compare(rhsBegin, rhsBegin + rhs.length, lhsBegin,
+                                                      lhsBegin + lhs.length, byteLess);
+
+        bool result = op == "<"    ? isLess
+                      : op == ">"  ? isGreater
+                      : op == "==" ? !isLess && !isGreater
+                                   : isLess || isGreater;
+        m_Value = Value{result ? 1 : 0};
+        return;
+    }
+
+    Fail(STR("operator %s is not supported on these operands while compiling", op.c_str()));
+}
+
+void ConstEvaluator::VisitLiteralExpr(LiteralExpr &node)
+{
+    if (node.kind == LiteralKind::Number)
+    {
+        m_Value = Value{node.numberValue};
+        return;
+    }
+
+    if (node.kind == LiteralKind::Null)
+    {
+        Fail("pointers can't be computed while compiling");
+        return;
+    }
+
+    Value text = MakeArray(static_cast<int32_t>(node.value.size()), true);
+
+    if (m_IsFailed)
+    {
+        return;
+    }
+
+    std::transform(node.value.begin(), node.value.end(), text.storage->elements.begin(),
+                   [](char c) { return static_cast<int32_t>(static_cast<int8_t>(c)); });
+
+    // Literals live in read-only memory in the generated code
+    text.storage->isConst = true;
+    m_Value = text;
+}
+
+void ConstEvaluator::VisitVarExpr(VarExpr &node)
+{
+    Value *value = Lookup(node.name);
+
+    if (!value)
+    {
+        Fail(STR("%s is not declared", node.name.c_str()));
+        return;
+    }
+
+    if (value->isRuntime)
+    {
+        Fail(STR("%s is not a constant", node.name.c_str()));
+        return;
+    }
+
+    m_Value = *value;
+}
+
+void ConstEvaluator::VisitCastExpr(CastExpr &)
+{
+    Fail("casts can't be evaluated while compiling");
+}
+
+void ConstEvaluator::VisitMemberExpr(MemberExpr &node)
+{
+    Fail(STR("struct member %s can't be read while compiling", node.member.c_str()));
+}
+
+void ConstEvaluator::VisitIndexExpr(IndexExpr &node)
+{
+    Evaluate(node.object);
+    Value sequence = m_Value;
+
+    if (!AsSequence(sequence, "an indexed value"))
+    {
+        return;
+    }
+
+    Evaluate(node.index);
+
+    if (!AsNumber(m_Value, "an index"))
+    {
+        return;
+    }
+
+    if (m_Value.number < 0 || m_Value.number >= sequence.length)
+    {
+        Fail(STR("index %d is out of bounds for length %d", m_Value.number, sequence.length));
+        return;
+    }
+
+    m_Value = Value{sequence.storage->elements[sequence.offset + static_cast<size_t>(m_Value.number)]};
+}
+
+void ConstEvaluator::VisitSizeofExpr(SizeofExpr &node)
+{
+    Fail(STR("sizeof(%s) is not known while compiling", node.targetType.name.c_str()));
+}
+
+void ConstEvaluator::VisitAssignExpr(AssignExpr &node)
+{
+    Evaluate(node.value);
+    Value value = m_Value;
+
+    if (m_IsFailed)
+    {
+        return;
+    }
+
+    if (node.target->type == NodeType::VarExpr)
+    {
+        const std::string &name = static_cast<const VarExpr &>(*node.target).name;
+        Value *target = nullptr;
+
+        // Only locals can change, unit-level const vars are never assigned
+        for (auto scope = m_Scopes.rbegin(); scope != m_Scopes.rend() && !target; ++scope)
+        {
+            auto it = scope->find(name);
+            target = it != scope->end() ? &it->second : nullptr;
+        }
+
+        if (!target || target->isRuntime || (target->storage && target->storage->isConst))
+        {
+            Fail(STR("%s can't be assigned while compiling", name.c_str()));
+            return;
+        }
+
+        if (!target->storage != !value.storage)
+        {
+            Fail(STR("%s is assigned a value of another type", name.c_str()));
+            return;
+        }
+
+        *target = value;
+        m_Value = value;
+        return;
+    }
+
+    if (node.target->type != NodeType::IndexExpr)
+    {
+        Fail("only variables and elements can be assigned while compiling");
+        return;
+    }
+
+    auto &target = static_cast<IndexExpr &>(*node.target);
+
+    Evaluate(target.object);
+    Value sequence = m_Value;
+
+    if (!AsSequence(sequence, "an indexed value") || !AsNumber(value, "an element"))
+    {
+        return;
+    }
+
+    if (sequence.storage->isConst)
+    {
+        Fail("the elements of a const and of a literal can't be assigned");
+        return;
+    }
+
+    Evaluate(target.index);
+
+    if (!AsNumber(m_Value, "an index"))
+    {
+        return;
+    }
+
+    if (m_Value.number < 0 || m_Value.number >= sequence.length)
+    {
+        Fail(STR("index %d is out of bounds for length %d", m_Value.number, sequence.length));
+        return;
+    }
+
+    int32_t &element = sequence.storage->elements[sequence.offset + static_cast<size_t>(m_Value.number)];
+    element = sequence.storage->isChar ? static_cast<int8_t>(value.number) : value.number;
+
+    m_Value = value;
+}
+
+} // namespace jlang
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "TypeTable.h"
+
+#include "../AST/Ast.h"
+#include "../AST/Expressions/Expressions.h"
+#include "../AST/Statements/Statements.h"
+#include "../AST/TopLevelDecl/TopLevelDecl.h"
+#include "../CodeGen/AstVisitor.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace jlang
+{
+
+// Runs after the ConstantFolder and computes the initializer of every const var by interpreting the AST,
+// so codegen emits the result as a constant instead of code that computes it at startup. Initializers may
+// use literals, other const vars, jlen, jslice and calls to const functions, which run with int32 and
+// char scalars and arrays, slices and strs of them; anything else is an error. Each const var gets a
+// budget of AST nodes to visit and of bytes for the arrays it creates, exceeding either fails it.
+class ConstEvaluator : public AstVisitor
+{
+  public:
+    ConstEvaluator(const TypeTable &typeTable, uint64_t maxSteps, uint64_t maxMemory);
+
+    // Makes the const functions and unit-level const vars of a unit usable from every unit, whatever the
+    // order of the units
+    void DeclareUnit(const std::vector<std::shared_ptr<AstNode>> &program);
+
+    void Run(const std::vector<std::shared_ptr<AstNode>> &program);
+
+  private:
+    virtual void VisitImportDecl(ImportDecl &) override;
+    virtual void VisitFunctionDecl(FunctionDecl &) override;
+    virtual void VisitInterfaceDecl(InterfaceDecl &) override;
+    virtual void VisitStructDecl(StructDecl &) override;
+    virtual void VisitVariableDecl(VariableDecl &) override;
+
+    virtual void VisitIfStatement(IfStatement &) override;
+    virtual void VisitWhileStatement(WhileStatement &) override;
+    virtual void VisitForStatement(ForStatement &) override;
+    virtual void VisitBlockStatement(BlockStatement &) override;
+    virtual void VisitExprStatement(ExprStatement &) override;
+    virtual void VisitReturnStatement(ReturnStatement &) override;
+
+    virtual void VisitCallExpr(CallExpr &) override;
+    virtual void VisitBinaryExpr(BinaryExpr &) override;
+    virtual void VisitLiteralExpr(LiteralExpr &) override;
+    virtual void VisitVarExpr(VarExpr &) override;
+    virtual void VisitCastExpr(CastExpr &) override;
+    virtual void VisitMemberExpr(MemberExpr &) override;
+    virtual void VisitIndexExpr(IndexExpr &) override;
+    virtual void VisitSizeofExpr(SizeofExpr &) override;
+    virtual void VisitAssignExpr(AssignExpr &) override;
+
+  private:
+    // Elements of an array, shared by the slices of it. Chars are kept as int32 holding their int8 value.
+    struct Storage
+    {
+        std::vector<int32_t> elements;
+        bool isChar = false;
+        bool isConst = false;
+    };
+
+    // A scalar, or elements [offset, offset + length) of storage. Locals of the function being compiled
+    // are bound as runtime values, which a const var initializer must not use.
+    struct Value
+    {
+        Value() = default;
+        explicit Value(int32_t number) : number(number) {}
+
+        static Value Runtime()
+        {
+            Value value;
+            value.isRuntime = true;
+            return value;
+        }
+
+        int32_t number = 0;
+        std::shared_ptr<Storage> storage;
+        size_t offset = 0;
+        int32_t length = 0;
+        bool isRuntime = false;
+    };
+
+    using Scope = std::unordered_map<std::string, Value>;
+
+    void Evaluate(const std::shared_ptr<AstNode> &node);
+    void Fail(const std::string &message);
+
+    // Walks a function outside of evaluation, evaluating the const vars it declares
+    void Scan(const std::shared_ptr<AstNode> &node);
+
+    // Computes node.constValue and binds the const var in the innermost scope
+    void EvaluateConstVar(VariableDecl &node);
+    bool EvaluateElements(VariableDecl &node, const TypeInfo &type, Value &result);
+
+    // Evaluates the unit-level const var a name refers to when it is first read, with its own budgets
+    Value *EvaluateUnitConst(const std::string &name);
+
+    void Declare(const std::string &name, Value value);
+    Value *Lookup(const std::string &name);
+
+    Value MakeArray(int32_t length, bool isChar);
+    bool AsNumber(const Value &value, const char *what);
+    bool AsSequence(const Value &value, const char *what);
+    bool IsCharType(TypeId id) const;
+
+    void CallFunction(CallExpr &node, const FunctionDecl &function);
+
+  private:
+    const TypeTable &m_TypeTable;
+    const uint64_t m_MaxSteps;
+    const uint64_t m_MaxMemory;
+
+    std::unordered_map<std::string, const FunctionDecl *> m_ConstFunctions;
+    std::unordered_map<std::string, VariableDecl *> m_UnitConsts;
+
+    // The unit-level const vars being evaluated, each waiting on the next one
+    std::vector<std::string> m_Evaluating;
+
+    // Unit-level const vars, then the scopes of the function being scanned or called
+    Scope m_Globals;
+    std::vector<Scope> m_Scopes;
+
+    // The const var being evaluated and what it used of its budgets so far
+    std::string m_ConstName;
+    uint64_t m_Steps = 0;
+    uint64_t m_Memory = 0;
+    uint32_t m_CallDepth = 0;
+    bool m_IsFailed = false;
+
+    Value m_Value;
+    bool m_IsReturning = false;
+};
+
+} // namespace jlang
@@ -0,0 +1,267 @@
+#include "ConstantFolder.h"
+
+#include <cstdint>
+
+namespace jlang
+{
+
+void ConstantFolder::Run(std::vector<std::shared_ptr<AstNode>> &program)
+{
+    for (const auto &node : program)
+    {
+        if (node)
+        {
+            node->Accept(*this);
+        }
+    }
+}
+
+void ConstantFolder::Fold(std::shared_ptr<AstNode> &node)
+{
+    if (!node)
+    {
+        return;
+    }
+
+    m_Replacement.reset();
+    node->Accept(*this);
+
+    if (m_Replacement)
+    {
+        node = std::move(m_Replacement);
+    }
+
+    m_Replacement.reset();
+}
+
+void ConstantFolder::VisitFunctionDecl(FunctionDecl &node)
+{
+    Fold(node.body);
+}
+
+void ConstantFolder::VisitImportDecl(ImportDecl &) {}
+
+void ConstantFolder::VisitInterfaceDecl(InterfaceDecl &) {}
+
+void ConstantFolder::VisitStructDecl(StructDecl &) {}
+
+void ConstantFolder::VisitVariableDecl(VariableDecl &node)
+{
+    Fold(node.initializer);
+}
+
+void ConstantFolder::VisitIfStatement(IfStatement &node)
+{
+    Fold(node.condition);
+
+    if (node.condition && node.condition->type == NodeType::LiteralExpr)
+    {
+        const auto &condition = static_cast<const LiteralExpr &>(*node.condition);
+
+        if (condition.kind == LiteralKind::Number || condition.kind == LiteralKind::Null)
+        {
+            bool isTaken = condition.kind == LiteralKind::Number && condition.numberValue != 0;
+            std::shared_ptr<AstNode> branch = isTaken ? node.thenBranch : node.elseBranch;
+
+            Fold(branch);
+            m_Replacement = branch ? branch : std::make_shared<BlockStatement>();
+            return;
+        }
+    }
+
+    Fold(node.thenBranch);
+    Fold(node.elseBranch);
+}
+
+void ConstantFolder::VisitWhileStatement(WhileStatement &node)
+{
+    Fold(node.condition);
+
+    if (IsConstantFalse(node.condition.get()))
+    {
+        m_Replacement = std::make_shared<BlockStatement>();
+        return;
+    }
+
+    Fold(node.body);
+}
+
+void ConstantFolder::VisitForStatement(ForStatement &node)
+{
+    Fold(node.initializer);
+    Fold(node.condition);
+
+    // The initializer still runs once, its side effects and declaration are kept
+    if (IsConstantFalse(node.condition.get()))
+    {
+        auto block = std::make_shared<BlockStatement>();
+
+        if (node.initializer)
+        {
+            block->statements.push_back(node.initializer);
+        }
+
+        m_Replacement = block;
+        return;
+    }
+
+    Fold(node.increment);
+    Fold(node.body);
+}
+
+void ConstantFolder::VisitBlockStatement(BlockStatement &node)
+{
+    for (auto &statement : node.statements)
+    {
+        Fold(statement);
+    }
+}
+
+void ConstantFolder::VisitExprStatement(ExprStatement &node)
+{
+    Fold(node.expression);
+}
+
+void ConstantFolder::VisitReturnStatement(ReturnStatement &node)
+{
+    Fold(node.value);
+}
+
+void ConstantFolder::VisitCallExpr(CallExpr &node)
+{
+    for (auto &argument : node.arguments)
+    {
+        Fold(argument);
+    }
+
+    Fold(node.closureBody);
+}
+
+void ConstantFolder::VisitBinaryExpr(BinaryExpr &node)
+{
+    Fold(node.left);
+    Fold(node.right);
+
+    if (!node.left || !node.right || node.left->type != NodeType::LiteralExpr ||
+        node.right->type != NodeType::LiteralExpr)
+    {
+        return;
+    }
+
+    const auto &lhs = static_cast<const LiteralExpr &>(*node.left);
+    const auto &rhs = static_cast<const LiteralExpr &>(*node.right);
+
+    if (lhs.kind == LiteralKind::Null && rhs.kind == LiteralKind::Null)
+    {
+        if (node.op == "==" || node.op == "!=")
+        {
+            m_Replacement = MakeNumber(node.op == "==" ? 1 : 0);
+        }
+
+        return;
+    }
+
+    // strs compare by content, so two literals are equal exactly when their text is
+    if (lhs.kind == LiteralKind::String && rhs.kind == LiteralKind::String)
+    {
+        if (node.op == "==" || node.op == "!=")
+        {
+            m_Replacement = MakeNumber((lhs.value == rhs.value) == (node.op == "=="));
+        }
+
+        return;
+    }
+
+    if (lhs.kind != LiteralKind::Number || rhs.kind != LiteralKind::Number)
+    {
+        return;
+    }
+
+    // int32 arithmetic wraps in the generated code, so fold it the same way
+    auto left = static_cast<uint32_t>(lhs.numberValue);
+    auto right = static_cast<uint32_t>(rhs.numberValue);
+
+    if (node.op == "+")
+    {
+        m_Replacement = MakeNumber(static_cast<int32_t>(left + right));
+    }
+    else if (node.op == "-")
+    {
+        m_Replacement = MakeNumber(static_cast<int32_t>(left - right));
+    }
+    else if (node.op == "*")
+    {
+        m_Replacement = MakeNumber(static_cast<int32_t>(left * right));
+    }
+    else if (node.op == "==")
+    {
+        m_Replacement = MakeNumber(lhs.numberValue == rhs.numberValue);
+    }
+    else if (node.op == "!=")
+    {
+        m_Replacement = MakeNumber(lhs.numberValue != rhs.numberValue);
+    }
+    else if (node.op == "<")
+    {
+        m_Replacement = MakeNumber(lhs.numberValue < rhs.numberValue);
+    }
+    else if (node.op == ">")
+    {
+        m_Replacement = MakeNumber(lhs.numberValue > rhs.numberValue);
+    }
+}
+
+void ConstantFolder::VisitLiteralExpr(LiteralExpr &) {}
+
+void ConstantFolder::VisitVarExpr(VarExpr &) {}
+
+void ConstantFolder::VisitCastExpr(CastExpr &node)
+{
+    Fold(node.expr);
+}
+
+void ConstantFolder::VisitMemberExpr(MemberExpr &node)
+{
+    Fold(node.object);
+}
+
+void ConstantFolder::VisitIndexExpr(IndexExpr &node)
+{
+    Fold(node.object);
+    Fold(node.index);
+}
+
+// Codegen emits the size of the type it lowered, which the data layout folds; the folder would have to
+// repeat the lowering of slices, soa row references and the structs of other units to get it right
+void ConstantFolder::VisitSizeofExpr(SizeofExpr &) {}
+
+void ConstantFolder::VisitAssignExpr(AssignExpr &node)
+{
+    Fold(node.target);
+    Fold(node.value);
+}
+
+bool ConstantFolder::IsConstantFalse(const AstNode *condition)
+{
+    if (!condition || condition->type != NodeType::LiteralExpr)
+    {
+        return false;
+    }
+
+    const auto &literal = static_cast<const LiteralExpr &>(*condition);
+
+    return literal.kind == LiteralKind::Null ||
+           (literal.kind == LiteralKind::Number && literal.numberValue == 0);
+}
+
+std::shared_ptr<LiteralExpr> ConstantFolder::MakeNumber(int32_t value)
+{
+    auto literal = std::make_shared<LiteralExpr>();
+    literal->kind = LiteralKind::Number;
+    literal->value = std::to_string(value);
+    literal->numberValue = value;
+
+    return literal;
+}
+
+} // namespace jlang
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../AST/Ast.h"
+#include "../AST/Expressions/Expressions.h"
+#include "../AST/Statements/Statements.h"
+#include "../AST/TopLevelDecl/TopLevelDecl.h"
+#include "../CodeGen/AstVisitor.h"
+
+#include <memory>
+#include <vector>
+
+namespace jlang
+{
+
+// Runs between Parser::Parse and CodeGenerator::Generate. Folds integer BinaryExprs whose operands are
+// literals and replaces an IfStatement whose condition folds to a constant with the branch that is
+// taken, so codegen never sees the dead one. Loops whose condition folds to false are dropped the same way.
+class ConstantFolder : public AstVisitor
+{
+  public:
+    void Run(std::vector<std::shared_ptr<AstNode>> &program);
+
+  private:
+    virtual void VisitImportDecl(ImportDecl &) override;
+    virtual void VisitFunctionDecl(FunctionDecl &) override;
+    virtual void VisitInterfaceDecl(InterfaceDecl &) override;
+    virtual void VisitStructDecl(StructDecl &) override;
+    virtual void VisitVariableDecl(VariableDecl &) override;
+
+    virtual void VisitIfStatement(IfStatement &) override;
+    virtual void VisitWhileStatement(WhileStatement &) override;
+    virtual void VisitForStatement(ForStatement &) override;
+    virtual void VisitBlockStatement(BlockStatement &) override;
+    virtual void VisitExprStatement(ExprStatement &) override;
+    virtual void VisitReturnStatement(ReturnStatement &) override;
+
+    virtual void VisitCallExpr(CallExpr &) override;
+    virtual void VisitBinaryExpr(BinaryExpr &) override;
+    virtual void VisitLiteralExpr(LiteralExpr &) override;
+    virtual void VisitVarExpr(VarExpr &) override;
+    virtual void VisitCastExpr(CastExpr &) override;
+    virtual void VisitMemberExpr(MemberExpr &) override;
+    virtual void VisitIndexExpr(IndexExpr &) override;
+    virtual void VisitSizeofExpr(SizeofExpr &) override;
+    virtual void VisitAssignExpr(AssignExpr &) override;
+
+  private:
+    // Visits node and swaps it for the replacement the visit produced, if any
+    void Fold(std::shared_ptr<AstNode> &node);
+
+    static bool IsConstantFalse(const AstNode *condition);
+    static std::shared_ptr<LiteralExpr> MakeNumber(int32_t value);
+
+  private:
+    std::shared_ptr<AstNode> m_Replacement;
+};
+
+} // namespace jlang
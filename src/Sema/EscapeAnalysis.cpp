@@ -0,0 +1,339 @@
+#include "EscapeAnalysis.h"
+
+namespace jlang
+{
+
+EscapeAnalysis::EscapeAnalysis(const TypeTable &typeTable) : m_TypeTable(typeTable) {}
+
+void EscapeAnalysis::Run(const std::vector<std::shared_ptr<AstNode>> &program)
+{
+    for (const auto &node : program)
+    {
+        if (node)
+        {
+            node->Accept(*this);
+        }
+    }
+}
+
+void EscapeAnalysis::VisitFunctionDecl(FunctionDecl &node)
+{
+    if (!node.body || node.body->type != NodeType::BlockStatement)
+    {
+        return;
+    }
+
+    auto &body = static_cast<BlockStatement &>(*node.body);
+
+    m_Candidates.clear();
+    m_BlockDepth = 0;
+
+    // Statements of the function body itself run on every path, nested blocks do not
+    for (auto &statement : body.statements)
+    {
+        if (statement)
+        {
+            statement->Accept(*this);
+        }
+    }
+
+    for (const Candidate &candidate : m_Candidates)
+    {
+        if (candidate.escapes || !candidate.freeStatement)
+        {
+            continue;
+        }
+
+        // CodeGen decides with the object's allocated size whether it fits on the stack
+        candidate.decl->isStackAllocated = true;
+        candidate.freeCall->freesStackObject = true;
+    }
+
+    m_Candidates.clear();
+}
+
+void EscapeAnalysis::VisitImportDecl(ImportDecl &) {}
+
+void EscapeAnalysis::VisitInterfaceDecl(InterfaceDecl &) {}
+
+void EscapeAnalysis::VisitStructDecl(StructDecl &) {}
+
+void EscapeAnalysis::VisitVariableDecl(VariableDecl &node)
+{
+    if (node.initializer)
+    {
+        node.initializer->Accept(*this);
+    }
+
+    if (Candidate *shadowed = FindCandidate(node.name))
+    {
+        shadowed->escapes = true;
+        return;
+    }
+
+    if (m_BlockDepth != 0 || !node.varType.isPointer || node.varType.id == InvalidTypeId)
+    {
+        return;
+    }
+
+    // Rows of an soa struct are not contiguous objects, so they can't be moved onto the stack. The type
+    // table knows structs of every unit and imported module, not only this one.
+    if (m_TypeTable.Get(m_TypeTable.Get(node.varType.id).pointee).isSoa)
+    {
+        return;
+    }
+
+    const SizeofExpr *allocatedSize = MatchHeapAllocation(node.initializer.get());
+
+    if (allocatedSize && allocatedSize->targetType.name == node.varType.name)
+    {
+        Candidate candidate;
+        candidate.decl = &node;
+        m_Candidates.push_back(candidate);
+    }
+}
+
+void EscapeAnalysis::VisitIfStatement(IfStatement &node)
+{
+    if (node.condition)
+    {
+        node.condition->Accept(*this);
+    }
+
+    m_BlockDepth++;
+
+    if (node.thenBranch)
+    {
+        node.thenBranch->Accept(*this);
+    }
+
+    if (node.elseBranch)
+    {
+        node.elseBranch->Accept(*this);
+    }
+
+    m_BlockDepth--;
+}
+
+void EscapeAnalysis::VisitWhileStatement(WhileStatement &node)
+{
+    m_BlockDepth++;
+
+    for (auto *child : {node.condition.get(), node.body.get()})
+    {
+        if (child)
+        {
+            child->Accept(*this);
+        }
+    }
+
+    m_BlockDepth--;
+}
+
+void EscapeAnalysis::VisitForStatement(ForStatement &node)
+{
+    // A loop body may run any number of times, so nothing inside it counts as the top level
+    m_BlockDepth++;
+
+    for (auto *child : {node.initializer.get(), node.condition.get(), node.increment.get(), node.body.get()})
+    {
+        if (child)
+        {
+            child->Accept(*this);
+        }
+    }
+
+    m_BlockDepth--;
+}
+
+void EscapeAnalysis::VisitBlockStatement(BlockStatement &node)
+{
+    m_BlockDepth++;
+
+    for (auto &statement : node.statements)
+    {
+        if (statement)
+        {
+            statement->Accept(*this);
+        }
+    }
+
+    m_BlockDepth--;
+}
+
+void EscapeAnalysis::VisitExprStatement(ExprStatement &node)
+{
+    if (!node.expression)
+    {
+        return;
+    }
+
+    const VarExpr *freed = m_BlockDepth == 0 ? MatchFree(node.expression.get()) : nullptr;
+    Candidate *candidate = freed ? FindCandidate(freed->name) : nullptr;
+
+    if (candidate && !candidate->freeStatement)
+    {
+        candidate->freeStatement = &node;
+        candidate->freeCall = static_cast<CallExpr *>(node.expression.get());
+        return;
+    }
+
+    node.expression->Accept(*this);
+}
+
+void EscapeAnalysis::VisitReturnStatement(ReturnStatement &node)
+{
+    // A returned pointer outlives the frame, VisitVarExpr marks it
+    if (node.value)
+    {
+        node.value->Accept(*this);
+    }
+}
+
+void EscapeAnalysis::VisitCallExpr(CallExpr &node)
+{
+    for (auto &argument : node.arguments)
+    {
+        if (argument)
+        {
+            argument->Accept(*this);
+        }
+    }
+
+    // A parallel_for body runs on other threads, every local it names escapes
+    if (node.closureBody)
+    {
+        m_BlockDepth++;
+        node.closureBody->Accept(*this);
+        m_BlockDepth--;
+    }
+}
+
+void EscapeAnalysis::VisitBinaryExpr(BinaryExpr &node)
+{
+    // Comparing the pointer (e.g. against NULL) doesn't let it escape
+    bool isComparison = node.op == "==" || node.op == "!=";
+
+    for (auto *operand : {node.left.get(), node.right.get()})
+    {
+        if (operand && !(isComparison && operand->type == NodeType::VarExpr))
+        {
+            operand->Accept(*this);
+        }
+    }
+}
+
+void EscapeAnalysis::VisitLiteralExpr(LiteralExpr &) {}
+
+void EscapeAnalysis::VisitVarExpr(VarExpr &node)
+{
+    // Any use not whitelisted by the parent node lets the pointer escape
+    if (Candidate *candidate = FindCandidate(node.name))
+    {
+        candidate->escapes = true;
+    }
+}
+
+void EscapeAnalysis::VisitCastExpr(CastExpr &node)
+{
+    if (node.expr)
+    {
+        node.expr->Accept(*this);
+    }
+}
+
+void EscapeAnalysis::VisitMemberExpr(MemberExpr &node)
+{
+    // Dereferencing the pointer to reach a field doesn't let it escape
+    if (node.object && node.object->type != NodeType::VarExpr)
+    {
+        node.object->Accept(*this);
+    }
+}
+
+void EscapeAnalysis::VisitIndexExpr(IndexExpr &node)
+{
+    if (node.object)
+    {
+        node.object->Accept(*this);
+    }
+
+    if (node.index)
+    {
+        node.index->Accept(*this);
+    }
+}
+
+void EscapeAnalysis::VisitSizeofExpr(SizeofExpr &) {}
+
+void EscapeAnalysis::VisitAssignExpr(AssignExpr &node)
+{
+    // Storing into a field of the object is fine, storing the pointer itself anywhere is not
+    if (node.target)
+    {
+        node.target->Accept(*this);
+    }
+
+    if (node.value)
+    {
+        node.value->Accept(*this);
+    }
+}
+
+const SizeofExpr *EscapeAnalysis::MatchHeapAllocation(const AstNode *initializer)
+{
+    if (initializer && initializer->type == NodeType::CastExpr)
+    {
+        initializer = static_cast<const CastExpr *>(initializer)->expr.get();
+    }
+
+    if (!initializer || initializer->type != NodeType::CallExpr)
+    {
+        return nullptr;
+    }
+
+    const auto *call = static_cast<const CallExpr *>(initializer);
+
+    if (call->callee != "jalloc" || call->arguments.size() != 1 || !call->arguments[0] ||
+        call->arguments[0]->type != NodeType::SizeofExpr)
+    {
+        return nullptr;
+    }
+
+    const auto *size = static_cast<const SizeofExpr *>(call->arguments[0].get());
+
+    return size->targetType.isPointer ? nullptr : size;
+}
+
+const VarExpr *EscapeAnalysis::MatchFree(const AstNode *expression)
+{
+    if (!expression || expression->type != NodeType::CallExpr)
+    {
+        return nullptr;
+    }
+
+    const auto *call = static_cast<const CallExpr *>(expression);
+
+    if (call->callee != "jfree" || call->arguments.size() != 1 || !call->arguments[0] ||
+        call->arguments[0]->type != NodeType::VarExpr)
+    {
+        return nullptr;
+    }
+
+    return static_cast<const VarExpr *>(call->arguments[0].get());
+}
+
+EscapeAnalysis::Candidate *EscapeAnalysis::FindCandidate(const std::string &name)
+{
+    for (Candidate &candidate : m_Candidates)
+    {
+        if (candidate.decl->name == name)
+        {
+            return &candidate;
+        }
+    }
+
+    return nullptr;
+}
+
+} // namespace jlang
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "TypeTable.h"
+
+#include "../AST/Ast.h"
+#include "../AST/Expressions/Expressions.h"
+#include "../AST/Statements/Statements.h"
+#include "../AST/TopLevelDecl/TopLevelDecl.h"
+#include "../CodeGen/AstVisitor.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace jlang
+{
+
+// Finds locals initialized with '(struct T*) jalloc(sizeof(struct T))' whose pointer is only dereferenced,
+// compared and passed to a jfree at the top level of the same function. Such objects never outlive the
+// call, so the declaration and its jfree are marked; CodeGen moves the object onto the stack and drops the
+// jfree when the struct is small enough.
+class EscapeAnalysis : public AstVisitor
+{
+  public:
+    explicit EscapeAnalysis(const TypeTable &typeTable);
+
+    void Run(const std::vector<std::shared_ptr<AstNode>> &program);
+
+  private:
+    virtual void VisitImportDecl(ImportDecl &) override;
+    virtual void VisitFunctionDecl(FunctionDecl &) override;
+    virtual void VisitInterfaceDecl(InterfaceDecl &) override;
+    virtual void VisitStructDecl(StructDecl &) override;
+    virtual void VisitVariableDecl(VariableDecl &) override;
+
+    virtual void VisitIfStatement(IfStatement &) override;
+    virtual void VisitWhileStatement(WhileStatement &) override;
+    virtual void VisitForStatement(ForStatement &) override;
+    virtual void VisitBlockStatement(BlockStatement &) override;
+    virtual void VisitExprStatement(ExprStatement &) override;
+    virtual void VisitReturnStatement(ReturnStatement &) override;
+
+    virtual void VisitCallExpr(CallExpr &) override;
+    virtual void VisitBinaryExpr(BinaryExpr &) override;
+    virtual void VisitLiteralExpr(LiteralExpr &) override;
+    virtual void VisitVarExpr(VarExpr &) override;
+    virtual void VisitCastExpr(CastExpr &) override;
+    virtual void VisitMemberExpr(MemberExpr &) override;
+    virtual void VisitIndexExpr(IndexExpr &) override;
+    virtual void VisitSizeofExpr(SizeofExpr &) override;
+    virtual void VisitAssignExpr(AssignExpr &) override;
+
+  private:
+    struct Candidate
+    {
+        VariableDecl *decl = nullptr;
+        const AstNode *freeStatement = nullptr;
+        CallExpr *freeCall = nullptr;
+        bool escapes = false;
+    };
+
+    static const SizeofExpr *MatchHeapAllocation(const AstNode *initializer);
+    static const VarExpr *MatchFree(const AstNode *expression);
+
+    Candidate *FindCandidate(const std::string &name);
+
+  private:
+    const TypeTable &m_TypeTable;
+    std::vector<Candidate> m_Candidates;
+    uint32_t m_BlockDepth = 0;
+};
+
+} // namespace jlang
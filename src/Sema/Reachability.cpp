@@ -0,0 +1,217 @@
+#include "Reachability.h"
+
+#include "../Common/Logger.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace jlang
+{
+
+Reachability::Reachability(BodyParser bodyParser) : m_BodyParser(std::move(bodyParser)) {}
+
+void Reachability::Run(const std::vector<std::vector<std::shared_ptr<AstNode>> *> &units,
+                       const std::vector<std::string> &roots)
+{
+    // Calls name their callee, every function of that name is reached (e.g. one print per struct)
+    std::unordered_map<std::string, std::vector<FunctionDecl *>> functions;
+    size_t functionCount = 0;
+    size_t lazyBodyCount = 0;
+
+    for (auto *unit : units)
+    {
+        for (const auto &node : *unit)
+        {
+            if (node && node->type == NodeType::FunctionDecl)
+            {
+                auto &functionDecl = static_cast<FunctionDecl &>(*node);
+                functions[functionDecl.name].push_back(&functionDecl);
+
+                functionCount++;
+                lazyBodyCount += functionDecl.lazyBodyTokenIndex ? 1 : 0;
+            }
+            else if (node && node->type == NodeType::VariableDecl)
+            {
+                // Unit-level const vars call their const functions while compiling
+                Visit(node);
+            }
+        }
+    }
+
+    for (const std::string &root : roots)
+    {
+        Reach(root);
+    }
+
+    size_t parsedBodyCount = 0;
+
+    while (!m_Worklist.empty())
+    {
+        std::string name = std::move(m_Worklist.back());
+        m_Worklist.pop_back();
+
+        auto it = functions.find(name);
+
+        if (it == functions.end())
+        {
+            continue;
+        }
+
+        for (FunctionDecl *functionDecl : it->second)
+        {
+            if (functionDecl->lazyBodyTokenIndex)
+            {
+                m_BodyParser(*functionDecl);
+                functionDecl->lazyBodyTokenIndex.reset();
+                parsedBodyCount++;
+            }
+
+            Visit(functionDecl->body);
+        }
+    }
+
+    auto isFunction = [](const std::shared_ptr<AstNode> &node) {
+        return node && node->type == NodeType::FunctionDecl;
+    };
+
+    auto isUnreachable = [&](const std::shared_ptr<AstNode> &node) {
+        return isFunction(node) && !m_ReachedNames.count(static_cast<const FunctionDecl &>(*node).name);
+    };
+
+    size_t reachedCount = 0;
+
+    for (auto *unit : units)
+    {
+        unit->erase(std::remove_if(unit->begin(), unit->end(), isUnreachable), unit->end());
+        reachedCount += static_cast<size_t>(std::count_if(unit->begin(), unit->end(), isFunction));
+    }
+
+    JLANG_REMARK("reachability", STR("%zu of %zu functions reachable, %zu of %zu skipped bodies parsed",
+                                     reachedCount, functionCount, parsedBodyCount, lazyBodyCount));
+}
+
+void Reachability::Visit(const std::shared_ptr<AstNode> &node)
+{
+    if (node)
+    {
+        node->Accept(*this);
+    }
+}
+
+void Reachability::Reach(const std::string &name)
+{
+    if (m_ReachedNames.insert(name).second)
+    {
+        m_Worklist.push_back(name);
+    }
+}
+
+void Reachability::VisitFunctionDecl(FunctionDecl &node)
+{
+    Visit(node.body);
+}
+
+void Reachability::VisitImportDecl(ImportDecl &) {}
+
+void Reachability::VisitInterfaceDecl(InterfaceDecl &) {}
+
+void Reachability::VisitStructDecl(StructDecl &) {}
+
+void Reachability::VisitVariableDecl(VariableDecl &node)
+{
+    Visit(node.initializer);
+}
+
+void Reachability::VisitIfStatement(IfStatement &node)
+{
+    Visit(node.condition);
+    Visit(node.thenBranch);
+    Visit(node.elseBranch);
+}
+
+void Reachability::VisitWhileStatement(WhileStatement &node)
+{
+    Visit(node.condition);
+    Visit(node.body);
+}
+
+void Reachability::VisitForStatement(ForStatement &node)
+{
+    Visit(node.initializer);
+    Visit(node.condition);
+    Visit(node.increment);
+    Visit(node.body);
+}
+
+void Reachability::VisitBlockStatement(BlockStatement &node)
+{
+    for (const auto &statement : node.statements)
+    {
+        Visit(statement);
+    }
+}
+
+void Reachability::VisitExprStatement(ExprStatement &node)
+{
+    Visit(node.expression);
+}
+
+void Reachability::VisitReturnStatement(ReturnStatement &node)
+{
+    Visit(node.value);
+}
+
+void Reachability::VisitCallExpr(CallExpr &node)
+{
+    Reach(node.callee);
+
+    // parallel_for calls the function named by its third argument
+    if (node.callee == "parallel_for" && node.arguments.size() >= 3 && node.arguments[2] &&
+        node.arguments[2]->type == NodeType::VarExpr)
+    {
+        Reach(static_cast<const VarExpr &>(*node.arguments[2]).name);
+    }
+
+    for (const auto &argument : node.arguments)
+    {
+        Visit(argument);
+    }
+
+    Visit(node.closureBody);
+}
+
+void Reachability::VisitBinaryExpr(BinaryExpr &node)
+{
+    Visit(node.left);
+    Visit(node.right);
+}
+
+void Reachability::VisitLiteralExpr(LiteralExpr &) {}
+
+void Reachability::VisitVarExpr(VarExpr &) {}
+
+void Reachability::VisitCastExpr(CastExpr &node)
+{
+    Visit(node.expr);
+}
+
+void Reachability::VisitMemberExpr(MemberExpr &node)
+{
+    Visit(node.object);
+}
+
+void Reachability::VisitIndexExpr(IndexExpr &node)
+{
+    Visit(node.object);
+    Visit(node.index);
+}
+
+void Reachability::VisitSizeofExpr(SizeofExpr &) {}
+
+void Reachability::VisitAssignExpr(AssignExpr &node)
+{
+    Visit(node.target);
+    Visit(node.value);
+}
+
+} // namespace jlang
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../AST/Ast.h"
+#include "../AST/Expressions/Expressions.h"
+#include "../AST/Statements/Statements.h"
+#include "../AST/TopLevelDecl/TopLevelDecl.h"
+#include "../CodeGen/AstVisitor.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace jlang
+{
+
+// Walks the call graph from the root functions and removes every function no call reaches, so codegen
+// never sees it. A body a lazy parse skipped is handed to the body parser only once its function is
+// reached, unreachable ones are never parsed at all.
+class Reachability : public AstVisitor
+{
+  public:
+    using BodyParser = std::function<void(FunctionDecl &)>;
+
+    explicit Reachability(BodyParser bodyParser);
+
+    void Run(const std::vector<std::vector<std::shared_ptr<AstNode>> *> &units,
+             const std::vector<std::string> &roots);
+
+  private:
+    virtual void VisitImportDecl(ImportDecl &) override;
+    virtual void VisitFunctionDecl(FunctionDecl &) override;
+    virtual void VisitInterfaceDecl(InterfaceDecl &) override;
+    virtual void VisitStructDecl(StructDecl &) override;
+    virtual void VisitVariableDecl(VariableDecl &) override;
+
+    virtual void VisitIfStatement(IfStatement &) override;
+    virtual void VisitWhileStatement(WhileStatement &) override;
+    virtual void VisitForStatement(ForStatement &) override;
+    virtual void VisitBlockStatement(BlockStatement &) override;
+    virtual void VisitExprStatement(ExprStatement &) override;
+    virtual void VisitReturnStatement(ReturnStatement &) override;
+
+    virtual void VisitCallExpr(CallExpr &) override;
+    virtual void VisitBinaryExpr(BinaryExpr &) override;
+    virtual void VisitLiteralExpr(LiteralExpr &) override;
+    virtual void VisitVarExpr(VarExpr &) override;
+    virtual void VisitCastExpr(CastExpr &) override;
+    virtual void VisitMemberExpr(MemberExpr &) override;
+    virtual void VisitIndexExpr(IndexExpr &) override;
+    virtual void VisitSizeofExpr(SizeofExpr &) override;
+    virtual void VisitAssignExpr(AssignExpr &) override;
+
+  private:
+    void Visit(const std::shared_ptr<AstNode> &node);
+    void Reach(const std::string &name);
+
+  private:
+    BodyParser m_BodyParser;
+    std::unordered_set<std::string> m_ReachedNames;
+    std::vector<std::string> m_Worklist;
+};
+
+} // namespace jlang
@@ -0,0 +1,311 @@
+#include "TypeResolver.h"
+
+#include "../Common/Logger.h"
+
+namespace jlang
+{
+
+TypeResolver::TypeResolver(TypeTable &typeTable, ImportTable *importTable)
+    : m_TypeTable(typeTable), m_ImportTable(importTable)
+{
+}
+
+void TypeResolver::DeclareUnit(const std::vector<std::shared_ptr<AstNode>> &program)
+{
+    for (const auto &node : program)
+    {
+        if (node && node->type == NodeType::StructDecl)
+        {
+            auto &structDecl = static_cast<StructDecl &>(*node);
+            structDecl.typeId = m_TypeTable.DeclareStruct(structDecl.name, structDecl.isSoa);
+        }
+        else if (node && node->type == NodeType::InterfaceDecl)
+        {
+            const auto &interfaceDecl = static_cast<const InterfaceDecl &>(*node);
+            m_TypeTable.DeclareInterface(interfaceDecl.name, interfaceDecl.methods);
+        }
+        else if (node && node->type == NodeType::FunctionDecl)
+        {
+            m_FunctionNames.insert(static_cast<const FunctionDecl &>(*node).name);
+        }
+    }
+}
+
+void TypeResolver::Run(const std::vector<std::shared_ptr<AstNode>> &program)
+{
+    DeclareUnit(program);
+
+    for (const auto &node : program)
+    {
+        Visit(node);
+    }
+}
+
+void TypeResolver::Resolve(TypeRef &typeRef)
+{
+    TypeId id = m_TypeTable.Lookup(typeRef.name);
+
+    if (id == InvalidTypeId)
+    {
+        id = ImportStruct(typeRef.name);
+    }
+
+    if (id == InvalidTypeId)
+    {
+        JLANG_ERROR(STR("Unknown type: %s", typeRef.name.c_str()));
+        return;
+    }
+
+    if (typeRef.isPointer && m_TypeTable.Get(id).kind == TypeKind::Interface)
+    {
+        JLANG_ERROR(STR("Interface %s is used as a value, it already holds a pointer", typeRef.name.c_str()));
+        return;
+    }
+
+    if (typeRef.isPointer)
+    {
+        id = m_TypeTable.GetPointerTo(id);
+    }
+
+    bool isSequence = typeRef.isSlice || typeRef.arrayLength != 0;
+
+    if (isSequence && id == TypeTable::VoidId)
+    {
+        JLANG_ERROR(STR("Arrays and slices can't hold %s elements", typeRef.name.c_str()));
+        return;
+    }
+
+    if (typeRef.isSlice)
+    {
+        id = m_TypeTable.GetSliceOf(id);
+    }
+    else if (typeRef.arrayLength != 0)
+    {
+        id = m_TypeTable.GetArrayOf(id, typeRef.arrayLength);
+    }
+
+    typeRef.id = id;
+}
+
+void TypeResolver::Visit(const std::shared_ptr<AstNode> &node)
+{
+    if (node)
+    {
+        node->Accept(*this);
+    }
+}
+
+void TypeResolver::ImportFunction(const std::string &name)
+{
+    if (m_ImportTable && !m_FunctionNames.count(name))
+    {
+        if (std::shared_ptr<FunctionDecl> functionDecl = m_ImportTable->RequireFunction(name))
+        {
+            m_FunctionNames.insert(functionDecl->name);
+            VisitFunctionDecl(*functionDecl);
+        }
+    }
+}
+
+TypeId TypeResolver::ImportStruct(const std::string &name)
+{
+    std::shared_ptr<StructDecl> structDecl = m_ImportTable ? m_ImportTable->RequireStruct(name) : nullptr;
+
+    if (!structDecl)
+    {
+        return InvalidTypeId;
+    }
+
+    // Declared before its fields are resolved, a field may point back at the struct
+    structDecl->typeId = m_TypeTable.DeclareStruct(structDecl->name, structDecl->isSoa);
+    VisitStructDecl(*structDecl);
+
+    return structDecl->typeId;
+}
+
+void TypeResolver::VisitFunctionDecl(FunctionDecl &node)
+{
+    Resolve(node.returnType);
+
+    for (auto &param : node.params)
+    {
+        Resolve(param.type);
+
+        if (param.type.arrayLength != 0)
+        {
+            JLANG_ERROR(STR("%s: parameter %s must be a slice, arrays are passed as T[]", node.name.c_str(),
+                            param.name.c_str()));
+        }
+    }
+
+    Visit(node.body);
+}
+
+void TypeResolver::VisitImportDecl(ImportDecl &) {}
+
+void TypeResolver::VisitInterfaceDecl(InterfaceDecl &) {}
+
+void TypeResolver::VisitStructDecl(StructDecl &node)
+{
+    for (auto &field : node.fields)
+    {
+        Resolve(field.type);
+
+        // An array of soa rows is a column table of its own, it is not laid out inside another struct
+        if (field.type.arrayLength != 0 && field.type.id != InvalidTypeId &&
+            m_TypeTable.Get(m_TypeTable.Get(field.type.id).element).isSoa)
+        {
+            JLANG_ERROR(STR("%s: field %s can't be an array of soa struct %s", node.name.c_str(),
+                            field.name.c_str(), field.type.name.c_str()));
+        }
+    }
+
+    if (!node.interfaceImplemented.empty())
+    {
+        ImplementInterface(node);
+    }
+}
+
+void TypeResolver::ImplementInterface(const StructDecl &node)
+{
+    TypeId interfaceId = m_TypeTable.Lookup(node.interfaceImplemented);
+
+    // The interface of an imported struct comes with it from the same module interface
+    if (interfaceId == InvalidTypeId && m_ImportTable)
+    {
+        for (const auto &declaration : m_ImportTable->GetDeclarations())
+        {
+            if (declaration->type != NodeType::InterfaceDecl)
+            {
+                continue;
+            }
+
+            const auto &interfaceDecl = static_cast<const InterfaceDecl &>(*declaration);
+
+            if (interfaceDecl.name == node.interfaceImplemented)
+            {
+                interfaceId = m_TypeTable.DeclareInterface(interfaceDecl.name, interfaceDecl.methods);
+            }
+        }
+    }
+
+    if (interfaceId == InvalidTypeId || m_TypeTable.Get(interfaceId).kind != TypeKind::Interface)
+    {
+        JLANG_ERROR(STR("Struct %s implements unknown interface %s", node.name.c_str(),
+                        node.interfaceImplemented.c_str()));
+        return;
+    }
+
+    if (node.isSoa)
+    {
+        JLANG_ERROR(STR("Soa struct %s can't implement an interface, its rows are not objects",
+                        node.name.c_str()));
+        return;
+    }
+
+    m_TypeTable.AddImplementer(interfaceId, node.typeId);
+}
+
+void TypeResolver::VisitVariableDecl(VariableDecl &node)
+{
+    Resolve(node.varType);
+    Visit(node.initializer);
+}
+
+void TypeResolver::VisitIfStatement(IfStatement &node)
+{
+    Visit(node.condition);
+    Visit(node.thenBranch);
+    Visit(node.elseBranch);
+}
+
+void TypeResolver::VisitWhileStatement(WhileStatement &node)
+{
+    Visit(node.condition);
+    Visit(node.body);
+}
+
+void TypeResolver::VisitForStatement(ForStatement &node)
+{
+    Visit(node.initializer);
+    Visit(node.condition);
+    Visit(node.increment);
+    Visit(node.body);
+}
+
+void TypeResolver::VisitBlockStatement(BlockStatement &node)
+{
+    for (const auto &statement : node.statements)
+    {
+        Visit(statement);
+    }
+}
+
+void TypeResolver::VisitExprStatement(ExprStatement &node)
+{
+    Visit(node.expression);
+}
+
+void TypeResolver::VisitReturnStatement(ReturnStatement &node)
+{
+    Visit(node.value);
+}
+
+void TypeResolver::VisitCallExpr(CallExpr &node)
+{
+    ImportFunction(node.callee);
+
+    // parallel_for names the function it calls in its third argument
+    if (node.callee == "parallel_for" && node.arguments.size() >= 3 && node.arguments[2] &&
+        node.arguments[2]->type == NodeType::VarExpr)
+    {
+        ImportFunction(static_cast<const VarExpr &>(*node.arguments[2]).name);
+    }
+
+    for (const auto &argument : node.arguments)
+    {
+        Visit(argument);
+    }
+
+    Visit(node.closureBody);
+}
+
+void TypeResolver::VisitBinaryExpr(BinaryExpr &node)
+{
+    Visit(node.left);
+    Visit(node.right);
+}
+
+void TypeResolver::VisitLiteralExpr(LiteralExpr &) {}
+
+void TypeResolver::VisitVarExpr(VarExpr &) {}
+
+void TypeResolver::VisitCastExpr(CastExpr &node)
+{
+    Resolve(node.targetType);
+    Visit(node.expr);
+}
+
+void TypeResolver::VisitMemberExpr(MemberExpr &node)
+{
+    Visit(node.object);
+}
+
+void TypeResolver::VisitIndexExpr(IndexExpr &node)
+{
+    Visit(node.object);
+    Visit(node.index);
+}
+
+void TypeResolver::VisitSizeofExpr(SizeofExpr &node)
+{
+    Resolve(node.targetType);
+}
+
+void TypeResolver::VisitAssignExpr(AssignExpr &node)
+{
+    Visit(node.target);
+    Visit(node.value);
+}
+
+} // namespace jlang
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "TypeTable.h"
+
+#include "../AST/Ast.h"
+#include "../AST/Expressions/Expressions.h"
+#include "../AST/Statements/Statements.h"
+#include "../AST/TopLevelDecl/TopLevelDecl.h"
+#include "../CodeGen/AstVisitor.h"
+#include "../Interface/ImportTable.h"
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace jlang
+{
+
+// Resolves every TypeRef in the program to its interned TypeId, so later passes and codegen never look
+// types up by name. Structs are declared up front, which lets a type be used before its declaration.
+// Structs and functions the program doesn't declare are looked up in the imported module interfaces.
+class TypeResolver : public AstVisitor
+{
+  public:
+    explicit TypeResolver(TypeTable &typeTable, ImportTable *importTable = nullptr);
+
+    // Makes the structs, interfaces and functions of a unit visible, so other units of the same program can
+    // use them too
+    void DeclareUnit(const std::vector<std::shared_ptr<AstNode>> &program);
+
+    void Run(const std::vector<std::shared_ptr<AstNode>> &program);
+
+  private:
+    virtual void VisitImportDecl(ImportDecl &) override;
+    virtual void VisitFunctionDecl(FunctionDecl &) override;
+    virtual void VisitInterfaceDecl(InterfaceDecl &) override;
+    virtual void VisitStructDecl(StructDecl &) override;
+    virtual void VisitVariableDecl(VariableDecl &) override;
+
+    virtual void VisitIfStatement(IfStatement &) override;
+    virtual void VisitWhileStatement(WhileStatement &) override;
+    virtual void VisitForStatement(ForStatement &) override;
+    virtual void VisitBlockStatement(BlockStatement &) override;
+    virtual void VisitExprStatement(ExprStatement &) override;
+    virtual void VisitReturnStatement(ReturnStatement &) override;
+
+    virtual void VisitCallExpr(CallExpr &) override;
+    virtual void VisitBinaryExpr(BinaryExpr &) override;
+    virtual void VisitLiteralExpr(LiteralExpr &) override;
+    virtual void VisitVarExpr(VarExpr &) override;
+    virtual void VisitCastExpr(CastExpr &) override;
+    virtual void VisitMemberExpr(MemberExpr &) override;
+    virtual void VisitIndexExpr(IndexExpr &) override;
+    virtual void VisitSizeofExpr(SizeofExpr &) override;
+    virtual void VisitAssignExpr(AssignExpr &) override;
+
+  private:
+    void Resolve(TypeRef &typeRef);
+    void Visit(const std::shared_ptr<AstNode> &node);
+
+    TypeId ImportStruct(const std::string &name);
+
+    // Adds the struct to the implementers of the interface it names
+    void ImplementInterface(const StructDecl &node);
+
+    // Brings in the declaration of a function some import provides, unless the program defines it
+    void ImportFunction(const std::string &name);
+
+  private:
+    TypeTable &m_TypeTable;
+    ImportTable *m_ImportTable;
+    std::unordered_set<std::string> m_FunctionNames;
+};
+
+} // namespace jlang
@@ -0,0 +1,155 @@
+#include "TypeTable.h"
+
+#include <algorithm>
+
+namespace jlang
+{
+
+TypeTable::TypeTable()
+{
+    Add(TypeInfo{TypeKind::Void, "void"});
+    Add(TypeInfo{TypeKind::Int32, "int32"});
+    Add(TypeInfo{TypeKind::Char, "char"});
+    AddVector("int32x4", Int32Id, 4);
+    AddVector("int32x8", Int32Id, 8);
+    Add(TypeInfo{TypeKind::Arena, "jarena"});
+
+    TypeInfo str{TypeKind::Slice, "str"};
+    str.element = CharId;
+
+    m_SliceTypes[CharId] = Add(std::move(str));
+    m_NamedTypes["str"] = StrId;
+}
+
+TypeId TypeTable::DeclareStruct(const std::string &name, bool isSoa)
+{
+    auto it = m_NamedTypes.find(name);
+
+    if (it != m_NamedTypes.end())
+    {
+        return it->second;
+    }
+
+    TypeInfo info{TypeKind::Struct, name};
+    info.isSoa = isSoa;
+
+    return Add(std::move(info));
+}
+
+TypeId TypeTable::DeclareInterface(const std::string &name, const std::vector<std::string> &methods)
+{
+    auto it = m_NamedTypes.find(name);
+
+    if (it != m_NamedTypes.end())
+    {
+        return it->second;
+    }
+
+    TypeInfo info{TypeKind::Interface, name};
+    info.methods = methods;
+
+    return Add(std::move(info));
+}
+
+void TypeTable::AddImplementer(TypeId interfaceId, TypeId structId)
+{
+    std::vector<TypeId> &implementers = m_Types[interfaceId].implementers;
+
+    if (std::find(implementers.begin(), implementers.end(), structId) != implementers.end())
+    {
+        return;
+    }
+
+    auto byName = [&](TypeId a, TypeId b) { return m_Types[a].name < m_Types[b].name; };
+    auto position = std::upper_bound(implementers.begin(), implementers.end(), structId, byName);
+
+    implementers.insert(position, structId);
+    m_Types[structId].implemented = interfaceId;
+}
+
+TypeId TypeTable::GetPointerTo(TypeId pointee)
+{
+    auto it = m_PointerTypes.find(pointee);
+
+    if (it != m_PointerTypes.end())
+    {
+        return it->second;
+    }
+
+    TypeInfo info{TypeKind::Pointer, m_Types[pointee].name + "*"};
+    info.pointee = pointee;
+
+    TypeId id = Add(std::move(info));
+    m_PointerTypes[pointee] = id;
+
+    return id;
+}
+
+TypeId TypeTable::GetArrayOf(TypeId element, uint32_t length)
+{
+    auto it = m_ArrayTypes.find({element, length});
+
+    if (it != m_ArrayTypes.end())
+    {
+        return it->second;
+    }
+
+    TypeInfo info{TypeKind::Array, m_Types[element].name + "[" + std::to_string(length) + "]"};
+    info.element = element;
+    info.length = length;
+
+    TypeId id = Add(std::move(info));
+    m_ArrayTypes[{element, length}] = id;
+
+    return id;
+}
+
+TypeId TypeTable::GetSliceOf(TypeId element)
+{
+    auto it = m_SliceTypes.find(element);
+
+    if (it != m_SliceTypes.end())
+    {
+        return it->second;
+    }
+
+    TypeInfo info{TypeKind::Slice, m_Types[element].name + "[]"};
+    info.element = element;
+
+    TypeId id = Add(std::move(info));
+    m_SliceTypes[element] = id;
+
+    return id;
+}
+
+TypeId TypeTable::Lookup(const std::string &name) const
+{
+    auto it = m_NamedTypes.find(name);
+    return it != m_NamedTypes.end() ? it->second : InvalidTypeId;
+}
+
+TypeId TypeTable::AddVector(const std::string &name, TypeId element, uint32_t laneCount)
+{
+    TypeInfo info{TypeKind::Vector, name};
+    info.element = element;
+    info.laneCount = laneCount;
+
+    return Add(std::move(info));
+}
+
+TypeId TypeTable::Add(TypeInfo info)
+{
+    auto id = static_cast<TypeId>(m_Types.size());
+
+    // Only builtins, structs and interfaces are looked up by name, the others are reached through their
+    // element type
+    if (info.kind != TypeKind::Pointer && info.kind != TypeKind::Array && info.kind != TypeKind::Slice)
+    {
+        m_NamedTypes[info.name] = id;
+    }
+
+    m_Types.push_back(std::move(info));
+    return id;
+}
+
+} // namespace jlang
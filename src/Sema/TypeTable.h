@@ -0,0 +1,96 @@
+#pragma once
+
+#include "../Types/TypeId.h"
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace jlang
+{
+
+enum class TypeKind
+{
+    Void,
+    Int32,
+    Char,
+    Struct,
+    Pointer,
+    Vector,
+
+    // 'T[N]' stored in place and 'T[]', a pointer and a length
+    Array,
+    Slice,
+
+    // The runtime's JArena, only handled through jarena* pointers
+    Arena,
+
+    // A value of any struct implementing the interface: a pointer to the struct and its vtable
+    Interface
+};
+
+struct TypeInfo
+{
+    TypeKind kind;
+    std::string name;
+    TypeId pointee = InvalidTypeId;
+    bool isSoa = false;
+
+    // Vector types: lanes of the element type, operated on element-wise. Arrays and slices: the type of
+    // their elements.
+    TypeId element = InvalidTypeId;
+    uint32_t laneCount = 0;
+
+    // Array types: the number of elements
+    uint32_t length = 0;
+
+    // Interface types: their methods in vtable order and the structs implementing them, sorted by name so
+    // every unit and every build numbers them alike. Structs: the interface they implement.
+    std::vector<std::string> methods = {};
+    std::vector<TypeId> implementers = {};
+    TypeId implemented = InvalidTypeId;
+};
+
+// Interns every type of the program once. Builtins have fixed ids, each struct gets an id when it is
+// declared and pointer, array and slice types are created on first use and cached per element type, so
+// two TypeRefs naming the same type always resolve to the same TypeId.
+class TypeTable
+{
+  public:
+    static constexpr TypeId VoidId = 0;
+    static constexpr TypeId Int32Id = 1;
+    static constexpr TypeId CharId = 2;
+    static constexpr TypeId Int32x4Id = 3;
+    static constexpr TypeId Int32x8Id = 4;
+    static constexpr TypeId ArenaId = 5;
+
+    // The type of string literals, a slice of chars that char[] names as well
+    static constexpr TypeId StrId = 6;
+
+    TypeTable();
+
+    TypeId DeclareStruct(const std::string &name, bool isSoa);
+    TypeId DeclareInterface(const std::string &name, const std::vector<std::string> &methods);
+    void AddImplementer(TypeId interfaceId, TypeId structId);
+    TypeId GetPointerTo(TypeId pointee);
+    TypeId GetArrayOf(TypeId element, uint32_t length);
+    TypeId GetSliceOf(TypeId element);
+    TypeId Lookup(const std::string &name) const;
+
+    const TypeInfo &Get(TypeId id) const { return m_Types[id]; }
+    size_t Size() const { return m_Types.size(); }
+
+  private:
+    TypeId Add(TypeInfo info);
+    TypeId AddVector(const std::string &name, TypeId element, uint32_t laneCount);
+
+  private:
+    std::vector<TypeInfo> m_Types;
+    std::unordered_map<std::string, TypeId> m_NamedTypes;
+    std::unordered_map<TypeId, TypeId> m_PointerTypes;
+    std::map<std::pair<TypeId, uint32_t>, TypeId> m_ArrayTypes;
+    std::unordered_map<TypeId, TypeId> m_SliceTypes;
+};
+
+} // namespace jlang
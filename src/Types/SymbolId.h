@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+namespace jlang
+{
+
+// Index of a name interned by the SymbolInterner
+using SymbolId = uint32_t;
+
+constexpr SymbolId InvalidSymbolId = std::numeric_limits<SymbolId>::max();
+
+} // namespace jlang
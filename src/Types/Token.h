@@ -1,5 +1,11 @@
 #pragma once
 
+#include "../Enums/TokenTypes.h"
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
 namespace jlang
 {
 
@@ -9,8 +15,11 @@ struct Token
     std::string m_lexeme;
     uint32_t m_CurrentLine;
 
-    Token(const TokenType type, const std::string lexeme, uint32_t const currentLine)
-        : m_type(type), m_lexeme(std::move(lexeme)), m_CurrentLine(currentLine)
+    // 1-based, 0 for tokens that have no place in the source such as EndOfFile
+    uint32_t m_Column;
+
+    Token(const TokenType type, const std::string lexeme, uint32_t const currentLine, uint32_t const column = 0)
+        : m_type(type), m_lexeme(std::move(lexeme)), m_CurrentLine(currentLine), m_Column(column)
     {
     }
 
@@ -18,7 +27,7 @@ struct Token
     {
         std::stringstream ss;
 
-        ss << m_CurrentLine << ": ";
+        ss << m_CurrentLine << ":" << m_Column << ": ";
         ss << m_lexeme;
         ss << " (" << static_cast<int32_t>(m_type) << ")";
 
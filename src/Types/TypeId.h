@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+namespace jlang
+{
+
+// Index of an interned type in the TypeTable
+using TypeId = uint32_t;
+
+constexpr TypeId InvalidTypeId = std::numeric_limits<TypeId>::max();
+
+} // namespace jlang
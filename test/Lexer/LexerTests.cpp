@@ -0,0 +1,96 @@
+#include "Lexer/Lexer.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+using namespace jlang;
+
+namespace
+{
+
+std::vector<TokenType> TypesOf(const std::vector<Token> &tokens)
+{
+    std::vector<TokenType> types;
+
+    for (const Token &token : tokens)
+    {
+        types.push_back(token.m_type);
+    }
+
+    return types;
+}
+
+} // namespace
+
+// The lexer keeps a reference to the source, so every test holds it in a variable
+
+TEST(LexerTests, ScansKeywordsIdentifiersAndSymbols)
+{
+    const std::string source = "var count int32 = 42;";
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.Tokenize();
+
+    std::vector<TokenType> expected{TokenType::Var,   TokenType::Identifier,    TokenType::Int32,
+                                    TokenType::Equal, TokenType::NumberLiteral, TokenType::Semicolon,
+                                    TokenType::EndOfFile};
+    EXPECT_EQ(TypesOf(tokens), expected);
+    EXPECT_EQ(tokens[1].m_lexeme, "count");
+    EXPECT_EQ(tokens[4].m_lexeme, "42");
+}
+
+TEST(LexerTests, ScansTwoCharacterOperators)
+{
+    const std::string source = "a == b != c -> d";
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.Tokenize();
+
+    std::vector<TokenType> expected{TokenType::Identifier, TokenType::EqualEqual, TokenType::Identifier,
+                                    TokenType::NotEqual,   TokenType::Identifier, TokenType::Arrow,
+                                    TokenType::Identifier, TokenType::EndOfFile};
+    EXPECT_EQ(TypesOf(tokens), expected);
+}
+
+TEST(LexerTests, TracksLinesAndColumns)
+{
+    const std::string source = "struct Person\n{\n    age int32;\n}";
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.Tokenize();
+
+    ASSERT_GE(tokens.size(), 5u);
+    EXPECT_EQ(tokens[0].m_CurrentLine, 1u);
+    EXPECT_EQ(tokens[0].m_Column, 1u);
+    EXPECT_EQ(tokens[1].m_Column, 8u);
+    EXPECT_EQ(tokens[3].m_lexeme, "age");
+    EXPECT_EQ(tokens[3].m_CurrentLine, 3u);
+    EXPECT_EQ(tokens[3].m_Column, 5u);
+}
+
+TEST(LexerTests, ScansStringLiterals)
+{
+    const std::string source = "jout(\"a b\");";
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.Tokenize();
+
+    ASSERT_GE(tokens.size(), 3u);
+    EXPECT_EQ(tokens[2].m_type, TokenType::StringLiteral);
+    EXPECT_EQ(tokens[2].m_lexeme, "a b");
+}
+
+TEST(LexerTests, StreamedInputGivesTheSameTokens)
+{
+    const std::string source = "int32 main()\n{\n    return 0;\n}\n";
+
+    std::vector<Token> tokens = Lexer(source).Tokenize();
+
+    std::istringstream input(source);
+    Lexer streamed(input);
+
+    for (const Token &token : tokens)
+    {
+        Token next = streamed.NextToken();
+        EXPECT_EQ(next.m_type, token.m_type);
+        EXPECT_EQ(next.m_lexeme, token.m_lexeme);
+        EXPECT_EQ(next.m_CurrentLine, token.m_CurrentLine);
+    }
+}
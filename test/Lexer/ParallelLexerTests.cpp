@@ -0,0 +1,106 @@
+#include "Lexer/Lexer.h"
+#include "Lexer/ParallelLexer.h"
+
+#include <gtest/gtest.h>
+
+using namespace jlang;
+
+namespace
+{
+
+// A minimum chunk size this small cuts the short sources below into as many chunks as there are threads
+constexpr size_t TinyChunkSize = 4;
+
+void ExpectSameTokens(const std::vector<Token> &actual, const std::vector<Token> &expected)
+{
+    ASSERT_EQ(actual.size(), expected.size());
+
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        EXPECT_EQ(actual[i].m_type, expected[i].m_type) << "token " << i;
+        EXPECT_EQ(actual[i].m_lexeme, expected[i].m_lexeme) << "token " << i;
+        EXPECT_EQ(actual[i].m_CurrentLine, expected[i].m_CurrentLine) << "token " << i;
+        EXPECT_EQ(actual[i].m_Column, expected[i].m_Column) << "token " << i;
+    }
+}
+
+} // namespace
+
+TEST(ParallelLexerTests, SmallSourceStaysInOneChunk)
+{
+    const std::string source = "int32 main()\n{\n    return 0;\n}\n";
+
+    ExpectSameTokens(ParallelLexer(source, 4).Tokenize(), Lexer(source).Tokenize());
+}
+
+TEST(ParallelLexerTests, MatchesLexerOnEveryThreadCount)
+{
+    const std::string source = "struct Person\n{\n    age int32;\n}\n\n"
+                               "int32 main()\n{\n    var p Person* = (struct Person*) jalloc(sizeof(struct Person));\n"
+                               "    p.age = 42 + 1;\n    jout(\"age %d\", p.age);\n    return 0;\n}\n";
+    std::vector<Token> expected = Lexer(source).Tokenize();
+
+    for (unsigned threads = 2; threads <= 16; ++threads)
+    {
+        SCOPED_TRACE(threads);
+        ExpectSameTokens(ParallelLexer(source, threads, TinyChunkSize).Tokenize(), expected);
+    }
+}
+
+TEST(ParallelLexerTests, CutInsideStringLiteral)
+{
+    // With two threads the even cut falls in the middle of the literal, whose spaces are no token boundary
+    const std::string source = "jout(\"a b c d e f g h i j k l m n o p q r s t u v w x y z\");";
+    std::vector<Token> expected = Lexer(source).Tokenize();
+    std::vector<Token> tokens = ParallelLexer(source, 2, TinyChunkSize).Tokenize();
+
+    ExpectSameTokens(tokens, expected);
+    ASSERT_GE(tokens.size(), 3u);
+    EXPECT_EQ(tokens[2].m_type, TokenType::StringLiteral);
+    EXPECT_EQ(tokens[2].m_lexeme, "a b c d e f g h i j k l m n o p q r s t u v w x y z");
+}
+
+TEST(ParallelLexerTests, StringLiteralSpanningSeveralCuts)
+{
+    const std::string source = "var a int32 = 1;\njout(\"first line\nsecond line\nthird line\");\nvar b int32 = 2;\n";
+
+    for (unsigned threads = 2; threads <= 8; ++threads)
+    {
+        SCOPED_TRACE(threads);
+        ExpectSameTokens(ParallelLexer(source, threads, TinyChunkSize).Tokenize(), Lexer(source).Tokenize());
+    }
+}
+
+TEST(ParallelLexerTests, UnterminatedStringLiteral)
+{
+    // Everything after the opening quote is inside the literal, which the Lexer drops without a token
+    const std::string source = "var a int32 = 1;\nvar b int32 = 2;\njout(\"never closed ; var c int32 = 3;\n";
+    std::vector<Token> expected = Lexer(source).Tokenize();
+
+    for (unsigned threads = 2; threads <= 8; ++threads)
+    {
+        SCOPED_TRACE(threads);
+        ExpectSameTokens(ParallelLexer(source, threads, TinyChunkSize).Tokenize(), expected);
+    }
+}
+
+TEST(ParallelLexerTests, LinesContinueAfterTheStitch)
+{
+    std::string source;
+
+    for (int i = 0; i < 40; ++i)
+    {
+        source += "var v" + std::to_string(i) + " int32 = " + std::to_string(i) + ";\n";
+    }
+
+    std::vector<Token> tokens = ParallelLexer(source, 4, TinyChunkSize).Tokenize();
+    ExpectSameTokens(tokens, Lexer(source).Tokenize());
+
+    // Six tokens per line: the name declared on line n is token 6 * (n - 1) + 1
+    ASSERT_EQ(tokens.size(), 40u * 6 + 1);
+    EXPECT_EQ(tokens[6 * 30 + 1].m_lexeme, "v30");
+    EXPECT_EQ(tokens[6 * 30 + 1].m_CurrentLine, 31u);
+    EXPECT_EQ(tokens[6 * 30 + 1].m_Column, 5u);
+    EXPECT_EQ(tokens.back().m_type, TokenType::EndOfFile);
+    EXPECT_EQ(tokens.back().m_CurrentLine, 41u);
+}
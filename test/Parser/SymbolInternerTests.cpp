@@ -0,0 +1,40 @@
+#include "Parser/SymbolInterner.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace jlang;
+
+TEST(SymbolInternerTests, InternsEachNameOnce)
+{
+    SymbolInterner names;
+
+    SymbolId count = names.Intern("count");
+    SymbolId total = names.Intern("total");
+
+    EXPECT_EQ(count, 0u);
+    EXPECT_EQ(total, 1u);
+    EXPECT_EQ(names.Intern("count"), count);
+    EXPECT_EQ(names.GetCount(), 2u);
+    EXPECT_EQ(names.GetName(total), "total");
+}
+
+// The table starts with 64 slots and doubles at half load, ids handed out before a rehash must still resolve
+TEST(SymbolInternerTests, KeepsIdsAcrossGrowth)
+{
+    SymbolInterner names;
+
+    for (int i = 0; i < 200; ++i)
+    {
+        EXPECT_EQ(names.Intern("name" + std::to_string(i)), static_cast<SymbolId>(i));
+    }
+
+    for (int i = 0; i < 200; ++i)
+    {
+        EXPECT_EQ(names.Intern("name" + std::to_string(i)), static_cast<SymbolId>(i));
+        EXPECT_EQ(names.GetName(static_cast<SymbolId>(i)), "name" + std::to_string(i));
+    }
+
+    EXPECT_EQ(names.GetCount(), 200u);
+}
@@ -0,0 +1,124 @@
+#include "CodeGen/SymbolTable.h"
+
+#include <gtest/gtest.h>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/LLVMContext.h>
+
+#include <string>
+
+using namespace jlang;
+
+namespace
+{
+
+class SymbolTableTests : public ::testing::Test
+{
+  protected:
+    llvm::Value *MakeValue(int32_t value)
+    {
+        return llvm::ConstantInt::get(llvm::Type::getInt32Ty(m_Context), value);
+    }
+
+  protected:
+    llvm::LLVMContext m_Context;
+    SymbolInterner m_Names;
+};
+
+} // namespace
+
+TEST_F(SymbolTableTests, PopScopeUnbindsItsNames)
+{
+    SymbolId count = m_Names.Intern("count");
+    SymbolTable symbols(m_Names);
+    llvm::Value *value = MakeValue(1);
+
+    EXPECT_EQ(symbols.Lookup(count), nullptr);
+
+    symbols.PushScope();
+    symbols.Declare(count, value);
+    EXPECT_EQ(symbols.Lookup(count), value);
+
+    symbols.PopScope();
+    EXPECT_EQ(symbols.Lookup(count), nullptr);
+}
+
+TEST_F(SymbolTableTests, InnerDeclarationShadowsOuter)
+{
+    SymbolId count = m_Names.Intern("count");
+    SymbolId total = m_Names.Intern("total");
+    SymbolTable symbols(m_Names);
+    llvm::Value *outer = MakeValue(1);
+    llvm::Value *inner = MakeValue(2);
+    llvm::Value *sum = MakeValue(3);
+
+    symbols.PushScope();
+    symbols.Declare(count, outer);
+    symbols.Declare(total, sum);
+
+    symbols.PushScope();
+    symbols.Declare(count, inner);
+    EXPECT_EQ(symbols.Lookup(count), inner);
+    EXPECT_EQ(symbols.Lookup(total), sum);
+
+    std::vector<std::pair<SymbolId, llvm::Value *>> visible = symbols.GetVisible();
+    ASSERT_EQ(visible.size(), 2u);
+    EXPECT_EQ(visible[0], std::make_pair(count, inner));
+    EXPECT_EQ(visible[1], std::make_pair(total, sum));
+
+    symbols.PopScope();
+    EXPECT_EQ(symbols.Lookup(count), outer);
+    EXPECT_EQ(symbols.Lookup(total), sum);
+}
+
+// The undo stack has an entry per declaration, popping replays them in reverse down to the outer binding
+TEST_F(SymbolTableTests, RedeclarationInOneScopeRestoresOuterOnPop)
+{
+    SymbolId count = m_Names.Intern("count");
+    SymbolTable symbols(m_Names);
+    llvm::Value *outer = MakeValue(1);
+    llvm::Value *first = MakeValue(2);
+    llvm::Value *second = MakeValue(3);
+
+    symbols.PushScope();
+    symbols.Declare(count, outer);
+
+    symbols.PushScope();
+    symbols.Declare(count, first);
+    symbols.Declare(count, second);
+    EXPECT_EQ(symbols.Lookup(count), second);
+
+    symbols.PopScope();
+    EXPECT_EQ(symbols.Lookup(count), outer);
+
+    symbols.PopScope();
+    EXPECT_EQ(symbols.Lookup(count), nullptr);
+}
+
+// Units share the interner, a later unit may intern names after the table was sized
+TEST_F(SymbolTableTests, DeclaresNamesInternedAfterConstruction)
+{
+    SymbolTable symbols(m_Names);
+    llvm::Value *value = MakeValue(1);
+
+    SymbolId late = m_Names.Intern("late");
+
+    for (int i = 0; i < 100; ++i)
+    {
+        m_Names.Intern("filler" + std::to_string(i));
+    }
+
+    SymbolId last = m_Names.Intern("last");
+
+    EXPECT_EQ(symbols.Lookup(last), nullptr);
+
+    symbols.PushScope();
+    symbols.Declare(late, value);
+    symbols.Declare(last, value);
+    EXPECT_EQ(symbols.Lookup(late), value);
+    EXPECT_EQ(symbols.Lookup(last), value);
+
+    symbols.PopScope();
+    EXPECT_EQ(symbols.Lookup(late), nullptr);
+    EXPECT_EQ(symbols.Lookup(last), nullptr);
+}
@@ -0,0 +1,70 @@
+#include "Parser/TokenStream.h"
+
+#include <gtest/gtest.h>
+
+using namespace jlang;
+
+namespace
+{
+
+std::vector<Token> MakeTokens()
+{
+    return {Token(TokenType::Var, "var", 1), Token(TokenType::Identifier, "count", 1),
+            Token(TokenType::Int32, "int32", 1), Token(TokenType::Semicolon, ";", 1),
+            Token(TokenType::EndOfFile, "", 1)};
+}
+
+} // namespace
+
+TEST(TokenStreamTests, PeeksUpToMaxLookahead)
+{
+    std::vector<Token> tokens = MakeTokens();
+    TokenStream stream(tokens);
+
+    EXPECT_EQ(stream.Peek(TokenStream::MaxLookahead).m_lexeme, "int32");
+    EXPECT_EQ(stream.Peek().m_lexeme, "var");
+
+    stream.Advance();
+
+    EXPECT_EQ(stream.Previous().m_lexeme, "var");
+    EXPECT_EQ(stream.Peek(TokenStream::MaxLookahead).m_lexeme, ";");
+    EXPECT_EQ(stream.Previous().m_lexeme, "var");
+}
+
+// Clamping would hand back a nearer token and the parser would decide on the wrong one
+TEST(TokenStreamDeathTest, PeekBeyondMaxLookaheadAsserts)
+{
+    std::vector<Token> tokens = MakeTokens();
+    TokenStream stream(tokens);
+
+    EXPECT_DEATH(stream.Peek(TokenStream::MaxLookahead + 1), "JLANG ASSERT FAILED");
+}
+
+// Lazily skipped bodies are parsed after a Seek; Previous() must then be the token before the new position,
+// not a stale slot from where the stream was
+TEST(TokenStreamTests, SeekRepositionsPrevious)
+{
+    std::vector<Token> tokens = MakeTokens();
+    TokenStream stream(tokens);
+
+    stream.Advance();
+    stream.Advance();
+    stream.Advance();
+    EXPECT_EQ(stream.Previous().m_lexeme, "int32");
+
+    stream.Seek(2);
+
+    EXPECT_EQ(stream.GetIndex(), 2u);
+    EXPECT_EQ(stream.Previous().m_lexeme, "count");
+    EXPECT_EQ(stream.Peek().m_lexeme, "int32");
+
+    stream.Advance();
+
+    EXPECT_EQ(stream.Previous().m_lexeme, "int32");
+    EXPECT_EQ(stream.Peek().m_lexeme, ";");
+
+    stream.Seek(0);
+
+    EXPECT_EQ(stream.Previous().m_type, TokenType::EndOfFile);
+    EXPECT_EQ(stream.Peek().m_lexeme, "var");
+}